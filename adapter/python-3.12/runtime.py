@@ -1,9 +1,10 @@
 import asyncio
+import ctypes
 import os
 import runpy
 import selectors
 import sys
-import time
+from collections.abc import Mapping
 try:
     import tomllib  # Python 3.11+
 except ModuleNotFoundError:  # pragma: no cover
@@ -12,45 +13,202 @@ except ModuleNotFoundError:  # pragma: no cover
     except ModuleNotFoundError:  # pragma: no cover
         tomllib = None
 
-from ukernel_abi import CAP_LOG, UkernelAbi, OK
+from ukernel_abi import (
+    CAP_LOG,
+    IO_ERROR,
+    IO_HANGUP,
+    IO_READABLE,
+    IO_WRITABLE,
+    IoEvent,
+    OK,
+    UkernelAbi,
+)
+
+
+# Bound on an unbounded select(): with the ABI there is no self-pipe, so
+# call_soon_threadsafe callbacks wait at most this long for the next turn
+_IDLE_WAIT_NS = 1_000_000_000
+
+
+class _KeyMapping(Mapping):
+    """Read-only fileobj -> SelectorKey view for get_map()."""
+
+    def __init__(self, selector):
+        self._selector = selector
+
+    def __len__(self):
+        return len(self._selector._keys)
+
+    def __getitem__(self, fileobj):
+        try:
+            return self._selector._keys[self._selector._handle_of(fileobj)]
+        except ValueError:
+            raise KeyError(fileobj) from None
+
+    def __iter__(self):
+        return iter(self._selector._keys)
 
 
 class UkernelSelector(selectors.BaseSelector):
+    """Selector whose wait is one batched io_poll over ABI handles.
+
+    Registered objects are ABI handles (ints) or objects whose fileno()
+    returns one; SelectorKey.fd is the handle. The handle and interest
+    arrays persist across calls and are rebuilt only when registrations
+    change. Without the ABI library (a development host) everything is
+    delegated to selectors.DefaultSelector.
+    """
+
     def __init__(self, abi):
         super().__init__()
         self._abi = abi
-        self._base = selectors.DefaultSelector()
+        self._native = bool(abi and abi.available)
+        self._base = None if self._native else selectors.DefaultSelector()
+        self._keys = {}  # handle -> SelectorKey
+        self._map = _KeyMapping(self)
+        self._dirty = False
+        self._capacity = 0
+        self._handles = None
+        self._interest = None
+        self._events = None
+
+    @staticmethod
+    def _handle_of(fileobj):
+        if isinstance(fileobj, int):
+            return fileobj
+        try:
+            return int(fileobj.fileno())
+        except (AttributeError, TypeError, ValueError):
+            raise ValueError(f"Invalid file object: {fileobj!r}") from None
+
+    def _lookup(self, fileobj):
+        try:
+            return self._keys[self._handle_of(fileobj)]
+        except KeyError:
+            raise KeyError(f"{fileobj!r} is not registered") from None
 
     def register(self, fileobj, events, data=None):
-        return self._base.register(fileobj, events, data)
+        if self._base is not None:
+            return self._base.register(fileobj, events, data)
+        if not events or events & ~(selectors.EVENT_READ | selectors.EVENT_WRITE):
+            raise ValueError(f"Invalid events: {events!r}")
+        handle = self._handle_of(fileobj)
+        if handle in self._keys:
+            raise KeyError(f"{fileobj!r} (handle {handle:#x}) is already registered")
+        key = selectors.SelectorKey(fileobj, handle, events, data)
+        self._keys[handle] = key
+        self._dirty = True
+        return key
 
     def unregister(self, fileobj):
-        return self._base.unregister(fileobj)
+        if self._base is not None:
+            return self._base.unregister(fileobj)
+        key = self._lookup(fileobj)
+        del self._keys[key.fd]
+        self._dirty = True
+        return key
 
     def modify(self, fileobj, events, data=None):
-        return self._base.modify(fileobj, events, data)
+        if self._base is not None:
+            return self._base.modify(fileobj, events, data)
+        if not events or events & ~(selectors.EVENT_READ | selectors.EVENT_WRITE):
+            raise ValueError(f"Invalid events: {events!r}")
+        key = self._lookup(fileobj)
+        if events != key.events:
+            self._dirty = True
+        key = key._replace(events=events, data=data)
+        self._keys[key.fd] = key
+        return key
+
+    def _rebuild(self):
+        count = len(self._keys)
+        if count > self._capacity:
+            self._capacity = max(16, 1 << (count - 1).bit_length())
+            self._handles = (ctypes.c_uint64 * self._capacity)()
+            self._interest = (IoEvent * self._capacity)()
+            self._events = (IoEvent * self._capacity)()
+        for i, key in enumerate(self._keys.values()):
+            mask = 0
+            if key.events & selectors.EVENT_READ:
+                mask |= IO_READABLE
+            if key.events & selectors.EVENT_WRITE:
+                mask |= IO_WRITABLE
+            self._handles[i] = key.fd
+            self._interest[i].events = mask
+        self._dirty = False
 
     def select(self, timeout=None):
-        if self.get_map() and len(self.get_map()) > 0:
+        if self._base is not None:
             return self._base.select(timeout)
 
         if timeout is None:
-            timeout_ns = 1_000_000_000
+            timeout_ns = _IDLE_WAIT_NS
         else:
             timeout_ns = max(0, int(timeout * 1_000_000_000))
 
-        if self._abi and self._abi.available:
-            self._abi.io_poll(timeout_ns)
-        else:
-            time.sleep(timeout or 0)
-
-        return []
+        if not self._keys:
+            # Nothing registered: io_poll with no handles is a deadline sleep
+            if timeout_ns > 0:
+                self._abi.io_poll(timeout_ns)
+            return []
+
+        if self._dirty:
+            self._rebuild()
+        res, ready = self._abi.io_poll_handles(
+            self._handles, self._interest, self._events, len(self._keys), timeout_ns
+        )
+        if res != OK:
+            # ERR_WOULD_BLOCK / ERR_TIMEOUT: nothing became ready
+            return []
+
+        result = []
+        for i in range(ready):
+            ev = self._events[i]
+            key = self._keys.get(ev.handle)
+            if key is None:
+                continue
+            events = 0
+            if ev.events & (IO_READABLE | IO_HANGUP | IO_ERROR):
+                events |= selectors.EVENT_READ
+            if ev.events & (IO_WRITABLE | IO_HANGUP | IO_ERROR):
+                events |= selectors.EVENT_WRITE
+            events &= key.events
+            if events:
+                result.append((key, events))
+        return result
 
     def close(self):
-        return self._base.close()
+        if self._base is not None:
+            return self._base.close()
+        self._keys.clear()
+        self._handles = self._interest = self._events = None
+        self._capacity = 0
 
     def get_map(self):
-        return self._base.get_map()
+        if self._base is not None:
+            return self._base.get_map()
+        return self._map
+
+
+class UkernelEventLoop(asyncio.SelectorEventLoop):
+    """SelectorEventLoop without the self-pipe when waiting on ABI handles.
+
+    The self-pipe is an OS socket pair, which io_poll cannot wait on.
+    Cross-thread wakeups instead land on the next loop turn, at most
+    _IDLE_WAIT_NS away.
+    """
+
+    def _make_self_pipe(self):
+        if not self._selector._native:
+            return super()._make_self_pipe()
+        self._ssock = None
+        self._csock = None
+        self._internal_fds = 0
+
+    def _close_self_pipe(self):
+        if self._ssock is None:
+            return
+        super()._close_self_pipe()
 
 
 class UkernelEventLoopPolicy(asyncio.DefaultEventLoopPolicy):
@@ -60,7 +218,7 @@ class UkernelEventLoopPolicy(asyncio.DefaultEventLoopPolicy):
 
     def new_event_loop(self):
         selector = UkernelSelector(self._abi)
-        return asyncio.SelectorEventLoop(selector)
+        return UkernelEventLoop(selector)
 
 
 def _read_config(root):
@@ -22,6 +22,22 @@ CAP_IO = 5
 CAP_IPC = 6
 CAP_NET = 7
 CAP_TRACE = 8
+CAP_NET_RAW = 9
+
+IO_READABLE = 0x01
+IO_WRITABLE = 0x02
+IO_HANGUP = 0x04
+IO_ERROR = 0x08
+# io_poll count flag: events_out carries per-handle interest masks
+IO_POLL_INTEREST = 0x80000000
+
+
+class IoEvent(ctypes.Structure):
+    _fields_ = [
+        ("handle", ctypes.c_uint64),
+        ("events", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+    ]
 
 
 class UkernelAbi:
@@ -134,3 +150,23 @@ class UkernelAbi:
             ctypes.byref(count_out),
         )
 
+    def io_poll_handles(self, handles, interest, events, count, timeout_ns):
+        """One io_poll over `count` handles; returns (result, ready count).
+
+        handles is a c_uint64 array, interest and events are IoEvent arrays.
+        events is refilled from interest before the call, so the kernel
+        reports only the events each handle asked for; ready entries come
+        back in events[:ready].
+        """
+        if not self.available:
+            return ERR_UNSUPPORTED, 0
+        ctypes.memmove(events, interest, ctypes.sizeof(IoEvent) * count)
+        count_out = ctypes.c_uint32(0)
+        res = self._lib.io_poll(
+            handles,
+            ctypes.c_uint32(count | IO_POLL_INTEREST),
+            ctypes.c_uint64(timeout_ns),
+            ctypes.c_uint64(ctypes.addressof(events)),
+            ctypes.byref(count_out),
+        )
+        return res, count_out.value
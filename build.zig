@@ -1,5 +1,95 @@
 const std = @import("std");
 
+const Profile = enum {
+    /// Every driver and runtime, demo workload included (the default)
+    full,
+    /// Production: drivers and MicroPython, no demo workload
+    prod,
+    /// MicroPython + virtio-net; no block device, entrypoint embedded
+    net,
+    /// Demo workload only: no drivers, no MicroPython
+    minimal,
+
+    fn defaults(self: Profile) KernelConfig {
+        return switch (self) {
+            .full => .{},
+            .prod => .{ .demo_workload = false, .pcap = false },
+            .net => .{
+                .blk = false,
+                .disk_log = false,
+                .demo_workload = false,
+                .abi_trace = false,
+                .pcap = false,
+                .max_io = 8,
+                .abi_heap_kb = 256,
+                .mp_heap_kb = 2048,
+                .mp_exec_kb = 128,
+                .rootfs_cache_kb = 0,
+            },
+            .minimal => .{
+                .blk = false,
+                .disk_log = false,
+                .net = false,
+                .balloon = false,
+                .micropython = false,
+                .abi_ring = false,
+                .abi_trace = false,
+                .pcap = false,
+                .max_io = 8,
+                .max_net = 1,
+                .udp_sockets = 1,
+                .net_max_mtu = 1500,
+                .ip_reasm_kb = 2,
+                .udp_rx_kb = 2,
+                .abi_heap_kb = 64,
+                .mp_exec_kb = 0,
+                .rootfs_cache_kb = 0,
+            },
+        };
+    }
+};
+
+/// Compile-time kernel configuration, exported to kernel/config.zig
+/// through the build_options module.
+const KernelConfig = struct {
+    blk: bool = true,
+    /// Append-only record log on the second virtio-blk drive
+    disk_log: bool = true,
+    net: bool = true,
+    /// Raw frame rings for packet-processing workloads (net_frame_*)
+    net_raw: bool = true,
+    /// virtio-balloon: free page reporting and host-set balloon size
+    balloon: bool = true,
+    micropython: bool = true,
+    demo_workload: bool = true,
+    bench: bool = false,
+    abi_ring: bool = true,
+    abi_trace: bool = true,
+    /// Packet capture ring drained to serial (`ukernel pcap`)
+    pcap: bool = true,
+    max_io: u32 = 32,
+    max_net: u32 = 16,
+    udp_sockets: u32 = 16,
+    virtq_size: u32 = 16,
+    net_rx_bufs: u32 = 8,
+    /// Largest MTU the virtio-net buffers hold (jumbo frames up to 9000)
+    net_max_mtu: u32 = 9000,
+    /// Largest IPv4 datagram reassembled from fragments, in KiB
+    ip_reasm_kb: u32 = 16,
+    /// Receive buffer per UDP socket in KiB; longer datagrams are truncated
+    udp_rx_kb: u32 = 16,
+    pcap_kb: u32 = 256,
+    /// Bytes of each frame kept in the capture ring
+    pcap_snaplen: u32 = 128,
+    abi_heap_kb: u32 = 1024,
+    mp_heap_kb: u32 = 4096,
+    mp_heap_init_kb: u32 = 256,
+    mp_exec_kb: u32 = 256,
+    rootfs_cache_kb: u32 = 512,
+    /// 0: same as mp_heap_kb
+    page_pool_kb: u32 = 0,
+};
+
 pub fn build(b: *std.Build) void {
     const target_query = std.Target.Query{
         .cpu_arch = .x86_64,
@@ -9,6 +99,111 @@ pub fn build(b: *std.Build) void {
     const target = b.resolveTargetQuery(target_query);
     const optimize = b.standardOptimizeOption(.{});
 
+    // Per-ABI-call counters and latency histograms (task_get_stats)
+    const abi_stats = b.option(bool, "abi-stats", "Record per-ABI-call counters and latency histograms") orelse false;
+    const build_options = b.addOptions();
+    build_options.addOption(bool, "abi_stats", abi_stats);
+
+    // Kernel profile: picks defaults for every subsystem and table size
+    // below; each one can still be overridden with its own -D option.
+    const profile = b.option(Profile, "profile", "Kernel profile: full, prod, net or minimal (default full)") orelse .full;
+    const defaults = profile.defaults();
+    const blk = b.option(bool, "blk", "Compile in the virtio-blk driver and tar rootfs loader") orelse defaults.blk;
+    const net = b.option(bool, "net", "Compile in virtio-net, the UDP stack and the net_* ABI") orelse defaults.net;
+    var cfg = KernelConfig{
+        .blk = blk,
+        // Follows -Dblk unless set explicitly
+        .disk_log = b.option(bool, "disk-log", "Append-only record log on the second virtio-blk drive (io_open(\"disklog\"))") orelse (defaults.disk_log and blk),
+        .net = net,
+        // Follows -Dnet unless set explicitly
+        .net_raw = b.option(bool, "net-raw", "Raw frame rings steered from virtio-net (net_frame_*, CAP_NET_RAW)") orelse (defaults.net_raw and net),
+        .balloon = b.option(bool, "balloon", "Compile in the virtio-balloon driver (free page reporting, mem_trim)") orelse defaults.balloon,
+        .micropython = b.option(bool, "micropython", "Link the MicroPython runtime") orelse defaults.micropython,
+        .demo_workload = b.option(bool, "demo-workload", "Run the built-in ABI demo workload at boot") orelse defaults.demo_workload,
+        .bench = b.option(bool, "bench", "Run the in-guest microbenchmarks instead of the workload") orelse defaults.bench,
+        .abi_ring = b.option(bool, "abi-ring", "Compile in the io_ring_* ABI") orelse defaults.abi_ring,
+        .abi_trace = b.option(bool, "abi-trace", "Compile in the trace_* ABI") orelse defaults.abi_trace,
+        .pcap = b.option(bool, "pcap", "Capture virtio-net frames and drop reasons into a ring drained to serial") orelse defaults.pcap,
+        .max_io = b.option(u32, "max-io", "I/O handle table size") orelse defaults.max_io,
+        .max_net = b.option(u32, "max-net", "Network handle table size") orelse defaults.max_net,
+        .udp_sockets = b.option(u32, "udp-sockets", "UDP socket table size") orelse defaults.udp_sockets,
+        .virtq_size = b.option(u32, "virtq-size", "Virtqueue depth for virtio devices (power of two)") orelse defaults.virtq_size,
+        .net_rx_bufs = b.option(u32, "net-rx-bufs", "Pre-posted virtio-net receive buffers") orelse defaults.net_rx_bufs,
+        .net_max_mtu = b.option(u32, "net-max-mtu", "Largest MTU accepted from the virtio-net device, 1500 to 9000") orelse defaults.net_max_mtu,
+        .ip_reasm_kb = b.option(u32, "ip-reasm-kb", "Largest IPv4 datagram reassembled from fragments in KiB (1 to 64)") orelse defaults.ip_reasm_kb,
+        .udp_rx_kb = b.option(u32, "udp-rx-kb", "Receive buffer per UDP socket in KiB (1 to 64); longer datagrams are truncated") orelse defaults.udp_rx_kb,
+        .pcap_kb = b.option(u32, "pcap-kb", "Packet capture ring size in KiB") orelse defaults.pcap_kb,
+        .pcap_snaplen = b.option(u32, "pcap-snaplen", "Bytes captured per frame, 14 to 9014") orelse defaults.pcap_snaplen,
+        .abi_heap_kb = b.option(u32, "abi-heap-kb", "mem_alloc heap size in KiB") orelse defaults.abi_heap_kb,
+        .mp_heap_kb = b.option(u32, "mp-heap-kb", "MicroPython GC heap limit in KiB") orelse defaults.mp_heap_kb,
+        .mp_heap_init_kb = b.option(u32, "mp-heap-init-kb", "Initial MicroPython GC heap in KiB (grows up to -Dmp-heap-kb)") orelse defaults.mp_heap_init_kb,
+        .mp_exec_kb = b.option(u32, "mp-exec-kb", "Executable arena for native/viper code in KiB (0 disables the emitters)") orelse defaults.mp_exec_kb,
+        .rootfs_cache_kb = b.option(u32, "rootfs-cache-kb", "Cache for rootfs files outside the boot prefetch, in KiB") orelse defaults.rootfs_cache_kb,
+        .page_pool_kb = b.option(u32, "page-pool-kb", "Kernel page pool in KiB (default: -Dmp-heap-kb)") orelse defaults.page_pool_kb,
+    };
+    if (!std.math.isPowerOfTwo(cfg.virtq_size) or cfg.virtq_size < 4 or cfg.virtq_size > 256) {
+        std.debug.panic("-Dvirtq-size must be a power of two between 4 and 256, got {d}", .{cfg.virtq_size});
+    }
+    if (cfg.disk_log and !cfg.blk) {
+        std.debug.panic("-Ddisk-log needs -Dblk", .{});
+    }
+    if (cfg.net_raw and !cfg.net) {
+        std.debug.panic("-Dnet-raw needs -Dnet", .{});
+    }
+    // Every net handle indexes a UDP socket
+    if (cfg.max_net > cfg.udp_sockets) {
+        std.debug.panic("-Dmax-net ({d}) must not exceed -Dudp-sockets ({d})", .{ cfg.max_net, cfg.udp_sockets });
+    }
+    if (cfg.net_rx_bufs == 0 or cfg.net_rx_bufs > cfg.virtq_size) {
+        std.debug.panic("-Dnet-rx-bufs must be between 1 and -Dvirtq-size, got {d}", .{cfg.net_rx_bufs});
+    }
+    if (cfg.net_max_mtu < 1500 or cfg.net_max_mtu > 9000) {
+        std.debug.panic("-Dnet-max-mtu must be between 1500 and 9000, got {d}", .{cfg.net_max_mtu});
+    }
+    if (cfg.ip_reasm_kb == 0 or cfg.ip_reasm_kb > 64) {
+        std.debug.panic("-Dip-reasm-kb must be between 1 and 64, got {d}", .{cfg.ip_reasm_kb});
+    }
+    if (cfg.udp_rx_kb == 0 or cfg.udp_rx_kb > 64) {
+        std.debug.panic("-Dudp-rx-kb must be between 1 and 64, got {d}", .{cfg.udp_rx_kb});
+    }
+    if (cfg.pcap_snaplen < 14 or cfg.pcap_snaplen > 9014) {
+        std.debug.panic("-Dpcap-snaplen must be between 14 and 9014, got {d}", .{cfg.pcap_snaplen});
+    }
+    if (cfg.pcap and cfg.pcap_kb * 1024 < cfg.pcap_snaplen + 16) {
+        std.debug.panic("-Dpcap-kb is too small for one -Dpcap-snaplen frame", .{});
+    }
+    if (cfg.page_pool_kb == 0) cfg.page_pool_kb = cfg.mp_heap_kb;
+    if (cfg.mp_heap_init_kb == 0 or cfg.mp_heap_init_kb > cfg.mp_heap_kb) {
+        std.debug.panic("-Dmp-heap-init-kb must be between 1 and -Dmp-heap-kb, got {d}", .{cfg.mp_heap_init_kb});
+    }
+    if (cfg.mp_heap_kb > cfg.page_pool_kb) {
+        std.debug.panic("-Dmp-heap-kb ({d}) does not fit in -Dpage-pool-kb ({d})", .{ cfg.mp_heap_kb, cfg.page_pool_kb });
+    }
+    inline for (@typeInfo(KernelConfig).@"struct".fields) |field| {
+        build_options.addOption(field.type, field.name, @field(cfg, field.name));
+    }
+
+    // Python source (or .mpy bytecode) compiled into the image, run when
+    // there is no rootfs (profiles without virtio-blk).
+    const entry_source_path = b.option([]const u8, "entry-source", "Python entrypoint (.py or .mpy) to embed in the kernel image");
+    var entry_source: []const u8 = "";
+    if (entry_source_path) |path| {
+        entry_source = b.build_root.handle.readFileAlloc(b.allocator, path, 1024 * 1024) catch |err| {
+            std.debug.panic("-Dentry-source: cannot read {s}: {s}", .{ path, @errorName(err) });
+        };
+    }
+    build_options.addOption([]const u8, "entry_source", entry_source);
+
+    // Frozen bytecode: a frozen_content.c produced by mpy-tool.py from
+    // mpy-cross output (scripts/ukernel build does this). -Dfrozen-entry
+    // names the frozen module to run as __main__ instead of src/main.py.
+    const frozen_content = b.option([]const u8, "frozen-content", "mpy-tool.py frozen_content.c to link into MicroPython");
+    const frozen_entry = b.option([]const u8, "frozen-entry", "Frozen module to run as the entrypoint (e.g. main.py)") orelse "";
+    if (frozen_entry.len > 0 and frozen_content == null) {
+        std.debug.panic("-Dfrozen-entry needs -Dfrozen-content", .{});
+    }
+    build_options.addOption([]const u8, "frozen_entry", frozen_entry);
+
     const exe_module = b.createModule(.{
         .root_source_file = b.path("kernel/main.zig"),
         .target = target,
@@ -17,6 +212,7 @@ pub fn build(b: *std.Build) void {
         .code_model = .kernel,
         .pic = false,
     });
+    exe_module.addOptions("build_options", build_options);
     const exe = b.addExecutable(.{
         .name = "ukernel",
         .root_module = exe_module,
@@ -93,23 +289,11 @@ pub fn build(b: *std.Build) void {
         mp_root ++ "py/compile.c",
         mp_root ++ "py/emitcommon.c",
         mp_root ++ "py/emitbc.c",
+        // Native/viper emitter: x86-64 only, the other targets' backends
+        // would compile to nothing
         mp_root ++ "py/asmbase.c",
         mp_root ++ "py/asmx64.c",
         mp_root ++ "py/emitnx64.c",
-        mp_root ++ "py/asmx86.c",
-        mp_root ++ "py/emitnx86.c",
-        mp_root ++ "py/asmthumb.c",
-        mp_root ++ "py/emitnthumb.c",
-        mp_root ++ "py/emitinlinethumb.c",
-        mp_root ++ "py/asmarm.c",
-        mp_root ++ "py/emitnarm.c",
-        mp_root ++ "py/asmxtensa.c",
-        mp_root ++ "py/emitnxtensa.c",
-        mp_root ++ "py/emitinlinextensa.c",
-        mp_root ++ "py/emitnxtensawin.c",
-        mp_root ++ "py/asmrv32.c",
-        mp_root ++ "py/emitnrv32.c",
-        mp_root ++ "py/emitndebug.c",
         mp_root ++ "py/emitnative.c",
         mp_root ++ "py/formatfloat.c",
         mp_root ++ "py/parsenumbase.c",
@@ -195,11 +379,18 @@ pub fn build(b: *std.Build) void {
         mp_root ++ "py/frozenmod.c",
     };
 
+    // extmod modules behind asyncio (the port supplies 'select')
+    const mp_extmod_sources: []const []const u8 = &.{
+        mp_root ++ "extmod/modasyncio.c",
+        mp_root ++ "extmod/modtime.c",
+    };
+
     // Port-specific sources
     const mp_port_sources: []const []const u8 = &.{
         mp_port ++ "mphalport.c",
         mp_port ++ "mp_main.c",
         mp_port ++ "modukernel.c",
+        mp_port ++ "modselect.c",
         "kernel/libc_shim.c",
         mp_root ++ "shared/runtime/stdout_helpers.c",
     };
@@ -224,18 +415,40 @@ pub fn build(b: *std.Build) void {
         mp_lib.addIncludePath(b.path(inc));
     }
 
+    // Config-dependent defines apply to every MicroPython source, so the
+    // core and the port agree: freezing switches on
+    // MICROPY_MODULE_FROZEN_MPY, and without an exec arena there is no
+    // native emitter
+    var mp_extra_flags: []const []const u8 = &.{};
+    if (frozen_content != null) {
+        mp_extra_flags = std.mem.concat(b.allocator, []const u8, &.{ mp_extra_flags, &.{"-DMICROPY_MODULE_FROZEN_MPY=1"} }) catch @panic("OOM");
+    }
+    if (cfg.mp_exec_kb == 0) {
+        mp_extra_flags = std.mem.concat(b.allocator, []const u8, &.{ mp_extra_flags, &.{"-DMICROPY_EMIT_X64=0"} }) catch @panic("OOM");
+    }
+    const mp_flags = std.mem.concat(b.allocator, []const u8, &.{ mp_c_flags, mp_extra_flags }) catch @panic("OOM");
+
     mp_lib.addCSourceFiles(.{
         .files = mp_py_sources,
-        .flags = mp_c_flags,
+        .flags = mp_flags,
+    });
+
+    mp_lib.addCSourceFiles(.{
+        .files = mp_extmod_sources,
+        .flags = mp_flags,
     });
 
     mp_lib.addCSourceFiles(.{
         .files = mp_port_sources,
-        .flags = mp_c_flags,
+        .flags = mp_flags,
     });
 
+    if (frozen_content) |path| {
+        mp_lib.addCSourceFile(.{ .file = b.path(path), .flags = mp_flags });
+    }
+
     // Link MicroPython library into the kernel
-    exe.linkLibrary(mp_lib);
+    if (cfg.micropython) exe.linkLibrary(mp_lib);
 
     // Also add include paths to kernel exe for C header resolution
     for (mp_include_paths) |inc| {
@@ -245,15 +458,54 @@ pub fn build(b: *std.Build) void {
     b.installArtifact(exe);
 
     const test_target = b.standardTargetOptions(.{});
-    const abi_module = b.createModule(.{
-        .root_source_file = b.path("kernel/abi.zig"),
+    const test_step = b.step("test", "Run kernel unit tests");
+    const test_roots = [_][]const u8{
+        "kernel/abi.zig",
+        "kernel/abi_stats.zig",
+        "kernel/balloon.zig",
+        "kernel/bench.zig",
+        "kernel/bundle.zig",
+        "kernel/boottime.zig",
+        "kernel/clock.zig",
+        "kernel/disk_log.zig",
+        "kernel/exec_arena.zig",
+        "kernel/frame_ring.zig",
+        "kernel/gc_stats.zig",
+        "kernel/io_ring.zig",
+        "kernel/net.zig",
+        "kernel/pages.zig",
+        "kernel/pcap.zig",
+        "kernel/readiness.zig",
+        "kernel/rootfs.zig",
+        "kernel/serial.zig",
+        "kernel/timer.zig",
+        "kernel/trace.zig",
+        "kernel/virtio_mock.zig",
+    };
+    for (test_roots) |root| {
+        const test_module = b.createModule(.{
+            .root_source_file = b.path(root),
+            .target = test_target,
+            .optimize = optimize,
+        });
+        test_module.addOptions("build_options", build_options);
+        const unit_tests = b.addTest(.{
+            .root_module = test_module,
+        });
+        test_step.dependOn(&b.addRunArtifact(unit_tests).step);
+    }
+
+    // Driver microbenchmarks against the virtio device models, on the host
+    const host_bench_module = b.createModule(.{
+        .root_source_file = b.path("kernel/host_bench.zig"),
         .target = test_target,
         .optimize = optimize,
     });
-    const abi_tests = b.addTest(.{
-        .root_module = abi_module,
+    host_bench_module.addOptions("build_options", build_options);
+    const host_bench = b.addExecutable(.{
+        .name = "host-bench",
+        .root_module = host_bench_module,
     });
-    const run_abi_tests = b.addRunArtifact(abi_tests);
-    const test_step = b.step("test", "Run kernel unit tests");
-    test_step.dependOn(&run_abi_tests.step);
+    const bench_step = b.step("bench", "Run driver microbenchmarks against the host virtio models");
+    bench_step.dependOn(&b.addRunArtifact(host_bench).step);
 }
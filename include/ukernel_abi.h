@@ -51,7 +51,8 @@ enum {
   CAP_IO = 5,
   CAP_IPC = 6,
   CAP_NET = 7,
-  CAP_TRACE = 8
+  CAP_TRACE = 8,
+  CAP_NET_RAW = 9
 };
 
 /* Handle tags (upper 8 bits) */
@@ -61,7 +62,11 @@ enum {
   HANDLE_IPC = 0x03,
   HANDLE_NET = 0x04,
   HANDLE_CAP = 0x05,
-  HANDLE_SPAN = 0x06
+  HANDLE_SPAN = 0x06,
+  HANDLE_TIMER = 0x07,
+  HANDLE_IOSET = 0x08,
+  HANDLE_RING = 0x09,
+  HANDLE_FRAME = 0x0A
 };
 
 /* Extended error info (optional) */
@@ -93,9 +98,54 @@ result_t task_set_priority(handle_t task, u32 priority);
 result_t task_get_stats(handle_t task, ptr_t stats_out);
 result_t task_exit(i32 code);
 
+/* ABI call ids for task_stats_t.calls[], in kernel export order */
+#define UKERNEL_ABI_CALLS(X) \
+  X(cap_acquire) X(cap_drop) X(cap_enter) X(cap_exit) \
+  X(abi_version) X(abi_features) X(abi_feature_enabled) \
+  X(task_spawn) X(task_yield) X(task_sleep) X(task_set_priority) \
+  X(task_get_stats) X(task_exit) \
+  X(time_now) X(time_deadline) X(time_cancel) \
+  X(mem_alloc) X(mem_free) X(mem_map) X(mem_share) X(mem_unshare) \
+  X(io_open) X(io_read) X(io_write) X(io_close) X(io_poll) \
+  X(io_set_create) X(io_set_ctl) X(io_set_wait) X(io_set_close) \
+  X(io_ring_setup) X(io_ring_enter) X(io_ring_close) \
+  X(ipc_channel_create) X(ipc_send) X(ipc_recv) X(ipc_close) \
+  X(net_socket) X(net_bind) X(net_connect) X(net_send) X(net_recv) X(net_close) \
+  X(log_write) X(log_set_level) X(log_dropped) \
+  X(trace_span_begin) X(trace_span_end) X(trace_event) \
+  X(mem_balloon_stats) X(mem_trim) \
+  X(net_frame_setup) X(net_frame_sync) X(net_frame_close)
+
+#define UKERNEL_ABI_CALL_ID(name) ABI_CALL_##name,
+enum { UKERNEL_ABI_CALLS(UKERNEL_ABI_CALL_ID) ABI_CALL_COUNT };
+#undef UKERNEL_ABI_CALL_ID
+
+#define ABI_STATS_MAX_CALLS   64
+#define ABI_STATS_MAX_RESULTS 12
+
+typedef struct {
+  u64 calls;
+  u64 errors;
+  u64 total_ns;
+  u64 max_ns;
+  u64 p50_ns;
+  u64 p99_ns;
+  u32 results[ABI_STATS_MAX_RESULTS]; /* by result_t; last slot: other codes */
+} abi_call_stats_t;
+
+typedef struct {
+  u64 cpu_time_ns;
+  u64 sched_ticks;
+  u64 context_switches;
+  u32 abi_stats_enabled;  /* kernel built with -Dabi-stats=true */
+  u32 call_count;         /* valid entries in calls[] */
+  abi_call_stats_t calls[ABI_STATS_MAX_CALLS];
+} task_stats_t;
+
 /* Time */
 result_t time_now(time_ns* out);
 result_t time_deadline(time_ns abs, handle_t* handle_out);
+result_t time_cancel(handle_t deadline);
 
 /* Memory */
 result_t mem_alloc(size_t bytes, u32 flags, ptr_t* out_ptr);
@@ -104,12 +154,32 @@ result_t mem_map(ptr_t ptr, size_t bytes, u32 flags);
 result_t mem_share(ptr_t ptr, size_t bytes, handle_t* handle_out);
 result_t mem_unshare(handle_t shared);
 
+/* virtio-balloon (FEAT_BALLOON): sizes in 4 KiB pages */
+typedef struct {
+  u32 target_pages;     /* balloon size the host asked for */
+  u32 balloon_pages;    /* current balloon size */
+  u64 inflated_pages;
+  u64 deflated_pages;
+  u64 reported_pages;   /* free pages handed back by free page reporting */
+  u64 reports;
+  u64 reclaimed_pages;  /* reported pages written again */
+  u32 reporting;        /* the host accepted free page reporting */
+  u32 reserved;
+} mem_balloon_stats_t;
+
+result_t mem_balloon_stats(ptr_t stats_out);
+/* Report free memory now; reported_out (may be NULL) gets the page count */
+result_t mem_trim(u64* reported_out);
+
 /* I/O event flags */
 #define IO_READABLE 0x01
 #define IO_WRITABLE 0x02
 #define IO_HANGUP   0x04
 #define IO_ERROR    0x08
 
+/* io_open flags: on "disklog", io_write returns once the record is durable */
+#define IO_OPEN_SYNC 0x01
+
 typedef struct {
     handle_t handle;
     u32      events;
@@ -121,9 +191,79 @@ result_t io_open(ptr_t path_ptr, u32 flags, handle_t* handle_out);
 result_t io_read(handle_t io, ptr_t buf_ptr, size_t len, size_t* read_out);
 result_t io_write(handle_t io, ptr_t buf_ptr, size_t len, size_t* wrote_out);
 result_t io_close(handle_t io);
+/* io_poll count flag: events_out[i].events holds the interest mask for
+ * handles[i] on entry; only those events (plus HANGUP/ERROR) are reported */
+#define IO_POLL_INTEREST 0x80000000u
+
 result_t io_poll(handle_t* handles, u32 count, time_ns timeout,
                  ptr_t events_out, u32* count_out);
 
+/* Readiness sets */
+#define IO_EDGE     0x80000000u
+
+#define IOSET_ADD 1
+#define IOSET_MOD 2
+#define IOSET_DEL 3
+
+typedef struct {
+    handle_t handle;
+    u64      user_data;
+    u32      events;
+    u32      reserved;
+} io_set_event_t;
+
+result_t io_set_create(u32 flags, handle_t* set_out);
+result_t io_set_ctl(handle_t set, u32 op, handle_t handle, u32 events, u64 user_data);
+result_t io_set_wait(handle_t set, ptr_t events_out, u32 max_events, time_ns timeout,
+                     u32* count_out);
+result_t io_set_close(handle_t set);
+
+/* Submission/completion rings */
+#define IO_RING_OP_NOP     0
+#define IO_RING_OP_READ    1
+#define IO_RING_OP_WRITE   2
+#define IO_RING_OP_SEND    3
+#define IO_RING_OP_RECV    4
+#define IO_RING_OP_TIMEOUT 5
+#define IO_RING_OP_POLL    6
+
+typedef struct {
+    u32 sq_head;
+    u32 sq_tail;
+    u32 cq_head;
+    u32 cq_tail;
+    u32 sq_entries;
+    u32 cq_entries;
+    u32 reserved[10];
+} io_ring_hdr_t;
+
+typedef struct {
+    u8       opcode;
+    u8       flags;
+    u16      reserved0;
+    u32      op_flags;
+    handle_t handle;
+    ptr_t    addr;
+    u64      len;
+    u64      arg;       /* TIMEOUT: relative ns, POLL: event mask */
+    u64      user_data;
+} io_sqe_t;
+
+typedef struct {
+    u64      user_data;
+    u64      value;     /* bytes transferred, or POLL events */
+    result_t result;
+    u32      flags;
+} io_cqe_t;
+
+/* Ring memory: header, then entries SQEs, then 2 * entries CQEs */
+#define IO_RING_SIZE(entries) \
+    (sizeof(io_ring_hdr_t) + (entries) * sizeof(io_sqe_t) + 2 * (entries) * sizeof(io_cqe_t))
+
+result_t io_ring_setup(ptr_t mem, size_t len, u32 entries, handle_t* ring_out);
+result_t io_ring_enter(handle_t ring, u32 min_complete, time_ns timeout, u32* submitted_out);
+result_t io_ring_close(handle_t ring);
+
 /* IPC */
 result_t ipc_channel_create(u32 flags, handle_t* handle_out);
 result_t ipc_send(handle_t ch, ptr_t buf_ptr, size_t len, u32 flags);
@@ -138,8 +278,50 @@ result_t net_send(handle_t sock, ptr_t buf_ptr, size_t len, u32 flags, size_t* w
 result_t net_recv(handle_t sock, ptr_t buf_ptr, size_t len, u32 flags, size_t* read_out);
 result_t net_close(handle_t sock);
 
+/* Raw frame rings (CAP_NET_RAW) */
+#define NET_FRAME_SLOT_SIZE 2048
+
+typedef struct {
+    u32 rx_head;       /* workload consumes RX descriptors from here */
+    u32 rx_tail;       /* kernel */
+    u32 tx_head;       /* kernel: descriptors before it are free again */
+    u32 tx_tail;       /* workload queues TX descriptors here */
+    u32 entries;
+    u32 slot_size;     /* NET_FRAME_SLOT_SIZE */
+    u32 slots_offset;  /* from the ring base to slot 0 */
+    u32 rx_dropped;
+    u32 tx_errors;
+    u32 reserved[7];
+} net_frame_hdr_t;
+
+typedef struct {
+    u32 slot;          /* 0 .. 2 * entries - 1 */
+    u16 len;
+    u16 flags;
+} net_frame_desc_t;
+
+/* Ring memory: header, entries RX then entries TX descriptors, then
+ * 2 * entries slots from a 64-byte boundary */
+#define NET_FRAME_SLOTS_OFFSET(entries) \
+    ((sizeof(net_frame_hdr_t) + 2 * (entries) * sizeof(net_frame_desc_t) + 63) & ~(size_t)63)
+#define NET_FRAME_RING_SIZE(entries) \
+    (NET_FRAME_SLOTS_OFFSET(entries) + 2 * (entries) * NET_FRAME_SLOT_SIZE)
+
+/* ethertype 0: any but ARP; udp_port 0: any (non-zero implies IPv4) */
+result_t net_frame_setup(ptr_t mem, size_t len, u32 entries, u32 ethertype, u32 udp_port,
+                         handle_t* ring_out);
+result_t net_frame_sync(handle_t ring, u32* sent_out, u32* pending_out);
+result_t net_frame_close(handle_t ring);
+
 /* Observability */
+#define LOG_DEBUG 0
+#define LOG_INFO  1
+#define LOG_WARN  2
+#define LOG_ERROR 3
+
 result_t log_write(u32 level, ptr_t msg_ptr, size_t len);
+result_t log_set_level(u32 min_level);
+result_t log_dropped(u64* count_out);
 result_t trace_span_begin(ptr_t name_ptr, size_t name_len, handle_t* span_out);
 result_t trace_span_end(handle_t span);
 result_t trace_event(handle_t span, ptr_t name_ptr, size_t name_len, ptr_t kv_ptr, size_t kv_len);
@@ -2,6 +2,18 @@ const std = @import("std");
 const serial = @import("serial.zig");
 const builtin = @import("builtin");
 const net = @import("net.zig");
+const clock = @import("clock.zig");
+const timer = @import("timer.zig");
+const readiness = @import("readiness.zig");
+const io_ring = @import("io_ring.zig");
+const frame_ring = @import("frame_ring.zig");
+const trace = @import("trace.zig");
+const pcap = @import("pcap.zig");
+const abi_stats = @import("abi_stats.zig");
+const build_options = @import("build_options");
+const config = @import("config.zig");
+const disk_log = @import("disk_log.zig");
+const balloon = @import("balloon.zig");
 
 pub const u8_t = u8;
 pub const u16_t = u16;
@@ -33,24 +45,67 @@ pub const FEAT_BALLOON: u32 = 1 << 2;
 pub const FEAT_SNAPSHOT: u32 = 1 << 3;
 pub const FEAT_TRACING: u32 = 1 << 4;
 
+const SupportedFeatures: u64 = if (config.abi_trace) FEAT_TRACING else 0;
+
+/// SupportedFeatures plus what depends on devices found at boot.
+fn supportedFeatures() u64 {
+    var features = SupportedFeatures;
+    if (comptime config.balloon) {
+        if (balloon.isReady()) features |= FEAT_BALLOON;
+    }
+    return features;
+}
+
 pub const HANDLE_TASK: u8 = 0x01;
 pub const HANDLE_IO: u8 = 0x02;
 pub const HANDLE_IPC: u8 = 0x03;
 pub const HANDLE_NET: u8 = 0x04;
 pub const HANDLE_CAP: u8 = 0x05;
 pub const HANDLE_SPAN: u8 = 0x06;
+pub const HANDLE_TIMER: u8 = 0x07;
+pub const HANDLE_IOSET: u8 = 0x08;
+pub const HANDLE_RING: u8 = 0x09;
+pub const HANDLE_FRAME: u8 = 0x0A;
 
 pub const IO_READABLE: u32 = 0x01;
 pub const IO_WRITABLE: u32 = 0x02;
 pub const IO_HANGUP: u32 = 0x04;
 pub const IO_ERROR: u32 = 0x08;
 
+// io_open flags: on a "disklog" handle, every io_write waits until its
+// record is on stable storage
+pub const IO_OPEN_SYNC: u32 = 0x01;
+
 pub const io_event_t = extern struct {
     handle: handle_t,
     events: u32,
     reserved: u32 = 0,
 };
 
+// io_poll count flag: on entry events_out[i].events is the interest mask for
+// handles[i], and only those events (plus HANGUP/ERROR) are reported
+pub const IO_POLL_INTEREST: u32 = 0x8000_0000;
+
+// Readiness set interest flag and control ops
+pub const IO_EDGE: u32 = readiness.EDGE;
+pub const IOSET_ADD: u32 = 1;
+pub const IOSET_MOD: u32 = 2;
+pub const IOSET_DEL: u32 = 3;
+
+pub const io_set_event_t = readiness.Event;
+
+comptime {
+    std.debug.assert(IO_READABLE == readiness.READABLE);
+    std.debug.assert(IO_WRITABLE == readiness.WRITABLE);
+    std.debug.assert(IO_HANGUP == readiness.HANGUP);
+    std.debug.assert(IO_ERROR == readiness.ERROR);
+}
+
+pub const LOG_DEBUG: u32 = 0;
+pub const LOG_INFO: u32 = 1;
+pub const LOG_WARN: u32 = 2;
+pub const LOG_ERROR: u32 = 3;
+
 pub const CAP_LOG: u32 = 1;
 pub const CAP_TIME: u32 = 2;
 pub const CAP_TASK: u32 = 3;
@@ -59,6 +114,7 @@ pub const CAP_IO: u32 = 5;
 pub const CAP_IPC: u32 = 6;
 pub const CAP_NET: u32 = 7;
 pub const CAP_TRACE: u32 = 8;
+pub const CAP_NET_RAW: u32 = 9;
 
 const ABI_MAJOR: u32 = 0;
 const ABI_MINOR: u32 = 2;
@@ -73,12 +129,19 @@ const CapKind = enum(u32) {
     ipc = CAP_IPC,
     net = CAP_NET,
     trace = CAP_TRACE,
+    net_raw = CAP_NET_RAW,
 };
 
-const MaxCaps = 8;
+const MaxCaps = 9;
 const MaxIpc = 16;
-const MaxNet = 16;
-const MaxIo = 32;
+const MaxNet = config.max_net;
+const MaxIo = config.max_io;
+const MaxDeadlines = 16;
+const MaxIoSets = readiness.MaxSets;
+const MaxRings = 4;
+const MaxSpans = 64;
+const MaxRingPending = 64;
+const MaxFrameRings = net.MaxFrameRings;
 
 var policy_mask: u32 = 0;
 var issued_mask: u32 = 0;
@@ -93,14 +156,55 @@ const HandleEntry = struct {
 var ipc_table: [MaxIpc]HandleEntry = [_]HandleEntry{.{}} ** MaxIpc;
 var net_table: [MaxNet]HandleEntry = [_]HandleEntry{.{}} ** MaxNet;
 var io_table: [MaxIo]HandleEntry = [_]HandleEntry{.{}} ** MaxIo;
+var deadline_table: [MaxDeadlines]HandleEntry = [_]HandleEntry{.{}} ** MaxDeadlines;
+var deadline_timers: [MaxDeadlines]timer.Timer = [_]timer.Timer{.{}} ** MaxDeadlines;
+var deadline_sources: [MaxDeadlines]readiness.Source = [_]readiness.Source{.{}} ** MaxDeadlines;
+var ioset_table: [MaxIoSets]HandleEntry = [_]HandleEntry{.{}} ** MaxIoSets;
+var span_table: [MaxSpans]HandleEntry = [_]HandleEntry{.{}} ** MaxSpans;
+var open_spans: [MaxSpans]trace.OpenSpan = [_]trace.OpenSpan{.{}} ** MaxSpans;
+var ring_table: [MaxRings]HandleEntry = [_]HandleEntry{.{}} ** MaxRings;
+var rings: [MaxRings]io_ring.Ring = undefined;
+var ring_inflight: [MaxRings]u32 = [_]u32{0} ** MaxRings;
+var frame_table: [MaxFrameRings]HandleEntry = [_]HandleEntry{.{}} ** MaxFrameRings;
+
+// Ring operations that could not complete at submission time
+const RingPending = struct {
+    in_use: bool = false,
+    ring: u32 = 0,
+    sqe: io_ring.Sqe = std.mem.zeroes(io_ring.Sqe),
+    t: timer.Timer = .{},
+};
+var ring_pending: [MaxRingPending]RingPending = [_]RingPending{.{}} ** MaxRingPending;
+
+// Shared by every serial IO handle; probed once per io_set_wait pass
+var serial_source: readiness.Source = .{};
+
+// Kernel-owned timers for blocking waits
+var sleep_timer: timer.Timer = .{};
+var poll_timer: timer.Timer = .{};
 
-const IoKind = enum(u8) { none, serial, socket };
+// Cycles spent parked in blocking waits, subtracted from task CPU time
+var task_start_tsc: u64 = 0;
+var wait_cycles: u64 = 0;
+
+const IoKind = enum(u8) { none, serial, socket, disk_log };
 var io_kind: [MaxIo]IoKind = [_]IoKind{.none} ** MaxIo;
+var io_sync: [MaxIo]bool = [_]bool{false} ** MaxIo;
+
+// Log pipeline state
+var log_min_level: u32 = LOG_DEBUG;
+var log_dropped_total: u64 = 0;
+var log_dropped_unreported: u32 = 0;
 
 // Memory allocator state
-const HEAP_SIZE: usize = 1024 * 1024; // 1MB
-var heap: [HEAP_SIZE]u8 align(16) = undefined;
+const HEAP_SIZE: usize = config.abi_heap_size; // 1MB in the full profile
+// Page aligned so free page reporting can hand back the pages above heap_top
+var heap: [HEAP_SIZE]u8 align(4096) = undefined;
 var heap_top: usize = 0;
+// Highest heap_top since the pages above it were last reported, and the
+// end of the reported range
+var heap_peak: usize = 0;
+var heap_reported_end: usize = 0;
 
 const MaxAllocs = 256;
 const AllocEntry = struct {
@@ -117,6 +221,150 @@ fn audit(msg: []const u8) void {
     serial.writeAll(msg);
 }
 
+// --- ABI call statistics ---
+//
+// Every entry point is exported from the comptime block below. With
+// -Dabi-stats=true each export is a wrapper that counts the call, its
+// result code, and its TSC latency; otherwise the functions are exported
+// directly and cost nothing. Order matches ABI_CALL_* in ukernel_abi.h.
+
+pub const AbiStatsEnabled = build_options.abi_stats;
+
+pub const AbiCall = enum(u32) {
+    cap_acquire,
+    cap_drop,
+    cap_enter,
+    cap_exit,
+    abi_version,
+    abi_features,
+    abi_feature_enabled,
+    task_spawn,
+    task_yield,
+    task_sleep,
+    task_set_priority,
+    task_get_stats,
+    task_exit,
+    time_now,
+    time_deadline,
+    time_cancel,
+    mem_alloc,
+    mem_free,
+    mem_map,
+    mem_share,
+    mem_unshare,
+    io_open,
+    io_read,
+    io_write,
+    io_close,
+    io_poll,
+    io_set_create,
+    io_set_ctl,
+    io_set_wait,
+    io_set_close,
+    io_ring_setup,
+    io_ring_enter,
+    io_ring_close,
+    ipc_channel_create,
+    ipc_send,
+    ipc_recv,
+    ipc_close,
+    net_socket,
+    net_bind,
+    net_connect,
+    net_send,
+    net_recv,
+    net_close,
+    log_write,
+    log_set_level,
+    log_dropped,
+    trace_span_begin,
+    trace_span_end,
+    trace_event,
+    mem_balloon_stats,
+    mem_trim,
+    net_frame_setup,
+    net_frame_sync,
+    net_frame_close,
+};
+
+const NumAbiCalls = @typeInfo(AbiCall).@"enum".fields.len;
+pub const ABI_STATS_MAX_CALLS = 64;
+
+comptime {
+    std.debug.assert(NumAbiCalls <= ABI_STATS_MAX_CALLS);
+}
+
+var call_stats: [if (AbiStatsEnabled) NumAbiCalls else 0]abi_stats.CallStats =
+    [_]abi_stats.CallStats{.{}} ** (if (AbiStatsEnabled) NumAbiCalls else 0);
+
+fn recordCall(call: AbiCall, start: u64, rc: result_t) result_t {
+    abi_stats.record(&call_stats[@intFromEnum(call)], rc, clock.rdtsc() -% start);
+    return rc;
+}
+
+/// Wrap f in a C-callable function with the same signature that records
+/// the call under `call`.
+fn instrumented(comptime call: AbiCall, comptime f: anytype) @TypeOf(f) {
+    const P = @typeInfo(@TypeOf(f)).@"fn".params;
+    const W = struct {
+        fn w0() callconv(.c) result_t {
+            const t = clock.rdtsc();
+            return recordCall(call, t, f());
+        }
+        fn w1(a: P[0].type.?) callconv(.c) result_t {
+            const t = clock.rdtsc();
+            return recordCall(call, t, f(a));
+        }
+        fn w2(a: P[0].type.?, b: P[1].type.?) callconv(.c) result_t {
+            const t = clock.rdtsc();
+            return recordCall(call, t, f(a, b));
+        }
+        fn w3(a: P[0].type.?, b: P[1].type.?, c: P[2].type.?) callconv(.c) result_t {
+            const t = clock.rdtsc();
+            return recordCall(call, t, f(a, b, c));
+        }
+        fn w4(a: P[0].type.?, b: P[1].type.?, c: P[2].type.?, d: P[3].type.?) callconv(.c) result_t {
+            const t = clock.rdtsc();
+            return recordCall(call, t, f(a, b, c, d));
+        }
+        fn w5(a: P[0].type.?, b: P[1].type.?, c: P[2].type.?, d: P[3].type.?, e: P[4].type.?) callconv(.c) result_t {
+            const t = clock.rdtsc();
+            return recordCall(call, t, f(a, b, c, d, e));
+        }
+        fn w6(a: P[0].type.?, b: P[1].type.?, c: P[2].type.?, d: P[3].type.?, e: P[4].type.?, g: P[5].type.?) callconv(.c) result_t {
+            const t = clock.rdtsc();
+            return recordCall(call, t, f(a, b, c, d, e, g));
+        }
+    };
+    return switch (P.len) {
+        0 => W.w0,
+        1 => W.w1,
+        2 => W.w2,
+        3 => W.w3,
+        4 => W.w4,
+        5 => W.w5,
+        6 => W.w6,
+        else => @compileError("too many ABI call parameters"),
+    };
+}
+
+comptime {
+    for (std.enums.values(AbiCall)) |call| {
+        const name = @tagName(call);
+        const f = @field(@This(), name);
+        if (AbiStatsEnabled) {
+            const wrapped = instrumented(call, f);
+            @export(&wrapped, .{ .name = name });
+        } else {
+            @export(&f, .{ .name = name });
+        }
+    }
+}
+
+pub fn resetCallStats() void {
+    for (&call_stats) |*s| s.* = .{};
+}
+
 fn kindIndex(kind: CapKind) usize {
     return @intCast(@intFromEnum(kind) - 1);
 }
@@ -142,6 +390,7 @@ fn capKindFrom(handle: handle_t) ?CapKind {
         CAP_IPC => .ipc,
         CAP_NET => .net,
         CAP_TRACE => .trace,
+        CAP_NET_RAW => .net_raw,
         else => null,
     };
 }
@@ -207,15 +456,32 @@ fn closeHandle(table: []HandleEntry, tag: u8, handle: handle_t) result_t {
     return OK;
 }
 
-fn rdtsc() u64 {
-    if (builtin.cpu.arch != .x86_64) return 0;
-    var lo: u32 = 0;
-    var hi: u32 = 0;
-    asm volatile ("rdtsc" : [lo] "={eax}" (lo), [hi] "={edx}" (hi));
-    return (@as(u64, hi) << 32) | @as(u64, lo);
+/// Read the clock and fire any expired timers.
+fn timerNow() u64 {
+    const now = clock.nowNs();
+    timer.advance(now);
+    return now;
+}
+
+fn armTimeout(t: *timer.Timer, timeout: time_ns) void {
+    const now = timerNow();
+    timer.arm(t, now +| timeout);
+}
+
+fn cpuRelax() void {
+    // Idle point: ship a few trace and capture records, refill the UART
+    // FIFO and move the record log's group commit along
+    trace.drain(4);
+    pcap.drain(2);
+    serial.pump();
+    if (comptime config.disk_log) disk_log.pump();
+    if (comptime config.balloon) balloon.poll();
+    if (comptime builtin.cpu.arch == .x86_64) {
+        asm volatile ("pause");
+    }
 }
 
-pub export fn cap_acquire(kind: u32, handle_out: ?*handle_t) callconv(.c) result_t {
+pub fn cap_acquire(kind: u32, handle_out: ?*handle_t) callconv(.c) result_t {
     if (handle_out == null) return ERR_INVALID;
     switch (kind) {
         CAP_LOG => {
@@ -260,12 +526,26 @@ pub export fn cap_acquire(kind: u32, handle_out: ?*handle_t) callconv(.c) result
             audit("cap: acquire net\n");
             return OK;
         },
-        CAP_IPC, CAP_TRACE => return ERR_UNSUPPORTED,
+        CAP_TRACE => {
+            if ((policy_mask & capBit(.trace)) == 0) return ERR_PERMISSION;
+            handle_out.?.* = makeCap(.trace);
+            issued_mask |= capBit(.trace);
+            audit("cap: acquire trace\n");
+            return OK;
+        },
+        CAP_NET_RAW => {
+            if ((policy_mask & capBit(.net_raw)) == 0) return ERR_PERMISSION;
+            handle_out.?.* = makeCap(.net_raw);
+            issued_mask |= capBit(.net_raw);
+            audit("cap: acquire net_raw\n");
+            return OK;
+        },
+        CAP_IPC => return ERR_UNSUPPORTED,
         else => return ERR_INVALID,
     }
 }
 
-pub export fn cap_drop(cap: handle_t) callconv(.c) result_t {
+pub fn cap_drop(cap: handle_t) callconv(.c) result_t {
     const k = capKindFrom(cap) orelse return ERR_INVALID;
     const idx = kindIndex(k);
     cap_gen[idx] +%= 1;
@@ -275,7 +555,7 @@ pub export fn cap_drop(cap: handle_t) callconv(.c) result_t {
     return OK;
 }
 
-pub export fn cap_enter(caps: ?*handle_t, cap_count: u32) callconv(.c) result_t {
+pub fn cap_enter(caps: ?*handle_t, cap_count: u32) callconv(.c) result_t {
     if (cap_count > MaxCaps) return ERR_INVALID;
     if (cap_count > 0 and caps == null) return ERR_INVALID;
     const cap_ptr: [*]handle_t = if (caps) |p| @ptrCast(p) else undefined;
@@ -295,7 +575,7 @@ pub export fn cap_enter(caps: ?*handle_t, cap_count: u32) callconv(.c) result_t
     return OK;
 }
 
-pub export fn cap_exit() callconv(.c) result_t {
+pub fn cap_exit() callconv(.c) result_t {
     active_mask = 0;
     audit("cap: exit\n");
     return OK;
@@ -312,11 +592,30 @@ pub fn resetCapsForWorkload(mask: u32) void {
     issued_mask = 0;
     active_mask = 0;
     for (&io_kind) |*k| k.* = .none;
+    for (&io_sync) |*s| s.* = false;
     for (&io_table) |*entry| entry.* = .{};
+    for (&deadline_table) |*entry| entry.* = .{};
+    for (&ioset_table) |*entry| entry.* = .{};
+    for (&ring_table) |*entry| entry.* = .{};
+    // Stop steering into the previous workload's memory
+    for (&frame_table, 0..) |*entry, i| {
+        if (entry.in_use) net.frameDetach(@intCast(i));
+        entry.* = .{};
+    }
+    task_start_tsc = clock.rdtsc();
+    wait_cycles = 0;
+    for (&span_table) |*entry| entry.* = .{};
+    log_min_level = LOG_DEBUG;
+    for (&ring_pending) |*p| p.* = .{};
+    ring_inflight = [_]u32{0} ** MaxRings;
+    readiness.resetAll();
+    for (&deadline_sources) |*src| src.* = .{};
+    serial_source = .{};
+    timer.reset();
     audit("cap: reset\n");
 }
 
-pub export fn abi_version(major: ?*u32, minor: ?*u32, patch: ?*u32) callconv(.c) result_t {
+pub fn abi_version(major: ?*u32, minor: ?*u32, patch: ?*u32) callconv(.c) result_t {
     if (major == null or minor == null or patch == null) return ERR_INVALID;
     major.?.* = ABI_MAJOR;
     minor.?.* = ABI_MINOR;
@@ -324,26 +623,21 @@ pub export fn abi_version(major: ?*u32, minor: ?*u32, patch: ?*u32) callconv(.c)
     return OK;
 }
 
-pub export fn abi_features(bitset_out: ?*u64) callconv(.c) result_t {
+pub fn abi_features(bitset_out: ?*u64) callconv(.c) result_t {
     if (bitset_out == null) return ERR_INVALID;
-    bitset_out.?.* = 0;
+    bitset_out.?.* = supportedFeatures();
     return OK;
 }
 
-pub export fn abi_feature_enabled(feature_id: u32, enabled_out: ?*u32) callconv(.c) result_t {
+pub fn abi_feature_enabled(feature_id: u32, enabled_out: ?*u32) callconv(.c) result_t {
     if (enabled_out == null) return ERR_INVALID;
-    const features: u64 = 0;
-    if (feature_id >= 64) {
-        enabled_out.?.* = 0;
-        return OK;
-    }
-    const shift: u6 = @intCast(feature_id);
-    const enabled = ((features >> shift) & 1) != 0;
+    // feature_id is a FEAT_* flag
+    const enabled = feature_id != 0 and (supportedFeatures() & feature_id) == feature_id;
     enabled_out.?.* = if (enabled) 1 else 0;
     return OK;
 }
 
-pub export fn task_spawn(_: ptr_t, _: ptr_t, caps: ?*handle_t, cap_count: u32, _: u32, _: ?*handle_t) callconv(.c) result_t {
+pub fn task_spawn(_: ptr_t, _: ptr_t, caps: ?*handle_t, cap_count: u32, _: u32, _: ?*handle_t) callconv(.c) result_t {
     if (!allow(.task)) return ERR_PERMISSION;
     if (cap_count > 0 and caps == null) return ERR_INVALID;
     const cap_ptr: [*]handle_t = if (caps) |p| @ptrCast(p) else undefined;
@@ -358,31 +652,82 @@ pub export fn task_spawn(_: ptr_t, _: ptr_t, caps: ?*handle_t, cap_count: u32, _
     return ERR_UNSUPPORTED;
 }
 
-pub export fn task_yield() callconv(.c) result_t {
+pub fn task_yield() callconv(.c) result_t {
     if (!allow(.task)) return ERR_PERMISSION;
-    if (comptime builtin.cpu.arch == .x86_64) {
-        asm volatile ("pause");
-    }
+    cpuRelax();
     return OK;
 }
 
-pub export fn task_sleep(duration: time_ns) callconv(.c) result_t {
+pub fn task_sleep(duration: time_ns) callconv(.c) result_t {
     if (!allow(.task)) return ERR_PERMISSION;
     if (duration == 0) return OK;
-    return ERR_UNSUPPORTED;
+    const wait_start = clock.rdtsc();
+    defer wait_cycles +%= clock.rdtsc() -% wait_start;
+    armTimeout(&sleep_timer, duration);
+    while (!timer.hasFired(&sleep_timer)) {
+        cpuRelax();
+        _ = timerNow();
+    }
+    return OK;
 }
 
-pub export fn task_set_priority(_: handle_t, _: u32) callconv(.c) result_t {
+pub fn task_set_priority(_: handle_t, _: u32) callconv(.c) result_t {
     if (!allow(.task)) return ERR_PERMISSION;
     return ERR_UNSUPPORTED;
 }
 
-pub export fn task_get_stats(_: handle_t, _: ptr_t) callconv(.c) result_t {
+pub const AbiCallStats = extern struct {
+    calls: u64,
+    errors: u64,
+    total_ns: u64,
+    max_ns: u64,
+    p50_ns: u64,
+    p99_ns: u64,
+    // Indexed by result_t; the last slot counts codes beyond ERR_CLOSED
+    results: [abi_stats.NumResultCodes]u32,
+};
+
+pub const TaskStats = extern struct {
+    cpu_time_ns: u64,
+    sched_ticks: u64,
+    context_switches: u64,
+    abi_stats_enabled: u32,
+    call_count: u32,
+    calls: [ABI_STATS_MAX_CALLS]AbiCallStats,
+};
+
+fn fillCallStats(out: *AbiCallStats, s: *const abi_stats.CallStats) void {
+    out.* = .{
+        .calls = s.calls,
+        .errors = s.errors,
+        .total_ns = clock.tscToNs(s.total_cycles),
+        .max_ns = clock.tscToNs(s.max_cycles),
+        .p50_ns = clock.tscToNs(abi_stats.percentile(s, 500)),
+        .p99_ns = clock.tscToNs(abi_stats.percentile(s, 990)),
+        .results = s.results,
+    };
+}
+
+/// task = 0 (or the current task) reports on the caller. cpu_time_ns excludes
+/// time parked in task_sleep and blocking io waits. Per-call entries are only
+/// populated when the kernel is built with -Dabi-stats=true.
+pub fn task_get_stats(task: handle_t, stats_out: ptr_t) callconv(.c) result_t {
     if (!allow(.task)) return ERR_PERMISSION;
-    return ERR_UNSUPPORTED;
+    if (stats_out == 0) return ERR_INVALID;
+    // Single task: only the caller itself can be queried
+    if (task != 0) return ERR_NOENT;
+
+    const out: *TaskStats = @ptrFromInt(stats_out);
+    out.* = std.mem.zeroes(TaskStats);
+    // Busy time since the workload started: blocking waits are idle
+    out.cpu_time_ns = clock.tscToNs((clock.rdtsc() -% task_start_tsc) -| wait_cycles);
+    out.abi_stats_enabled = if (AbiStatsEnabled) 1 else 0;
+    out.call_count = NumAbiCalls;
+    for (&call_stats, 0..) |*s, i| fillCallStats(&out.calls[i], s);
+    return OK;
 }
 
-pub export fn task_exit(_: i32) callconv(.c) result_t {
+pub fn task_exit(_: i32) callconv(.c) result_t {
     if (!allow(.task)) return ERR_PERMISSION;
     while (true) {
         if (comptime builtin.cpu.arch == .x86_64) {
@@ -391,19 +736,45 @@ pub export fn task_exit(_: i32) callconv(.c) result_t {
     }
 }
 
-pub export fn time_now(out: ?*time_ns) callconv(.c) result_t {
+pub fn time_now(out: ?*time_ns) callconv(.c) result_t {
     if (!allow(.time)) return ERR_PERMISSION;
     if (out == null) return ERR_INVALID;
-    out.?.* = rdtsc();
+    out.?.* = clock.nowNs();
     return OK;
 }
 
-pub export fn time_deadline(_: time_ns, _: ?*handle_t) callconv(.c) result_t {
+pub fn time_deadline(abs: time_ns, handle_out: ?*handle_t) callconv(.c) result_t {
     if (!allow(.time)) return ERR_PERMISSION;
-    return ERR_UNSUPPORTED;
+    if (handle_out == null) return ERR_INVALID;
+
+    var handle: handle_t = 0;
+    const rc = allocHandle(deadline_table[0..], HANDLE_TIMER, &handle);
+    if (rc != OK) return rc;
+
+    const idx = handleId(handle);
+    deadline_timers[idx] = .{ .callback = &deadlineFired, .ctx = idx };
+    _ = timerNow();
+    timer.arm(&deadline_timers[idx], abs);
+    // Deadlines already in the past are readable immediately
+    _ = timerNow();
+    handle_out.?.* = handle;
+    return OK;
 }
 
-pub export fn mem_alloc(bytes: size_t, flags: u32, out_ptr: ?*ptr_t) callconv(.c) result_t {
+fn deadlineFired(t: *timer.Timer) void {
+    readiness.notify(&deadline_sources[t.ctx], IO_READABLE);
+}
+
+pub fn time_cancel(deadline: handle_t) callconv(.c) result_t {
+    if (!allow(.time)) return ERR_PERMISSION;
+    const idx = validateHandle(deadline_table[0..], HANDLE_TIMER, deadline) orelse return ERR_INVALID;
+    timer.cancel(&deadline_timers[idx]);
+    deadline_timers[idx] = .{};
+    readiness.reset(&deadline_sources[idx]);
+    return closeHandle(deadline_table[0..], HANDLE_TIMER, deadline);
+}
+
+pub fn mem_alloc(bytes: size_t, flags: u32, out_ptr: ?*ptr_t) callconv(.c) result_t {
     if (!allow(.mem)) return ERR_PERMISSION;
     if (out_ptr == null) return ERR_INVALID;
     if (bytes == 0) return ERR_INVALID;
@@ -430,13 +801,14 @@ pub export fn mem_alloc(bytes: size_t, flags: u32, out_ptr: ?*ptr_t) callconv(.c
         .in_use = true,
     };
     heap_top += aligned;
+    if (heap_top > heap_peak) growHeapPeak();
 
     out_ptr.?.* = ptr;
     audit("mem: alloc\n");
     return OK;
 }
 
-pub export fn mem_free(ptr: ptr_t) callconv(.c) result_t {
+pub fn mem_free(ptr: ptr_t) callconv(.c) result_t {
     if (!allow(.mem)) return ERR_PERMISSION;
     if (ptr == 0) return ERR_INVALID;
 
@@ -455,21 +827,90 @@ pub export fn mem_free(ptr: ptr_t) callconv(.c) result_t {
     return ERR_INVALID; // Not found or double-free
 }
 
-pub export fn mem_map(_: ptr_t, _: size_t, _: u32) callconv(.c) result_t {
+const HeapPage = 4096;
+
+// Pages between the old peak and the new top that had been reported are
+// written again
+fn growHeapPeak() void {
+    const lo = std.mem.alignForward(usize, heap_peak, HeapPage);
+    const hi = @min(std.mem.alignForward(usize, heap_top, HeapPage), heap_reported_end);
+    if (comptime config.balloon) {
+        if (hi > lo) balloon.noteReclaimed((hi - lo) / HeapPage);
+    }
+    heap_peak = heap_top;
+}
+
+/// Free page reporting for the ABI heap: the whole pages above heap_top
+/// that were written since the last report.
+pub fn reportFreeHeap() void {
+    if (comptime !config.balloon) return;
+    const start = std.mem.alignForward(usize, heap_top, HeapPage);
+    const end = @min(std.mem.alignForward(usize, heap_peak, HeapPage), std.mem.alignBackward(usize, HEAP_SIZE, HeapPage));
+    if (end < start + balloon.MinReportBytes) return;
+    balloon.reportRange(@intFromPtr(&heap) + start, @intFromPtr(&heap) + end);
+    heap_peak = heap_top;
+    heap_reported_end = @max(heap_reported_end, end);
+}
+
+pub fn mem_map(_: ptr_t, _: size_t, _: u32) callconv(.c) result_t {
     if (!allow(.mem)) return ERR_PERMISSION;
     return ERR_UNSUPPORTED;
 }
 
-pub export fn mem_share(_: ptr_t, _: size_t, _: ?*handle_t) callconv(.c) result_t {
+pub fn mem_share(_: ptr_t, _: size_t, _: ?*handle_t) callconv(.c) result_t {
     if (!allow(.mem)) return ERR_PERMISSION;
     return ERR_UNSUPPORTED;
 }
 
-pub export fn mem_unshare(_: handle_t) callconv(.c) result_t {
+pub fn mem_unshare(_: handle_t) callconv(.c) result_t {
     if (!allow(.mem)) return ERR_PERMISSION;
     return ERR_UNSUPPORTED;
 }
 
+/// mem_balloon_stats output (mem_balloon_stats_t in ukernel_abi.h)
+pub const BalloonStats = extern struct {
+    target_pages: u32,
+    balloon_pages: u32,
+    inflated_pages: u64,
+    deflated_pages: u64,
+    reported_pages: u64,
+    reports: u64,
+    reclaimed_pages: u64,
+    reporting: u32,
+    _reserved: u32 = 0,
+};
+
+pub fn mem_balloon_stats(stats_out: ptr_t) callconv(.c) result_t {
+    if (!allow(.mem)) return ERR_PERMISSION;
+    if (comptime !config.balloon) return ERR_UNSUPPORTED;
+    if (stats_out == 0) return ERR_INVALID;
+    if (!balloon.isReady()) return ERR_NOENT;
+    const s = balloon.getStats();
+    const out: *BalloonStats = @ptrFromInt(stats_out);
+    out.* = .{
+        .target_pages = s.target_pages,
+        .balloon_pages = s.balloon_pages,
+        .inflated_pages = s.inflated_pages,
+        .deflated_pages = s.deflated_pages,
+        .reported_pages = s.reported_pages,
+        .reports = s.reports,
+        .reclaimed_pages = balloon.reclaimedPages(),
+        .reporting = @intFromBool(balloon.reportingEnabled()),
+    };
+    return OK;
+}
+
+/// Report free memory to the host now instead of at the next idle-time
+/// pass, e.g. after dropping a large working set.
+pub fn mem_trim(reported_out: ?*u64) callconv(.c) result_t {
+    if (!allow(.mem)) return ERR_PERMISSION;
+    if (comptime !config.balloon) return ERR_UNSUPPORTED;
+    if (!balloon.reportingEnabled()) return ERR_NOENT;
+    const reported = balloon.reportFree();
+    if (reported_out) |out| out.* = reported;
+    return OK;
+}
+
 fn pathStartsWith(path_ptr: ptr_t, prefix: []const u8) bool {
     const ptr: [*]const u8 = @ptrFromInt(path_ptr);
     for (prefix, 0..) |ch, i| {
@@ -478,29 +919,40 @@ fn pathStartsWith(path_ptr: ptr_t, prefix: []const u8) bool {
     return true;
 }
 
-pub export fn io_open(path_ptr: ptr_t, flags: u32, handle_out: ?*handle_t) callconv(.c) result_t {
+pub fn io_open(path_ptr: ptr_t, flags: u32, handle_out: ?*handle_t) callconv(.c) result_t {
     if (!allow(.io)) return ERR_PERMISSION;
-    _ = flags;
     if (handle_out == null) return ERR_INVALID;
     if (path_ptr == 0) return ERR_INVALID;
 
+    const kind: IoKind = if (pathStartsWith(path_ptr, "serial"))
+        .serial
+    else if (pathStartsWith(path_ptr, "disklog"))
+        .disk_log
+    else
+        .none;
+    if (kind == .disk_log) {
+        if (comptime !config.disk_log) return ERR_UNSUPPORTED;
+        if (!disk_log.isMounted()) return ERR_NOENT;
+    }
+
     var handle: handle_t = 0;
     const rc = allocHandle(io_table[0..], HANDLE_IO, &handle);
     if (rc != OK) return rc;
 
     const idx = handleId(handle);
-    if (pathStartsWith(path_ptr, "serial")) {
-        io_kind[idx] = .serial;
-    } else {
-        io_kind[idx] = .none;
-    }
+    io_kind[idx] = kind;
+    io_sync[idx] = kind == .disk_log and flags & IO_OPEN_SYNC != 0;
 
     handle_out.?.* = handle;
     return OK;
 }
 
-pub export fn io_read(io: handle_t, buf_ptr: ptr_t, len: size_t, read_out: ?*size_t) callconv(.c) result_t {
+pub fn io_read(io: handle_t, buf_ptr: ptr_t, len: size_t, read_out: ?*size_t) callconv(.c) result_t {
     if (!allow(.io)) return ERR_PERMISSION;
+    return ioReadImpl(io, buf_ptr, len, read_out);
+}
+
+fn ioReadImpl(io: handle_t, buf_ptr: ptr_t, len: size_t, read_out: ?*size_t) result_t {
     const idx = validateHandle(io_table[0..], HANDLE_IO, io) orelse return ERR_INVALID;
     if (len > 0 and buf_ptr == 0) return ERR_INVALID;
     if (read_out != null) read_out.?.* = 0;
@@ -517,12 +969,18 @@ pub export fn io_read(io: handle_t, buf_ptr: ptr_t, len: size_t, read_out: ?*siz
             if (n == 0) return ERR_WOULD_BLOCK;
             return OK;
         },
+        // Write-only; scripts/disk_log.py reads the log on the host
+        .disk_log => return ERR_UNSUPPORTED,
         .socket, .none => return ERR_WOULD_BLOCK,
     }
 }
 
-pub export fn io_write(io: handle_t, buf_ptr: ptr_t, len: size_t, wrote_out: ?*size_t) callconv(.c) result_t {
+pub fn io_write(io: handle_t, buf_ptr: ptr_t, len: size_t, wrote_out: ?*size_t) callconv(.c) result_t {
     if (!allow(.io)) return ERR_PERMISSION;
+    return ioWriteImpl(io, buf_ptr, len, wrote_out);
+}
+
+fn ioWriteImpl(io: handle_t, buf_ptr: ptr_t, len: size_t, wrote_out: ?*size_t) result_t {
     const idx = validateHandle(io_table[0..], HANDLE_IO, io) orelse return ERR_INVALID;
     if (len > 0 and buf_ptr == 0) return ERR_INVALID;
 
@@ -536,6 +994,21 @@ pub export fn io_write(io: handle_t, buf_ptr: ptr_t, len: size_t, wrote_out: ?*s
             if (wrote_out != null) wrote_out.?.* = n;
             return OK;
         },
+        .disk_log => {
+            if (comptime !config.disk_log) return ERR_UNSUPPORTED;
+            // One io_write is one record
+            if (len > disk_log.MaxRecord) return ERR_INVALID;
+            if (wrote_out != null) wrote_out.?.* = 0;
+            if (len == 0) return OK;
+            const buf: [*]const u8 = @ptrFromInt(buf_ptr);
+            if (!disk_log.append(.user, &.{buf[0..len]})) {
+                // Full disk, or closed after a write error
+                return if (disk_log.isMounted()) ERR_NOMEM else ERR_IO;
+            }
+            if (io_sync[idx] and !disk_log.sync()) return ERR_IO;
+            if (wrote_out != null) wrote_out.?.* = len;
+            return OK;
+        },
         .socket, .none => {
             if (wrote_out != null) wrote_out.?.* = len;
             return OK;
@@ -543,10 +1016,16 @@ pub export fn io_write(io: handle_t, buf_ptr: ptr_t, len: size_t, wrote_out: ?*s
     }
 }
 
-pub export fn io_close(io: handle_t) callconv(.c) result_t {
+pub fn io_close(io: handle_t) callconv(.c) result_t {
     if (!allow(.io)) return ERR_PERMISSION;
     const idx = validateHandle(io_table[0..], HANDLE_IO, io) orelse return ERR_INVALID;
+    if (io_kind[idx] == .serial) readiness.dropHandle(&serial_source, io);
+    // Closing a log handle makes everything written through it durable
+    if (comptime config.disk_log) {
+        if (io_kind[idx] == .disk_log) _ = disk_log.sync();
+    }
     io_kind[idx] = .none;
+    io_sync[idx] = false;
     return closeHandle(io_table[0..], HANDLE_IO, io);
 }
 
@@ -557,6 +1036,11 @@ fn probeIoEvents(idx: u32) u32 {
             if (serial.rxReady()) ev |= IO_READABLE;
             if (serial.txReady()) ev |= IO_WRITABLE;
         },
+        .disk_log => {
+            if (comptime config.disk_log) {
+                if (disk_log.isMounted()) ev |= IO_WRITABLE else ev |= IO_HANGUP;
+            }
+        },
         .socket, .none => {},
     }
     return ev;
@@ -570,50 +1054,70 @@ fn probeNetEvents(idx: u32) u32 {
     return ev;
 }
 
-pub export fn io_poll(handles: ?*handle_t, count: u32, timeout: time_ns, events_out: ptr_t, count_out: ?*u32) callconv(.c) result_t {
+/// Current events for any pollable handle; null if the handle is invalid.
+fn probeHandleEvents(handle: handle_t) ?u32 {
+    switch (handleTag(handle)) {
+        HANDLE_IO => {
+            const id = validateHandle(io_table[0..], HANDLE_IO, handle) orelse return null;
+            return probeIoEvents(id);
+        },
+        HANDLE_NET => {
+            const id = validateHandle(net_table[0..], HANDLE_NET, handle) orelse return null;
+            return probeNetEvents(id);
+        },
+        HANDLE_TIMER => {
+            const id = validateHandle(deadline_table[0..], HANDLE_TIMER, handle) orelse return null;
+            return if (timer.hasFired(&deadline_timers[id])) IO_READABLE else 0;
+        },
+        HANDLE_FRAME => {
+            const id = validateHandle(frame_table[0..], HANDLE_FRAME, handle) orelse return null;
+            return net.frameEvents(id);
+        },
+        else => return null,
+    }
+}
+
+pub fn io_poll(handles: ?*handle_t, count_flags: u32, timeout: time_ns, events_out: ptr_t, count_out: ?*u32) callconv(.c) result_t {
     if (!allow(.io)) return ERR_PERMISSION;
     if (count_out != null) count_out.?.* = 0;
+    const masked = (count_flags & IO_POLL_INTEREST) != 0;
+    const count = count_flags & ~IO_POLL_INTEREST;
 
     // Backward compat: count=0 is deadline-aware sleep
     if (count == 0) {
         if (timeout == 0) return ERR_WOULD_BLOCK;
 
-        const start = rdtsc();
-        while (true) {
-            if (comptime builtin.cpu.arch == .x86_64) {
-                asm volatile ("pause");
-            }
-            if (rdtsc() - start >= timeout) break;
+        const wait_start = clock.rdtsc();
+        defer wait_cycles +%= clock.rdtsc() -% wait_start;
+        armTimeout(&poll_timer, timeout);
+        while (!timer.hasFired(&poll_timer)) {
+            cpuRelax();
+            _ = timerNow();
         }
         return ERR_TIMEOUT;
     }
 
     if (handles == null) return ERR_INVALID;
+    if (masked and events_out == 0) return ERR_INVALID;
     const handle_arr: [*]const handle_t = @ptrCast(handles.?);
     const events_buf: ?[*]io_event_t = if (events_out != 0) @ptrFromInt(events_out) else null;
 
-    // Drain incoming network packets before polling
+    // Drain incoming network packets and expire deadlines before polling
     if (comptime builtin.cpu.arch == .x86_64) {
         net.processIncoming();
     }
+    _ = timerNow();
 
-    // Check all handles for ready events (supports both IO and NET handles)
+    // Check all handles for ready events (supports both IO and NET handles).
+    // With interest masks, entry i is read before any report is written, and
+    // reports only go to entries at or below i, so the buffer works in place.
     const checkEvents = struct {
-        fn check(h_arr: [*]const handle_t, cnt: u32, ev_buf: ?[*]io_event_t) u32 {
+        fn check(h_arr: [*]const handle_t, cnt: u32, ev_buf: ?[*]io_event_t, interest: bool) u32 {
             var n: u32 = 0;
             var i: u32 = 0;
             while (i < cnt) : (i += 1) {
-                const tag = handleTag(h_arr[i]);
-                var ev: u32 = 0;
-                if (tag == HANDLE_IO) {
-                    const id = validateHandle(io_table[0..], HANDLE_IO, h_arr[i]) orelse continue;
-                    ev = probeIoEvents(id);
-                } else if (tag == HANDLE_NET) {
-                    const id = validateHandle(net_table[0..], HANDLE_NET, h_arr[i]) orelse continue;
-                    ev = probeNetEvents(id);
-                } else {
-                    continue;
-                }
+                var ev = probeHandleEvents(h_arr[i]) orelse continue;
+                if (interest) ev &= ev_buf.?[i].events | IO_HANGUP | IO_ERROR;
                 if (ev != 0) {
                     if (ev_buf) |buf| {
                         buf[n] = .{ .handle = h_arr[i], .events = ev };
@@ -626,7 +1130,7 @@ pub export fn io_poll(handles: ?*handle_t, count: u32, timeout: time_ns, events_
     }.check;
 
     // First non-blocking check
-    const found = checkEvents(handle_arr, count, events_buf);
+    const found = checkEvents(handle_arr, count, events_buf, masked);
     if (found > 0) {
         if (count_out != null) count_out.?.* = found;
         return OK;
@@ -634,28 +1138,292 @@ pub export fn io_poll(handles: ?*handle_t, count: u32, timeout: time_ns, events_
     if (timeout == 0) return ERR_WOULD_BLOCK;
 
     // Poll loop with timeout
-    const start = rdtsc();
+    const wait_start = clock.rdtsc();
+    defer wait_cycles +%= clock.rdtsc() -% wait_start;
+    armTimeout(&poll_timer, timeout);
     while (true) {
+        cpuRelax();
+        _ = timerNow();
         if (comptime builtin.cpu.arch == .x86_64) {
-            asm volatile ("pause");
+            net.processIncoming();
         }
-        const n = checkEvents(handle_arr, count, events_buf);
+        const n = checkEvents(handle_arr, count, events_buf, masked);
         if (n > 0) {
+            timer.cancel(&poll_timer);
             if (count_out != null) count_out.?.* = n;
             return OK;
         }
-        if (rdtsc() - start >= timeout) return ERR_TIMEOUT;
+        if (timer.hasFired(&poll_timer)) return ERR_TIMEOUT;
+    }
+}
+
+/// Map a pollable handle to its readiness source.
+fn sourceFor(handle: handle_t) ?*readiness.Source {
+    switch (handleTag(handle)) {
+        HANDLE_IO => {
+            const id = validateHandle(io_table[0..], HANDLE_IO, handle) orelse return null;
+            return if (io_kind[id] == .serial) &serial_source else null;
+        },
+        HANDLE_NET => {
+            const id = validateHandle(net_table[0..], HANDLE_NET, handle) orelse return null;
+            return &net.udp_ready[id];
+        },
+        HANDLE_TIMER => {
+            const id = validateHandle(deadline_table[0..], HANDLE_TIMER, handle) orelse return null;
+            return &deadline_sources[id];
+        },
+        HANDLE_FRAME => {
+            const id = validateHandle(frame_table[0..], HANDLE_FRAME, handle) orelse return null;
+            return &net.frame_ready[id];
+        },
+        else => return null,
+    }
+}
+
+pub fn io_set_create(flags: u32, set_out: ?*handle_t) callconv(.c) result_t {
+    if (!allow(.io)) return ERR_PERMISSION;
+    _ = flags;
+    if (set_out == null) return ERR_INVALID;
+    var handle: handle_t = 0;
+    const rc = allocHandle(ioset_table[0..], HANDLE_IOSET, &handle);
+    if (rc != OK) return rc;
+    set_out.?.* = handle;
+    return OK;
+}
+
+pub fn io_set_ctl(set: handle_t, op: u32, handle: handle_t, events: u32, user_data: u64) callconv(.c) result_t {
+    if (!allow(.io)) return ERR_PERMISSION;
+    const sid = validateHandle(ioset_table[0..], HANDLE_IOSET, set) orelse return ERR_INVALID;
+    const existing = readiness.find(sid, handle);
+    switch (op) {
+        IOSET_ADD => {
+            if (existing != null) return ERR_BUSY;
+            const src = sourceFor(handle) orelse return ERR_INVALID;
+            _ = readiness.register(sid, src, handle, events, user_data) orelse return ERR_NOMEM;
+            return OK;
+        },
+        IOSET_MOD => {
+            const reg = existing orelse return ERR_NOENT;
+            readiness.modify(reg, events, user_data);
+            return OK;
+        },
+        IOSET_DEL => {
+            const reg = existing orelse return ERR_NOENT;
+            readiness.unregister(reg);
+            return OK;
+        },
+        else => return ERR_INVALID,
+    }
+}
+
+/// One readiness pass: pull in device state, then drain the ready queue.
+fn collectIoSet(sid: u32, out: []io_set_event_t) u32 {
+    if (comptime builtin.cpu.arch == .x86_64) {
+        net.processIncoming();
+    }
+    if (readiness.hasInterest(&serial_source)) {
+        var state: u32 = 0;
+        if (serial.rxReady()) state |= IO_READABLE;
+        if (serial.txReady()) state |= IO_WRITABLE;
+        readiness.setLevel(&serial_source, state);
+    }
+    if (comptime config.net_raw) net.frameUpdateReadiness();
+    _ = timerNow();
+    return readiness.collect(sid, out);
+}
+
+pub fn io_set_wait(set: handle_t, events_out: ptr_t, max_events: u32, timeout: time_ns, count_out: ?*u32) callconv(.c) result_t {
+    if (!allow(.io)) return ERR_PERMISSION;
+    const sid = validateHandle(ioset_table[0..], HANDLE_IOSET, set) orelse return ERR_INVALID;
+    if (events_out == 0 or max_events == 0) return ERR_INVALID;
+    if (count_out != null) count_out.?.* = 0;
+
+    const buf: [*]io_set_event_t = @ptrFromInt(events_out);
+    const out = buf[0..max_events];
+
+    var n = collectIoSet(sid, out);
+    if (n == 0) {
+        if (timeout == 0) return ERR_WOULD_BLOCK;
+        const wait_start = clock.rdtsc();
+        defer wait_cycles +%= clock.rdtsc() -% wait_start;
+        armTimeout(&poll_timer, timeout);
+        while (n == 0) {
+            if (timer.hasFired(&poll_timer)) return ERR_TIMEOUT;
+            cpuRelax();
+            n = collectIoSet(sid, out);
+        }
+        timer.cancel(&poll_timer);
+    }
+    if (count_out != null) count_out.?.* = n;
+    return OK;
+}
+
+pub fn io_set_close(set: handle_t) callconv(.c) result_t {
+    if (!allow(.io)) return ERR_PERMISSION;
+    const sid = validateHandle(ioset_table[0..], HANDLE_IOSET, set) orelse return ERR_INVALID;
+    readiness.closeSet(sid);
+    return closeHandle(ioset_table[0..], HANDLE_IOSET, set);
+}
+
+pub fn io_ring_setup(mem: ptr_t, len: size_t, entries: u32, ring_out: ?*handle_t) callconv(.c) result_t {
+    if (comptime !config.abi_ring) return ERR_UNSUPPORTED;
+    if (!allow(.io)) return ERR_PERMISSION;
+    if (ring_out == null or mem == 0) return ERR_INVALID;
+    if (!io_ring.validEntries(entries)) return ERR_INVALID;
+    if ((mem & 7) != 0 or len < io_ring.ringSize(entries)) return ERR_INVALID;
+
+    var handle: handle_t = 0;
+    const rc = allocHandle(ring_table[0..], HANDLE_RING, &handle);
+    if (rc != OK) return rc;
+
+    const rid = handleId(handle);
+    rings[rid] = io_ring.Ring.init(mem, entries);
+    ring_inflight[rid] = 0;
+    ring_out.?.* = handle;
+    return OK;
+}
+
+fn ringCqe(sqe: *const io_ring.Sqe, result: result_t, value: u64) io_ring.Cqe {
+    return .{ .user_data = sqe.user_data, .value = value, .result = result, .flags = 0 };
+}
+
+/// Run one ring op against the cap set captured at enter. Returns null when
+/// the op would block and should stay in flight.
+fn ringExec(sqe: *const io_ring.Sqe, caps: u32) ?io_ring.Cqe {
+    var n: size_t = 0;
+    const rc: result_t = switch (sqe.opcode) {
+        io_ring.OP_NOP => OK,
+        io_ring.OP_READ => if ((caps & capBit(.io)) == 0) ERR_PERMISSION else ioReadImpl(sqe.handle, sqe.addr, sqe.len, &n),
+        io_ring.OP_WRITE => if ((caps & capBit(.io)) == 0) ERR_PERMISSION else ioWriteImpl(sqe.handle, sqe.addr, sqe.len, &n),
+        io_ring.OP_SEND => if ((caps & capBit(.net)) == 0) ERR_PERMISSION else netSendImpl(sqe.handle, sqe.addr, sqe.len, sqe.op_flags, &n),
+        io_ring.OP_RECV => if ((caps & capBit(.net)) == 0) ERR_PERMISSION else netRecvImpl(sqe.handle, sqe.addr, sqe.len, sqe.op_flags, &n),
+        io_ring.OP_POLL => blk: {
+            if ((caps & capBit(.io)) == 0) break :blk ERR_PERMISSION;
+            const ev = probeHandleEvents(sqe.handle) orelse break :blk ERR_INVALID;
+            const ready = ev & (@as(u32, @truncate(sqe.arg)) | IO_HANGUP | IO_ERROR);
+            if (ready == 0) break :blk ERR_WOULD_BLOCK;
+            n = ready;
+            break :blk OK;
+        },
+        else => ERR_UNSUPPORTED,
+    };
+    if (rc == ERR_WOULD_BLOCK) return null;
+    return ringCqe(sqe, rc, n);
+}
+
+fn ringPark(rid: u32, sqe: *const io_ring.Sqe) ?*RingPending {
+    for (&ring_pending) |*p| {
+        if (p.in_use) continue;
+        p.* = .{ .in_use = true, .ring = rid, .sqe = sqe.* };
+        ring_inflight[rid] += 1;
+        return p;
+    }
+    return null;
+}
+
+fn ringStart(rid: u32, sqe: *const io_ring.Sqe, caps: u32) ?io_ring.Cqe {
+    if (sqe.opcode == io_ring.OP_TIMEOUT) {
+        if ((caps & capBit(.time)) == 0) return ringCqe(sqe, ERR_PERMISSION, 0);
+        const p = ringPark(rid, sqe) orelse return ringCqe(sqe, ERR_BUSY, 0);
+        armTimeout(&p.t, sqe.arg);
+        return null;
+    }
+    if (ringExec(sqe, caps)) |cqe| return cqe;
+    if (ringPark(rid, sqe) == null) return ringCqe(sqe, ERR_BUSY, 0);
+    return null;
+}
+
+/// Retry in-flight ops for a ring; returns how many completed.
+fn ringRetry(rid: u32, caps: u32) u32 {
+    if (ring_inflight[rid] == 0) return 0;
+    var done: u32 = 0;
+    for (&ring_pending) |*p| {
+        if (!p.in_use or p.ring != rid) continue;
+        const cqe = if (p.sqe.opcode == io_ring.OP_TIMEOUT)
+            (if (timer.hasFired(&p.t)) ringCqe(&p.sqe, ERR_TIMEOUT, 0) else null)
+        else
+            ringExec(&p.sqe, caps);
+        if (cqe) |c| {
+            // A CQ slot was reserved for every in-flight op at submission
+            _ = rings[rid].postCqe(c);
+            p.* = .{};
+            ring_inflight[rid] -= 1;
+            done += 1;
+        }
+    }
+    return done;
+}
+
+fn ringCancel(rid: u32) void {
+    for (&ring_pending) |*p| {
+        if (!p.in_use or p.ring != rid) continue;
+        timer.cancel(&p.t);
+        p.* = .{};
+    }
+    ring_inflight[rid] = 0;
+}
+
+fn ringPass(rid: u32, caps: u32) u32 {
+    if (comptime builtin.cpu.arch == .x86_64) {
+        net.processIncoming();
+    }
+    _ = timerNow();
+    return ringRetry(rid, caps);
+}
+
+pub fn io_ring_enter(ring: handle_t, min_complete: u32, timeout: time_ns, submitted_out: ?*u32) callconv(.c) result_t {
+    if (comptime !config.abi_ring) return ERR_UNSUPPORTED;
+    if (!allow(.io)) return ERR_PERMISSION;
+    const rid = validateHandle(ring_table[0..], HANDLE_RING, ring) orelse return ERR_INVALID;
+    if (submitted_out != null) submitted_out.?.* = 0;
+
+    // Capabilities are checked once per enter, not per operation
+    const caps = active_mask;
+    const r = &rings[rid];
+
+    var completed = ringPass(rid, caps);
+    var submitted: u32 = 0;
+    // Only consume an SQE while every in-flight op still has a CQ slot
+    while (r.cqFree() > ring_inflight[rid]) {
+        const sqe = r.nextSqe() orelse break;
+        submitted += 1;
+        if (ringStart(rid, &sqe, caps)) |cqe| {
+            _ = r.postCqe(cqe);
+            completed += 1;
+        }
+    }
+    if (submitted_out != null) submitted_out.?.* = submitted;
+
+    if (completed >= min_complete or timeout == 0) return OK;
+
+    const wait_start = clock.rdtsc();
+    defer wait_cycles +%= clock.rdtsc() -% wait_start;
+    armTimeout(&poll_timer, timeout);
+    while (completed < min_complete) {
+        if (timer.hasFired(&poll_timer)) return ERR_TIMEOUT;
+        cpuRelax();
+        completed += ringPass(rid, caps);
     }
+    timer.cancel(&poll_timer);
+    return OK;
+}
+
+pub fn io_ring_close(ring: handle_t) callconv(.c) result_t {
+    if (comptime !config.abi_ring) return ERR_UNSUPPORTED;
+    if (!allow(.io)) return ERR_PERMISSION;
+    const rid = validateHandle(ring_table[0..], HANDLE_RING, ring) orelse return ERR_INVALID;
+    ringCancel(rid);
+    return closeHandle(ring_table[0..], HANDLE_RING, ring);
 }
 
-pub export fn ipc_channel_create(flags: u32, handle_out: ?*handle_t) callconv(.c) result_t {
+pub fn ipc_channel_create(flags: u32, handle_out: ?*handle_t) callconv(.c) result_t {
     if (!allow(.ipc)) return ERR_PERMISSION;
     _ = flags;
     if (handle_out == null) return ERR_INVALID;
     return allocHandle(ipc_table[0..], HANDLE_IPC, handle_out.?);
 }
 
-pub export fn ipc_send(ch: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32) callconv(.c) result_t {
+pub fn ipc_send(ch: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32) callconv(.c) result_t {
     if (!allow(.ipc)) return ERR_PERMISSION;
     _ = flags;
     if (validateHandle(ipc_table[0..], HANDLE_IPC, ch) == null) return ERR_INVALID;
@@ -663,7 +1431,7 @@ pub export fn ipc_send(ch: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32) ca
     return OK;
 }
 
-pub export fn ipc_recv(ch: handle_t, buf_ptr: ptr_t, len: size_t, read_out: ?*size_t, flags: u32) callconv(.c) result_t {
+pub fn ipc_recv(ch: handle_t, buf_ptr: ptr_t, len: size_t, read_out: ?*size_t, flags: u32) callconv(.c) result_t {
     if (!allow(.ipc)) return ERR_PERMISSION;
     _ = flags;
     if (validateHandle(ipc_table[0..], HANDLE_IPC, ch) == null) return ERR_INVALID;
@@ -672,17 +1440,22 @@ pub export fn ipc_recv(ch: handle_t, buf_ptr: ptr_t, len: size_t, read_out: ?*si
     return ERR_WOULD_BLOCK;
 }
 
-pub export fn ipc_close(ch: handle_t) callconv(.c) result_t {
+pub fn ipc_close(ch: handle_t) callconv(.c) result_t {
     if (!allow(.ipc)) return ERR_PERMISSION;
     return closeHandle(ipc_table[0..], HANDLE_IPC, ch);
 }
 
-pub export fn net_socket(domain: u32, type_: u32, protocol: u32, handle_out: ?*handle_t) callconv(.c) result_t {
+pub fn net_socket(domain: u32, type_: u32, protocol: u32, handle_out: ?*handle_t) callconv(.c) result_t {
+    if (comptime !config.net) return ERR_UNSUPPORTED;
     if (!allow(.net)) return ERR_PERMISSION;
     if (handle_out == null) return ERR_INVALID;
     // Only support AF_INET(2) + SOCK_DGRAM(2) + UDP(17)
     if (domain != 2 or type_ != 2 or protocol != 17) return ERR_UNSUPPORTED;
 
+    // virtio-net is brought up lazily on the first socket. Sockets are
+    // still handed out without a NIC; sends then fail with ERR_IO.
+    _ = net.ensureDevice();
+
     var handle: handle_t = 0;
     const rc = allocHandle(net_table[0..], HANDLE_NET, &handle);
     if (rc != OK) return rc;
@@ -705,7 +1478,8 @@ fn parseNetAddr(addr_ptr: ptr_t, addr_len: u32) ?struct { ip: [4]u8, port: u16 }
     return .{ .ip = ip, .port = port };
 }
 
-pub export fn net_bind(sock: handle_t, addr_ptr: ptr_t, addr_len: u32) callconv(.c) result_t {
+pub fn net_bind(sock: handle_t, addr_ptr: ptr_t, addr_len: u32) callconv(.c) result_t {
+    if (comptime !config.net) return ERR_UNSUPPORTED;
     if (!allow(.net)) return ERR_PERMISSION;
     const idx = validateHandle(net_table[0..], HANDLE_NET, sock) orelse return ERR_INVALID;
     const addr = parseNetAddr(addr_ptr, addr_len) orelse return ERR_INVALID;
@@ -713,7 +1487,8 @@ pub export fn net_bind(sock: handle_t, addr_ptr: ptr_t, addr_len: u32) callconv(
     return OK;
 }
 
-pub export fn net_connect(sock: handle_t, addr_ptr: ptr_t, addr_len: u32) callconv(.c) result_t {
+pub fn net_connect(sock: handle_t, addr_ptr: ptr_t, addr_len: u32) callconv(.c) result_t {
+    if (comptime !config.net) return ERR_UNSUPPORTED;
     if (!allow(.net)) return ERR_PERMISSION;
     const idx = validateHandle(net_table[0..], HANDLE_NET, sock) orelse return ERR_INVALID;
     const addr = parseNetAddr(addr_ptr, addr_len) orelse return ERR_INVALID;
@@ -721,9 +1496,15 @@ pub export fn net_connect(sock: handle_t, addr_ptr: ptr_t, addr_len: u32) callco
     return OK;
 }
 
-pub export fn net_send(sock: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32, wrote_out: ?*size_t) callconv(.c) result_t {
+pub fn net_send(sock: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32, wrote_out: ?*size_t) callconv(.c) result_t {
+    if (comptime !config.net) return ERR_UNSUPPORTED;
     if (!allow(.net)) return ERR_PERMISSION;
+    return netSendImpl(sock, buf_ptr, len, flags, wrote_out);
+}
+
+fn netSendImpl(sock: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32, wrote_out: ?*size_t) result_t {
     _ = flags;
+    if (comptime !config.net) return ERR_UNSUPPORTED;
     const idx = validateHandle(net_table[0..], HANDLE_NET, sock) orelse return ERR_INVALID;
     if (len > 0 and buf_ptr == 0) return ERR_INVALID;
     if (len == 0) {
@@ -737,16 +1518,22 @@ pub export fn net_send(sock: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32,
     return OK;
 }
 
-pub export fn net_recv(sock: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32, read_out: ?*size_t) callconv(.c) result_t {
+pub fn net_recv(sock: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32, read_out: ?*size_t) callconv(.c) result_t {
+    if (comptime !config.net) return ERR_UNSUPPORTED;
     if (!allow(.net)) return ERR_PERMISSION;
-    _ = flags;
-    const idx = validateHandle(net_table[0..], HANDLE_NET, sock) orelse return ERR_INVALID;
-    if (len > 0 and buf_ptr == 0) return ERR_INVALID;
 
     // Drain incoming packets first
     if (comptime builtin.cpu.arch == .x86_64) {
         net.processIncoming();
     }
+    return netRecvImpl(sock, buf_ptr, len, flags, read_out);
+}
+
+fn netRecvImpl(sock: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32, read_out: ?*size_t) result_t {
+    _ = flags;
+    if (comptime !config.net) return ERR_UNSUPPORTED;
+    const idx = validateHandle(net_table[0..], HANDLE_NET, sock) orelse return ERR_INVALID;
+    if (len > 0 and buf_ptr == 0) return ERR_INVALID;
 
     const buf: [*]u8 = if (buf_ptr != 0) @ptrFromInt(buf_ptr) else undefined;
     const n = net.udpRecv(idx, buf[0..len]) orelse {
@@ -757,91 +1544,159 @@ pub export fn net_recv(sock: handle_t, buf_ptr: ptr_t, len: size_t, flags: u32,
     return OK;
 }
 
-pub export fn net_close(sock: handle_t) callconv(.c) result_t {
+pub fn net_close(sock: handle_t) callconv(.c) result_t {
+    if (comptime !config.net) return ERR_UNSUPPORTED;
     if (!allow(.net)) return ERR_PERMISSION;
     const idx = validateHandle(net_table[0..], HANDLE_NET, sock) orelse return ERR_INVALID;
     net.udpSocketClose(idx);
     return closeHandle(net_table[0..], HANDLE_NET, sock);
 }
 
-pub export fn log_write(level: u32, msg_ptr: ptr_t, len: size_t) callconv(.c) result_t {
+/// Attach a raw frame ring in workload memory (frame_ring.zig layout) and
+/// steer matching received frames to it instead of the stack.
+pub fn net_frame_setup(mem: ptr_t, len: size_t, entries: u32, ethertype: u32, udp_port: u32, ring_out: ?*handle_t) callconv(.c) result_t {
+    if (comptime !config.net_raw) return ERR_UNSUPPORTED;
+    if (!allow(.net_raw)) return ERR_PERMISSION;
+    if (ring_out == null or mem == 0) return ERR_INVALID;
+    if (!frame_ring.validEntries(entries)) return ERR_INVALID;
+    if ((mem & 63) != 0 or len < frame_ring.ringSize(entries)) return ERR_INVALID;
+    if (ethertype > 0xFFFF or udp_port > 0xFFFF) return ERR_INVALID;
+    const steer = frame_ring.Steer{ .ethertype = @intCast(ethertype), .udp_port = @intCast(udp_port) };
+    if (!steer.valid()) return ERR_INVALID;
+    if (!net.ensureDevice()) return ERR_NOENT;
+    if (!net.frameFitsSlot()) return ERR_UNSUPPORTED;
+
+    var handle: handle_t = 0;
+    const rc = allocHandle(frame_table[0..], HANDLE_FRAME, &handle);
+    if (rc != OK) return rc;
+
+    net.frameAttach(handleId(handle), frame_ring.Ring.init(mem, entries), steer);
+    ring_out.?.* = handle;
+    return OK;
+}
+
+/// Send every frame queued on the TX ring, then move received frames from
+/// the device onto the RX rings: one call per batch in both directions.
+pub fn net_frame_sync(ring: handle_t, sent_out: ?*u32, pending_out: ?*u32) callconv(.c) result_t {
+    if (comptime !config.net_raw) return ERR_UNSUPPORTED;
+    if (!allow(.net_raw)) return ERR_PERMISSION;
+    const idx = validateHandle(frame_table[0..], HANDLE_FRAME, ring) orelse return ERR_INVALID;
+
+    const sent = net.frameTransmit(idx);
+    if (comptime builtin.cpu.arch == .x86_64) {
+        net.processIncoming();
+    }
+    if (sent_out != null) sent_out.?.* = sent;
+    if (pending_out != null) pending_out.?.* = net.frameRing(idx).rxPending();
+    return OK;
+}
+
+pub fn net_frame_close(ring: handle_t) callconv(.c) result_t {
+    if (comptime !config.net_raw) return ERR_UNSUPPORTED;
+    if (!allow(.net_raw)) return ERR_PERMISSION;
+    const idx = validateHandle(frame_table[0..], HANDLE_FRAME, ring) orelse return ERR_INVALID;
+    net.frameDetach(idx);
+    return closeHandle(frame_table[0..], HANDLE_FRAME, ring);
+}
+
+/// Queue a log record without waiting on the UART. Records below the
+/// minimum level are discarded before any formatting; records that do not
+/// fit in the transmit ring are counted as dropped.
+pub fn log_write(level: u32, msg_ptr: ptr_t, len: size_t) callconv(.c) result_t {
     if (!allow(.log)) return ERR_PERMISSION;
     if (len == 0) return OK;
     if (msg_ptr == 0) return ERR_INVALID;
-    logPrefix(level);
-    var i: u64 = 0;
-    while (i < len) : (i += 1) {
-        const byte_ptr = @as(*const u8, @ptrFromInt(msg_ptr + i));
-        const b = byte_ptr.*;
-        if (b == '\n') {
-            serial.writeByte('\r');
-        }
-        serial.writeByte(b);
+    if (level < log_min_level) return OK;
+
+    if (log_dropped_unreported != 0) {
+        var note_buf: [48]u8 = undefined;
+        const note = std.fmt.bufPrint(&note_buf, "[log] {d} records dropped\n", .{log_dropped_unreported}) catch note_buf[0..0];
+        if (serial.tryWriteRecord(&.{note})) log_dropped_unreported = 0;
+    }
+
+    var prefix_buf: [40]u8 = undefined;
+    const prefix = logPrefix(&prefix_buf, level);
+    const msg: [*]const u8 = @ptrFromInt(msg_ptr);
+    if (!serial.tryWriteRecord(&.{ prefix, msg[0..len] })) {
+        log_dropped_total +%= 1;
+        log_dropped_unreported +%= 1;
     }
+    // The record log gets every record, including ones the serial ring dropped
+    if (comptime config.disk_log) _ = disk_log.append(.log, &.{ prefix, msg[0..len] });
+    serial.pump();
     return OK;
 }
 
-pub export fn trace_span_begin(_: ptr_t, _: size_t, _: ?*handle_t) callconv(.c) result_t {
-    if (!allow(.trace)) return ERR_PERMISSION;
-    return ERR_UNSUPPORTED;
+pub fn log_set_level(min_level: u32) callconv(.c) result_t {
+    if (!allow(.log)) return ERR_PERMISSION;
+    if (min_level > LOG_ERROR) return ERR_INVALID;
+    log_min_level = min_level;
+    return OK;
 }
 
-pub export fn trace_span_end(_: handle_t) callconv(.c) result_t {
-    if (!allow(.trace)) return ERR_PERMISSION;
-    return ERR_UNSUPPORTED;
+pub fn log_dropped(count_out: ?*u64) callconv(.c) result_t {
+    if (!allow(.log)) return ERR_PERMISSION;
+    if (count_out == null) return ERR_INVALID;
+    count_out.?.* = log_dropped_total;
+    return OK;
 }
 
-pub export fn trace_event(_: handle_t, _: ptr_t, _: size_t, _: ptr_t, _: size_t) callconv(.c) result_t {
-    if (!allow(.trace)) return ERR_PERMISSION;
-    return ERR_UNSUPPORTED;
+fn traceName(ptr: ptr_t, len: size_t) ?u16 {
+    if (len == 0) return 0;
+    if (ptr == 0) return null;
+    const bytes: [*]const u8 = @ptrFromInt(ptr);
+    return trace.intern(bytes[0..len]);
 }
 
-fn capMask(kind: u32) u32 {
-    return @as(u32, 1) << @as(u5, @intCast(kind - 1));
+pub fn trace_span_begin(name_ptr: ptr_t, name_len: size_t, span_out: ?*handle_t) callconv(.c) result_t {
+    if (comptime !config.abi_trace) return ERR_UNSUPPORTED;
+    if (!allow(.trace)) return ERR_PERMISSION;
+    if (span_out == null) return ERR_INVALID;
+    const name = traceName(name_ptr, name_len) orelse return ERR_INVALID;
+
+    var handle: handle_t = 0;
+    const rc = allocHandle(span_table[0..], HANDLE_SPAN, &handle);
+    if (rc != OK) return rc;
+
+    open_spans[handleId(handle)] = trace.beginSpan(name);
+    span_out.?.* = handle;
+    return OK;
 }
 
-fn logPrefix(level: u32) void {
-    serial.writeAll("[log lvl=");
-    writeU32Dec(level);
-    serial.writeAll(" cap=0x");
-    writeU32Hex(active_mask);
-    serial.writeAll("] ");
+pub fn trace_span_end(span: handle_t) callconv(.c) result_t {
+    if (comptime !config.abi_trace) return ERR_UNSUPPORTED;
+    if (!allow(.trace)) return ERR_PERMISSION;
+    const idx = validateHandle(span_table[0..], HANDLE_SPAN, span) orelse return ERR_INVALID;
+    trace.endSpan(open_spans[idx]);
+    open_spans[idx] = .{};
+    return closeHandle(span_table[0..], HANDLE_SPAN, span);
 }
 
-fn writeU32Dec(value: u32) void {
-    var buf: [10]u8 = undefined;
-    var v = value;
-    if (v == 0) {
-        serial.writeByte('0');
-        return;
-    }
-    var i: usize = 0;
-    while (v > 0) : (v /= 10) {
-        buf[i] = @intCast('0' + @as(u8, @intCast(v % 10)));
-        i += 1;
-    }
-    while (i > 0) : (i -= 1) {
-        serial.writeByte(buf[i - 1]);
+/// span = 0 attaches the event to the innermost open span.
+pub fn trace_event(span: handle_t, name_ptr: ptr_t, name_len: size_t, kv_ptr: ptr_t, kv_len: size_t) callconv(.c) result_t {
+    if (comptime !config.abi_trace) return ERR_UNSUPPORTED;
+    if (!allow(.trace)) return ERR_PERMISSION;
+    var span_id: u32 = 0;
+    if (span != 0) {
+        const idx = validateHandle(span_table[0..], HANDLE_SPAN, span) orelse return ERR_INVALID;
+        span_id = open_spans[idx].id;
     }
+    const name = traceName(name_ptr, name_len) orelse return ERR_INVALID;
+    const kv: []const u8 = if (kv_len == 0) "" else blk: {
+        if (kv_ptr == 0) return ERR_INVALID;
+        const bytes: [*]const u8 = @ptrFromInt(kv_ptr);
+        break :blk bytes[0..kv_len];
+    };
+    trace.event(span_id, name, kv);
+    return OK;
 }
 
-fn writeU32Hex(value: u32) void {
-    var shift: i32 = 28;
-    var started = false;
-    while (shift >= 0) : (shift -= 4) {
-        const nibble: u4 = @intCast((value >> @as(u5, @intCast(shift))) & 0xF);
-        if (!started and nibble == 0 and shift != 0) {
-            continue;
-        }
-        started = true;
-        const n: u8 = @intCast(nibble);
-        const ch: u8 = if (n < 10)
-            @intCast('0' + n)
-        else
-            @intCast('a' + (n - 10));
-        serial.writeByte(ch);
-    }
-    if (!started) serial.writeByte('0');
+fn capMask(kind: u32) u32 {
+    return @as(u32, 1) << @as(u5, @intCast(kind - 1));
+}
+
+fn logPrefix(buf: []u8, level: u32) []const u8 {
+    return std.fmt.bufPrint(buf, "[log lvl={d} cap=0x{x}] ", .{ level, active_mask }) catch buf[0..0];
 }
 
 test "caps start empty and deny by default" {
@@ -958,6 +1813,62 @@ test "mem_alloc permission denied without cap" {
     try std.testing.expectEqual(ERR_PERMISSION, mem_alloc(64, 0, &ptr));
 }
 
+test "mem_trim reports the ABI heap above its top" {
+    const virtio_mock = @import("virtio_mock.zig");
+    resetCapsForWorkload(capMask(CAP_MEM));
+    heap_top = 0;
+    heap_peak = 0;
+    heap_reported_end = 0;
+    for (&alloc_table) |*entry| {
+        entry.* = .{};
+    }
+    var cap: handle_t = 0;
+    _ = cap_acquire(CAP_MEM, &cap);
+    _ = cap_enter(&cap, 1);
+
+    var reported: u64 = 0;
+    var enabled: u32 = 1;
+    virtio_mock.reset();
+    try std.testing.expect(!balloon.init());
+    try std.testing.expectEqual(ERR_NOENT, mem_trim(&reported));
+    try std.testing.expectEqual(OK, abi_feature_enabled(FEAT_BALLOON, &enabled));
+    try std.testing.expectEqual(@as(u32, 0), enabled);
+
+    const model = virtio_mock.addBalloon(virtio_mock.BALLOON_F_REPORTING);
+    try std.testing.expect(balloon.init());
+    try std.testing.expectEqual(OK, abi_feature_enabled(FEAT_BALLOON, &enabled));
+    try std.testing.expectEqual(@as(u32, 1), enabled);
+    // The first pass hands back the untouched page pool
+    try std.testing.expectEqual(OK, mem_trim(&reported));
+    const before = model.stats.reported_bytes;
+
+    // 128 KiB written and freed above a live allocation: 32 pages go back,
+    // the live one keeps its data
+    var small: ptr_t = 0;
+    var big: ptr_t = 0;
+    try std.testing.expectEqual(OK, mem_alloc(64, 0, &small));
+    @memset(@as([*]u8, @ptrFromInt(small))[0..64], 0x11);
+    try std.testing.expectEqual(OK, mem_alloc(128 * 1024, 0, &big));
+    @memset(@as([*]u8, @ptrFromInt(big))[0 .. 128 * 1024], 0x5A);
+    try std.testing.expectEqual(OK, mem_free(big));
+    try std.testing.expectEqual(OK, mem_trim(&reported));
+    try std.testing.expectEqual(@as(u64, 32), reported);
+    try std.testing.expectEqual(before + 32 * 4096, model.stats.reported_bytes);
+    try std.testing.expect(std.mem.allEqual(u8, @as([*]u8, @ptrFromInt(small))[0..64], 0x11));
+    try std.testing.expectEqual(OK, mem_trim(&reported));
+    try std.testing.expectEqual(@as(u64, 0), reported);
+
+    // Growing over the reported pages reclaims them
+    try std.testing.expectEqual(OK, mem_alloc(128 * 1024, 0, &big));
+    var stats: BalloonStats = undefined;
+    try std.testing.expectEqual(OK, mem_balloon_stats(@intFromPtr(&stats)));
+    try std.testing.expectEqual(@as(u64, 32), stats.reclaimed_pages);
+    try std.testing.expectEqual(@as(u32, 1), stats.reporting);
+    try std.testing.expectEqual(ERR_INVALID, mem_balloon_stats(0));
+    try std.testing.expectEqual(OK, mem_free(big));
+    try std.testing.expectEqual(OK, mem_free(small));
+}
+
 test "io_poll permission denied without CAP_IO" {
     resetCapsForWorkload(0);
 
@@ -1005,6 +1916,44 @@ test "io_open + io_close lifecycle" {
     try std.testing.expectEqual(ERR_INVALID, io_close(handle));
 }
 
+var test_rootfs: [512]u8 = undefined;
+var test_data_disk: [64 * 512]u8 = undefined;
+
+test "io_open disklog writes records to the data disk" {
+    const virtio_mock = @import("virtio_mock.zig");
+    const policy = capMask(CAP_IO);
+    resetCapsForWorkload(policy);
+    var cap: handle_t = 0;
+    try std.testing.expectEqual(OK, cap_acquire(CAP_IO, &cap));
+    try std.testing.expectEqual(OK, cap_enter(&cap, 1));
+
+    var handle: handle_t = 0;
+    const path = "disklog";
+    try std.testing.expectEqual(ERR_NOENT, io_open(@intFromPtr(path.ptr), 0, &handle));
+
+    virtio_mock.reset();
+    _ = virtio_mock.addBlk(&test_rootfs);
+    const model = virtio_mock.addBlk(&test_data_disk);
+    @memset(&test_data_disk, 0);
+    try std.testing.expect(disk_log.mount());
+    defer disk_log.unmount();
+
+    try std.testing.expectEqual(OK, io_open(@intFromPtr(path.ptr), IO_OPEN_SYNC, &handle));
+    const written_before = model.stats.bytes_written;
+    const msg = "sample 1";
+    var wrote: size_t = 0;
+    try std.testing.expectEqual(OK, io_write(handle, @intFromPtr(msg.ptr), msg.len, &wrote));
+    try std.testing.expectEqual(@as(size_t, msg.len), wrote);
+    // IO_OPEN_SYNC: the batch is written before io_write returns
+    try std.testing.expect(model.stats.bytes_written > written_before);
+    try std.testing.expectEqual(@as(u64, 1), disk_log.stats.batches);
+
+    var buf: [16]u8 = undefined;
+    try std.testing.expectEqual(ERR_UNSUPPORTED, io_read(handle, @intFromPtr(&buf), buf.len, null));
+    try std.testing.expectEqual(IO_WRITABLE, probeIoEvents(handleId(handle)));
+    try std.testing.expectEqual(OK, io_close(handle));
+}
+
 test "io_poll probes serial handle" {
     const policy = capMask(CAP_IO);
     resetCapsForWorkload(policy);
@@ -1017,22 +1966,362 @@ test "io_poll probes serial handle" {
     const path = "serial";
     try std.testing.expectEqual(OK, io_open(@intFromPtr(path.ptr), 0, &handle));
 
-    // Non-blocking poll — on non-x86_64 test host, serial port I/O returns 0,
-    // so rxReady/txReady return false. Poll should return ERR_WOULD_BLOCK.
-    // On real hardware it would return IO_WRITABLE.
+    // Hosted builds model an idle UART (serial.zig's inb stub reports an
+    // empty transmitter and no received byte), so the handle is writable only
     var events: [1]io_event_t = [_]io_event_t{.{ .handle = 0, .events = 0 }} ** 1;
     var ev_count: u32 = 0;
-    const rc = io_poll(&handle, 1, 0, @intFromPtr(&events[0]), &ev_count);
+    try std.testing.expectEqual(OK, io_poll(&handle, 1, 0, @intFromPtr(&events[0]), &ev_count));
+    try std.testing.expectEqual(@as(u32, 1), ev_count);
+    try std.testing.expectEqual(handle, events[0].handle);
+    try std.testing.expectEqual(IO_WRITABLE, events[0].events);
 
-    if (comptime builtin.cpu.arch == .x86_64) {
-        // On x86_64 host, inb returns 0 so no events
-        try std.testing.expectEqual(ERR_WOULD_BLOCK, rc);
-        try std.testing.expectEqual(@as(u32, 0), ev_count);
+    _ = io_close(handle);
+}
+
+test "time_deadline in the past is readable and cancel releases it" {
+    const policy = capMask(CAP_TIME) | capMask(CAP_IO);
+    resetCapsForWorkload(policy);
+
+    var caps: [2]handle_t = .{ 0, 0 };
+    try std.testing.expectEqual(OK, cap_acquire(CAP_TIME, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_IO, &caps[1]));
+    try std.testing.expectEqual(OK, cap_enter(&caps[0], 2));
+
+    var deadline: handle_t = 0;
+    try std.testing.expectEqual(OK, time_deadline(0, &deadline));
+    try std.testing.expectEqual(@as(u8, HANDLE_TIMER), handleTag(deadline));
+
+    var events: [1]io_event_t = [_]io_event_t{.{ .handle = 0, .events = 0 }} ** 1;
+    var ev_count: u32 = 0;
+    try std.testing.expectEqual(OK, io_poll(&deadline, 1, 0, @intFromPtr(&events[0]), &ev_count));
+    try std.testing.expectEqual(@as(u32, 1), ev_count);
+    try std.testing.expectEqual(deadline, events[0].handle);
+    try std.testing.expectEqual(IO_READABLE, events[0].events);
+
+    try std.testing.expectEqual(OK, time_cancel(deadline));
+    try std.testing.expectEqual(ERR_INVALID, time_cancel(deadline));
+}
+
+test "time_deadline in the future is not readable yet" {
+    const policy = capMask(CAP_TIME) | capMask(CAP_IO);
+    resetCapsForWorkload(policy);
+
+    var caps: [2]handle_t = .{ 0, 0 };
+    try std.testing.expectEqual(OK, cap_acquire(CAP_TIME, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_IO, &caps[1]));
+    try std.testing.expectEqual(OK, cap_enter(&caps[0], 2));
+
+    var now: time_ns = 0;
+    try std.testing.expectEqual(OK, time_now(&now));
+
+    var deadline: handle_t = 0;
+    try std.testing.expectEqual(OK, time_deadline(now + 60 * 1_000_000_000, &deadline));
+
+    var events: [1]io_event_t = [_]io_event_t{.{ .handle = 0, .events = 0 }} ** 1;
+    var ev_count: u32 = 0;
+    try std.testing.expectEqual(ERR_WOULD_BLOCK, io_poll(&deadline, 1, 0, @intFromPtr(&events[0]), &ev_count));
+    try std.testing.expectEqual(OK, time_cancel(deadline));
+}
+
+test "io_poll interest masks filter reported events" {
+    const policy = capMask(CAP_TIME) | capMask(CAP_IO);
+    resetCapsForWorkload(policy);
+
+    var caps: [2]handle_t = .{ 0, 0 };
+    try std.testing.expectEqual(OK, cap_acquire(CAP_TIME, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_IO, &caps[1]));
+    try std.testing.expectEqual(OK, cap_enter(&caps[0], 2));
+
+    var fired: [2]handle_t = .{ 0, 0 };
+    try std.testing.expectEqual(OK, time_deadline(0, &fired[0]));
+    try std.testing.expectEqual(OK, time_deadline(0, &fired[1]));
+
+    // Both deadlines are readable, but only the second asks for it
+    var events = [_]io_event_t{ .{ .handle = 0, .events = IO_WRITABLE }, .{ .handle = 0, .events = IO_READABLE } };
+    var ev_count: u32 = 0;
+    try std.testing.expectEqual(OK, io_poll(&fired[0], 2 | IO_POLL_INTEREST, 0, @intFromPtr(&events[0]), &ev_count));
+    try std.testing.expectEqual(@as(u32, 1), ev_count);
+    try std.testing.expectEqual(fired[1], events[0].handle);
+    try std.testing.expectEqual(IO_READABLE, events[0].events);
+
+    events[0].events = IO_WRITABLE;
+    try std.testing.expectEqual(ERR_WOULD_BLOCK, io_poll(&fired[0], 1 | IO_POLL_INTEREST, 0, @intFromPtr(&events[0]), &ev_count));
+    try std.testing.expectEqual(ERR_INVALID, io_poll(&fired[0], 1 | IO_POLL_INTEREST, 0, 0, &ev_count));
+
+    try std.testing.expectEqual(OK, time_cancel(fired[0]));
+    try std.testing.expectEqual(OK, time_cancel(fired[1]));
+}
+
+test "io_set reports deadlines edge- and level-triggered" {
+    const policy = capMask(CAP_TIME) | capMask(CAP_IO);
+    resetCapsForWorkload(policy);
+
+    var caps: [2]handle_t = .{ 0, 0 };
+    try std.testing.expectEqual(OK, cap_acquire(CAP_TIME, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_IO, &caps[1]));
+    try std.testing.expectEqual(OK, cap_enter(&caps[0], 2));
+
+    var set: handle_t = 0;
+    try std.testing.expectEqual(OK, io_set_create(0, &set));
+    try std.testing.expectEqual(@as(u8, HANDLE_IOSET), handleTag(set));
+
+    var now: time_ns = 0;
+    try std.testing.expectEqual(OK, time_now(&now));
+    var level: handle_t = 0;
+    var edge: handle_t = 0;
+    try std.testing.expectEqual(OK, time_deadline(now + 60 * 1_000_000_000, &level));
+    try std.testing.expectEqual(OK, time_deadline(0, &edge));
+
+    try std.testing.expectEqual(OK, io_set_ctl(set, IOSET_ADD, level, IO_READABLE, 1));
+    try std.testing.expectEqual(OK, io_set_ctl(set, IOSET_ADD, edge, IO_READABLE | IO_EDGE, 2));
+    try std.testing.expectEqual(ERR_BUSY, io_set_ctl(set, IOSET_ADD, edge, IO_READABLE, 2));
+
+    var events: [4]io_set_event_t = undefined;
+    var n: u32 = 0;
+    try std.testing.expectEqual(OK, io_set_wait(set, @intFromPtr(&events[0]), 4, 0, &n));
+    try std.testing.expectEqual(@as(u32, 1), n);
+    try std.testing.expectEqual(edge, events[0].handle);
+    try std.testing.expectEqual(@as(u64, 2), events[0].user_data);
+
+    // Edge-triggered: already reported, nothing new
+    try std.testing.expectEqual(ERR_WOULD_BLOCK, io_set_wait(set, @intFromPtr(&events[0]), 4, 0, &n));
+
+    // Switching to level-triggered re-evaluates and keeps reporting
+    try std.testing.expectEqual(OK, io_set_ctl(set, IOSET_MOD, edge, IO_READABLE, 3));
+    try std.testing.expectEqual(OK, io_set_wait(set, @intFromPtr(&events[0]), 4, 0, &n));
+    try std.testing.expectEqual(@as(u64, 3), events[0].user_data);
+    try std.testing.expectEqual(OK, io_set_wait(set, @intFromPtr(&events[0]), 4, 0, &n));
+    try std.testing.expectEqual(@as(u32, 1), n);
+
+    // Cancelling the deadline drops its registration
+    try std.testing.expectEqual(OK, time_cancel(edge));
+    try std.testing.expectEqual(ERR_WOULD_BLOCK, io_set_wait(set, @intFromPtr(&events[0]), 4, 0, &n));
+    try std.testing.expectEqual(ERR_NOENT, io_set_ctl(set, IOSET_DEL, edge, 0, 0));
+
+    try std.testing.expectEqual(OK, io_set_ctl(set, IOSET_DEL, level, 0, 0));
+    try std.testing.expectEqual(OK, io_set_close(set));
+    try std.testing.expectEqual(ERR_INVALID, io_set_close(set));
+    _ = time_cancel(level);
+}
+
+test "io_ring batches submissions and completes timeouts" {
+    if (!config.abi_ring) return error.SkipZigTest;
+    const policy = capMask(CAP_TIME) | capMask(CAP_IO);
+    resetCapsForWorkload(policy);
+
+    var caps: [2]handle_t = .{ 0, 0 };
+    try std.testing.expectEqual(OK, cap_acquire(CAP_TIME, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_IO, &caps[1]));
+    try std.testing.expectEqual(OK, cap_enter(&caps[0], 2));
+
+    var io: handle_t = 0;
+    const path = "null";
+    try std.testing.expectEqual(OK, io_open(@intFromPtr(path.ptr), 0, &io));
+
+    var mem: [io_ring.ringSize(4)]u8 align(8) = undefined;
+    var ring: handle_t = 0;
+    try std.testing.expectEqual(ERR_INVALID, io_ring_setup(@intFromPtr(&mem), mem.len, 3, &ring));
+    try std.testing.expectEqual(OK, io_ring_setup(@intFromPtr(&mem), mem.len, 4, &ring));
+    try std.testing.expectEqual(@as(u8, HANDLE_RING), handleTag(ring));
+
+    const S = struct {
+        fn sqe(op: u8, handle: handle_t, addr: ptr_t, len: u64, arg: u64, user_data: u64) io_ring.Sqe {
+            return .{ .opcode = op, .flags = 0, .reserved0 = 0, .op_flags = 0, .handle = handle, .addr = addr, .len = len, .arg = arg, .user_data = user_data };
+        }
+    };
+    const payload = "hello";
+    var rx: [8]u8 = undefined;
+    const r = &rings[handleId(ring)];
+    r.sqes[0] = S.sqe(io_ring.OP_NOP, 0, 0, 0, 0, 1);
+    r.sqes[1] = S.sqe(io_ring.OP_WRITE, io, @intFromPtr(payload.ptr), payload.len, 0, 2);
+    r.sqes[2] = S.sqe(io_ring.OP_TIMEOUT, 0, 0, 0, 0, 3);
+    // Never readable: stays in flight until the ring is closed
+    r.sqes[3] = S.sqe(io_ring.OP_READ, io, @intFromPtr(&rx), rx.len, 0, 4);
+    r.hdr.sq_tail = 4;
+
+    var submitted: u32 = 0;
+    try std.testing.expectEqual(OK, io_ring_enter(ring, 3, 1_000_000_000, &submitted));
+    try std.testing.expectEqual(@as(u32, 4), submitted);
+    try std.testing.expectEqual(@as(u32, 3), r.hdr.cq_tail);
+    try std.testing.expectEqual(@as(u64, 1), r.cqes[0].user_data);
+    try std.testing.expectEqual(OK, r.cqes[0].result);
+    try std.testing.expectEqual(@as(u64, 2), r.cqes[1].user_data);
+    try std.testing.expectEqual(@as(u64, payload.len), r.cqes[1].value);
+    try std.testing.expectEqual(@as(u64, 3), r.cqes[2].user_data);
+    try std.testing.expectEqual(ERR_TIMEOUT, r.cqes[2].result);
+
+    try std.testing.expectEqual(OK, io_ring_close(ring));
+    try std.testing.expectEqual(ERR_INVALID, io_ring_enter(ring, 0, 0, null));
+    _ = io_close(io);
+}
+
+test "net_frame rings need CAP_NET_RAW and report readiness through io_poll" {
+    if (!config.net_raw) return error.SkipZigTest;
+    const virtio_mock = @import("virtio_mock.zig");
+    const virtio_net = @import("virtio_net.zig");
+    var mem: [frame_ring.ringSize(4)]u8 align(64) = undefined;
+    var ring: handle_t = 0;
+
+    // CAP_NET does not grant raw access
+    resetCapsForWorkload(capMask(CAP_NET) | capMask(CAP_IO));
+    var caps: [2]handle_t = .{ 0, 0 };
+    try std.testing.expectEqual(ERR_PERMISSION, cap_acquire(CAP_NET_RAW, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_NET, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_IO, &caps[1]));
+    try std.testing.expectEqual(OK, cap_enter(&caps[0], 2));
+    try std.testing.expectEqual(ERR_PERMISSION, net_frame_setup(@intFromPtr(&mem), mem.len, 4, 0, 0, &ring));
+
+    resetCapsForWorkload(capMask(CAP_NET_RAW) | capMask(CAP_IO));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_NET_RAW, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_IO, &caps[1]));
+    try std.testing.expectEqual(OK, cap_enter(&caps[0], 2));
+
+    virtio_mock.reset();
+    _ = virtio_mock.addNet(.{ 0xaa, 0xfc, 0, 0, 0, 1 }, .loopback);
+    try std.testing.expect(virtio_net.init());
+
+    // ARP stays with the stack; memory must be 64-byte aligned and large
+    // enough for the entry count
+    try std.testing.expectEqual(ERR_INVALID, net_frame_setup(@intFromPtr(&mem), mem.len, 4, 0x0806, 0, &ring));
+    try std.testing.expectEqual(ERR_INVALID, net_frame_setup(@intFromPtr(&mem) + 8, mem.len - 8, 4, 0, 0, &ring));
+    try std.testing.expectEqual(ERR_INVALID, net_frame_setup(@intFromPtr(&mem), mem.len, 8, 0, 0, &ring));
+    try std.testing.expectEqual(OK, net_frame_setup(@intFromPtr(&mem), mem.len, 4, 0x88b5, 0, &ring));
+    try std.testing.expectEqual(@as(u8, HANDLE_FRAME), handleTag(ring));
+
+    var events = [_]io_event_t{.{ .handle = 0, .events = 0 }};
+    var count: u32 = 0;
+    try std.testing.expectEqual(OK, io_poll(&ring, 1, 0, @intFromPtr(&events), &count));
+    try std.testing.expectEqual(IO_WRITABLE, events[0].events);
+
+    // The loopback peer returns the frame, which the steering puts on the
+    // RX ring within the same sync
+    const r = net.frameRing(handleId(ring));
+    const slot = r.slot(r.tx[0].slot).?;
+    @memset(slot[0..60], 0);
+    slot[12] = 0x88;
+    slot[13] = 0xb5;
+    r.tx[0].len = 60;
+    r.hdr.tx_tail = 1;
+    var sent: u32 = 0;
+    var pending: u32 = 0;
+    try std.testing.expectEqual(OK, net_frame_sync(ring, &sent, &pending));
+    try std.testing.expectEqual(@as(u32, 1), sent);
+    try std.testing.expectEqual(@as(u32, 1), pending);
+    try std.testing.expectEqual(OK, io_poll(&ring, 1, 0, @intFromPtr(&events), &count));
+    try std.testing.expectEqual(IO_READABLE | IO_WRITABLE, events[0].events);
+
+    // Consuming through shared memory alone clears READABLE
+    r.hdr.rx_head = 1;
+    try std.testing.expectEqual(OK, io_poll(&ring, 1, 0, @intFromPtr(&events), &count));
+    try std.testing.expectEqual(IO_WRITABLE, events[0].events);
+
+    try std.testing.expectEqual(OK, net_frame_close(ring));
+    try std.testing.expectEqual(ERR_INVALID, net_frame_sync(ring, null, null));
+
+    // Jumbo frames would not fit a slot
+    if (virtio_net.MaxMtu + 14 > frame_ring.SlotSize) {
+        virtio_mock.reset();
+        const dev = virtio_mock.addNet(.{ 0xaa, 0xfc, 0, 0, 0, 1 }, .loopback);
+        virtio_mock.setNetMtu(dev, virtio_net.MaxMtu);
+        try std.testing.expect(virtio_net.init());
+        try std.testing.expectEqual(ERR_UNSUPPORTED, net_frame_setup(@intFromPtr(&mem), mem.len, 4, 0x88b5, 0, &ring));
+    }
+}
+
+test "trace spans and events record under CAP_TRACE" {
+    if (!config.abi_trace) return error.SkipZigTest;
+    const policy = capMask(CAP_TRACE);
+    resetCapsForWorkload(policy);
+
+    var span: handle_t = 0;
+    const name = "request";
+    try std.testing.expectEqual(ERR_PERMISSION, trace_span_begin(@intFromPtr(name.ptr), name.len, &span));
+
+    var cap: handle_t = 0;
+    try std.testing.expectEqual(OK, cap_acquire(CAP_TRACE, &cap));
+    try std.testing.expectEqual(OK, cap_enter(&cap, 1));
+
+    const before = trace.pending();
+    try std.testing.expectEqual(OK, trace_span_begin(@intFromPtr(name.ptr), name.len, &span));
+    try std.testing.expectEqual(@as(u8, HANDLE_SPAN), handleTag(span));
+    const ev = "db_query";
+    const kv = "rows=3";
+    try std.testing.expectEqual(OK, trace_event(span, @intFromPtr(ev.ptr), ev.len, @intFromPtr(kv.ptr), kv.len));
+    try std.testing.expectEqual(OK, trace_event(0, @intFromPtr(ev.ptr), ev.len, 0, 0));
+    try std.testing.expectEqual(OK, trace_span_end(span));
+    try std.testing.expectEqual(ERR_INVALID, trace_span_end(span));
+    // The kv payload rides in one follow-on record
+    try std.testing.expectEqual(before + 5, trace.pending());
+
+    var features: u64 = 0;
+    try std.testing.expectEqual(OK, abi_features(&features));
+    try std.testing.expect((features & FEAT_TRACING) != 0);
+    var enabled: u32 = 0;
+    try std.testing.expectEqual(OK, abi_feature_enabled(FEAT_TRACING, &enabled));
+    try std.testing.expectEqual(@as(u32, 1), enabled);
+    try std.testing.expectEqual(OK, abi_feature_enabled(FEAT_VSOCK, &enabled));
+    try std.testing.expectEqual(@as(u32, 0), enabled);
+}
+
+test "log_write filters by level before queueing" {
+    const policy = capMask(CAP_LOG);
+    resetCapsForWorkload(policy);
+
+    var cap: handle_t = 0;
+    try std.testing.expectEqual(OK, cap_acquire(CAP_LOG, &cap));
+    try std.testing.expectEqual(OK, cap_enter(&cap, 1));
+
+    try std.testing.expectEqual(ERR_INVALID, log_set_level(LOG_ERROR + 1));
+    try std.testing.expectEqual(OK, log_set_level(LOG_WARN));
+
+    const before = serial.pending();
+    const msg = "filtered\n";
+    try std.testing.expectEqual(OK, log_write(LOG_INFO, @intFromPtr(msg.ptr), msg.len));
+    try std.testing.expectEqual(before, serial.pending());
+
+    var dropped: u64 = 1;
+    try std.testing.expectEqual(OK, log_dropped(&dropped));
+    try std.testing.expectEqual(@as(u64, 0), dropped);
+}
+
+test "task_get_stats reports per-call counters" {
+    const policy = capMask(CAP_TASK) | capMask(CAP_TIME);
+    resetCapsForWorkload(policy);
+    resetCallStats();
+
+    var caps: [2]handle_t = .{ 0, 0 };
+    try std.testing.expectEqual(OK, cap_acquire(CAP_TASK, &caps[0]));
+    try std.testing.expectEqual(OK, cap_acquire(CAP_TIME, &caps[1]));
+    try std.testing.expectEqual(OK, cap_enter(&caps, 2));
+
+    var stats: TaskStats = undefined;
+    try std.testing.expectEqual(ERR_INVALID, task_get_stats(0, 0));
+    try std.testing.expectEqual(ERR_NOENT, task_get_stats(1, @intFromPtr(&stats)));
+
+    if (AbiStatsEnabled) {
+        const wrapped = instrumented(.time_now, time_now);
+        var now: time_ns = 0;
+        _ = wrapped(&now);
+        _ = wrapped(null);
+    }
+    try std.testing.expectEqual(OK, task_get_stats(0, @intFromPtr(&stats)));
+    try std.testing.expectEqual(@as(u32, NumAbiCalls), stats.call_count);
+    if (AbiStatsEnabled) {
+        const s = stats.calls[@intFromEnum(AbiCall.time_now)];
+        try std.testing.expectEqual(@as(u64, 2), s.calls);
+        try std.testing.expectEqual(@as(u64, 1), s.errors);
+        try std.testing.expectEqual(@as(u32, 1), s.results[ERR_INVALID]);
+        try std.testing.expect(s.p99_ns <= s.max_ns);
     } else {
-        // Same behavior on non-x86_64
-        try std.testing.expectEqual(ERR_WOULD_BLOCK, rc);
-        try std.testing.expectEqual(@as(u32, 0), ev_count);
+        try std.testing.expectEqual(@as(u32, 0), stats.abi_stats_enabled);
+        try std.testing.expectEqual(@as(u64, 0), stats.calls[0].calls);
     }
 
-    _ = io_close(handle);
+    // A blocking sleep is not charged as CPU time
+    if (builtin.cpu.arch == .x86_64) {
+        try std.testing.expectEqual(OK, task_sleep(1_000_000));
+        try std.testing.expectEqual(OK, task_get_stats(0, @intFromPtr(&stats)));
+        const elapsed = clock.tscToNs(clock.rdtsc() -% task_start_tsc);
+        try std.testing.expect(stats.cpu_time_ns + 500_000 <= elapsed);
+    }
 }
@@ -0,0 +1,96 @@
+// Per-ABI-call counters and TSC latency histograms.
+//
+// Enabled with -Dabi-stats=true; when disabled the export wrappers in
+// abi.zig are not generated and nothing here is referenced.
+//
+// Latencies go into a log-linear histogram: values below 16 cycles get a
+// bucket each, and every power of two above that is split into four
+// sub-buckets (<= 25% relative error), up to 2^44 cycles.
+
+const std = @import("std");
+
+pub const SubBits = 2;
+const SubBuckets = 1 << SubBits;
+const LinearMax = 16; // 2^(SubBits + 2)
+const MaxExp = 44;
+pub const NumBuckets = LinearMax + (MaxExp - 4) * SubBuckets;
+
+// result_t codes 0..10 get their own counter; anything larger lands in the last
+pub const NumResultCodes = 12;
+
+pub const CallStats = struct {
+    calls: u64 = 0,
+    errors: u64 = 0,
+    total_cycles: u64 = 0,
+    max_cycles: u64 = 0,
+    results: [NumResultCodes]u32 = [_]u32{0} ** NumResultCodes,
+    hist: [NumBuckets]u32 = [_]u32{0} ** NumBuckets,
+};
+
+pub fn bucketOf(cycles: u64) usize {
+    if (cycles < LinearMax) return @intCast(cycles);
+    const exp: usize = 63 - @clz(cycles);
+    if (exp >= MaxExp) return NumBuckets - 1;
+    const sub: usize = @intCast((cycles >> @as(u6, @intCast(exp - SubBits))) & (SubBuckets - 1));
+    return LinearMax + (exp - 4) * SubBuckets + sub;
+}
+
+/// Largest cycle count that maps to bucket b.
+pub fn bucketUpper(b: usize) u64 {
+    if (b < LinearMax) return b;
+    const rel = b - LinearMax;
+    const exp: u6 = @intCast(rel / SubBuckets + 4);
+    const sub: u64 = rel % SubBuckets;
+    const step = @as(u64, 1) << (exp - SubBits);
+    return (@as(u64, 1) << exp) + (sub + 1) * step - 1;
+}
+
+pub fn record(s: *CallStats, rc: u32, cycles: u64) void {
+    s.calls += 1;
+    if (rc != 0) s.errors += 1;
+    s.results[if (rc < NumResultCodes - 1) rc else NumResultCodes - 1] +%= 1;
+    s.total_cycles +%= cycles;
+    if (cycles > s.max_cycles) s.max_cycles = cycles;
+    s.hist[bucketOf(cycles)] +%= 1;
+}
+
+/// Cycle count at or below which `permille`/1000 of calls completed
+/// (bucket upper bound).
+pub fn percentile(s: *const CallStats, permille: u32) u64 {
+    if (s.calls == 0) return 0;
+    const want = (s.calls * permille + 999) / 1000;
+    var seen: u64 = 0;
+    for (s.hist, 0..) |count, b| {
+        seen += count;
+        if (seen >= want) return @min(bucketUpper(b), s.max_cycles);
+    }
+    return s.max_cycles;
+}
+
+test "log-linear buckets are monotonic and bound their values" {
+    var prev: usize = 0;
+    var v: u64 = 0;
+    while (v < 100_000) : (v += 37) {
+        const b = bucketOf(v);
+        try std.testing.expect(b >= prev);
+        try std.testing.expect(bucketUpper(b) >= v);
+        if (b > 0) try std.testing.expect(bucketUpper(b - 1) < v);
+        prev = b;
+    }
+    try std.testing.expectEqual(@as(usize, NumBuckets - 1), bucketOf(std.math.maxInt(u64)));
+}
+
+test "percentiles come from the histogram" {
+    var s: CallStats = .{};
+    var i: u64 = 0;
+    while (i < 99) : (i += 1) record(&s, 0, 100);
+    record(&s, 9, 50_000);
+    try std.testing.expectEqual(@as(u64, 100), s.calls);
+    try std.testing.expectEqual(@as(u64, 1), s.errors);
+    try std.testing.expectEqual(@as(u32, 1), s.results[9]);
+
+    const p50 = percentile(&s, 500);
+    try std.testing.expect(p50 >= 100 and p50 < 128);
+    try std.testing.expect(percentile(&s, 990) < 128);
+    try std.testing.expectEqual(@as(u64, 50_000), percentile(&s, 1000));
+}
@@ -0,0 +1,449 @@
+// virtio-balloon: free page reporting and host-requested inflation.
+//
+// Free page reporting (VIRTIO_BALLOON_F_PAGE_REPORTING) hands whole free
+// pages back to the host, which drops them (Firecracker madvises them
+// away), so a guest that freed memory after a startup burst stops holding
+// it resident. Free memory comes from four places: runs of free pages in
+// the kernel page pool, whole free pages in the MicroPython GC heap, the
+// page-aligned inside of free libc blocks, and the ABI heap above its top.
+// Only runs of at least MinReportPages are reported, up to ReportCapacity
+// ranges per request, and each request is waited for before the caller
+// can touch memory again. The kernel runs identity-mapped, so addresses
+// are guest-physical.
+//
+// Nothing is done when a reported page is reused: the host supplies a
+// zero page on the next write. The owners only clear their mark and count
+// the page as reclaimed.
+//
+// The host can also set a target balloon size (config num_pages); poll()
+// inflates by taking single pages from the page pool and sending their
+// PFNs, and deflates by returning them, PfnBatch pages at a time.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const config = @import("config.zig");
+const serial = @import("serial.zig");
+const clock = @import("clock.zig");
+const virtio = @import("virtio.zig");
+const pages = @import("pages.zig");
+const abi = @import("abi.zig");
+const mp_bridge = @import("mp_bridge.zig");
+
+// Feature bits
+const F_MUST_TELL_HOST: u32 = 1 << 0;
+const F_PAGE_REPORTING: u32 = 1 << 5;
+
+// Device config space: target and current balloon size in 4 KiB pages
+const CONFIG_NUM_PAGES: u32 = virtio.MMIO_CONFIG;
+const CONFIG_ACTUAL: u32 = virtio.MMIO_CONFIG + 4;
+
+// Queue indices. Optional queues are numbered densely, and neither the
+// stats nor the free page hint queue is negotiated, so reporting is 2.
+const InflateQueue = 0;
+const DeflateQueue = 1;
+const ReportingQueue = 2;
+
+/// Smallest run worth a report (64 KiB).
+pub const MinReportPages = 16;
+pub const MinReportBytes = MinReportPages * pages.PageSize;
+/// Ranges per reporting request, one descriptor each.
+const ReportCapacity = @min(16, virtio.QUEUE_SIZE);
+/// Longest single range (descriptor lengths are 32 bits).
+const MaxRangeBytes = 1 << 30;
+/// PFNs per inflate or deflate request.
+const PfnBatch = 256;
+
+/// How often poll() reads the target, and how often it reports free memory.
+const PollIntervalNs = 100 * std.time.ns_per_ms;
+const ReportIntervalNs = std.time.ns_per_s;
+
+const PoolPages = config.page_pool_size / pages.PageSize;
+const PoolWords = (PoolPages + 63) / 64;
+
+pub const Stats = struct {
+    /// Host target and current balloon size, in pages
+    target_pages: u32 = 0,
+    balloon_pages: u32 = 0,
+    inflated_pages: u64 = 0,
+    deflated_pages: u64 = 0,
+    /// Pages handed back by free page reporting, and requests used
+    reported_pages: u64 = 0,
+    reports: u64 = 0,
+    /// Reported pages written again, outside the page pool (libc, ABI
+    /// heap); see reclaimedPages()
+    reclaimed_other: u64 = 0,
+};
+
+const Range = struct { start: usize, end: usize };
+
+var dev: virtio.VirtioDevice = undefined;
+var inflate_q: virtio.VirtioDevice = undefined;
+var deflate_q: virtio.VirtioDevice = undefined;
+var report_q: virtio.VirtioDevice = undefined;
+var inflate_mem: virtio.QueueMem = .{};
+var deflate_mem: virtio.QueueMem = .{};
+var report_mem: virtio.QueueMem = .{};
+var ready: bool = false;
+var reporting: bool = false;
+
+var stats: Stats = .{};
+var pfns: [PfnBatch]u32 align(16) = undefined;
+/// Page pool pages currently in the balloon
+var ballooned: [PoolWords]u64 = [_]u64{0} ** PoolWords;
+var ranges: [ReportCapacity]Range = undefined;
+var range_count: usize = 0;
+var next_poll_ns: u64 = 0;
+var next_report_ns: u64 = 0;
+
+// Free run of GC heap pages being collected by gcPage
+var gc_run_start: usize = 0;
+var gc_run_len: usize = 0;
+
+pub fn init() bool {
+    ready = false;
+    reporting = false;
+    stats = .{};
+    ballooned = [_]u64{0} ** PoolWords;
+    range_count = 0;
+
+    dev = virtio.probe(virtio.DEVICE_BALLOON) orelse return false;
+    if (!virtio.negotiate(&dev, F_MUST_TELL_HOST | F_PAGE_REPORTING)) return false;
+    inflate_q = dev;
+    deflate_q = dev;
+    if (!virtio.setupQueue(&inflate_q, InflateQueue, &inflate_mem)) return false;
+    if (!virtio.setupQueue(&deflate_q, DeflateQueue, &deflate_mem)) return false;
+    if (dev.features & F_PAGE_REPORTING != 0) {
+        report_q = dev;
+        if (!virtio.setupQueue(&report_q, ReportingQueue, &report_mem)) return false;
+        reporting = true;
+    }
+    virtio.driverOk(&dev);
+    virtio.mmioWrite32(dev.base, CONFIG_ACTUAL, 0);
+    ready = true;
+    serial.writeAll(if (reporting) "virtio_balloon: ready, free page reporting\n" else "virtio_balloon: ready\n");
+    return true;
+}
+
+pub fn isReady() bool {
+    return ready;
+}
+
+pub fn reportingEnabled() bool {
+    return ready and reporting;
+}
+
+pub fn getStats() Stats {
+    return stats;
+}
+
+/// Reported pages written again since boot, across all sources.
+pub fn reclaimedPages() u64 {
+    return pages.pool.reclaimed + stats.reclaimed_other;
+}
+
+/// Count reported pages outside the page pool that were written again.
+pub fn noteReclaimed(count: usize) void {
+    stats.reclaimed_other += count;
+}
+
+/// Called from idle points: follows the host's target and reports free
+/// memory, each at most once per interval.
+pub fn poll() void {
+    if (!ready) return;
+    const now = clock.nowNs();
+    if (now < next_poll_ns) return;
+    next_poll_ns = now + PollIntervalNs;
+    update();
+    if (reporting and now >= next_report_ns) {
+        next_report_ns = now + ReportIntervalNs;
+        _ = reportFree();
+    }
+}
+
+// --- Inflate / deflate ---
+
+fn isBallooned(page: usize) bool {
+    return (ballooned[page / 64] >> @intCast(page % 64)) & 1 != 0;
+}
+
+fn setBallooned(page: usize, value: bool) void {
+    const bit = @as(u64, 1) << @intCast(page % 64);
+    if (value) ballooned[page / 64] |= bit else ballooned[page / 64] &= ~bit;
+}
+
+fn waitUsed(q: *virtio.VirtioDevice) void {
+    while (virtio.popUsed(q) == null) {
+        if (comptime builtin.cpu.arch == .x86_64) {
+            asm volatile ("pause");
+        }
+    }
+}
+
+fn sendPfns(q: *virtio.VirtioDevice, count: usize) void {
+    q.desc[0] = .{ .addr = @intFromPtr(&pfns), .len = @intCast(count * 4), .flags = 0, .next = 0 };
+    virtio.addAvail(q, 0);
+    virtio.notify(q);
+    waitUsed(q);
+}
+
+/// Move the balloon one batch towards the host's target.
+pub fn update() void {
+    if (!ready) return;
+    const target = virtio.mmioRead32(dev.base, CONFIG_NUM_PAGES);
+    stats.target_pages = target;
+    if (stats.balloon_pages < target) {
+        inflate(@min(target - stats.balloon_pages, PfnBatch));
+    } else if (stats.balloon_pages > target) {
+        deflate(@min(stats.balloon_pages - target, PfnBatch));
+    }
+}
+
+fn inflate(count: usize) void {
+    const pool = &pages.pool;
+    var n: usize = 0;
+    while (n < count) : (n += 1) {
+        // Balloon pages are never written, so taking a reported one is
+        // not a reclaim
+        const reclaimed = pool.reclaimed;
+        const page = pool.alloc(1) orelse break;
+        pool.reclaimed = reclaimed;
+        setBallooned(pool.pageIndex(@intFromPtr(page.ptr)).?, true);
+        pfns[n] = @truncate(@intFromPtr(page.ptr) / pages.PageSize);
+    }
+    if (n == 0) return;
+    sendPfns(&inflate_q, n);
+    stats.balloon_pages += @intCast(n);
+    stats.inflated_pages += n;
+    virtio.mmioWrite32(dev.base, CONFIG_ACTUAL, stats.balloon_pages);
+}
+
+fn deflate(count: usize) void {
+    const pool = &pages.pool;
+    var n: usize = 0;
+    var page: usize = 0;
+    while (page < PoolPages and n < count) : (page += 1) {
+        if (!isBallooned(page)) continue;
+        pfns[n] = @truncate(pool.pageAddr(page) / pages.PageSize);
+        n += 1;
+    }
+    if (n == 0) return;
+    // Without MUST_TELL_HOST this may come after reuse; sending first is
+    // valid either way
+    sendPfns(&deflate_q, n);
+    for (pfns[0..n]) |pfn| {
+        const addr = @as(usize, pfn) * pages.PageSize;
+        setBallooned(pool.pageIndex(addr).?, false);
+        pool.free(@as([*]u8, @ptrFromInt(addr))[0..pages.PageSize]);
+    }
+    stats.balloon_pages -= @intCast(n);
+    stats.deflated_pages += n;
+    virtio.mmioWrite32(dev.base, CONFIG_ACTUAL, stats.balloon_pages);
+}
+
+// --- Free page reporting ---
+
+/// Queue the whole pages of [start, end) for reporting. The memory must
+/// stay free until the next flushReports; reportFree flushes before it
+/// returns.
+pub fn reportRange(start: usize, end: usize) void {
+    if (!reportingEnabled()) return;
+    var lo = std.mem.alignForward(usize, start, pages.PageSize);
+    const hi = std.mem.alignBackward(usize, end, pages.PageSize);
+    if (hi <= lo) return;
+    stats.reported_pages += (hi - lo) / pages.PageSize;
+    while (lo < hi) {
+        const next = @min(hi, lo + MaxRangeBytes);
+        if (range_count > 0) {
+            const last = &ranges[range_count - 1];
+            if (last.end == lo and next - last.start <= MaxRangeBytes) {
+                last.end = next;
+                lo = next;
+                continue;
+            }
+        }
+        if (range_count == @min(ReportCapacity, report_q.queue_size)) flushReports();
+        ranges[range_count] = .{ .start = lo, .end = next };
+        range_count += 1;
+        lo = next;
+    }
+}
+
+/// Send the queued ranges as one chain of device-writable buffers and wait
+/// for the host to release them.
+pub fn flushReports() void {
+    if (range_count == 0) return;
+    const n = range_count;
+    range_count = 0;
+    for (ranges[0..n], 0..) |r, i| {
+        const last = i + 1 == n;
+        report_q.desc[i] = .{
+            .addr = r.start,
+            .len = @intCast(r.end - r.start),
+            .flags = virtio.VRING_DESC_F_WRITE | (if (last) 0 else virtio.VRING_DESC_F_NEXT),
+            .next = if (last) 0 else @intCast(i + 1),
+        };
+    }
+    virtio.addAvail(&report_q, 0);
+    virtio.notify(&report_q);
+    waitUsed(&report_q);
+    stats.reports += 1;
+}
+
+/// Report every free range of MinReportPages or more not reported yet.
+/// Returns the number of pages reported.
+pub fn reportFree() u64 {
+    if (!reportingEnabled()) return 0;
+    const before = stats.reported_pages;
+
+    var cursor: usize = 0;
+    while (pages.pool.nextUnreported(&cursor, MinReportPages)) |run| {
+        reportRange(@intFromPtr(run.ptr), @intFromPtr(run.ptr) + run.len);
+    }
+    abi.reportFreeHeap();
+    if (comptime config.micropython and !config.hosted) mp_bridge.reportFree();
+    flushReports();
+    return stats.reported_pages - before;
+}
+
+/// One page of the GC heap, in address order: whether it holds only free
+/// blocks. Free runs of MinReportPages are reported; a used page that was
+/// reported is reclaimed. Call gcScanDone after the last page.
+pub fn gcPage(addr: usize, free: bool) void {
+    const page = pages.pool.pageIndex(addr) orelse return;
+    if (free and gc_run_len > 0 and gc_run_start + gc_run_len == page) {
+        gc_run_len += 1;
+        return;
+    }
+    flushGcRun();
+    if (free) {
+        gc_run_start = page;
+        gc_run_len = 1;
+    } else {
+        _ = pages.pool.unreport(page);
+    }
+}
+
+pub fn gcScanDone() void {
+    flushGcRun();
+}
+
+fn flushGcRun() void {
+    const pool = &pages.pool;
+    const end = gc_run_start + gc_run_len;
+    defer gc_run_len = 0;
+    if (gc_run_len < MinReportPages) return;
+    var page = gc_run_start;
+    while (page < end) {
+        if (pool.isReported(page)) {
+            page += 1;
+            continue;
+        }
+        var stop = page;
+        while (stop < end and !pool.isReported(stop)) stop += 1;
+        pool.markReported(page, stop - page);
+        reportRange(pool.pageAddr(page), pool.pageAddr(stop));
+        page = stop;
+    }
+}
+
+// --- Tests against the virtio_mock balloon ---
+
+const virtio_mock = @import("virtio_mock.zig");
+
+fn resetPool() void {
+    const p = &pages.pool;
+    @memset(&p.bitmap, 0);
+    @memset(&p.reported, 0);
+    p.used = 0;
+    p.peak = 0;
+    p.reclaimed = 0;
+}
+
+test "free pool runs are reported once and reclaimed on reuse" {
+    virtio_mock.reset();
+    resetPool();
+    const model = virtio_mock.addBalloon(virtio_mock.BALLOON_F_MUST_TELL_HOST | virtio_mock.BALLOON_F_REPORTING);
+    try std.testing.expect(init());
+    try std.testing.expect(reportingEnabled());
+
+    // Everything but the live run is reported, and the run keeps its data
+    const live = pages.pool.alloc(4).?;
+    @memset(live, 0xAB);
+    const reported = reportFree();
+    try std.testing.expectEqual(@as(u64, PoolPages - 4), reported);
+    try std.testing.expectEqual(reported * pages.PageSize, model.stats.reported_bytes);
+    try std.testing.expect(std.mem.allEqual(u8, live, 0xAB));
+    try std.testing.expectEqual(@as(u64, 1), model.stats.reports);
+
+    // Nothing new to report
+    try std.testing.expectEqual(@as(u64, 0), reportFree());
+
+    // Reuse clears the marks; the freed run is reported again once it is
+    // large enough
+    const reuse = pages.pool.alloc(MinReportPages).?;
+    try std.testing.expectEqual(@as(u64, MinReportPages), reclaimedPages());
+    pages.pool.free(reuse);
+    try std.testing.expectEqual(@as(u64, MinReportPages), reportFree());
+    pages.pool.free(live);
+    try std.testing.expectEqual(@as(u64, 0), reportFree());
+    try std.testing.expectEqual(reported + MinReportPages, getStats().reported_pages);
+}
+
+test "GC heap pages: free runs reported, used pages reclaimed" {
+    virtio_mock.reset();
+    resetPool();
+    const model = virtio_mock.addBalloon(virtio_mock.BALLOON_F_REPORTING);
+    try std.testing.expect(init());
+
+    // A GC area of 40 pages: used, 20 free, used, 17 free, used
+    const area = pages.pool.alloc(40).?;
+    const base = @intFromPtr(area.ptr);
+    for (0..40) |i| gcPage(base + i * pages.PageSize, i != 0 and i != 21 and i != 39);
+    gcScanDone();
+    flushReports();
+    try std.testing.expectEqual(@as(u64, 20 + 17) * pages.PageSize, model.stats.reported_bytes);
+
+    // A reported page the GC now uses is reclaimed; a rescan reports
+    // nothing twice
+    for (0..40) |i| gcPage(base + i * pages.PageSize, i != 0 and i != 5 and i != 21 and i != 39);
+    gcScanDone();
+    try std.testing.expectEqual(@as(usize, 1), pages.pool.reclaimed);
+    flushReports();
+    try std.testing.expectEqual(@as(u64, 20 + 17) * pages.PageSize, model.stats.reported_bytes);
+}
+
+test "inflate and deflate follow the host target" {
+    virtio_mock.reset();
+    resetPool();
+    const model = virtio_mock.addBalloon(virtio_mock.BALLOON_F_MUST_TELL_HOST);
+    try std.testing.expect(init());
+    try std.testing.expect(!reportingEnabled());
+    try std.testing.expectEqual(@as(u64, 0), reportFree());
+
+    virtio_mock.setBalloonTarget(model, 64);
+    update();
+    try std.testing.expectEqual(@as(u32, 64), getStats().balloon_pages);
+    try std.testing.expectEqual(@as(usize, 64), pages.pool.used);
+    try std.testing.expectEqual(@as(u64, 64), model.stats.inflated_pages);
+    try std.testing.expectEqual(@as(u32, 64), virtio_mock.balloonActual(model));
+
+    // Larger targets move PfnBatch pages per update
+    virtio_mock.setBalloonTarget(model, 64 + PfnBatch + 1);
+    update();
+    try std.testing.expectEqual(@as(u32, 64 + PfnBatch), getStats().balloon_pages);
+    update();
+    try std.testing.expectEqual(@as(u32, 64 + PfnBatch + 1), virtio_mock.balloonActual(model));
+
+    virtio_mock.setBalloonTarget(model, 16);
+    update();
+    update();
+    try std.testing.expectEqual(@as(u32, 16), getStats().balloon_pages);
+    try std.testing.expectEqual(@as(usize, 16), pages.pool.used);
+    try std.testing.expectEqual(@as(u64, 64 + PfnBatch + 1 - 16), model.stats.deflated_pages);
+    try std.testing.expectEqual(@as(u32, 16), virtio_mock.balloonActual(model));
+
+    // No balloon device
+    virtio_mock.reset();
+    try std.testing.expect(!init());
+    update();
+}
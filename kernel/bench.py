@@ -0,0 +1,81 @@
+# MicroPython interpreter loops for -Dbench=true builds (embedded by
+# kernel/bench.zig and run in place of the workload entrypoint). Each loop
+# reports ns per iteration on a "#M" line, like the kernel-side suites.
+import time
+
+N = 20000
+
+
+def loop_range(n):
+    for _ in range(n):
+        pass
+
+
+def loop_while(n):
+    i = 0
+    s = 0
+    while i < n:
+        s += i & 7
+        i += 1
+    return s
+
+
+def _f(a, b):
+    return a + b
+
+
+def loop_call(n):
+    s = 0
+    for i in range(n):
+        s = _f(s, i)
+    return s
+
+
+def loop_dict(n):
+    d = {}
+    for i in range(n):
+        d[i & 255] = i
+    return len(d)
+
+
+def loop_bytearray(n):
+    buf = bytearray(256)
+    for i in range(n):
+        buf[i & 255] = buf[(i + 1) & 255] ^ 0x5A
+    return buf[0]
+
+
+class _Obj:
+    def __init__(self):
+        self.x = 0
+
+
+def loop_attr(n):
+    o = _Obj()
+    for _ in range(n):
+        o.x += 1
+    return o.x
+
+
+def loop_str(n):
+    parts = []
+    for i in range(n // 10):
+        parts.append(str(i))
+    return len("".join(parts))
+
+
+def measure(name, fn):
+    fn(N // 10)
+    t0 = time.ticks_us()
+    fn(N)
+    dt = time.ticks_diff(time.ticks_us(), t0)
+    print("#M mp." + name + " iters=" + str(N) + " iter_ns=" + str(dt * 1000 // N))
+
+
+measure("range", loop_range)
+measure("while", loop_while)
+measure("call", loop_call)
+measure("dict", loop_dict)
+measure("bytearray", loop_bytearray)
+measure("attr", loop_attr)
+measure("str", loop_str)
@@ -0,0 +1,484 @@
+// In-guest microbenchmarks (-Dbench=true).
+//
+// Replaces the demo workload. With the workload's caps entered, each suite
+// runs a fixed amount of work and writes one serial line per measurement;
+// the MicroPython suite (bench.py, embedded) follows and reports the same
+// way. `scripts/ukernel bench` boots the image, collects the lines and
+// compares them against a stored baseline:
+//
+//   #M <name> <key>=<value> ...
+//   #M done
+//
+// Keys ending in _ns are latencies (lower is better) and keys ending in
+// _per_s are rates (higher is better); anything else is context. A line
+// with skipped=<reason> means the suite could not run (no device, no
+// traffic).
+
+const std = @import("std");
+const abi = @import("abi.zig");
+const abi_stats = @import("abi_stats.zig");
+const clock = @import("clock.zig");
+const config = @import("config.zig");
+const net = @import("net.zig");
+const pages = @import("pages.zig");
+const serial = @import("serial.zig");
+const virtio_blk = @import("virtio_blk.zig");
+
+/// MicroPython interpreter loops, run as the entrypoint in bench builds
+pub const python_source = @embedFile("bench.py");
+
+const AbiIters = 20_000;
+const Warmup = 256;
+const MemBytes = 256 * 1024;
+const MemRounds = 64;
+const SmallCopy = 4096;
+const AllocBatch = 64;
+const AllocRounds = 200;
+const BlkSeqChunk = 64 * 1024;
+const BlkSeqMax = 16 * 1024 * 1024;
+const BlkRandIo = 4096;
+const BlkRandReads = 512;
+const UdpTxPackets = 5000;
+const UdpPayload = 64;
+/// Port the host-side sender targets once it sees net.rx_ready
+pub const UdpRxPort: u16 = 7200;
+const UdpRxWaitNs = 2_000_000_000;
+const UdpRxWindowNs = 500_000_000;
+
+// Scratch buffers, in .bss so they cost nothing outside bench builds
+var buf_a: [MemBytes]u8 align(4096) = undefined;
+var buf_b: [MemBytes]u8 align(4096) = undefined;
+
+/// One "#M" line, built in place.
+pub const Line = struct {
+    buf: [256]u8 = undefined,
+    len: usize = 0,
+
+    pub fn init(name: []const u8) Line {
+        var l = Line{};
+        l.append("#M {s}", .{name});
+        return l;
+    }
+
+    fn append(self: *Line, comptime fmt: []const u8, args: anytype) void {
+        // Leave room for the newline
+        const out = std.fmt.bufPrint(self.buf[self.len .. self.buf.len - 1], fmt, args) catch return;
+        self.len += out.len;
+    }
+
+    pub fn field(self: *Line, key: []const u8, value: u64) void {
+        self.append(" {s}={d}", .{ key, value });
+    }
+
+    pub fn text(self: *Line, key: []const u8, value: []const u8) void {
+        self.append(" {s}={s}", .{ key, value });
+    }
+
+    pub fn finish(self: *Line) []const u8 {
+        self.buf[self.len] = '\n';
+        return self.buf[0 .. self.len + 1];
+    }
+};
+
+fn emit(line: *Line) void {
+    serial.writeAll(line.finish());
+}
+
+fn skipped(name: []const u8, reason: []const u8) void {
+    var line = Line.init(name);
+    line.text("skipped", reason);
+    emit(&line);
+}
+
+/// `count` events in `ns` nanoseconds, per second.
+pub fn perSecond(count: u64, ns: u64) u64 {
+    if (ns == 0) return 0;
+    return @intCast(@as(u128, count) * 1_000_000_000 / ns);
+}
+
+/// Bytes in `ns` nanoseconds, in MiB per second.
+pub fn mibPerSecond(bytes: u64, ns: u64) u64 {
+    return perSecond(bytes, ns) >> 20;
+}
+
+/// xorshift64 for random block offsets; deterministic across runs.
+pub const Rng = struct {
+    state: u64,
+
+    pub fn next(self: *Rng) u64 {
+        var x = self.state;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        self.state = x;
+        return x;
+    }
+
+    /// Uniform enough for picking offsets in [0, n).
+    pub fn below(self: *Rng, n: u64) u64 {
+        return if (n == 0) 0 else self.next() % n;
+    }
+};
+
+fn elapsedNs(start: u64) u64 {
+    return clock.tscToNs(clock.rdtsc() -% start);
+}
+
+// --- ABI call latency ---
+
+var lat_deadline: abi.handle_t = 0;
+var lat_set: abi.handle_t = 0;
+
+fn callTimeNow() void {
+    var t: abi.time_ns = 0;
+    _ = abi.time_now(&t);
+    std.mem.doNotOptimizeAway(t);
+}
+
+fn callTaskYield() void {
+    _ = abi.task_yield();
+}
+
+fn callIoPoll() void {
+    // One pending deadline, non-blocking: the full probe path
+    var n: u32 = 0;
+    _ = abi.io_poll(&lat_deadline, 1, 0, 0, &n);
+}
+
+fn callIoSetWait() void {
+    var ev: [1]abi.io_set_event_t = undefined;
+    var n: u32 = 0;
+    _ = abi.io_set_wait(lat_set, @intFromPtr(&ev), 1, 0, &n);
+}
+
+fn callMemAllocFree() void {
+    var ptr: abi.ptr_t = 0;
+    if (abi.mem_alloc(64, 0, &ptr) == abi.OK) _ = abi.mem_free(ptr);
+}
+
+fn callDeadlineCancel() void {
+    var h: abi.handle_t = 0;
+    if (abi.time_deadline(~@as(abi.time_ns, 0), &h) == abi.OK) _ = abi.time_cancel(h);
+}
+
+fn callLatency(name: []const u8, comptime call: fn () void) void {
+    var stats = abi_stats.CallStats{};
+    for (0..Warmup) |_| call();
+    for (0..AbiIters) |_| {
+        const t0 = clock.rdtsc();
+        call();
+        abi_stats.record(&stats, 0, clock.rdtsc() -% t0);
+    }
+    var line = Line.init(name);
+    line.field("iters", stats.calls);
+    line.field("mean_ns", clock.tscToNs(stats.total_cycles / stats.calls));
+    line.field("p50_ns", clock.tscToNs(abi_stats.percentile(&stats, 500)));
+    line.field("p99_ns", clock.tscToNs(abi_stats.percentile(&stats, 990)));
+    emit(&line);
+}
+
+fn abiSuite() void {
+    var now: abi.time_ns = 0;
+    _ = abi.time_now(&now);
+    if (abi.time_deadline(now + 3600 * 1_000_000_000, &lat_deadline) != abi.OK or
+        abi.io_set_create(0, &lat_set) != abi.OK)
+    {
+        skipped("abi", "setup");
+        return;
+    }
+    defer {
+        _ = abi.time_cancel(lat_deadline);
+        _ = abi.io_set_close(lat_set);
+    }
+    _ = abi.io_set_ctl(lat_set, abi.IOSET_ADD, lat_deadline, abi.IO_READABLE, 0);
+
+    callLatency("abi.time_now", callTimeNow);
+    callLatency("abi.task_yield", callTaskYield);
+    callLatency("abi.io_poll", callIoPoll);
+    callLatency("abi.io_set_wait", callIoSetWait);
+    callLatency("abi.mem_alloc_free", callMemAllocFree);
+    callLatency("abi.time_deadline_cancel", callDeadlineCancel);
+}
+
+// --- memcpy / memset bandwidth ---
+
+fn memSuite() void {
+    @memset(buf_a[0..], 0x5a);
+    @memset(buf_b[0..], 0);
+
+    var start = clock.rdtsc();
+    for (0..MemRounds) |_| {
+        @memcpy(buf_b[0..], buf_a[0..]);
+        std.mem.doNotOptimizeAway(&buf_b);
+    }
+    var ns = elapsedNs(start);
+    var line = Line.init("mem.memcpy_256k");
+    line.field("bytes", MemBytes * MemRounds);
+    line.field("mib_per_s", mibPerSecond(MemBytes * MemRounds, ns));
+    emit(&line);
+
+    // Cache-resident copies: per-call overhead matters as much as bandwidth
+    const small_rounds = MemBytes * MemRounds / SmallCopy;
+    start = clock.rdtsc();
+    for (0..small_rounds) |i| {
+        const off = (i * SmallCopy) % (MemBytes / 4);
+        @memcpy(buf_b[off .. off + SmallCopy], buf_a[off .. off + SmallCopy]);
+        std.mem.doNotOptimizeAway(&buf_b);
+    }
+    ns = elapsedNs(start);
+    line = Line.init("mem.memcpy_4k");
+    line.field("bytes", SmallCopy * small_rounds);
+    line.field("mib_per_s", mibPerSecond(SmallCopy * small_rounds, ns));
+    emit(&line);
+
+    start = clock.rdtsc();
+    for (0..MemRounds) |i| {
+        @memset(buf_b[0..], @truncate(i));
+        std.mem.doNotOptimizeAway(&buf_b);
+    }
+    ns = elapsedNs(start);
+    line = Line.init("mem.memset_256k");
+    line.field("bytes", MemBytes * MemRounds);
+    line.field("mib_per_s", mibPerSecond(MemBytes * MemRounds, ns));
+    emit(&line);
+}
+
+// --- Allocator throughput ---
+
+fn allocSuite() void {
+    // mem_alloc: batches of mixed sizes, freed newest first so the heap
+    // top is reclaimed and every round starts from the same state
+    var ptrs: [AllocBatch]abi.ptr_t = undefined;
+    var ops: u64 = 0;
+    var start = clock.rdtsc();
+    for (0..AllocRounds) |_| {
+        var n: usize = 0;
+        while (n < AllocBatch) : (n += 1) {
+            const size: abi.size_t = 16 + (n % 8) * 120;
+            if (abi.mem_alloc(size, 0, &ptrs[n]) != abi.OK) break;
+        }
+        var i = n;
+        while (i > 0) {
+            i -= 1;
+            _ = abi.mem_free(ptrs[i]);
+        }
+        ops += 2 * n;
+    }
+    var ns = elapsedNs(start);
+    var line = Line.init("alloc.mem_alloc");
+    line.field("ops", ops);
+    line.field("ops_per_s", perSecond(ops, ns));
+    emit(&line);
+
+    // Kernel page pool, single pages and 4-page runs. Runs before the GC
+    // heap takes its first area, so the pool is empty.
+    var runs: [AllocBatch][]align(pages.PageSize) u8 = undefined;
+    ops = 0;
+    start = clock.rdtsc();
+    for (0..AllocRounds) |_| {
+        var n: usize = 0;
+        while (n < AllocBatch) : (n += 1) {
+            runs[n] = pages.pool.alloc(if (n % 4 == 3) 4 else 1) orelse break;
+        }
+        for (runs[0..n]) |run| pages.pool.free(run);
+        ops += 2 * n;
+    }
+    ns = elapsedNs(start);
+    line = Line.init("alloc.pages");
+    line.field("ops", ops);
+    line.field("ops_per_s", perSecond(ops, ns));
+    emit(&line);
+}
+
+// --- virtio-blk read throughput ---
+
+fn blkRead(sector: u64, bytes: usize) bool {
+    if (!virtio_blk.startRead(sector, @intCast(bytes / 512), &buf_a)) return false;
+    return virtio_blk.waitRead();
+}
+
+fn blkSuite() void {
+    if (comptime !config.blk) return;
+    if (!virtio_blk.isReady()) {
+        skipped("blk.seq_read", "no_device");
+        return;
+    }
+    const capacity = virtio_blk.capacityBytes();
+    const seq_bytes = @min(capacity, BlkSeqMax) / BlkSeqChunk * BlkSeqChunk;
+    if (seq_bytes == 0) {
+        skipped("blk.seq_read", "small_device");
+        return;
+    }
+
+    var start = clock.rdtsc();
+    var off: u64 = 0;
+    while (off < seq_bytes) : (off += BlkSeqChunk) {
+        if (!blkRead(off / 512, BlkSeqChunk)) {
+            skipped("blk.seq_read", "io_error");
+            return;
+        }
+    }
+    var ns = elapsedNs(start);
+    var line = Line.init("blk.seq_read");
+    line.field("bytes", seq_bytes);
+    line.field("io_size", BlkSeqChunk);
+    line.field("mib_per_s", mibPerSecond(seq_bytes, ns));
+    emit(&line);
+
+    var rng = Rng{ .state = 0x9e3779b97f4a7c15 };
+    const blocks = capacity / BlkRandIo;
+    start = clock.rdtsc();
+    for (0..BlkRandReads) |_| {
+        const block = rng.below(blocks);
+        if (!blkRead(block * (BlkRandIo / 512), BlkRandIo)) {
+            skipped("blk.rand_read", "io_error");
+            return;
+        }
+    }
+    ns = elapsedNs(start);
+    line = Line.init("blk.rand_read");
+    line.field("reads", BlkRandReads);
+    line.field("io_size", BlkRandIo);
+    line.field("iops_per_s", perSecond(BlkRandReads, ns));
+    line.field("mib_per_s", mibPerSecond(BlkRandReads * BlkRandIo, ns));
+    line.field("mean_ns", ns / BlkRandReads);
+    emit(&line);
+}
+
+// --- UDP packet rate ---
+
+fn packAddr(ip: [4]u8, port: u16) [6]u8 {
+    return .{ ip[0], ip[1], ip[2], ip[3], @truncate(port >> 8), @truncate(port) };
+}
+
+fn udpTx() void {
+    var sock: abi.handle_t = 0;
+    if (abi.net_socket(2, 2, 17, &sock) != abi.OK) {
+        skipped("net.udp_tx", "socket");
+        return;
+    }
+    defer _ = abi.net_close(sock);
+    // Discard port on the host side of the tap
+    const addr = packAddr(net.GATEWAY_IP, 9);
+    _ = abi.net_connect(sock, @intFromPtr(&addr), addr.len);
+
+    var payload = [_]u8{0xab} ** UdpPayload;
+    var wrote: abi.size_t = 0;
+    // The first send resolves the gateway's MAC
+    if (abi.net_send(sock, @intFromPtr(&payload), payload.len, 0, &wrote) != abi.OK) {
+        skipped("net.udp_tx", "no_link");
+        return;
+    }
+
+    var sent: u64 = 0;
+    const start = clock.rdtsc();
+    for (0..UdpTxPackets) |_| {
+        if (abi.net_send(sock, @intFromPtr(&payload), payload.len, 0, &wrote) == abi.OK) sent += 1;
+    }
+    const ns = elapsedNs(start);
+    var line = Line.init("net.udp_tx");
+    line.field("packets", sent);
+    line.field("payload", UdpPayload);
+    line.field("pps_per_s", perSecond(sent, ns));
+    emit(&line);
+}
+
+fn udpRx() void {
+    var sock: abi.handle_t = 0;
+    if (abi.net_socket(2, 2, 17, &sock) != abi.OK) {
+        skipped("net.udp_rx", "socket");
+        return;
+    }
+    defer _ = abi.net_close(sock);
+    const addr = packAddr(.{ 0, 0, 0, 0 }, UdpRxPort);
+    if (abi.net_bind(sock, @intFromPtr(&addr), addr.len) != abi.OK) {
+        skipped("net.udp_rx", "bind");
+        return;
+    }
+
+    // The host starts sending when it sees this line
+    var line = Line.init("net.rx_ready");
+    line.field("port", UdpRxPort);
+    emit(&line);
+    serial.flush();
+
+    var buf: [2048]u8 = undefined;
+    var got: abi.size_t = 0;
+    var received: u64 = 0;
+    var bytes: u64 = 0;
+    var window_start: u64 = 0;
+    const wait_start = clock.nowNs();
+    while (true) {
+        const now = clock.nowNs();
+        if (received == 0) {
+            if (now - wait_start > UdpRxWaitNs) break;
+        } else if (now - window_start > UdpRxWindowNs) break;
+        if (abi.net_recv(sock, @intFromPtr(&buf), buf.len, 0, &got) != abi.OK) continue;
+        if (received == 0) window_start = now;
+        received += 1;
+        bytes += got;
+    }
+    if (received < 2) {
+        skipped("net.udp_rx", "no_sender");
+        return;
+    }
+    // The first datagram opens the window
+    const ns = clock.nowNs() - window_start;
+    line = Line.init("net.udp_rx");
+    line.field("packets", received - 1);
+    line.field("bytes", bytes);
+    line.field("pps_per_s", perSecond(received - 1, ns));
+    emit(&line);
+}
+
+fn netSuite() void {
+    if (comptime !config.net) return;
+    if (!net.ensureDevice()) {
+        skipped("net.udp_tx", "no_device");
+        return;
+    }
+    udpTx();
+    udpRx();
+}
+
+/// Kernel-side suites; call with the workload's caps entered and the block
+/// device initialized, before MicroPython takes the page pool.
+pub fn run() void {
+    serial.writeAll("bench: starting\n");
+    abiSuite();
+    memSuite();
+    allocSuite();
+    blkSuite();
+    netSuite();
+}
+
+/// End marker; the host stops the VM when it sees it.
+pub fn finish() void {
+    var line = Line.init("done");
+    emit(&line);
+    serial.flush();
+}
+
+test "bench lines and rates" {
+    var line = Line.init("abi.time_now");
+    line.field("p50_ns", 42);
+    line.text("skipped", "no_device");
+    try std.testing.expectEqualStrings("#M abi.time_now p50_ns=42 skipped=no_device\n", line.finish());
+
+    // Fields that do not fit are dropped whole; the newline always fits
+    var long = Line.init("x");
+    for (0..64) |_| long.field("mib_per_s", 123456);
+    const out = long.finish();
+    try std.testing.expect(out.len <= long.buf.len);
+    try std.testing.expect(std.mem.endsWith(u8, out, "=123456\n"));
+
+    try std.testing.expectEqual(@as(u64, 2000), perSecond(1000, 500_000_000));
+    try std.testing.expectEqual(@as(u64, 0), perSecond(5, 0));
+    try std.testing.expectEqual(@as(u64, 512), mibPerSecond(256 << 20, 500_000_000));
+
+    var rng = Rng{ .state = 1 };
+    const first = rng.next();
+    try std.testing.expect(first != 1);
+    for (0..1000) |_| try std.testing.expect(rng.below(10) < 10);
+    try std.testing.expectEqual(@as(u64, 0), rng.below(0));
+}
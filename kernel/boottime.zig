@@ -0,0 +1,129 @@
+// Boot-phase timeline.
+//
+// The boot stubs sample the TSC at their first instruction
+// (boot_tsc_entry) and again on reaching 64-bit _start (boot_tsc_start);
+// kernelMain marks the end of each later phase. Once the workload is about
+// to run, the whole timeline is written as one serial line that
+// scripts/boot_timeline.py turns into a per-phase table:
+//
+//   #B t0=<entry ns since TSC reset> <phase>=<ns since entry> ...
+//
+// Phases that did not run in this build (e.g. blk in the net profile) are
+// left out, and the rest are written in the order they ended. Raw TSC
+// values are kept until the line is written, so phases before clock
+// calibration are converted with the calibrated frequency.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const clock = @import("clock.zig");
+const serial = @import("serial.zig");
+
+pub const Phase = enum(u8) {
+    /// First instruction of pvh_start / multiboot_entry / _start
+    entry,
+    /// 64-bit _start reached (page tables, long mode)
+    long_mode,
+    kernel_main,
+    serial,
+    clock,
+    mmio,
+    /// Demo workload, or entering the workload cap policy
+    workload,
+    /// Device init; the rootfs read is only submitted here
+    blk,
+    /// gc_init + mp_init, overlapping the rootfs read
+    mp_init,
+    /// Waiting for the rootfs read and finding the entrypoint
+    rootfs,
+    /// Parse + compile, or .mpy load; ends at the first workload bytecode
+    compile,
+    /// virtio-net bring-up, on first socket (usually after the timeline)
+    net,
+};
+
+const NumPhases = @typeInfo(Phase).@"enum".fields.len;
+
+// Written by pvh_boot.S / multiboot.S before the stack exists
+extern var boot_tsc_entry: u64;
+extern var boot_tsc_start: u64;
+
+var marks: [NumPhases]u64 = [_]u64{0} ** NumPhases;
+var emitted: bool = false;
+
+/// Record the end of a phase.
+pub fn mark(phase: Phase) void {
+    marks[@intFromEnum(phase)] = clock.rdtsc();
+}
+
+/// Pick up the samples taken by the assembly boot path.
+pub fn captureEntry() void {
+    if (comptime builtin.is_test or builtin.cpu.arch != .x86_64) return;
+    marks[@intFromEnum(Phase.entry)] = boot_tsc_entry;
+    marks[@intFromEnum(Phase.long_mode)] = boot_tsc_start;
+}
+
+fn appendField(buf: []u8, len: *usize, name: []const u8, value: u64) void {
+    const out = std.fmt.bufPrint(buf[len.*..], " {s}={d}", .{ name, value }) catch return;
+    len.* += out.len;
+}
+
+/// Format the timeline line into buf.
+pub fn format(buf: []u8) []const u8 {
+    const t0 = marks[@intFromEnum(Phase.entry)];
+    var len: usize = 0;
+    const head = std.fmt.bufPrint(buf, "#B t0={d}", .{clock.tscToNs(t0)}) catch return buf[0..0];
+    len = head.len;
+    // Selection by end time: phases can overlap, so enum order is not
+    // necessarily the order they finished in
+    var done: [NumPhases]bool = [_]bool{false} ** NumPhases;
+    done[@intFromEnum(Phase.entry)] = true;
+    while (true) {
+        var next: ?usize = null;
+        for (marks, 0..) |tsc, i| {
+            if (done[i] or tsc == 0 or tsc < t0) continue;
+            if (next == null or tsc < marks[next.?]) next = i;
+        }
+        const i = next orelse break;
+        done[i] = true;
+        appendField(buf, &len, @tagName(@as(Phase, @enumFromInt(i))), clock.tscToNs(marks[i] - t0));
+    }
+    if (len < buf.len) {
+        buf[len] = '\n';
+        len += 1;
+    }
+    return buf[0..len];
+}
+
+/// Write the timeline once; later calls are ignored.
+pub fn emit() void {
+    if (emitted) return;
+    emitted = true;
+    var buf: [320]u8 = undefined;
+    serial.writeAll(format(buf[0..]));
+}
+
+pub fn reset() void {
+    marks = [_]u64{0} ** NumPhases;
+    emitted = false;
+}
+
+test "timeline is relative to entry, in end order, without skipped phases" {
+    reset();
+    const saved_hz = clock.frequency();
+    const saved_src = clock.calibrationSource();
+    defer clock.setFrequency(saved_hz, saved_src);
+    clock.setFrequency(1_000_000_000, saved_src);
+
+    marks[@intFromEnum(Phase.entry)] = 5_000;
+    marks[@intFromEnum(Phase.long_mode)] = 5_400;
+    marks[@intFromEnum(Phase.kernel_main)] = 6_000;
+    marks[@intFromEnum(Phase.rootfs)] = 90_000;
+    marks[@intFromEnum(Phase.mp_init)] = 70_000;
+
+    var buf: [320]u8 = undefined;
+    try std.testing.expectEqualStrings(
+        "#B t0=5000 long_mode=400 kernel_main=1000 mp_init=65000 rootfs=85000\n",
+        format(buf[0..]),
+    );
+    reset();
+}
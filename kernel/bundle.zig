@@ -0,0 +1,417 @@
+// Indexed rootfs bundle, written by `ukernel pack` and read instead of a
+// tar when the rootfs drive holds one. Layout, little-endian:
+//
+//   0       Header (64 bytes): magic "UKBUNDLE", version, entry count,
+//           index size, page size, crc32 of the index, crc32 of the header
+//   64      index: IndexEntry[entry_count] sorted by path bytes, then the
+//           path bytes themselves
+//   pages   file extents, each starting on a page boundary
+//
+// Each file is stored raw or as one LZ4 block, with the crc32 of its
+// uncompressed contents in the index. A raw extent is read with one request
+// straight into its destination. An LZ4 extent is read into the tail of its
+// destination and decoded forward over itself, so neither goes through a
+// bounce buffer. The packer only compresses a file when that in-place decode
+// is safe, and decode checks it again. Extents inside the boot prefetch
+// window (tar.zig) are used from there.
+
+const std = @import("std");
+const serial = @import("serial.zig");
+const tar = @import("tar.zig");
+const virtio_blk = @import("virtio_blk.zig");
+
+pub const Magic = "UKBUNDLE";
+pub const Version: u16 = 1;
+pub const PageSize: u32 = 4096;
+
+const SectorSize = 512;
+
+/// Largest file the reader loads, as for tar members
+pub const MaxFileSize = 1024 * 1024;
+
+/// destSize of any extent the reader loads. tar.zig's file buffer is this
+/// large so that loadShared can use it.
+pub const MaxDestSize = std.mem.alignForward(usize, MaxFileSize + (MaxFileSize >> 8) + 32 + SectorSize, SectorSize);
+
+/// Largest index (entries and paths) the reader accepts
+const MaxIndexSize = 64 * 1024;
+
+pub const Codec = enum(u8) { raw = 0, lz4 = 1, _ };
+
+pub const Kind = enum(u8) { file = 0, dir = 1, _ };
+
+pub const Header = extern struct {
+    magic: [8]u8,
+    version: u16,
+    flags: u16,
+    entry_count: u32,
+    /// Bytes of entries and paths after the header
+    index_size: u32,
+    page_size: u32,
+    index_crc: u32,
+    reserved: [32]u8,
+    /// crc32 of the bytes before this field
+    header_crc: u32,
+};
+
+pub const IndexEntry = extern struct {
+    /// Extent start in bytes, a multiple of page_size (0 for directories)
+    offset: u64,
+    /// Bytes on the device
+    stored_size: u32,
+    /// Bytes once decompressed
+    size: u32,
+    /// crc32 of the uncompressed contents
+    crc: u32,
+    /// Path bytes, relative to the start of the index
+    name_offset: u32,
+    name_len: u16,
+    kind: u8,
+    codec: u8,
+    reserved: u32,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(Header) == 64);
+    std.debug.assert(@sizeOf(IndexEntry) == 32);
+}
+
+/// Where a file's contents live on the device.
+pub const Extent = struct {
+    offset: u64,
+    stored: u32,
+    size: u32,
+    crc: u32,
+    codec: Codec,
+};
+
+pub const Entry = struct {
+    name: []const u8,
+    is_dir: bool,
+    extent: Extent,
+};
+
+/// The header at the start of bytes, if it is a bundle header of a version
+/// this reader understands.
+pub fn parseHeader(bytes: []const u8) ?Header {
+    if (bytes.len < @sizeOf(Header)) return null;
+    const hdr = std.mem.bytesToValue(Header, bytes[0..@sizeOf(Header)]);
+    if (!std.mem.eql(u8, &hdr.magic, Magic)) return null;
+    if (hdr.header_crc != std.hash.Crc32.hash(bytes[0 .. @sizeOf(Header) - 4])) return null;
+    if (hdr.version != Version or hdr.page_size != PageSize) return null;
+    if (hdr.index_size > MaxIndexSize) return null;
+    if (@as(u64, hdr.entry_count) * @sizeOf(IndexEntry) > hdr.index_size) return null;
+    return hdr;
+}
+
+/// A verified index: every entry in range and the paths strictly ascending.
+pub const Index = struct {
+    bytes: []const u8,
+    count: u32,
+
+    /// Check the index bytes (index_size of them, after the header)
+    /// against hdr.
+    pub fn init(hdr: *const Header, bytes: []const u8) ?Index {
+        if (bytes.len != hdr.index_size) return null;
+        if (std.hash.Crc32.hash(bytes) != hdr.index_crc) return null;
+        const index = Index{ .bytes = bytes, .count = hdr.entry_count };
+        const names_start = @as(usize, hdr.entry_count) * @sizeOf(IndexEntry);
+        var prev: []const u8 = &.{};
+        var i: u32 = 0;
+        while (i < index.count) : (i += 1) {
+            const e = index.rawEntry(i);
+            if (e.name_len == 0 or e.name_offset < names_start) return null;
+            if (e.name_offset > bytes.len or e.name_len > bytes.len - e.name_offset) return null;
+            const name = bytes[e.name_offset..][0..e.name_len];
+            if (i > 0 and std.mem.order(u8, prev, name) != .lt) return null;
+            prev = name;
+            switch (@as(Kind, @enumFromInt(e.kind))) {
+                .dir => {},
+                .file => if (!validExtent(&e)) return null,
+                _ => return null,
+            }
+        }
+        return index;
+    }
+
+    fn rawEntry(self: *const Index, i: u32) IndexEntry {
+        const start = @as(usize, i) * @sizeOf(IndexEntry);
+        return std.mem.bytesToValue(IndexEntry, self.bytes[start..][0..@sizeOf(IndexEntry)]);
+    }
+
+    pub fn entry(self: *const Index, i: u32) Entry {
+        const e = self.rawEntry(i);
+        return .{
+            .name = self.bytes[e.name_offset..][0..e.name_len],
+            .is_dir = e.kind == @intFromEnum(Kind.dir),
+            .extent = .{
+                .offset = e.offset,
+                .stored = e.stored_size,
+                .size = e.size,
+                .crc = e.crc,
+                .codec = @enumFromInt(e.codec),
+            },
+        };
+    }
+};
+
+fn validExtent(e: *const IndexEntry) bool {
+    if (e.offset % PageSize != 0) return false;
+    return switch (@as(Codec, @enumFromInt(e.codec))) {
+        .raw => e.stored_size == e.size,
+        .lz4 => e.stored_size != 0 and e.stored_size < e.size,
+        _ => false,
+    };
+}
+
+/// Bytes a destination passed to load needs: the stored extent rounded up
+/// to whole sectors, and for LZ4 the room to decode it in place.
+/// scripts/ukernel (_bundle_inplace_size) uses the same formula.
+pub fn destSize(ext: Extent) usize {
+    const rounded = std.mem.alignForward(usize, ext.stored, SectorSize);
+    if (ext.codec != .lz4) return rounded;
+    const slack = rounded - ext.stored;
+    return std.mem.alignForward(usize, @as(usize, ext.size) + (ext.stored >> 8) + 32 + slack, SectorSize);
+}
+
+// --- LZ4 ---
+
+fn readLength(src: []const u8, i: *usize, nibble: u8) ?usize {
+    var len: usize = nibble;
+    if (nibble != 15) return len;
+    while (true) {
+        if (i.* >= src.len) return null;
+        const b = src[i.*];
+        i.* += 1;
+        len += b;
+        if (b != 255) return len;
+    }
+}
+
+/// Decode one LZ4 block (no frame) from src into dst and return the decoded
+/// length, or null if the block is malformed or does not fit. src may lie
+/// in dst (in-place decode) as long as output never reaches unread input.
+pub fn lz4Decompress(src: []const u8, dst: []u8) ?usize {
+    const src_addr = @intFromPtr(src.ptr);
+    const dst_addr = @intFromPtr(dst.ptr);
+    const in_place = src_addr >= dst_addr and src_addr < dst_addr + dst.len;
+    var i: usize = 0;
+    var o: usize = 0;
+    while (true) {
+        if (i >= src.len) return null;
+        const token = src[i];
+        i += 1;
+
+        const lit = readLength(src, &i, token >> 4) orelse return null;
+        if (lit > src.len - i or lit > dst.len - o) return null;
+        if (in_place and dst_addr + o > src_addr + i) return null;
+        std.mem.copyForwards(u8, dst[o..][0..lit], src[i..][0..lit]);
+        i += lit;
+        o += lit;
+        // The last sequence is literals only
+        if (i == src.len) return o;
+
+        if (src.len - i < 2) return null;
+        const offset = std.mem.readInt(u16, src[i..][0..2], .little);
+        i += 2;
+        const len = (readLength(src, &i, token & 0x0F) orelse return null) + 4;
+        if (offset == 0 or offset > o or len > dst.len - o) return null;
+        if (in_place and dst_addr + o + len > src_addr + i) return null;
+        if (offset >= len) {
+            @memcpy(dst[o..][0..len], dst[o - offset ..][0..len]);
+        } else {
+            // Overlapping match: repeats the last offset bytes
+            for (o..o + len) |k| dst[k] = dst[k - offset];
+        }
+        o += len;
+    }
+}
+
+// --- Device reader ---
+
+var index_buf: [std.mem.alignForward(usize, @sizeOf(Header) + MaxIndexSize, SectorSize)]u8 align(SectorSize) = undefined;
+
+/// The first len bytes of the drive: from the prefetch window, or read into
+/// index_buf.
+fn readHead(len: usize) ?[]const u8 {
+    if (tar.prefetched(0, len)) |bytes| return bytes;
+    const rounded = std.mem.alignForward(usize, len, SectorSize);
+    if (!virtio_blk.readInto(0, index_buf[0..rounded])) {
+        serial.writeAll("bundle: read error\n");
+        return null;
+    }
+    return index_buf[0..len];
+}
+
+/// Read and verify the header and index of the rootfs drive. null if it
+/// holds no bundle (the caller falls back to tar) or the bundle is corrupt.
+/// The index stays valid until the next call.
+pub fn open() ?Index {
+    if (!virtio_blk.isReady()) return null;
+    const first = readHead(SectorSize) orelse return null;
+    if (!std.mem.eql(u8, first[0..Magic.len], Magic)) return null;
+    const hdr = parseHeader(first) orelse {
+        serial.writeAll("bundle: unsupported or corrupt header\n");
+        return null;
+    };
+    const bytes = readHead(@sizeOf(Header) + hdr.index_size) orelse return null;
+    return Index.init(&hdr, bytes[@sizeOf(Header)..]) orelse {
+        serial.writeAll("bundle: corrupt index\n");
+        return null;
+    };
+}
+
+fn verify(ext: Extent, data: []const u8) bool {
+    if (std.hash.Crc32.hash(data) == ext.crc) return true;
+    serial.writeAll("bundle: checksum mismatch\n");
+    return false;
+}
+
+/// Contents of a raw extent inside the boot prefetch window, used where
+/// they are. Stable for the life of the kernel.
+pub fn resident(ext: Extent) ?[]const u8 {
+    if (ext.codec != .raw) return null;
+    const data = tar.prefetched(ext.offset, ext.size) orelse return null;
+    return if (verify(ext, data)) data else null;
+}
+
+/// Read an extent into dest (at least destSize(ext) bytes), decompressing
+/// it there. Returns dest[0..size] once the contents match their crc.
+pub fn load(ext: Extent, dest: []u8) ?[]const u8 {
+    if (ext.size > MaxFileSize) {
+        serial.writeAll("bundle: file too large\n");
+        return null;
+    }
+    // Nothing to read (virtio_blk rejects empty transfers)
+    if (ext.size == 0) return if (verify(ext, dest[0..0])) dest[0..0] else null;
+    const need = destSize(ext);
+    if (dest.len < need) return null;
+    const out = dest[0..ext.size];
+    const sector = ext.offset / SectorSize;
+    const rounded = std.mem.alignForward(usize, ext.stored, SectorSize);
+    switch (ext.codec) {
+        .raw => {
+            if (tar.prefetched(ext.offset, ext.size)) |src| {
+                @memcpy(out, src);
+            } else if (!virtio_blk.readInto(sector, dest[0..rounded])) {
+                serial.writeAll("bundle: read error\n");
+                return null;
+            }
+        },
+        .lz4 => {
+            const src = tar.prefetched(ext.offset, ext.stored) orelse blk: {
+                const tail = dest[need - rounded .. need];
+                if (!virtio_blk.readInto(sector, tail)) {
+                    serial.writeAll("bundle: read error\n");
+                    return null;
+                }
+                break :blk tail[0..ext.stored];
+            };
+            if (lz4Decompress(src, out) != ext.size) {
+                serial.writeAll("bundle: corrupt extent\n");
+                return null;
+            }
+        },
+        _ => return null,
+    }
+    return if (verify(ext, out)) out else null;
+}
+
+/// load into tar.zig's file buffer, valid until the next loadShared.
+pub fn loadShared(ext: Extent) ?[]const u8 {
+    return load(ext, tar.fileBuffer());
+}
+
+test "lz4 blocks decode, in place and with overlapping matches" {
+    // "abc" then a 32-byte match at offset 3, then "cabc!"
+    const block = [_]u8{ 0x3f, 'a', 'b', 'c', 3, 0, 13, 0x50, 'c', 'a', 'b', 'c', '!' };
+    const want = "abcabcabcabcabcabcabcabcabcabcabcabcabc!";
+    var out: [64]u8 = undefined;
+    try std.testing.expectEqual(@as(?usize, want.len), lz4Decompress(&block, &out));
+    try std.testing.expectEqualStrings(want, out[0..want.len]);
+
+    // Too small a destination, a truncated block, an offset before the start
+    try std.testing.expect(lz4Decompress(&block, out[0..20]) == null);
+    try std.testing.expect(lz4Decompress(block[0..5], &out) == null);
+    const bad = [_]u8{ 0x10, 'a', 2, 0, 0x00 };
+    try std.testing.expect(lz4Decompress(&bad, &out) == null);
+
+    // Room for an in-place decode: the sector-rounded read plus a margin
+    const ext = Extent{ .offset = 0, .stored = block.len, .size = want.len, .crc = 0, .codec = .lz4 };
+    try std.testing.expectEqual(@as(usize, 1024), destSize(ext));
+
+    // In place: 240 bytes of "x = 1\n" from a 16-byte block that overlaps
+    // the end of its own output
+    const lines = [_]u8{ 0x6f, 'x', ' ', '=', ' ', '1', '\n', 6, 0, 0xd2, 0x50, ' ', '=', ' ', '1', '\n' };
+    var buf: [256]u8 = undefined;
+    @memcpy(buf[230..][0..lines.len], &lines);
+    try std.testing.expectEqual(@as(?usize, 240), lz4Decompress(buf[230..][0..lines.len], buf[0..240]));
+    try std.testing.expectEqualStrings("x = 1\n" ** 40, buf[0..240]);
+
+    // Output that would overwrite unread input is refused
+    @memcpy(buf[224..][0..lines.len], &lines);
+    try std.testing.expect(lz4Decompress(buf[224..][0..lines.len], buf[0..240]) == null);
+}
+
+fn testBundle(buf: []u8, names: []const []const u8) usize {
+    const names_start = names.len * @sizeOf(IndexEntry);
+    var name_pos = names_start;
+    for (names, 0..) |name, i| {
+        const e = IndexEntry{
+            .offset = @as(u64, i + 1) * PageSize,
+            .stored_size = 1,
+            .size = 1,
+            .crc = 0,
+            .name_offset = @intCast(name_pos),
+            .name_len = @intCast(name.len),
+            .kind = @intFromEnum(Kind.file),
+            .codec = @intFromEnum(Codec.raw),
+            .reserved = 0,
+        };
+        @memcpy(buf[@sizeOf(Header) + i * @sizeOf(IndexEntry) ..][0..@sizeOf(IndexEntry)], std.mem.asBytes(&e));
+        @memcpy(buf[@sizeOf(Header) + name_pos ..][0..name.len], name);
+        name_pos += name.len;
+    }
+    var hdr = Header{
+        .magic = Magic.*,
+        .version = Version,
+        .flags = 0,
+        .entry_count = @intCast(names.len),
+        .index_size = @intCast(name_pos),
+        .page_size = PageSize,
+        .index_crc = std.hash.Crc32.hash(buf[@sizeOf(Header)..][0..name_pos]),
+        .reserved = [_]u8{0} ** 32,
+        .header_crc = 0,
+    };
+    hdr.header_crc = std.hash.Crc32.hash(std.mem.asBytes(&hdr)[0 .. @sizeOf(Header) - 4]);
+    @memcpy(buf[0..@sizeOf(Header)], std.mem.asBytes(&hdr));
+    return @sizeOf(Header) + name_pos;
+}
+
+test "bundle index is checked for order, ranges and checksums" {
+    var buf: [512]u8 = undefined;
+    const len = testBundle(&buf, &.{ "src", "src/main.mpy", "src/main.py" });
+    var hdr = parseHeader(&buf).?;
+    const index = Index.init(&hdr, buf[@sizeOf(Header)..len]).?;
+    try std.testing.expectEqual(@as(u32, 3), index.count);
+    const e = index.entry(1);
+    try std.testing.expectEqualStrings("src/main.mpy", e.name);
+    try std.testing.expectEqual(@as(u64, 2 * PageSize), e.extent.offset);
+    try std.testing.expectEqual(Codec.raw, e.extent.codec);
+
+    // Unsorted or duplicate paths
+    const unsorted = testBundle(&buf, &.{ "src/main.py", "src/main.mpy" });
+    hdr = parseHeader(&buf).?;
+    try std.testing.expect(Index.init(&hdr, buf[@sizeOf(Header)..unsorted]) == null);
+    const dup = testBundle(&buf, &.{ "a", "a" });
+    hdr = parseHeader(&buf).?;
+    try std.testing.expect(Index.init(&hdr, buf[@sizeOf(Header)..dup]) == null);
+
+    // A flipped index byte, then a flipped header byte
+    const ok = testBundle(&buf, &.{"a"});
+    hdr = parseHeader(&buf).?;
+    buf[ok - 1] = 'b';
+    try std.testing.expect(Index.init(&hdr, buf[@sizeOf(Header)..ok]) == null);
+    buf[12] ^= 1;
+    try std.testing.expect(parseHeader(&buf) == null);
+}
@@ -0,0 +1,277 @@
+const serial = @import("serial.zig");
+const builtin = @import("builtin");
+
+// TSC calibration and fixed-point tick -> nanosecond conversion.
+//
+// Calibration order at boot:
+//   1. CPUID leaf 0x15 (crystal clock * ratio) when it reports a crystal
+//   2. Hypervisor timing leaf 0x40000010 (TSC kHz)
+//   3. KVM pvclock page (tsc_to_system_mul / tsc_shift)
+//   4. CPUID leaf 0x16 (processor base frequency)
+//   5. PIT channel 2 one-shot, measured against the TSC
+// Until init() runs (and in host unit tests) the old 2 GHz assumption is used.
+
+/// `host`: measured against the host clock by `zig build bench`
+pub const Source = enum { default, cpuid_crystal, hypervisor_leaf, kvm_pvclock, cpuid_base, pit, host };
+
+const DEFAULT_TSC_HZ: u64 = 2_000_000_000;
+
+// ns = (tsc * ns_mult) >> NS_SHIFT
+const NS_SHIFT = 32;
+
+var tsc_hz: u64 = DEFAULT_TSC_HZ;
+var ns_mult: u64 = multFor(DEFAULT_TSC_HZ);
+var source: Source = .default;
+
+fn multFor(hz: u64) u64 {
+    return @intCast((@as(u128, 1_000_000_000) << NS_SHIFT) / hz);
+}
+
+pub fn rdtsc() u64 {
+    if (builtin.cpu.arch != .x86_64) return 0;
+    var lo: u32 = 0;
+    var hi: u32 = 0;
+    asm volatile ("rdtsc" : [lo] "={eax}" (lo), [hi] "={edx}" (hi));
+    return (@as(u64, hi) << 32) | @as(u64, lo);
+}
+
+pub fn tscToNs(tsc: u64) u64 {
+    return @truncate((@as(u128, tsc) * ns_mult) >> NS_SHIFT);
+}
+
+pub fn nsToTsc(ns: u64) u64 {
+    return @truncate((@as(u128, ns) * tsc_hz) / 1_000_000_000);
+}
+
+/// Monotonic nanoseconds since TSC reset (VM start on Firecracker/QEMU).
+pub fn nowNs() u64 {
+    return tscToNs(rdtsc());
+}
+
+pub fn frequency() u64 {
+    return tsc_hz;
+}
+
+pub fn calibrationSource() Source {
+    return source;
+}
+
+pub fn setFrequency(hz: u64, src: Source) void {
+    if (hz == 0) return;
+    tsc_hz = hz;
+    ns_mult = multFor(hz);
+    source = src;
+}
+
+// --- CPU primitives ---
+
+const CpuidResult = struct { eax: u32, ebx: u32, ecx: u32, edx: u32 };
+
+fn cpuid(leaf: u32, subleaf: u32) CpuidResult {
+    if (comptime builtin.cpu.arch != .x86_64) return .{ .eax = 0, .ebx = 0, .ecx = 0, .edx = 0 };
+    var eax: u32 = 0;
+    var ebx: u32 = 0;
+    var ecx: u32 = 0;
+    var edx: u32 = 0;
+    asm volatile ("cpuid"
+        : [eax] "={eax}" (eax),
+          [ebx] "={ebx}" (ebx),
+          [ecx] "={ecx}" (ecx),
+          [edx] "={edx}" (edx),
+        : [leaf] "{eax}" (leaf),
+          [subleaf] "{ecx}" (subleaf),
+    );
+    return .{ .eax = eax, .ebx = ebx, .ecx = ecx, .edx = edx };
+}
+
+fn wrmsr(msr: u32, value: u64) void {
+    if (comptime builtin.cpu.arch != .x86_64) return;
+    const lo: u32 = @truncate(value);
+    const hi: u32 = @truncate(value >> 32);
+    asm volatile ("wrmsr"
+        :
+        : [msr] "{ecx}" (msr),
+          [lo] "{eax}" (lo),
+          [hi] "{edx}" (hi),
+    );
+}
+
+fn outb(port: u16, value: u8) void {
+    if (comptime builtin.cpu.arch == .x86_64) {
+        asm volatile ("outb %[value], %[port]" : : [value] "{al}" (value), [port] "{dx}" (port));
+    }
+}
+
+fn inb(port: u16) u8 {
+    if (comptime builtin.cpu.arch == .x86_64) {
+        var value: u8 = 0;
+        asm volatile ("inb %[port], %[value]" : [value] "={al}" (value) : [port] "{dx}" (port));
+        return value;
+    }
+    return 0;
+}
+
+// --- Calibration sources ---
+
+fn fromCpuidCrystal() ?u64 {
+    const max_leaf = cpuid(0, 0).eax;
+    if (max_leaf < 0x15) return null;
+    const r = cpuid(0x15, 0);
+    // eax = denominator, ebx = numerator, ecx = crystal Hz (0 if not enumerated)
+    if (r.eax == 0 or r.ebx == 0 or r.ecx == 0) return null;
+    return @as(u64, r.ecx) * r.ebx / r.eax;
+}
+
+fn fromCpuidBase() ?u64 {
+    const max_leaf = cpuid(0, 0).eax;
+    if (max_leaf < 0x16) return null;
+    const mhz = cpuid(0x16, 0).eax & 0xFFFF;
+    if (mhz == 0) return null;
+    return @as(u64, mhz) * 1_000_000;
+}
+
+const HYPERVISOR_BASE: u32 = 0x40000000;
+
+fn hypervisorMaxLeaf() u32 {
+    // CPUID.1:ECX bit 31 = running under a hypervisor
+    if ((cpuid(1, 0).ecx & (1 << 31)) == 0) return 0;
+    return cpuid(HYPERVISOR_BASE, 0).eax;
+}
+
+fn isKvm() bool {
+    const r = cpuid(HYPERVISOR_BASE, 0);
+    // "KVMKVMKVM\0\0\0"
+    return r.ebx == 0x4b4d564b and r.ecx == 0x564b4d56 and r.edx == 0x4d;
+}
+
+fn fromHypervisorLeaf() ?u64 {
+    if (hypervisorMaxLeaf() < HYPERVISOR_BASE + 0x10) return null;
+    const khz = cpuid(HYPERVISOR_BASE + 0x10, 0).eax;
+    if (khz == 0) return null;
+    return @as(u64, khz) * 1000;
+}
+
+const MSR_KVM_SYSTEM_TIME_NEW: u32 = 0x4b564d01;
+const KVM_FEATURE_CLOCKSOURCE2: u32 = 1 << 3;
+
+const PvclockTimeInfo = extern struct {
+    version: u32,
+    pad0: u32,
+    tsc_timestamp: u64,
+    system_time: u64,
+    tsc_to_system_mul: u32,
+    tsc_shift: i8,
+    flags: u8,
+    pad: [2]u8,
+};
+
+var pvclock_info: PvclockTimeInfo align(64) = undefined;
+
+fn fromKvmPvclock() ?u64 {
+    if (hypervisorMaxLeaf() < HYPERVISOR_BASE + 1 or !isKvm()) return null;
+    if ((cpuid(HYPERVISOR_BASE + 1, 0).eax & KVM_FEATURE_CLOCKSOURCE2) == 0) return null;
+
+    const info: *volatile PvclockTimeInfo = &pvclock_info;
+    info.version = 0;
+    info.tsc_to_system_mul = 0;
+    wrmsr(MSR_KVM_SYSTEM_TIME_NEW, @intFromPtr(&pvclock_info) | 1);
+
+    // The host publishes the record before returning from the MSR write;
+    // an odd version means an update is in progress.
+    var mul: u32 = 0;
+    var shift: i8 = 0;
+    var tries: u32 = 0;
+    while (tries < 1000) : (tries += 1) {
+        const v1 = info.version;
+        mul = info.tsc_to_system_mul;
+        shift = info.tsc_shift;
+        const v2 = info.version;
+        if (v1 == v2 and (v1 & 1) == 0 and mul != 0) break;
+    }
+
+    // Stop the host from writing into our BSS once we have the scale.
+    wrmsr(MSR_KVM_SYSTEM_TIME_NEW, 0);
+    if (mul == 0) return null;
+
+    // ns = ((tsc << shift) * mul) >> 32  =>  hz = 1e9 * 2^32 / (mul * 2^shift)
+    var num: u128 = @as(u128, 1_000_000_000) << 32;
+    var den: u128 = mul;
+    if (shift >= 0) {
+        den <<= @as(u7, @intCast(shift));
+    } else {
+        num <<= @as(u7, @intCast(-@as(i16, shift)));
+    }
+    return @intCast(num / den);
+}
+
+// PIT input clock is 1.193182 MHz; a 10 ms one-shot on channel 2.
+const PIT_HZ: u64 = 1_193_182;
+const PIT_CAL_MS: u64 = 10;
+
+fn fromPit() ?u64 {
+    const count: u16 = @intCast(PIT_HZ * PIT_CAL_MS / 1000);
+
+    // Gate channel 2 on, speaker off.
+    const ctrl = inb(0x61);
+    outb(0x61, (ctrl & 0xFC) | 0x01);
+
+    // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count), binary.
+    outb(0x43, 0xB0);
+    outb(0x42, @truncate(count));
+    outb(0x42, @truncate(count >> 8));
+
+    // Retrigger the gate so counting starts now.
+    const gate = inb(0x61);
+    outb(0x61, gate & 0xFE);
+    outb(0x61, gate | 0x01);
+
+    const start = rdtsc();
+    var spins: u64 = 0;
+    // OUT2 (bit 5) goes high at terminal count. Bail out if there is no PIT.
+    while ((inb(0x61) & 0x20) == 0) : (spins += 1) {
+        if (spins > 100_000_000) {
+            outb(0x61, ctrl);
+            return null;
+        }
+    }
+    const end = rdtsc();
+    outb(0x61, ctrl);
+
+    if (end <= start) return null;
+    return (end - start) * (1000 / PIT_CAL_MS);
+}
+
+pub fn init() void {
+    if (fromCpuidCrystal()) |hz| {
+        setFrequency(hz, .cpuid_crystal);
+    } else if (fromHypervisorLeaf()) |hz| {
+        setFrequency(hz, .hypervisor_leaf);
+    } else if (fromKvmPvclock()) |hz| {
+        setFrequency(hz, .kvm_pvclock);
+    } else if (fromCpuidBase()) |hz| {
+        setFrequency(hz, .cpuid_base);
+    } else if (fromPit()) |hz| {
+        setFrequency(hz, .pit);
+    }
+
+    serial.writeAll("clock: tsc ");
+    serial.writeDec(tsc_hz / 1000);
+    serial.writeAll(" kHz via ");
+    serial.writeAll(@tagName(source));
+    serial.writeAll("\n");
+}
+
+test "fixed-point conversion matches frequency" {
+    const std = @import("std");
+    const saved_hz = tsc_hz;
+    const saved_src = source;
+    defer setFrequency(saved_hz, saved_src);
+
+    setFrequency(3_000_000_000, .cpuid_crystal);
+    try std.testing.expectEqual(@as(u64, 1_000_000_000), tscToNs(3_000_000_000));
+    try std.testing.expectEqual(@as(u64, 3_000_000), nsToTsc(1_000_000));
+
+    setFrequency(1_234_567_000, .pit);
+    const ns = tscToNs(1_234_567_000 * 5);
+    try std.testing.expect(ns >= 4_999_999_999 and ns <= 5_000_000_001);
+}
@@ -0,0 +1,79 @@
+// Compile-time kernel configuration.
+//
+// Values come from build.zig (-Dprofile=full|net|minimal plus per-option
+// overrides). Disabled subsystems are skipped with comptime checks, so
+// their code and tables are not linked into the image.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const build_options = @import("build_options");
+const root = @import("root");
+
+/// Running on the host (unit tests, `zig build bench`) instead of in the
+/// guest: virtio MMIO goes to the device models in virtio_mock.zig and
+/// serial port I/O is dropped. Host executables opt in by declaring
+/// `pub const ukernel_hosted = true` in their root file.
+pub const hosted: bool = builtin.is_test or (@hasDecl(root, "ukernel_hosted") and root.ukernel_hosted);
+
+// Drivers and runtimes
+pub const blk: bool = build_options.blk;
+/// Record log on the second virtio-blk drive (kernel/disk_log.zig)
+pub const disk_log: bool = build_options.disk_log;
+pub const net: bool = build_options.net;
+/// Raw frame rings steered from virtio-net (kernel/frame_ring.zig)
+pub const net_raw: bool = build_options.net_raw;
+/// virtio-balloon with free page reporting (kernel/balloon.zig)
+pub const balloon: bool = build_options.balloon;
+pub const micropython: bool = build_options.micropython;
+pub const demo_workload: bool = build_options.demo_workload;
+/// Microbenchmarks (kernel/bench.zig) in place of the demo workload and
+/// entrypoint
+pub const bench: bool = build_options.bench;
+
+// Optional ABI namespaces; calls return ERR_UNSUPPORTED when compiled out
+pub const abi_ring: bool = build_options.abi_ring;
+pub const abi_trace: bool = build_options.abi_trace;
+/// Packet capture ring (kernel/pcap.zig)
+pub const pcap: bool = build_options.pcap;
+
+// Table and pool sizes (comptime_int, like the literals they replace)
+pub const max_io = @as(comptime_int, build_options.max_io);
+pub const max_net = @as(comptime_int, build_options.max_net);
+pub const udp_sockets = @as(comptime_int, build_options.udp_sockets);
+pub const virtq_size = @as(comptime_int, build_options.virtq_size);
+pub const net_rx_bufs = @as(comptime_int, build_options.net_rx_bufs);
+/// virtio-net receive buffers hold frames of this MTU; the device's own
+/// (VIRTIO_NET_F_MTU) is used when it is no larger
+pub const net_max_mtu = @as(comptime_int, build_options.net_max_mtu);
+/// Reassembly buffer per in-flight fragmented datagram (capped at 65535)
+pub const ip_reasm_size = @min(@as(comptime_int, build_options.ip_reasm_kb) * 1024, 65535);
+/// Receive buffer in every UDP socket (capped at 65535)
+pub const udp_rx_size = @min(@as(comptime_int, build_options.udp_rx_kb) * 1024, 65535);
+pub const pcap_size = @as(comptime_int, build_options.pcap_kb) * 1024;
+pub const pcap_snaplen = @as(comptime_int, build_options.pcap_snaplen);
+pub const abi_heap_size = @as(comptime_int, build_options.abi_heap_kb) * 1024;
+/// GC heap limit; the heap starts at mp_heap_init_size and grows in areas
+pub const mp_heap_size = @as(comptime_int, build_options.mp_heap_kb) * 1024;
+pub const mp_heap_init_size = @as(comptime_int, build_options.mp_heap_init_kb) * 1024;
+/// Kernel page pool (kernel/pages.zig) the GC heap areas come from
+pub const page_pool_size = @as(comptime_int, build_options.page_pool_kb) * 1024;
+/// Executable arena for native/viper code; 0 compiles the emitters out
+pub const mp_exec_size = @as(comptime_int, build_options.mp_exec_kb) * 1024;
+pub const rootfs_cache_size = @as(comptime_int, build_options.rootfs_cache_kb) * 1024;
+
+/// Python source or .mpy bytecode embedded with -Dentry-source (empty if
+/// none).
+pub const entry_source: []const u8 = build_options.entry_source;
+
+/// Frozen module run as __main__ (-Dfrozen-entry, empty if none).
+pub const frozen_entry: [:0]const u8 = std.fmt.comptimePrint("{s}", .{build_options.frozen_entry});
+
+comptime {
+    std.debug.assert(std.math.isPowerOfTwo(virtq_size) and virtq_size >= 4);
+    std.debug.assert(blk or !disk_log);
+    std.debug.assert(net or !net_raw);
+    std.debug.assert(net_rx_bufs > 0 and net_rx_bufs <= virtq_size);
+    std.debug.assert(max_io > 0 and max_net > 0 and udp_sockets > 0);
+    std.debug.assert(max_net <= udp_sockets);
+    std.debug.assert(net_max_mtu >= 1500 and net_max_mtu <= 9000);
+}
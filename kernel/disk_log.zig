@@ -0,0 +1,615 @@
+// Append-only record log on a dedicated data disk (the second virtio-blk
+// drive), for output that would overrun the serial console.
+//
+// Records are appended to an in-memory batch. A batch goes to the disk as
+// one write followed by a flush (group commit) once the device is idle and
+// the batch is a quarter full, CommitNs old, or sync() asks for it. The
+// next batch fills while one is in flight. Layout, in 512-byte sectors:
+//
+//   0, 1    checkpoints: log id, generation, tail sector, next batch seq,
+//           epoch
+//   2..     batches: a 40-byte header, then records, padded to a sector
+//
+//   batch header  magic "ZLB1", sectors, seq, log id, payload length,
+//                 record count, epoch, crc32 of the header
+//   record        length u32, stream u16, reserved u16, crc32 u32, data
+//
+// Batch sequence numbers run on from 1. mount() takes the newest valid
+// checkpoint and scans forward while each batch has the expected seq and
+// every record checksum verifies, so a torn last batch ends the log and the
+// next batch overwrites it. Each mount starts a new epoch with a durable
+// checkpoint, and epochs may not go backwards along the log, so batches
+// left beyond an overwritten one are never taken as its successors. A
+// checkpoint is also written every CheckpointSectors of log, which bounds
+// the scan. The log does not wrap; on a full disk appends fail and are
+// counted as dropped. scripts/disk_log.py reads the log back on the host.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const serial = @import("serial.zig");
+const config = @import("config.zig");
+const clock = @import("clock.zig");
+const virtio_blk = @import("virtio_blk.zig");
+
+pub const Stream = enum(u16) {
+    /// log_write records, with their level prefix
+    log = 1,
+    /// Workload data written through an io_open("disklog") handle
+    user = 2,
+};
+
+const SectorSize = 512;
+const DataStart = 2;
+pub const BatchSize = 64 * 1024;
+const BatchHeaderSize = 40;
+const RecordHeaderSize = 12;
+pub const MaxRecord = BatchSize - BatchHeaderSize - RecordHeaderSize;
+const CommitNs: u64 = 2_000_000;
+pub const CheckpointSectors = 2048;
+
+const BatchMagic: u32 = 0x31424c5a; // "ZLB1"
+const CheckpointMagic: u32 = 0x31434c5a; // "ZLC1"
+
+pub const Stats = struct {
+    records: u64 = 0,
+    bytes: u64 = 0,
+    batches: u64 = 0,
+    flushes: u64 = 0,
+    checkpoints: u64 = 0,
+    /// Records lost to a full disk, an oversized record or a write error
+    dropped: u64 = 0,
+    /// Batches found by mount() past the checkpoint
+    recovered_batches: u64 = 0,
+    recovered_records: u64 = 0,
+};
+
+pub var stats: Stats = .{};
+
+var disk: virtio_blk.Disk = .{};
+var mounted: bool = false;
+var full: bool = false;
+var log_id: u32 = 0;
+var epoch: u32 = 0;
+var capacity: u64 = 0; // sectors
+
+// Next free sector, including the batch in flight
+var tail: u64 = DataStart;
+var next_seq: u64 = 1;
+var ckpt_gen: u64 = 0;
+var ckpt_tail: u64 = DataStart;
+
+// Double buffer: one batch fills while the other is on its way out
+var bufs: [2][BatchSize]u8 align(SectorSize) = undefined;
+var active: u1 = 0;
+var fill: usize = BatchHeaderSize;
+var batch_records: u32 = 0;
+var opened_ns: u64 = 0;
+
+var sector_buf: [SectorSize]u8 align(SectorSize) = undefined;
+
+const Phase = enum { idle, writing, flushing, checkpointing };
+var phase: Phase = .idle;
+var inflight: virtio_blk.Tag = 0;
+var inflight_records: u32 = 0;
+
+pub fn isMounted() bool {
+    return mounted;
+}
+
+// --- On-disk encoding ---
+
+fn put32(buf: []u8, offset: usize, value: u32) void {
+    std.mem.writeInt(u32, buf[offset..][0..4], value, .little);
+}
+
+fn put64(buf: []u8, offset: usize, value: u64) void {
+    std.mem.writeInt(u64, buf[offset..][0..8], value, .little);
+}
+
+fn get32(buf: []const u8, offset: usize) u32 {
+    return std.mem.readInt(u32, buf[offset..][0..4], .little);
+}
+
+fn get64(buf: []const u8, offset: usize) u64 {
+    return std.mem.readInt(u64, buf[offset..][0..8], .little);
+}
+
+fn sectorsFor(bytes: usize) u32 {
+    return @intCast((bytes + SectorSize - 1) / SectorSize);
+}
+
+const Checkpoint = struct {
+    log_id: u32,
+    gen: u64,
+    tail: u64,
+    next_seq: u64,
+    epoch: u32,
+};
+
+fn encodeCheckpoint(buf: []u8, cp: Checkpoint) void {
+    @memset(buf[0..SectorSize], 0);
+    put32(buf, 0, CheckpointMagic);
+    put32(buf, 4, cp.log_id);
+    put64(buf, 8, cp.gen);
+    put64(buf, 16, cp.tail);
+    put64(buf, 24, cp.next_seq);
+    put32(buf, 32, cp.epoch);
+    put32(buf, 36, std.hash.Crc32.hash(buf[0..36]));
+}
+
+fn decodeCheckpoint(buf: []const u8) ?Checkpoint {
+    if (get32(buf, 0) != CheckpointMagic) return null;
+    if (get32(buf, 36) != std.hash.Crc32.hash(buf[0..36])) return null;
+    return .{
+        .log_id = get32(buf, 4),
+        .gen = get64(buf, 8),
+        .tail = get64(buf, 16),
+        .next_seq = get64(buf, 24),
+        .epoch = get32(buf, 32),
+    };
+}
+
+fn currentCheckpoint() Checkpoint {
+    return .{ .log_id = log_id, .gen = ckpt_gen, .tail = tail, .next_seq = next_seq, .epoch = epoch };
+}
+
+const BatchHeader = struct { sectors: u32, epoch: u32 };
+
+/// A batch header that checks out as the successor at this position.
+fn checkBatchHeader(buf: []const u8, seq: u64, at: u64, min_epoch: u32) ?BatchHeader {
+    if (get32(buf, 0) != BatchMagic) return null;
+    if (get32(buf, 36) != std.hash.Crc32.hash(buf[0..36])) return null;
+    const sectors = get32(buf, 4);
+    const payload = get32(buf, 20);
+    const batch_epoch = get32(buf, 28);
+    if (get64(buf, 8) != seq or get32(buf, 16) != log_id or batch_epoch < min_epoch) return null;
+    if (sectors == 0 or sectors > BatchSize / SectorSize or at + sectors > capacity) return null;
+    if (BatchHeaderSize + @as(u64, payload) > @as(u64, sectors) * SectorSize) return null;
+    return .{ .sectors = sectors, .epoch = batch_epoch };
+}
+
+/// Record count of a complete batch, or null if any record is damaged.
+fn checkRecords(batch: []const u8) ?u32 {
+    const end: usize = BatchHeaderSize + get32(batch, 20);
+    const count = get32(batch, 24);
+    var offset: usize = BatchHeaderSize;
+    var n: u32 = 0;
+    while (offset < end) : (n += 1) {
+        if (end - offset < RecordHeaderSize) return null;
+        const len = get32(batch, offset);
+        const data_start = offset + RecordHeaderSize;
+        if (len > end - data_start) return null;
+        var crc = std.hash.Crc32.init();
+        crc.update(batch[offset..][0..8]);
+        crc.update(batch[data_start..][0..len]);
+        if (crc.final() != get32(batch, offset + 8)) return null;
+        offset = data_start + len;
+    }
+    return if (n == count) n else null;
+}
+
+// --- Device helpers ---
+
+fn readSync(sector: u64, buf: []u8) bool {
+    const tag = disk.startRead(sector, buf.ptr, @intCast(buf.len)) orelse return false;
+    disk.kick();
+    return disk.wait(tag);
+}
+
+fn writeSync(sector: u64, data: []const u8) bool {
+    const tag = disk.startWrite(sector, data) orelse return false;
+    disk.kick();
+    return disk.wait(tag);
+}
+
+fn flushSync() bool {
+    if (!disk.hasFlush()) return true;
+    const tag = disk.startFlush() orelse return false;
+    disk.kick();
+    return disk.wait(tag);
+}
+
+// --- Mount and recovery ---
+
+fn resetState() void {
+    mounted = false;
+    full = false;
+    tail = DataStart;
+    next_seq = 1;
+    ckpt_gen = 0;
+    ckpt_tail = DataStart;
+    active = 0;
+    fill = BatchHeaderSize;
+    batch_records = 0;
+    phase = .idle;
+    stats = .{};
+}
+
+/// Write the next checkpoint generation and wait until it is durable.
+fn checkpointSync() bool {
+    ckpt_gen += 1;
+    encodeCheckpoint(&sector_buf, currentCheckpoint());
+    if (!writeSync(ckpt_gen % DataStart, &sector_buf)) return false;
+    ckpt_tail = tail;
+    return flushSync();
+}
+
+fn format() bool {
+    // Any id other than the previous log's rejects its leftover batches
+    log_id = @truncate(clock.rdtsc() *% 0x9E3779B97F4A7C15 >> 32);
+    if (log_id == 0) log_id = 1;
+    ckpt_gen = 0;
+    epoch = 1;
+    @memset(&sector_buf, 0);
+    if (!writeSync(0, &sector_buf) or !writeSync(1, &sector_buf)) return false;
+    return checkpointSync();
+}
+
+/// Bring up the data disk and find the end of the log on it, formatting
+/// the disk if it holds no log. Returns whether appends can start.
+pub fn mount() bool {
+    if (comptime !config.disk_log) return false;
+    resetState();
+    if (!disk.init(1)) {
+        serial.writeAll("disk_log: no data disk\n");
+        return false;
+    }
+    capacity = disk.capacityBytes() / SectorSize;
+    if (disk.isReadOnly() or capacity < DataStart + 1) {
+        serial.writeAll("disk_log: data disk is read-only or too small\n");
+        return false;
+    }
+
+    var best: ?Checkpoint = null;
+    for (0..DataStart) |slot| {
+        if (!readSync(slot, &sector_buf)) {
+            serial.writeAll("disk_log: read error\n");
+            return false;
+        }
+        const cp = decodeCheckpoint(&sector_buf) orelse continue;
+        if (cp.tail < DataStart or cp.tail > capacity) continue;
+        if (best == null or cp.gen > best.?.gen) best = cp;
+    }
+
+    if (best) |cp| {
+        log_id = cp.log_id;
+        ckpt_gen = cp.gen;
+        tail = cp.tail;
+        next_seq = cp.next_seq;
+        epoch = cp.epoch;
+        scan();
+        // New epoch, durable before any batch carries it
+        epoch += 1;
+        if (!checkpointSync()) {
+            serial.writeAll("disk_log: checkpoint write failed\n");
+            return false;
+        }
+    } else if (!format()) {
+        serial.writeAll("disk_log: format failed\n");
+        return false;
+    }
+
+    mounted = true;
+    var msg: [96]u8 = undefined;
+    serial.writeAll(std.fmt.bufPrint(&msg, "disk_log: tail={d}/{d} sectors, {d} batches recovered\n", .{
+        tail, capacity, stats.recovered_batches,
+    }) catch "disk_log: mounted\n");
+    return true;
+}
+
+/// Walk complete batches from the checkpoint to the end of the log.
+fn scan() void {
+    const batch = &bufs[0];
+    var min_epoch = epoch;
+    while (tail < capacity) {
+        if (!readSync(tail, batch[0..SectorSize])) return;
+        const header = checkBatchHeader(batch, next_seq, tail, min_epoch) orelse return;
+        const len = @as(usize, header.sectors) * SectorSize;
+        if (header.sectors > 1 and !readSync(tail + 1, batch[SectorSize..len])) return;
+        const records = checkRecords(batch) orelse return;
+        tail += header.sectors;
+        next_seq += 1;
+        min_epoch = header.epoch;
+        stats.recovered_batches += 1;
+        stats.recovered_records += records;
+    }
+    // Batches from a later epoch than the checkpoint's (its own durable
+    // checkpoint was lost) still move the next epoch past them
+    epoch = min_epoch;
+}
+
+// --- Append and group commit ---
+
+/// Append one record made of parts. Waits for the device only when both
+/// batch buffers are taken. False if the record was dropped.
+pub fn append(stream: Stream, parts: []const []const u8) bool {
+    if (!mounted) return false;
+    var len: usize = 0;
+    for (parts) |part| len += part.len;
+    if (full or len > MaxRecord) {
+        stats.dropped += 1;
+        return false;
+    }
+
+    while (BatchSize - fill < RecordHeaderSize + len) {
+        if (phase == .idle) {
+            seal();
+        } else {
+            pump();
+            if (comptime builtin.cpu.arch == .x86_64) {
+                asm volatile ("pause");
+            }
+        }
+        if (!mounted or full) {
+            stats.dropped += 1;
+            return false;
+        }
+    }
+
+    const buf = &bufs[active];
+    const hdr = buf[fill..][0..RecordHeaderSize];
+    put32(hdr, 0, @intCast(len));
+    std.mem.writeInt(u16, hdr[4..6], @intFromEnum(stream), .little);
+    std.mem.writeInt(u16, hdr[6..8], 0, .little);
+    var crc = std.hash.Crc32.init();
+    crc.update(hdr[0..8]);
+    var offset = fill + RecordHeaderSize;
+    for (parts) |part| {
+        @memcpy(buf[offset..][0..part.len], part);
+        crc.update(part);
+        offset += part.len;
+    }
+    put32(hdr, 8, crc.final());
+
+    if (batch_records == 0) opened_ns = clock.nowNs();
+    fill = offset;
+    batch_records += 1;
+    stats.records += 1;
+    stats.bytes += len;
+    pump();
+    return true;
+}
+
+/// Write the active batch out; the device must be idle.
+fn seal() void {
+    if (batch_records == 0) return;
+    const buf = &bufs[active];
+    const sectors = sectorsFor(fill);
+    if (tail + sectors > capacity) {
+        serial.writeAll("disk_log: disk full, dropping records\n");
+        full = true;
+        stats.dropped += batch_records;
+        fill = BatchHeaderSize;
+        batch_records = 0;
+        return;
+    }
+
+    @memset(buf[fill .. @as(usize, sectors) * SectorSize], 0);
+    put32(buf, 0, BatchMagic);
+    put32(buf, 4, sectors);
+    put64(buf, 8, next_seq);
+    put32(buf, 16, log_id);
+    put32(buf, 20, @intCast(fill - BatchHeaderSize));
+    put32(buf, 24, batch_records);
+    put32(buf, 28, epoch);
+    put32(buf, 32, 0);
+    put32(buf, 36, std.hash.Crc32.hash(buf[0..36]));
+
+    inflight = disk.startWrite(tail, buf[0 .. @as(usize, sectors) * SectorSize]) orelse {
+        fail();
+        return;
+    };
+    disk.kick();
+    phase = .writing;
+    inflight_records = batch_records;
+    tail += sectors;
+    next_seq += 1;
+    stats.batches += 1;
+
+    active +%= 1;
+    fill = BatchHeaderSize;
+    batch_records = 0;
+}
+
+fn fail() void {
+    serial.writeAll("disk_log: write error, log closed\n");
+    mounted = false;
+    phase = .idle;
+    stats.dropped += inflight_records + batch_records;
+    batch_records = 0;
+}
+
+fn startCheckpoint() bool {
+    ckpt_gen += 1;
+    encodeCheckpoint(&sector_buf, currentCheckpoint());
+    // Slots alternate, so a torn write leaves the previous one intact
+    inflight = disk.startWrite(ckpt_gen % DataStart, &sector_buf) orelse return false;
+    disk.kick();
+    ckpt_tail = tail;
+    stats.checkpoints += 1;
+    phase = .checkpointing;
+    return true;
+}
+
+/// Advance the commit pipeline without waiting. Called from append and
+/// from the ABI idle points.
+pub fn pump() void {
+    if (!mounted) return;
+    switch (phase) {
+        .writing => {
+            const ok = disk.poll(inflight) orelse return;
+            if (!ok) return fail();
+            if (disk.hasFlush()) {
+                inflight = disk.startFlush() orelse return fail();
+                disk.kick();
+                phase = .flushing;
+                return;
+            }
+            committed();
+        },
+        .flushing => {
+            const ok = disk.poll(inflight) orelse return;
+            if (!ok) return fail();
+            stats.flushes += 1;
+            committed();
+        },
+        .checkpointing => {
+            // Not flushed on its own: the next batch's flush covers it,
+            // and until then the previous checkpoint is still valid
+            const ok = disk.poll(inflight) orelse return;
+            if (!ok) return fail();
+            phase = .idle;
+        },
+        .idle => {},
+    }
+    if (phase == .idle and batch_records > 0) {
+        if (fill >= BatchSize / 4 or clock.nowNs() -% opened_ns >= CommitNs) seal();
+    }
+}
+
+fn committed() void {
+    inflight_records = 0;
+    phase = .idle;
+    if (tail - ckpt_tail >= CheckpointSectors and !startCheckpoint()) fail();
+}
+
+/// Wait until every record appended so far is on stable storage.
+pub fn sync() bool {
+    while (mounted and (phase != .idle or batch_records > 0)) {
+        if (phase == .idle) seal() else pump();
+        if (comptime builtin.cpu.arch == .x86_64) {
+            asm volatile ("pause");
+        }
+    }
+    return mounted and !full;
+}
+
+/// Sync and stop taking records.
+pub fn unmount() void {
+    _ = sync();
+    mounted = false;
+}
+
+// --- Tests against the virtio-blk model ---
+
+const virtio_mock = @import("virtio_mock.zig");
+
+// The data disk is the second drive; the first stands in for the rootfs
+var test_rootfs: [SectorSize]u8 = undefined;
+
+fn testDisk(sectors: usize) ![]u8 {
+    const image = try std.testing.allocator.alloc(u8, sectors * SectorSize);
+    @memset(image, 0xEE);
+    virtio_mock.reset();
+    _ = virtio_mock.addBlk(&test_rootfs);
+    _ = virtio_mock.addBlk(image);
+    return image;
+}
+
+fn appendNumbered(count: usize, first: usize) !void {
+    for (first..first + count) |i| {
+        var buf: [32]u8 = undefined;
+        const text = try std.fmt.bufPrint(&buf, "record {d}", .{i});
+        try std.testing.expect(append(.user, &.{text}));
+    }
+}
+
+test "records survive a remount and appends resume at the tail" {
+    const image = try testDisk(4096);
+    defer std.testing.allocator.free(image);
+
+    try std.testing.expect(mount());
+    try std.testing.expectEqual(@as(u64, 0), stats.recovered_batches);
+    try appendNumbered(100, 0);
+    try std.testing.expect(append(.log, &.{ "[info] ", "two parts" }));
+    try std.testing.expect(sync());
+    const end = tail;
+    const batches = stats.batches;
+    try std.testing.expect(batches >= 1);
+
+    // "Crash": mount again from what is on the disk
+    try std.testing.expect(mount());
+    try std.testing.expectEqual(end, tail);
+    try std.testing.expectEqual(batches, stats.recovered_batches);
+    try std.testing.expectEqual(@as(u64, 101), stats.recovered_records);
+
+    // The second mount checkpointed its tail, so only new batches are scanned
+    try appendNumbered(10, 100);
+    try std.testing.expect(sync());
+    try std.testing.expect(mount());
+    try std.testing.expectEqual(@as(u64, 10), stats.recovered_records);
+}
+
+test "a torn last batch is discarded and overwritten" {
+    const image = try testDisk(4096);
+    defer std.testing.allocator.free(image);
+
+    try std.testing.expect(mount());
+    try appendNumbered(5, 0);
+    try std.testing.expect(sync());
+    const good_tail = tail;
+    // Two one-sector batches after it
+    try appendNumbered(1, 5);
+    try std.testing.expect(sync());
+    try appendNumbered(1, 6);
+    try std.testing.expect(sync());
+    try std.testing.expectEqual(good_tail + 2, tail);
+
+    // Damage the record in the first of them
+    image[good_tail * SectorSize + BatchHeaderSize + RecordHeaderSize] ^= 0xFF;
+    try std.testing.expect(mount());
+    try std.testing.expectEqual(good_tail, tail);
+    try std.testing.expectEqual(@as(u64, 5), stats.recovered_records);
+
+    // The replacement takes the damaged batch's seq; the stale batch after
+    // it has the right next seq but an older epoch
+    try appendNumbered(1, 100);
+    try std.testing.expect(sync());
+    try std.testing.expect(mount());
+    try std.testing.expectEqual(good_tail + 1, tail);
+    try std.testing.expectEqual(@as(u64, 1), stats.recovered_records);
+}
+
+test "checkpoints bound the recovery scan" {
+    const image = try testDisk(8192);
+    defer std.testing.allocator.free(image);
+
+    try std.testing.expect(mount());
+    const record = [_]u8{'x'} ** 4000;
+    var total: u64 = 0;
+    while (stats.checkpoints < 2) : (total += 1) {
+        try std.testing.expect(append(.user, &.{&record}));
+    }
+    try std.testing.expect(sync());
+    const batches = stats.batches;
+
+    try std.testing.expect(mount());
+    try std.testing.expect(ckpt_gen >= 3);
+    try std.testing.expect(stats.recovered_batches < batches);
+    try std.testing.expect(stats.recovered_records < total);
+}
+
+test "a full disk drops records; a device without flush skips it" {
+    const image = try testDisk(DataStart + 8);
+    defer std.testing.allocator.free(image);
+
+    try std.testing.expect(mount());
+    const record = [_]u8{'y'} ** 1000;
+    var accepted: u32 = 0;
+    while (append(.user, &.{&record})) accepted += 1;
+    try std.testing.expect(accepted > 0);
+    try std.testing.expect(!sync());
+    try std.testing.expect(stats.dropped > 0);
+    try std.testing.expect(!append(.user, &.{"late"}));
+
+    virtio_mock.reset();
+    _ = virtio_mock.addBlk(&test_rootfs);
+    const model = virtio_mock.addBlk(image);
+    model.features = 0;
+    @memset(image, 0);
+    try std.testing.expect(mount());
+    try std.testing.expect(append(.user, &.{"no cache"}));
+    try std.testing.expect(sync());
+    try std.testing.expectEqual(@as(u64, 0), model.stats.flushes);
+    try std.testing.expect(!append(.user, &.{&([_]u8{0} ** (MaxRecord + 1))}));
+}
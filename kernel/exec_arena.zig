@@ -0,0 +1,65 @@
+// Executable memory for MicroPython's native and viper emitters.
+//
+// The boot page tables map everything without NX, so any kernel memory can
+// hold machine code. Emitted code gets its own arena (-Dmp-exec-kb) rather
+// than the GC heap or libc_shim's malloc: functions are never freed
+// individually while the interpreter runs, so a bump allocator suffices.
+// Freeing the most recent block (the emitter abandoning a failed compile)
+// rolls the arena back, and reset() drops everything at mp_deinit.
+
+const std = @import("std");
+const config = @import("config.zig");
+
+/// Code blocks start on a cache line
+const Align = 64;
+
+pub const Arena = struct {
+    buf: []u8,
+    used: usize = 0,
+    peak: usize = 0,
+
+    pub fn alloc(self: *Arena, min_size: usize) ?[]u8 {
+        const start = std.mem.alignForward(usize, self.used, Align);
+        if (min_size == 0 or start > self.buf.len or min_size > self.buf.len - start) return null;
+        self.used = start + min_size;
+        if (self.used > self.peak) self.peak = self.used;
+        return self.buf[start..self.used];
+    }
+
+    pub fn free(self: *Arena, ptr: [*]const u8, size: usize) void {
+        if (@intFromPtr(ptr) < @intFromPtr(self.buf.ptr)) return;
+        const start = @intFromPtr(ptr) - @intFromPtr(self.buf.ptr);
+        if (start + size == self.used) self.used = start;
+    }
+
+    pub fn reset(self: *Arena) void {
+        self.used = 0;
+    }
+};
+
+var exec_buf: [config.mp_exec_size]u8 align(Align) = undefined;
+pub var arena = Arena{ .buf = exec_buf[0..] };
+
+test "exec arena aligns blocks and rolls back the last free" {
+    var buf: [512]u8 align(Align) = undefined;
+    var a = Arena{ .buf = buf[0..] };
+
+    const first = a.alloc(10).?;
+    const second = a.alloc(100).?;
+    try std.testing.expectEqual(@as(usize, 10), first.len);
+    try std.testing.expectEqual(@as(usize, 64), @intFromPtr(second.ptr) - @intFromPtr(first.ptr));
+
+    // Only the most recent block is reclaimed
+    a.free(first.ptr, first.len);
+    try std.testing.expectEqual(@as(usize, 164), a.used);
+    a.free(second.ptr, second.len);
+    try std.testing.expectEqual(@as(usize, 64), a.used);
+
+    try std.testing.expect(a.alloc(1024) == null);
+    try std.testing.expect(a.alloc(448) != null);
+    try std.testing.expect(a.alloc(1) == null);
+    try std.testing.expectEqual(@as(usize, 512), a.peak);
+
+    a.reset();
+    try std.testing.expectEqual(@as(usize, 0), a.used);
+}
@@ -0,0 +1,296 @@
+// Raw frame rings shared with the workload (net_frame_*).
+//
+// Layout at the base address passed to net_frame_setup:
+//   FrameRingHeader            64 bytes
+//   FrameDesc[entries]         RX ring
+//   FrameDesc[entries]         TX ring
+//   slots                      2 * entries buffers of SlotSize bytes, at
+//                              slots_offset (64-byte aligned)
+//
+// The kernel copies each steered frame into the slot named by the RX
+// descriptor at rx_tail and advances it; the workload consumes from
+// rx_head. The workload fills TX descriptors at tx_tail; the kernel hands
+// their slots to virtio-net as they are and advances tx_head once the
+// device is done with them. Indices are free-running u32s masked by
+// entries - 1, as in io_ring.zig.
+//
+// Setup points RX descriptor i at slot i and TX descriptor i at slot
+// entries + i. A descriptor may name any slot, so a forwarder can swap the
+// slot of a consumed RX descriptor into the TX descriptor it fills and
+// send the frame without copying it.
+
+const std = @import("std");
+
+pub const MaxEntries: u32 = 256;
+
+/// Bytes per slot: any frame of a 1500-byte MTU. Longer steered frames are
+/// dropped and counted in rx_dropped.
+pub const SlotSize: u32 = 2048;
+
+const ETHERTYPE_IPV4: u16 = 0x0800;
+const ETHERTYPE_ARP: u16 = 0x0806;
+const PROTO_UDP: u8 = 17;
+
+pub const FrameRingHeader = extern struct {
+    rx_head: u32,
+    rx_tail: u32,
+    tx_head: u32,
+    tx_tail: u32,
+    entries: u32,
+    slot_size: u32,
+    slots_offset: u32,
+    /// Steered frames lost to a full RX ring, a bad descriptor or their length
+    rx_dropped: u32,
+    /// TX descriptors with a bad slot or length, or that the device refused
+    tx_errors: u32,
+    reserved: [7]u32,
+};
+
+pub const FrameDesc = extern struct {
+    slot: u32,
+    len: u16,
+    flags: u16,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(FrameRingHeader) == 64);
+    std.debug.assert(@sizeOf(FrameDesc) == 8);
+}
+
+pub fn slotsOffset(entries: u32) usize {
+    const descs = 2 * @as(usize, entries) * @sizeOf(FrameDesc);
+    return std.mem.alignForward(usize, @sizeOf(FrameRingHeader) + descs, 64);
+}
+
+pub fn ringSize(entries: u32) usize {
+    return slotsOffset(entries) + 2 * @as(usize, entries) * SlotSize;
+}
+
+pub fn validEntries(entries: u32) bool {
+    return entries != 0 and entries <= MaxEntries and std.math.isPowerOfTwo(entries);
+}
+
+/// Which received frames a ring takes instead of the stack. ARP always
+/// stays with the stack, so UDP sockets keep resolving next hops and the
+/// guest keeps answering for its address.
+pub const Steer = struct {
+    /// Ethertype to match; 0 for any but ARP
+    ethertype: u16 = 0,
+    /// IPv4 UDP destination port to match; 0 for any
+    udp_port: u16 = 0,
+
+    pub fn valid(self: Steer) bool {
+        if (self.ethertype == ETHERTYPE_ARP) return false;
+        return self.udp_port == 0 or self.ethertype == 0 or self.ethertype == ETHERTYPE_IPV4;
+    }
+
+    pub fn matches(self: Steer, frame: []const u8) bool {
+        if (frame.len < 14) return false;
+        const ethertype = std.mem.readInt(u16, frame[12..14], .big);
+        if (ethertype == ETHERTYPE_ARP) return false;
+        if (self.ethertype != 0 and ethertype != self.ethertype) return false;
+        if (self.udp_port == 0) return true;
+
+        // Only unfragmented datagrams carry the port in every packet;
+        // fragments go to the stack for reassembly
+        if (ethertype != ETHERTYPE_IPV4 or frame.len < 14 + 20 + 8) return false;
+        const ip = frame[14..];
+        if (ip[0] >> 4 != 4 or ip[9] != PROTO_UDP) return false;
+        if (std.mem.readInt(u16, ip[6..8], .big) & 0x3FFF != 0) return false;
+        const ihl = @as(usize, ip[0] & 0x0F) * 4;
+        if (ihl < 20 or ip.len < ihl + 8) return false;
+        return std.mem.readInt(u16, ip[ihl + 2 ..][0..2], .big) == self.udp_port;
+    }
+};
+
+/// Descriptors taken off the TX ring by txPeek.
+pub const TxBatch = struct {
+    /// Descriptors to release, valid or not
+    consumed: u32 = 0,
+    /// Frames written to the caller's array
+    frames: u32 = 0,
+};
+
+pub const Ring = struct {
+    hdr: *FrameRingHeader,
+    rx: [*]FrameDesc,
+    tx: [*]FrameDesc,
+    slots: [*]u8,
+    mask: u32,
+
+    /// Initialise the header and descriptors in place. Caller validates
+    /// base/entries.
+    pub fn init(base: usize, entries: u32) Ring {
+        const hdr: *FrameRingHeader = @ptrFromInt(base);
+        hdr.* = .{
+            .rx_head = 0,
+            .rx_tail = 0,
+            .tx_head = 0,
+            .tx_tail = 0,
+            .entries = entries,
+            .slot_size = SlotSize,
+            .slots_offset = @intCast(slotsOffset(entries)),
+            .rx_dropped = 0,
+            .tx_errors = 0,
+            .reserved = [_]u32{0} ** 7,
+        };
+        const rx_base = base + @sizeOf(FrameRingHeader);
+        const ring = Ring{
+            .hdr = hdr,
+            .rx = @ptrFromInt(rx_base),
+            .tx = @ptrFromInt(rx_base + @as(usize, entries) * @sizeOf(FrameDesc)),
+            .slots = @ptrFromInt(base + slotsOffset(entries)),
+            .mask = entries - 1,
+        };
+        var i: u32 = 0;
+        while (i < entries) : (i += 1) {
+            ring.rx[i] = .{ .slot = i, .len = 0, .flags = 0 };
+            ring.tx[i] = .{ .slot = entries + i, .len = 0, .flags = 0 };
+        }
+        return ring;
+    }
+
+    /// Start of a slot; null if the index is out of range.
+    pub fn slot(self: *const Ring, index: u32) ?[*]u8 {
+        if (index >= 2 * (self.mask + 1)) return null;
+        return self.slots + @as(usize, index) * SlotSize;
+    }
+
+    /// Frames waiting for the workload.
+    pub fn rxPending(self: *const Ring) u32 {
+        const head = @atomicLoad(u32, &self.hdr.rx_head, .acquire);
+        return self.hdr.rx_tail -% head;
+    }
+
+    /// Copy a received frame into the slot of the next RX descriptor.
+    /// False, and counted in rx_dropped, if the ring is full, the frame is
+    /// longer than a slot or the descriptor names no slot.
+    pub fn rxPush(self: *Ring, frame: []const u8) bool {
+        if (self.rxPending() > self.mask or frame.len > SlotSize) return self.rxDrop();
+        const tail = self.hdr.rx_tail;
+        const desc = &self.rx[tail & self.mask];
+        const dst = self.slot(desc.slot) orelse return self.rxDrop();
+        @memcpy(dst[0..frame.len], frame);
+        desc.len = @intCast(frame.len);
+        desc.flags = 0;
+        @atomicStore(u32, &self.hdr.rx_tail, tail +% 1, .release);
+        return true;
+    }
+
+    fn rxDrop(self: *Ring) bool {
+        self.hdr.rx_dropped +%= 1;
+        return false;
+    }
+
+    /// Frames queued on the TX ring from tx_head, up to out.len of them.
+    /// Descriptors are copied before use so the workload cannot change
+    /// them underneath the device; bad ones are skipped and counted in
+    /// tx_errors. The frames stay in the workload's slots until txRelease.
+    pub fn txPeek(self: *Ring, out: [][]const u8) TxBatch {
+        const head = self.hdr.tx_head;
+        const tail = @atomicLoad(u32, &self.hdr.tx_tail, .acquire);
+        const queued = @min(tail -% head, self.mask + 1);
+        var batch = TxBatch{};
+        while (batch.consumed < queued and batch.frames < out.len) {
+            const desc = self.tx[(head +% batch.consumed) & self.mask];
+            batch.consumed += 1;
+            const src = self.slot(desc.slot) orelse {
+                self.hdr.tx_errors +%= 1;
+                continue;
+            };
+            if (desc.len == 0 or desc.len > SlotSize) {
+                self.hdr.tx_errors +%= 1;
+                continue;
+            }
+            out[batch.frames] = src[0..desc.len];
+            batch.frames += 1;
+        }
+        return batch;
+    }
+
+    /// Hand consumed TX descriptors back to the workload; failed of their
+    /// frames were not sent.
+    pub fn txRelease(self: *Ring, consumed: u32, failed: u32) void {
+        self.hdr.tx_errors +%= failed;
+        @atomicStore(u32, &self.hdr.tx_head, self.hdr.tx_head +% consumed, .release);
+    }
+};
+
+fn udpFrame(buf: []u8, dst_port: u16, flags_frag: u16) []u8 {
+    @memset(buf[0 .. 14 + 20 + 8], 0);
+    std.mem.writeInt(u16, buf[12..14], ETHERTYPE_IPV4, .big);
+    buf[14] = 0x45;
+    std.mem.writeInt(u16, buf[20..22], flags_frag, .big);
+    buf[23] = PROTO_UDP;
+    std.mem.writeInt(u16, buf[36..38], dst_port, .big);
+    return buf[0 .. 14 + 20 + 8];
+}
+
+test "steering by ethertype and UDP port, never ARP" {
+    var buf: [64]u8 = undefined;
+    const any = Steer{};
+    const port = Steer{ .udp_port = 9000 };
+    const ipv6 = Steer{ .ethertype = 0x86dd };
+
+    try std.testing.expect(any.valid() and port.valid() and ipv6.valid());
+    try std.testing.expect(!(Steer{ .ethertype = ETHERTYPE_ARP }).valid());
+    try std.testing.expect(!(Steer{ .ethertype = 0x86dd, .udp_port = 53 }).valid());
+
+    const dgram = udpFrame(&buf, 9000, 0x4000); // DF set
+    try std.testing.expect(any.matches(dgram));
+    try std.testing.expect(port.matches(dgram));
+    try std.testing.expect(!ipv6.matches(dgram));
+    try std.testing.expect(!(Steer{ .udp_port = 9001 }).matches(dgram));
+    // A first fragment carries the port but not the whole datagram
+    try std.testing.expect(!port.matches(udpFrame(&buf, 9000, 0x2000)));
+    try std.testing.expect(!any.matches(buf[0..13]));
+
+    std.mem.writeInt(u16, buf[12..14], ETHERTYPE_ARP, .big);
+    try std.testing.expect(!any.matches(&buf));
+    std.mem.writeInt(u16, buf[12..14], 0x86dd, .big);
+    try std.testing.expect(ipv6.matches(&buf));
+    try std.testing.expect(!port.matches(&buf));
+}
+
+test "rx push, tx peek and zero-copy slot swap" {
+    const entries: u32 = 4;
+    var mem: [ringSize(4)]u8 align(64) = undefined;
+    var ring = Ring.init(@intFromPtr(&mem), entries);
+    try std.testing.expectEqual(@as(u32, 128), ring.hdr.slots_offset);
+    try std.testing.expectEqual(@as(u32, 5), ring.tx[1].slot);
+
+    const frame = [_]u8{0x5a} ** 60;
+    var i: u32 = 0;
+    while (i < entries) : (i += 1) try std.testing.expect(ring.rxPush(&frame));
+    try std.testing.expect(!ring.rxPush(&frame));
+    try std.testing.expectEqual(@as(u32, 4), ring.rxPending());
+    try std.testing.expectEqualSlices(u8, &frame, ring.slot(ring.rx[2].slot).?[0..ring.rx[2].len]);
+
+    // Consume one and make room; an oversized frame or a bad slot drops
+    ring.hdr.rx_head = 1;
+    const big: [SlotSize + 1]u8 = undefined;
+    try std.testing.expect(!ring.rxPush(&big));
+    ring.rx[0].slot = 99;
+    try std.testing.expect(!ring.rxPush(&frame));
+    try std.testing.expectEqual(@as(u32, 3), ring.hdr.rx_dropped);
+    ring.rx[0].slot = 0;
+
+    // Forward RX descriptor 0 by swapping its slot into TX descriptor 0,
+    // next to one bad descriptor and one ordinary frame
+    std.mem.swap(u32, &ring.rx[0].slot, &ring.tx[0].slot);
+    ring.tx[0].len = ring.rx[0].len;
+    ring.tx[1].len = 0;
+    ring.tx[2].len = 42;
+    ring.hdr.tx_tail = 3;
+
+    var out: [2][]const u8 = undefined;
+    const batch = ring.txPeek(&out);
+    try std.testing.expectEqual(@as(u32, 3), batch.consumed);
+    try std.testing.expectEqual(@as(u32, 2), batch.frames);
+    try std.testing.expectEqual(@intFromPtr(ring.slot(0).?), @intFromPtr(out[0].ptr));
+    try std.testing.expectEqual(@as(usize, 42), out[1].len);
+    ring.txRelease(batch.consumed, 1);
+    try std.testing.expectEqual(@as(u32, 3), ring.hdr.tx_head);
+    try std.testing.expectEqual(@as(u32, 2), ring.hdr.tx_errors);
+    try std.testing.expectEqual(@as(u32, 0), ring.txPeek(&out).consumed);
+}
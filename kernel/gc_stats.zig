@@ -0,0 +1,118 @@
+// MicroPython GC telemetry.
+//
+// mp_bridge's gc_collect records every collection here: the TSC length of
+// the pause (in the same log-linear histogram as the ABI call stats), bytes
+// reclaimed, and heap occupancy before/after. Heap growth through the
+// split-heap hook is counted too. Exposed as ukernel.gc_stats(), as "gc"
+// spans in the trace ring, and as one "#G" line on serial when the
+// interpreter exits:
+//
+//   #G collections=<n> pause_p50_ns=<ns> pause_p99_ns=<ns> pause_max_ns=<ns>
+//      reclaimed=<bytes> used=<bytes> total=<bytes> peak=<bytes> areas=<n>
+
+const std = @import("std");
+const abi_stats = @import("abi_stats.zig");
+const clock = @import("clock.zig");
+
+pub const GcStats = struct {
+    pauses: abi_stats.CallStats = .{},
+    reclaimed_total: u64 = 0,
+    last_reclaimed: u64 = 0,
+    /// Heap bytes across all areas, and bytes in use after the last event
+    heap_total: u64 = 0,
+    heap_used: u64 = 0,
+    heap_peak_used: u64 = 0,
+    areas: u32 = 0,
+    grow_failures: u32 = 0,
+
+    pub fn recordCollection(self: *GcStats, cycles: u64, used_before: u64, used_after: u64) void {
+        abi_stats.record(&self.pauses, 0, cycles);
+        self.last_reclaimed = used_before -| used_after;
+        self.reclaimed_total +%= self.last_reclaimed;
+        if (used_before > self.heap_peak_used) self.heap_peak_used = used_before;
+        self.heap_used = used_after;
+    }
+
+    pub fn recordArea(self: *GcStats, bytes: u64) void {
+        self.heap_total += bytes;
+        self.areas += 1;
+    }
+
+    pub fn collections(self: *const GcStats) u64 {
+        return self.pauses.calls;
+    }
+};
+
+/// C view of the counters, filled by kernel_gc_stats for ukernel.gc_stats().
+pub const GcStatsOut = extern struct {
+    collections: u64,
+    pause_total_ns: u64,
+    pause_max_ns: u64,
+    pause_p50_ns: u64,
+    pause_p99_ns: u64,
+    reclaimed_bytes: u64,
+    last_reclaimed_bytes: u64,
+    heap_total: u64,
+    heap_used: u64,
+    heap_peak_used: u64,
+    heap_limit: u64,
+    areas: u32,
+    grow_failures: u32,
+};
+
+pub fn snapshot(s: *const GcStats, heap_limit: u64) GcStatsOut {
+    return .{
+        .collections = s.collections(),
+        .pause_total_ns = clock.tscToNs(s.pauses.total_cycles),
+        .pause_max_ns = clock.tscToNs(s.pauses.max_cycles),
+        .pause_p50_ns = clock.tscToNs(abi_stats.percentile(&s.pauses, 500)),
+        .pause_p99_ns = clock.tscToNs(abi_stats.percentile(&s.pauses, 990)),
+        .reclaimed_bytes = s.reclaimed_total,
+        .last_reclaimed_bytes = s.last_reclaimed,
+        .heap_total = s.heap_total,
+        .heap_used = s.heap_used,
+        .heap_peak_used = s.heap_peak_used,
+        .heap_limit = heap_limit,
+        .areas = s.areas,
+        .grow_failures = s.grow_failures,
+    };
+}
+
+/// The "#G" summary line.
+pub fn format(s: *const GcStats, buf: []u8) []const u8 {
+    const out = snapshot(s, 0);
+    return std.fmt.bufPrint(
+        buf,
+        "#G collections={d} pause_p50_ns={d} pause_p99_ns={d} pause_max_ns={d} reclaimed={d} used={d} total={d} peak={d} areas={d}\n",
+        .{ out.collections, out.pause_p50_ns, out.pause_p99_ns, out.pause_max_ns, out.reclaimed_bytes, out.heap_used, out.heap_total, out.heap_peak_used, out.areas },
+    ) catch buf[0..0];
+}
+
+test "gc stats track pauses, reclaimed bytes and occupancy" {
+    const saved_hz = clock.frequency();
+    const saved_src = clock.calibrationSource();
+    defer clock.setFrequency(saved_hz, saved_src);
+    clock.setFrequency(1_000_000_000, saved_src);
+
+    var s = GcStats{};
+    s.recordArea(64 * 1024);
+    s.recordCollection(1000, 60_000, 20_000);
+    s.recordArea(128 * 1024);
+    s.recordCollection(3000, 150_000, 150_500);
+
+    try std.testing.expectEqual(@as(u64, 2), s.collections());
+    try std.testing.expectEqual(@as(u64, 40_000), s.reclaimed_total);
+    try std.testing.expectEqual(@as(u64, 0), s.last_reclaimed);
+    try std.testing.expectEqual(@as(u64, 150_000), s.heap_peak_used);
+    try std.testing.expectEqual(@as(u32, 2), s.areas);
+
+    const out = snapshot(&s, 1 << 20);
+    try std.testing.expectEqual(@as(u64, 3000), out.pause_max_ns);
+    try std.testing.expectEqual(@as(u64, 4000), out.pause_total_ns);
+    try std.testing.expectEqual(@as(u64, 192 * 1024), out.heap_total);
+
+    var buf: [256]u8 = undefined;
+    const line = format(&s, buf[0..]);
+    try std.testing.expect(std.mem.startsWith(u8, line, "#G collections=2 "));
+    try std.testing.expect(std.mem.endsWith(u8, line, " areas=2\n"));
+}
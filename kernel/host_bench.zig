@@ -0,0 +1,155 @@
+// Driver microbenchmarks on the host (`zig build bench`).
+//
+// The virtio drivers, the network stack and the tar reader run against the
+// device models in virtio_mock.zig, so their per-request cost (ring
+// bookkeeping, copies, header parsing) can be measured without a VM. The
+// numbers exclude VM exits and device latency; use `ukernel bench` for
+// those. Output uses the guest bench format:
+//
+//   #M host.<name> ops=N op_ns=X op_cycles=Y
+
+const std = @import("std");
+const clock = @import("clock.zig");
+const virtio_mock = @import("virtio_mock.zig");
+const virtio_blk = @import("virtio_blk.zig");
+const virtio_net = @import("virtio_net.zig");
+const net = @import("net.zig");
+const tar = @import("tar.zig");
+
+/// Route virtio MMIO to the device models (see config.hosted)
+pub const ukernel_hosted = true;
+
+const DiskSize = 1024 * 1024;
+const GuestMac = [6]u8{ 0xaa, 0xfc, 0, 0, 0, 1 };
+const Payload = [_]u8{0x5a} ** 64;
+
+var disk: [DiskSize]u8 align(512) = undefined;
+var buf: [64 * 1024]u8 align(512) = undefined;
+var out: std.fs.File.Writer = undefined;
+
+fn calibrate() !void {
+    const ns0 = std.time.nanoTimestamp();
+    const tsc0 = clock.rdtsc();
+    std.time.sleep(50 * std.time.ns_per_ms);
+    const ns = std.time.nanoTimestamp() - ns0;
+    const ticks = clock.rdtsc() - tsc0;
+    if (ns <= 0 or ticks == 0) return error.NoTsc;
+    clock.setFrequency(@intCast(@as(u128, ticks) * std.time.ns_per_s / @as(u128, @intCast(ns))), .host);
+}
+
+fn report(name: []const u8, ops: u64, cycles: u64) !void {
+    try out.print("#M host.{s} ops={d} op_ns={d} op_cycles={d}\n", .{
+        name, ops, clock.tscToNs(cycles) / ops, cycles / ops,
+    });
+}
+
+fn blkSuite() !void {
+    for (&disk, 0..) |*b, i| b.* = @truncate(i *% 131);
+    _ = virtio_mock.addBlk(&disk);
+    if (!virtio_blk.init()) return error.BlkInit;
+
+    const cases = [_]struct { name: []const u8, sectors: u32, ops: u64 }{
+        .{ .name = "blk.read_4k", .sectors = 8, .ops = 20_000 },
+        .{ .name = "blk.read_64k", .sectors = 128, .ops = 2_000 },
+    };
+    const sectors_total = DiskSize / 512;
+    for (cases) |case| {
+        const t0 = clock.rdtsc();
+        for (0..case.ops) |i| {
+            const sector = (i * case.sectors) % (sectors_total - case.sectors);
+            if (!virtio_blk.startRead(sector, case.sectors, &buf) or !virtio_blk.waitRead()) return error.BlkRead;
+        }
+        try report(case.name, case.ops, clock.rdtsc() - t0);
+    }
+
+    // Synchronous path: one request per sector
+    const ops = 20_000;
+    const t0 = clock.rdtsc();
+    for (0..ops) |i| {
+        if (!virtio_blk.readSectors(i % sectors_total, 1, &buf)) return error.BlkRead;
+    }
+    try report("blk.read_sector", ops, clock.rdtsc() - t0);
+}
+
+/// A small archive at the start of the disk; the looked-up file is last.
+fn writeArchive() void {
+    @memset(&disk, 0);
+    const names = [_][]const u8{ "lib/a.py", "lib/b.py", "lib/c.py", "main.py" };
+    var offset: usize = 0;
+    for (names) |name| {
+        const hdr = disk[offset .. offset + 512];
+        @memcpy(hdr[0..name.len], name);
+        _ = std.fmt.bufPrint(hdr[124..135], "{o:0>11}", .{1000}) catch unreachable;
+        hdr[156] = '0';
+        @memset(disk[offset + 512 .. offset + 512 + 1000], 'x');
+        offset += 512 + 1024;
+    }
+}
+
+fn tarSuite() !void {
+    writeArchive();
+    const ops = 2_000;
+    var t0 = clock.rdtsc();
+    for (0..ops) |_| {
+        if (tar.findFile("main.py") == null) return error.TarLookup;
+    }
+    try report("tar.find_sync", ops, clock.rdtsc() - t0);
+
+    tar.prefetchStart();
+    t0 = clock.rdtsc();
+    for (0..ops) |_| {
+        if (tar.findFile("main.py") == null) return error.TarLookup;
+    }
+    try report("tar.find_prefetched", ops, clock.rdtsc() - t0);
+}
+
+fn netSuite() !void {
+    const dev = virtio_mock.addNet(GuestMac, .gateway);
+    if (!virtio_net.init()) return error.NetInit;
+    net.udpSocketInit(0);
+    defer net.udpSocketClose(0);
+    if (!net.udpBind(0, 5000) or !net.udpConnect(0, net.GATEWAY_IP, 7)) return error.NetSocket;
+    var rx: [256]u8 = undefined;
+
+    // Round trip through the gateway's echo; the first one resolves ARP
+    if (!net.udpSend(0, &Payload)) return error.NetSend;
+    net.processIncoming();
+    _ = net.udpRecv(0, &rx);
+    const ops = 20_000;
+    var t0 = clock.rdtsc();
+    for (0..ops) |_| {
+        if (!net.udpSend(0, &Payload)) return error.NetSend;
+        net.processIncoming();
+        if (net.udpRecv(0, &rx) == null) return error.NetRecv;
+    }
+    try report("net.udp_echo", ops, clock.rdtsc() - t0);
+
+    // Transmit only: the peer just records the frame
+    dev.peer = .capture;
+    t0 = clock.rdtsc();
+    for (0..ops) |_| {
+        if (!net.udpSend(0, &Payload)) return error.NetSend;
+    }
+    try report("net.udp_tx", ops, clock.rdtsc() - t0);
+
+    // Receive only: one frame in the backlog, delivered on the repost
+    const frame = dev.lastTx();
+    t0 = clock.rdtsc();
+    for (0..ops) |_| {
+        if (!virtio_mock.injectRx(dev, frame)) return error.NetRecv;
+        if (virtio_net.rxPoll() == null) return error.NetRecv;
+    }
+    try report("net.rx_poll", ops, clock.rdtsc() - t0);
+}
+
+pub fn main() !void {
+    out = std.io.getStdOut().writer();
+    try calibrate();
+    try out.print("#M host.clock tsc_hz={d}\n", .{clock.frequency()});
+
+    virtio_mock.reset();
+    try blkSuite();
+    try tarSuite();
+    try netSuite();
+    try out.writeAll("#M done\n");
+}
@@ -0,0 +1,149 @@
+// Submission/completion rings shared with the workload.
+//
+// Layout at the base address passed to io_ring_setup:
+//   RingHeader                 64 bytes
+//   Sqe[sq_entries]            submission queue
+//   Cqe[cq_entries]            completion queue (2 * sq_entries)
+//
+// The workload writes SQEs at sq_tail and advances it; the kernel consumes
+// from sq_head. The kernel posts CQEs at cq_tail; the workload reaps from
+// cq_head. Indices are free-running u32s masked by entries - 1, so entry
+// counts must be powers of two.
+
+const std = @import("std");
+
+pub const OP_NOP: u8 = 0;
+pub const OP_READ: u8 = 1;
+pub const OP_WRITE: u8 = 2;
+pub const OP_SEND: u8 = 3;
+pub const OP_RECV: u8 = 4;
+pub const OP_TIMEOUT: u8 = 5;
+pub const OP_POLL: u8 = 6;
+
+pub const MaxEntries: u32 = 256;
+
+pub const RingHeader = extern struct {
+    sq_head: u32,
+    sq_tail: u32,
+    cq_head: u32,
+    cq_tail: u32,
+    sq_entries: u32,
+    cq_entries: u32,
+    reserved: [10]u32,
+};
+
+pub const Sqe = extern struct {
+    opcode: u8,
+    flags: u8,
+    reserved0: u16,
+    op_flags: u32,
+    handle: u64,
+    addr: u64,
+    len: u64,
+    // TIMEOUT: relative ns; POLL: event mask
+    arg: u64,
+    user_data: u64,
+};
+
+pub const Cqe = extern struct {
+    user_data: u64,
+    // Bytes transferred, or ready events for POLL
+    value: u64,
+    result: u32,
+    flags: u32,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(RingHeader) == 64);
+    std.debug.assert(@sizeOf(Sqe) == 48);
+    std.debug.assert(@sizeOf(Cqe) == 24);
+}
+
+pub fn ringSize(entries: u32) usize {
+    return @sizeOf(RingHeader) + @as(usize, entries) * @sizeOf(Sqe) + @as(usize, entries) * 2 * @sizeOf(Cqe);
+}
+
+pub fn validEntries(entries: u32) bool {
+    return entries != 0 and entries <= MaxEntries and std.math.isPowerOfTwo(entries);
+}
+
+pub const Ring = struct {
+    hdr: *RingHeader,
+    sqes: [*]Sqe,
+    cqes: [*]Cqe,
+    sq_mask: u32,
+    cq_mask: u32,
+
+    /// Initialise the header in place. Caller validates base/entries.
+    pub fn init(base: usize, entries: u32) Ring {
+        const hdr: *RingHeader = @ptrFromInt(base);
+        hdr.* = .{
+            .sq_head = 0,
+            .sq_tail = 0,
+            .cq_head = 0,
+            .cq_tail = 0,
+            .sq_entries = entries,
+            .cq_entries = entries * 2,
+            .reserved = [_]u32{0} ** 10,
+        };
+        const sq_base = base + @sizeOf(RingHeader);
+        const cq_base = sq_base + @as(usize, entries) * @sizeOf(Sqe);
+        return .{
+            .hdr = hdr,
+            .sqes = @ptrFromInt(sq_base),
+            .cqes = @ptrFromInt(cq_base),
+            .sq_mask = entries - 1,
+            .cq_mask = entries * 2 - 1,
+        };
+    }
+
+    /// Copy out the next submission so the workload cannot change it while
+    /// the kernel works on it.
+    pub fn nextSqe(self: *Ring) ?Sqe {
+        const head = self.hdr.sq_head;
+        const tail = @atomicLoad(u32, &self.hdr.sq_tail, .acquire);
+        if (head == tail) return null;
+        const sqe = self.sqes[head & self.sq_mask];
+        @atomicStore(u32, &self.hdr.sq_head, head +% 1, .release);
+        return sqe;
+    }
+
+    pub fn cqFree(self: *const Ring) u32 {
+        const head = @atomicLoad(u32, &self.hdr.cq_head, .acquire);
+        const used = self.hdr.cq_tail -% head;
+        const cap = self.cq_mask + 1;
+        return if (used >= cap) 0 else cap - used;
+    }
+
+    pub fn postCqe(self: *Ring, cqe: Cqe) bool {
+        if (self.cqFree() == 0) return false;
+        const tail = self.hdr.cq_tail;
+        self.cqes[tail & self.cq_mask] = cqe;
+        @atomicStore(u32, &self.hdr.cq_tail, tail +% 1, .release);
+        return true;
+    }
+};
+
+test "ring submit and complete round trip" {
+    const entries: u32 = 4;
+    var mem: [ringSize(4)]u8 align(8) = undefined;
+    var ring = Ring.init(@intFromPtr(&mem), entries);
+
+    try std.testing.expect(ring.nextSqe() == null);
+    ring.sqes[0] = std.mem.zeroes(Sqe);
+    ring.sqes[0].user_data = 99;
+    ring.hdr.sq_tail = 1;
+
+    const sqe = ring.nextSqe().?;
+    try std.testing.expectEqual(@as(u64, 99), sqe.user_data);
+    try std.testing.expect(ring.nextSqe() == null);
+
+    try std.testing.expectEqual(@as(u32, 8), ring.cqFree());
+    var i: u32 = 0;
+    while (i < 8) : (i += 1) {
+        try std.testing.expect(ring.postCqe(.{ .user_data = i, .value = 0, .result = 0, .flags = 0 }));
+    }
+    try std.testing.expect(!ring.postCqe(.{ .user_data = 8, .value = 0, .result = 0, .flags = 0 }));
+    ring.hdr.cq_head = 3;
+    try std.testing.expectEqual(@as(u32, 3), ring.cqFree());
+}
@@ -20,7 +20,7 @@ typedef struct block_header {
     size_t size;          /* usable size (not including header) */
     struct block_header *next_free;  /* NULL if in-use */
     size_t magic;         /* 0xDEADBEEF when allocated */
-    size_t _pad;          /* alignment padding */
+    size_t reported;      /* free block's pages handed to the host */
 } block_header_t;
 
 #define BLOCK_MAGIC 0xDEADBEEFUL
@@ -30,6 +30,18 @@ typedef struct block_header {
 static size_t heap_offset = 0;
 static block_header_t *free_list = NULL;
 
+#define LIBC_PAGE_SIZE 4096
+
+/* Whole pages inside a free block, past its header (kept resident) */
+static void block_pages(block_header_t *blk, uintptr_t *start, uintptr_t *end) {
+    uintptr_t data = (uintptr_t)blk + HEADER_SIZE;
+    *start = (data + LIBC_PAGE_SIZE - 1) & ~(uintptr_t)(LIBC_PAGE_SIZE - 1);
+    *end = (data + blk->size) & ~(uintptr_t)(LIBC_PAGE_SIZE - 1);
+    if (*end < *start) *end = *start;
+}
+
+extern void kernel_mem_reclaimed(size_t pages);
+
 void *malloc(size_t size) {
     if (size == 0) size = 1;
     size = ALIGN16(size);
@@ -42,6 +54,12 @@ void *malloc(size_t size) {
             *prev = blk->next_free;
             blk->next_free = NULL;
             blk->magic = BLOCK_MAGIC;
+            if (blk->reported) {
+                uintptr_t start, end;
+                block_pages(blk, &start, &end);
+                kernel_mem_reclaimed((end - start) / LIBC_PAGE_SIZE);
+                blk->reported = 0;
+            }
             return (char *)blk + HEADER_SIZE;
         }
         prev = &blk->next_free;
@@ -57,7 +75,7 @@ void *malloc(size_t size) {
     hdr->size = size;
     hdr->next_free = NULL;
     hdr->magic = BLOCK_MAGIC;
-    hdr->_pad = 0;
+    hdr->reported = 0;
     heap_offset += needed;
     return (char *)hdr + HEADER_SIZE;
 }
@@ -71,6 +89,23 @@ void free(void *ptr) {
     free_list = hdr;
 }
 
+/* Free page reporting (kernel/balloon.zig): pass the whole pages of each
+ * free block of at least min_bytes to report(), once per time the block is
+ * freed. Returns the number of blocks reported. */
+size_t libc_report_free(size_t min_bytes, void (*report)(uintptr_t start, uintptr_t end)) {
+    size_t count = 0;
+    for (block_header_t *blk = free_list; blk; blk = blk->next_free) {
+        if (blk->reported) continue;
+        uintptr_t start, end;
+        block_pages(blk, &start, &end);
+        if (end - start < min_bytes) continue;
+        report(start, end);
+        blk->reported = 1;
+        count++;
+    }
+    return count;
+}
+
 void *realloc(void *ptr, size_t size) {
     if (!ptr) return malloc(size);
     if (size == 0) { free(ptr); return NULL; }
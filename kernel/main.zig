@@ -4,8 +4,16 @@ const abi = @import("abi.zig");
 const workload = @import("workload.zig");
 const mp_bridge = @import("mp_bridge.zig");
 const virtio_blk = @import("virtio_blk.zig");
-const virtio_net = @import("virtio_net.zig");
 const tar = @import("tar.zig");
+const rootfs = @import("rootfs.zig");
+const clock = @import("clock.zig");
+const trace = @import("trace.zig");
+const pcap = @import("pcap.zig");
+const config = @import("config.zig");
+const boottime = @import("boottime.zig");
+const bench = @import("bench.zig");
+const disk_log = @import("disk_log.zig");
+const balloon = @import("balloon.zig");
 
 const WorkloadPolicy = struct {
     id: u32,
@@ -20,7 +28,9 @@ const policies = [_]WorkloadPolicy{
             (1 << (abi.CAP_TASK - 1)) |
             (1 << (abi.CAP_MEM - 1)) |
             (1 << (abi.CAP_IO - 1)) |
-            (1 << (abi.CAP_NET - 1)),
+            (1 << (abi.CAP_NET - 1)) |
+            (1 << (abi.CAP_TRACE - 1)) |
+            (1 << (abi.CAP_NET_RAW - 1)),
     },
 };
 
@@ -37,10 +47,13 @@ fn panicHandler(msg: []const u8, _: ?*std.builtin.StackTrace, _: ?usize) noretur
     serial.writeAll("panic: ");
     serial.writeAll(msg);
     serial.writeAll("\n");
+    trace.flush();
+    pcap.flush();
     haltForever();
 }
 
 fn haltForever() noreturn {
+    serial.flush();
     while (true) {
         asm volatile ("hlt");
     }
@@ -86,38 +99,118 @@ fn mapMmioRegion() void {
     writeCr3(cr3);
 }
 
-export fn kernelMain() noreturn {
-    _ = abi;
-    serial.init();
-    serial.writeAll("Cloud uKernel: booting...\n");
+fn enterPolicyCaps(mask: u32) void {
+    var caps: [abi.CAP_NET_RAW]abi.handle_t = undefined;
+    var count: u32 = 0;
+    var kind: u32 = abi.CAP_LOG;
+    while (kind <= abi.CAP_NET_RAW) : (kind += 1) {
+        if ((mask & (@as(u32, 1) << @intCast(kind - 1))) == 0) continue;
+        if (abi.cap_acquire(kind, &caps[count]) == abi.OK) count += 1;
+    }
+    if (abi.cap_enter(&caps[0], count) != abi.OK) {
+        serial.writeAll("kernel: cap_enter for workload policy failed\n");
+    }
+}
 
-    // Map MMIO region before virtio probing
-    mapMmioRegion();
+fn runPython(has_rootfs: bool) void {
+    // A frozen entrypoint replaces the rootfs one, so skip the read
+    const use_rootfs = config.blk and has_rootfs and config.frozen_entry.len == 0;
 
-    const policy_mask = policyFor(workload.WorkloadId);
-    abi.resetCapsForWorkload(policy_mask);
-    workload.workloadMain();
+    // Start reading the rootfs now so the device transfer overlaps heap and
+    // qstr setup; the rootfs index below waits for it.
+    if (use_rootfs and !config.bench) tar.prefetchStart();
+
+    var stack_top: u8 = 0;
+    mp_bridge.initMicroPython(@intFromPtr(&stack_top));
 
-    // Initialize virtio block device
-    const has_rootfs = virtio_blk.init();
+    if (config.bench) {
+        mp_bridge.runSource(bench.python_source);
+        return;
+    }
 
-    // Initialize virtio network device
-    _ = virtio_net.init();
+    if (config.frozen_entry.len > 0) {
+        if (mp_bridge.runFrozen(config.frozen_entry.ptr)) return;
+        serial.writeAll("micropython: frozen entrypoint missing\n");
+    }
 
-    // Try to load Python source from rootfs tar
-    var py_source: ?[]const u8 = null;
-    if (has_rootfs) {
-        py_source = tar.findFile("src/main.py");
-        if (py_source != null) {
+    // Load the entrypoint from the rootfs, bytecode before source; the
+    // same index serves the workload's imports
+    var entry: ?[]const u8 = null;
+    if (use_rootfs) {
+        if (rootfs.open("src/main.mpy")) |mpy| {
+            entry = mpy;
+            serial.writeAll("micropython: loaded src/main.mpy from rootfs\n");
+        } else if (rootfs.open("src/main.py")) |source| {
+            entry = source;
             serial.writeAll("micropython: loaded src/main.py from rootfs\n");
         } else {
             serial.writeAll("micropython: src/main.py not found in rootfs\n");
         }
+        boottime.mark(.rootfs);
+    }
+    if (entry == null and config.entry_source.len > 0) {
+        entry = config.entry_source;
+        serial.writeAll("micropython: using embedded entrypoint\n");
     }
 
-    // Run MicroPython with loaded source or fallback demo
-    const source = py_source orelse "print('hello from micropython')";
-    mp_bridge.runMicroPython(source);
+    // Run MicroPython with the loaded entrypoint or fallback demo
+    const code = entry orelse "print('hello from micropython')";
+    if (mp_bridge.isBytecode(code)) {
+        mp_bridge.runBytecode(code);
+    } else {
+        mp_bridge.runSource(code);
+    }
+}
+
+export fn kernelMain() noreturn {
+    boottime.mark(.kernel_main);
+    boottime.captureEntry();
+    _ = abi;
+    serial.init();
+    serial.writeAll("Cloud uKernel: booting...\n");
+    boottime.mark(.serial);
+
+    // Calibrate the TSC before anything reads the clock
+    clock.init();
+    boottime.mark(.clock);
+
+    // Map MMIO region before virtio probing. The balloon is only a few
+    // register accesses, so it is set up here too.
+    if (config.blk or config.net or config.balloon) mapMmioRegion();
+    if (config.balloon) _ = balloon.init();
+    boottime.mark(.mmio);
 
+    const policy_mask = policyFor(workload.WorkloadId);
+    abi.resetCapsForWorkload(policy_mask);
+    if (config.demo_workload and !config.bench) {
+        workload.workloadMain();
+    } else {
+        // The demo workload normally leaves its sandbox active for the
+        // runtime; without it, enter the workload's policy directly.
+        enterPolicyCaps(policy_mask);
+    }
+    boottime.mark(.workload);
+
+    // Initialize virtio block device; the rootfs read itself is started
+    // asynchronously by runPython. virtio-net is brought up on the first
+    // net_socket call (net.ensureDevice) rather than here.
+    const has_rootfs = if (config.blk) virtio_blk.init() else false;
+    // The record log lives on a second drive, if one is attached
+    if (config.disk_log) _ = disk_log.mount();
+    if (config.blk) boottime.mark(.blk);
+
+    // Benchmark builds measure the kernel before MicroPython claims the
+    // page pool, then run the interpreter loops in place of the workload
+    if (config.bench) bench.run();
+
+    // MicroPython emits the timeline at its first bytecode; this covers
+    // builds without it and scripts that fail to compile.
+    if (config.micropython) runPython(has_rootfs);
+    boottime.emit();
+    if (config.bench) bench.finish();
+
+    if (config.disk_log) _ = disk_log.sync();
+    trace.flush();
+    pcap.flush();
     haltForever();
 }
@@ -1,22 +1,28 @@
+const std = @import("std");
 const serial = @import("serial.zig");
+const clock = @import("clock.zig");
 const builtin = @import("builtin");
+const config = @import("config.zig");
+const boottime = @import("boottime.zig");
+const rootfs = @import("rootfs.zig");
+const exec_arena = @import("exec_arena.zig");
+const pages = @import("pages.zig");
+const gc_stats = @import("gc_stats.zig");
+const trace = @import("trace.zig");
+const balloon = @import("balloon.zig");
 
 // --- Exported functions for MicroPython C code to call ---
 
 export fn serial_write_bytes(ptr: ?[*]const u8, len: usize) callconv(.c) void {
     const p = ptr orelse return;
     if (len == 0) return;
-    for (p[0..len]) |b| {
-        if (b == '\n') {
-            serial.writeByte('\r');
-        }
-        serial.writeByte(b);
-    }
+    serial.writeAll(p[0..len]);
 }
 
 export fn serial_read_byte() callconv(.c) u8 {
     // Block until data available
     while (!serial.rxReady()) {
+        serial.pump();
         if (comptime builtin.cpu.arch == .x86_64) {
             asm volatile ("pause");
         }
@@ -25,61 +31,222 @@ export fn serial_read_byte() callconv(.c) u8 {
 }
 
 export fn kernel_ticks_ms() callconv(.c) u64 {
-    // rdtsc-based milliseconds (approximate: assume ~2GHz TSC)
-    if (comptime builtin.cpu.arch == .x86_64) {
-        var lo: u32 = 0;
-        var hi: u32 = 0;
-        asm volatile ("rdtsc"
-            : [lo] "={eax}" (lo),
-              [hi] "={edx}" (hi),
-        );
-        const tsc = (@as(u64, hi) << 32) | @as(u64, lo);
-        return tsc / 2_000_000; // ~2GHz TSC -> ms
-    }
-    return 0;
+    return clock.nowNs() / 1_000_000;
+}
+
+export fn kernel_ticks_us() callconv(.c) u64 {
+    return clock.nowNs() / 1_000;
 }
 
 // --- MicroPython C API declarations ---
 // Use opaque pointers to avoid Zig struct type mismatches with C types
 
 extern fn mp_init() callconv(.c) void;
+extern fn mp_port_init() callconv(.c) void;
 extern fn mp_deinit() callconv(.c) void;
 
 // do_str implemented in C to avoid complex Zig-C interop
 extern fn mp_do_str(src: [*]const u8, len: usize) callconv(.c) void;
+// Precompiled entrypoints: .mpy from mpy-cross, or frozen into the image
+extern fn mp_do_mpy(buf: [*]const u8, len: usize) callconv(.c) void;
+extern fn mp_do_frozen(name: [*:0]const u8) callconv(.c) c_int;
 
 // GC
 extern fn gc_init(start: [*]u8, end: [*]u8) callconv(.c) void;
 extern fn gc_collect_start() callconv(.c) void;
 extern fn gc_collect_root(ptrs: *anyopaque, len: usize) callconv(.c) void;
 extern fn gc_collect_end() callconv(.c) void;
+// gc_info wrapper in mp_main.c: bytes in use, total heap bytes
+extern fn mp_port_heap_used(total_out: *usize) callconv(.c) usize;
+
+// GC heap areas, from the kernel page pool. The heap starts at
+// -Dmp-heap-init-kb and MicroPython's split-heap support adds areas (via
+// mp_port_alloc_heap) when an allocation fails after a collection, up to
+// -Dmp-heap-kb in total.
+const MaxHeapAreas = 32;
+var heap_areas: [MaxHeapAreas][]u8 = undefined;
+var heap_area_count: usize = 0;
+var heap_bytes: usize = 0;
+
+pub var stats: gc_stats.GcStats = .{};
+var gc_trace_name: u16 = 0;
 
-// GC heap — separate from kernel ABI heap and libc shim heap
-var mp_gc_heap: [4 * 1024 * 1024]u8 align(16) = undefined;
+fn addHeapArea(bytes: usize) ?[]u8 {
+    if (heap_area_count >= MaxHeapAreas) return null;
+    const area = pages.pool.alloc(pages.pagesFor(bytes)) orelse return null;
+    heap_areas[heap_area_count] = area;
+    heap_area_count += 1;
+    heap_bytes += area.len;
+    stats.recordArea(area.len);
+    return area;
+}
+
+fn releaseHeap() void {
+    for (heap_areas[0..heap_area_count]) |area| pages.pool.free(area);
+    heap_area_count = 0;
+    heap_bytes = 0;
+}
 
 // Stack top for GC root scanning
 var stack_top_ptr: usize = 0;
 
-pub fn runMicroPython(source: []const u8) void {
+/// Set up the GC heap and interpreter state. Split from runSource so the
+/// boot sequence can overlap it with the rootfs read. Call from the frame
+/// that will call runSource: its stack top bounds GC root scanning.
+pub fn initMicroPython(stack_top: usize) void {
     serial.writeAll("micropython: init\n");
 
     // Record stack top for GC
-    var stack_dummy: u8 = 0;
-    stack_top_ptr = @intFromPtr(&stack_dummy);
+    stack_top_ptr = stack_top;
 
-    // Initialize GC heap
-    const heap_start: [*]u8 = @ptrCast(&mp_gc_heap);
-    const heap_end: [*]u8 = @ptrFromInt(@intFromPtr(heap_start) + mp_gc_heap.len);
-    gc_init(heap_start, heap_end);
+    // Initialize GC heap with its first area
+    stats = .{};
+    const area = addHeapArea(@min(config.mp_heap_init_size, config.mp_heap_size)) orelse {
+        serial.writeAll("micropython: no pages for the GC heap\n");
+        return;
+    };
+    gc_init(area.ptr, area.ptr + area.len);
     mp_init();
+    mp_port_init();
+    boottime.mark(.mp_init);
+}
+
+/// Compile and run source, then tear the interpreter down.
+pub fn runSource(source: []const u8) void {
     mp_do_str(source.ptr, source.len);
-    mp_deinit();
+    finish();
+}
 
+/// Run .mpy bytecode; nothing is parsed or compiled at boot.
+pub fn runBytecode(mpy: []const u8) void {
+    mp_do_mpy(mpy.ptr, mpy.len);
+    finish();
+}
+
+/// Run a module frozen into the image (-Dfrozen-content). Returns false,
+/// with the interpreter left up, if the image has no such module.
+pub fn runFrozen(name: [*:0]const u8) bool {
+    if (mp_do_frozen(name) == 0) return false;
+    finish();
+    return true;
+}
+
+/// .mpy format version emitted by the matching mpy-cross
+const MpyVersion: u8 = 6;
+
+/// True if the file is .mpy bytecode rather than source.
+pub fn isBytecode(data: []const u8) bool {
+    return data.len >= 4 and data[0] == 'M' and data[1] == MpyVersion;
+}
+
+fn finish() void {
+    var buf: [256]u8 = undefined;
+    serial.writeAll(gc_stats.format(&stats, buf[0..]));
+    mp_deinit();
+    releaseHeap();
+    exec_arena.arena.reset();
     serial.writeAll("micropython: done\n");
 }
 
-// GC collect — called by MicroPython's gc_collect
+// Called by mp_do_str/mp_do_mpy/mp_do_frozen right before the first
+// workload bytecode runs
+export fn boot_workload_ready() callconv(.c) void {
+    boottime.mark(.compile);
+    boottime.emit();
+}
+
+// Rootfs lookups for imports (mp_import_stat, mp_lexer_new_from_file,
+// mp_reader_new_file)
+export fn rootfs_stat(path: [*:0]const u8) callconv(.c) c_int {
+    return @intFromEnum(rootfs.importStat(std.mem.span(path)));
+}
+
+export fn rootfs_open(path: [*:0]const u8, len_out: *usize) callconv(.c) ?[*]const u8 {
+    const data = rootfs.open(std.mem.span(path)) orelse return null;
+    len_out.* = data.len;
+    return data.ptr;
+}
+
+// Native emitter code memory (mp_port_alloc_exec / mp_port_free_exec)
+export fn kernel_exec_alloc(min_size: usize, size_out: *usize) callconv(.c) ?*anyopaque {
+    const block = exec_arena.arena.alloc(min_size) orelse return null;
+    size_out.* = block.len;
+    return block.ptr;
+}
+
+export fn kernel_exec_free(ptr: ?*anyopaque, size: usize) callconv(.c) void {
+    const p = ptr orelse return;
+    exec_arena.arena.free(@ptrCast(p), size);
+}
+
+// Free page reporting (kernel/balloon.zig). mp_port_scan_gc_pages walks
+// the GC allocation tables and calls kernel_gc_page for every whole page of
+// the block pools; libc_report_free hands over the page-aligned inside of
+// free libc blocks.
+extern fn mp_port_scan_gc_pages() callconv(.c) void;
+extern fn libc_report_free(min_bytes: usize, report: *const fn (usize, usize) callconv(.c) void) callconv(.c) usize;
+
+/// Report free GC heap pages (while the interpreter is up) and free libc
+/// blocks. balloon.reportFree flushes the reports.
+pub fn reportFree() void {
+    if (heap_area_count > 0) {
+        mp_port_scan_gc_pages();
+        balloon.gcScanDone();
+    }
+    _ = libc_report_free(balloon.MinReportBytes, &reportLibcRange);
+}
+
+fn reportLibcRange(start: usize, end: usize) callconv(.c) void {
+    balloon.reportRange(start, end);
+}
+
+export fn kernel_gc_page(addr: usize, free: c_int) callconv(.c) void {
+    balloon.gcPage(addr, free != 0);
+}
+
+// libc malloc reused a block whose pages had been reported
+export fn kernel_mem_reclaimed(count: usize) callconv(.c) void {
+    balloon.noteReclaimed(count);
+}
+
+// Split-heap hooks (MICROPY_GC_SPLIT_HEAP_AUTO): largest area the GC may
+// ask for next, and the allocation itself
+export fn gc_get_max_new_split() callconv(.c) usize {
+    if (heap_area_count >= MaxHeapAreas) return 0;
+    const room = config.mp_heap_size -| heap_bytes;
+    return @min(room, pages.pool.largestFreeRun() * pages.PageSize) & ~@as(usize, pages.PageSize - 1);
+}
+
+export fn mp_port_alloc_heap(bytes: usize) callconv(.c) ?*anyopaque {
+    if (bytes > gc_get_max_new_split()) {
+        stats.grow_failures += 1;
+        return null;
+    }
+    const area = addHeapArea(bytes) orelse {
+        stats.grow_failures += 1;
+        return null;
+    };
+    return area.ptr;
+}
+
+// ukernel.gc_stats()
+export fn kernel_gc_stats(out: *gc_stats.GcStatsOut) callconv(.c) void {
+    out.* = gc_stats.snapshot(&stats, config.mp_heap_size);
+}
+
+// GC collect — called by MicroPython's gc_collect. The pause is timed
+// around the mark/sweep only; occupancy is sampled outside it.
 export fn gc_collect() callconv(.c) void {
+    var total: usize = 0;
+    const used_before = mp_port_heap_used(&total);
+
+    var span: trace.OpenSpan = .{};
+    if (comptime config.abi_trace) {
+        if (gc_trace_name == 0) gc_trace_name = trace.intern("gc");
+        span = trace.beginSpan(gc_trace_name);
+    }
+    const t0 = clock.rdtsc();
+
     gc_collect_start();
     var dummy: usize = 0;
     const sp = @intFromPtr(&dummy);
@@ -90,4 +257,15 @@ export fn gc_collect() callconv(.c) void {
         }
     }
     gc_collect_end();
+
+    const cycles = clock.rdtsc() -% t0;
+    if (comptime config.abi_trace) trace.endSpan(span);
+
+    const used_after = mp_port_heap_used(&total);
+    stats.recordCollection(cycles, used_before, used_after);
+    if (comptime config.abi_trace) {
+        var kv_buf: [32]u8 = undefined;
+        const kv = std.fmt.bufPrint(&kv_buf, "reclaimed_kib={d}", .{stats.last_reclaimed / 1024}) catch kv_buf[0..0];
+        trace.event(span.id, gc_trace_name, kv);
+    }
 }
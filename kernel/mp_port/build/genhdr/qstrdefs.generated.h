@@ -171,25 +171,31 @@ QDEF0(MP_QSTR__lt_genexpr_gt_, 27188, 9, "<genexpr>")
 QDEF0(MP_QSTR__lt_lambda_gt_, 35968, 8, "<lambda>")
 QDEF0(MP_QSTR__lt_listcomp_gt_, 5588, 10, "<listcomp>")
 QDEF0(MP_QSTR__lt_setcomp_gt_, 20820, 9, "<setcomp>")
+QDEF1(MP_QSTR__dot_frozen, 62593, 7, ".frozen")
 QDEF1(MP_QSTR__lt_stdin_gt_, 25571, 7, "<stdin>")
 QDEF1(MP_QSTR__lt_string_gt_, 21330, 8, "<string>")
 QDEF1(MP_QSTR_CAP_IO, 62414, 6, "CAP_IO")
 QDEF1(MP_QSTR_CAP_LOG, 26956, 7, "CAP_LOG")
 QDEF1(MP_QSTR_CAP_MEM, 31757, 7, "CAP_MEM")
-QDEF1(MP_QSTR_CAP_NET, 59935, 7, "CAP_NET")
+QDEF1(MP_QSTR_CAP_NET, 32919, 7, "CAP_NET")
 QDEF1(MP_QSTR_CAP_TASK, 36741, 8, "CAP_TASK")
 QDEF1(MP_QSTR_CAP_TIME, 28765, 8, "CAP_TIME")
-QDEF1(MP_QSTR_net_bind, 50696, 8, "net_bind")
-QDEF1(MP_QSTR_net_close, 19265, 9, "net_close")
-QDEF1(MP_QSTR_net_connect, 53301, 11, "net_connect")
-QDEF1(MP_QSTR_net_recv, 31163, 8, "net_recv")
-QDEF1(MP_QSTR_net_send, 1909, 8, "net_send")
-QDEF1(MP_QSTR_net_udp_socket, 13532, 14, "net_udp_socket")
+QDEF1(MP_QSTR_CancelledError, 39926, 14, "CancelledError")
+QDEF1(MP_QSTR_IO_SYNC, 12923, 7, "IO_SYNC")
+QDEF1(MP_QSTR_POLLERR, 49375, 7, "POLLERR")
+QDEF1(MP_QSTR_POLLHUP, 35447, 7, "POLLHUP")
+QDEF1(MP_QSTR_POLLIN, 24957, 6, "POLLIN")
+QDEF1(MP_QSTR_POLLOUT, 34164, 7, "POLLOUT")
+QDEF1(MP_QSTR_Task, 16904, 4, "Task")
+QDEF1(MP_QSTR_TaskQueue, 23705, 9, "TaskQueue")
 QDEF0(MP_QSTR___add__, 33476, 7, "__add__")
+QDEF1(MP_QSTR___await__, 64079, 9, "__await__")
 QDEF0(MP_QSTR___bool__, 25899, 8, "__bool__")
 QDEF1(MP_QSTR___build_class__, 34882, 15, "__build_class__")
 QDEF0(MP_QSTR___contains__, 24518, 12, "__contains__")
+QDEF1(MP_QSTR___del__, 14184, 7, "__del__")
 QDEF0(MP_QSTR___eq__, 15985, 6, "__eq__")
+QDEF1(MP_QSTR___file__, 21507, 8, "__file__")
 QDEF0(MP_QSTR___ge__, 18087, 6, "__ge__")
 QDEF0(MP_QSTR___gt__, 33462, 6, "__gt__")
 QDEF0(MP_QSTR___iadd__, 19053, 8, "__iadd__")
@@ -198,36 +204,87 @@ QDEF0(MP_QSTR___isub__, 30728, 8, "__isub__")
 QDEF0(MP_QSTR___le__, 5068, 6, "__le__")
 QDEF0(MP_QSTR___lt__, 26717, 6, "__lt__")
 QDEF0(MP_QSTR___ne__, 2830, 6, "__ne__")
+QDEF1(MP_QSTR___path__, 9160, 8, "__path__")
 QDEF1(MP_QSTR___repl_print__, 47872, 14, "__repl_print__")
 QDEF0(MP_QSTR___sub__, 2337, 7, "__sub__")
 QDEF1(MP_QSTR___traceback__, 53071, 13, "__traceback__")
+QDEF1(MP_QSTR__asyncio, 18906, 8, "_asyncio")
+QDEF1(MP_QSTR__task_queue, 50649, 11, "_task_queue")
 QDEF1(MP_QSTR_argv, 50887, 4, "argv")
+QDEF1(MP_QSTR_asyncio, 44357, 7, "asyncio")
+QDEF1(MP_QSTR_balloon_stats, 36118, 13, "balloon_stats")
 QDEF1(MP_QSTR_bin, 18656, 3, "bin")
 QDEF1(MP_QSTR_bound_method, 41623, 12, "bound_method")
 QDEF1(MP_QSTR_byteorder, 39265, 9, "byteorder")
+QDEF1(MP_QSTR_cancel, 34563, 6, "cancel")
 QDEF1(MP_QSTR_closure, 51828, 7, "closure")
+QDEF1(MP_QSTR_coro, 56244, 4, "coro")
+QDEF1(MP_QSTR_cur_task, 11763, 8, "cur_task")
+QDEF1(MP_QSTR_data, 56341, 4, "data")
 QDEF1(MP_QSTR_dict_view, 43309, 9, "dict_view")
+QDEF1(MP_QSTR_done, 837, 4, "done")
 QDEF1(MP_QSTR_errno, 4545, 5, "errno")
 QDEF1(MP_QSTR_exit, 48773, 4, "exit")
+QDEF1(MP_QSTR_fileno, 30338, 6, "fileno")
 QDEF1(MP_QSTR_function, 551, 8, "function")
+QDEF1(MP_QSTR_gc_stats, 1279, 8, "gc_stats")
 QDEF1(MP_QSTR_generator, 50070, 9, "generator")
 QDEF1(MP_QSTR_hex, 20592, 3, "hex")
 QDEF1(MP_QSTR_implementation, 11543, 14, "implementation")
+QDEF1(MP_QSTR_io_close, 1866, 8, "io_close")
+QDEF1(MP_QSTR_io_open, 46728, 7, "io_open")
+QDEF1(MP_QSTR_io_write, 8929, 8, "io_write")
+QDEF1(MP_QSTR_ipoll, 23891, 5, "ipoll")
 QDEF1(MP_QSTR_iterator, 48711, 8, "iterator")
 QDEF1(MP_QSTR_log, 16161, 3, "log")
 QDEF1(MP_QSTR_maximum_space_recursion_space_depth_space_exceeded, 7795, 32, "maximum recursion depth exceeded")
+QDEF1(MP_QSTR_mem_trim, 19229, 8, "mem_trim")
+QDEF1(MP_QSTR_modify, 26357, 6, "modify")
 QDEF1(MP_QSTR_module, 39359, 6, "module")
 QDEF1(MP_QSTR_modules, 53740, 7, "modules")
+QDEF1(MP_QSTR_native, 2948, 6, "native")
+QDEF1(MP_QSTR_net_addr, 61078, 8, "net_addr")
+QDEF1(MP_QSTR_net_bind, 47204, 8, "net_bind")
+QDEF1(MP_QSTR_net_close, 30803, 9, "net_close")
+QDEF1(MP_QSTR_net_connect, 11515, 11, "net_connect")
+QDEF1(MP_QSTR_net_recv, 19655, 8, "net_recv")
+QDEF1(MP_QSTR_net_recv_into, 27716, 13, "net_recv_into")
+QDEF1(MP_QSTR_net_send, 60057, 8, "net_send")
+QDEF1(MP_QSTR_net_udp_socket, 60190, 14, "net_udp_socket")
 QDEF1(MP_QSTR_oct, 23805, 3, "oct")
 QDEF1(MP_QSTR_path, 52872, 4, "path")
+QDEF1(MP_QSTR_peek, 49534, 4, "peek")
+QDEF1(MP_QSTR_ph_key, 6901, 6, "ph_key")
+QDEF1(MP_QSTR_poll, 55706, 4, "poll")
 QDEF1(MP_QSTR_print_exception, 8732, 15, "print_exception")
+QDEF1(MP_QSTR_ptr, 28755, 3, "ptr")
+QDEF1(MP_QSTR_ptr16, 51956, 5, "ptr16")
+QDEF1(MP_QSTR_ptr32, 51890, 5, "ptr32")
+QDEF1(MP_QSTR_ptr8, 31371, 4, "ptr8")
+QDEF1(MP_QSTR_push, 32443, 4, "push")
+QDEF1(MP_QSTR_register, 41388, 8, "register")
+QDEF1(MP_QSTR_select, 16781, 6, "select")
+QDEF1(MP_QSTR_sleep, 10218, 5, "sleep")
 QDEF1(MP_QSTR_sleep_ms, 25355, 8, "sleep_ms")
+QDEF1(MP_QSTR_sleep_us, 24595, 8, "sleep_us")
+QDEF1(MP_QSTR_src, 36103, 3, "src")
+QDEF1(MP_QSTR_state, 61650, 5, "state")
+QDEF1(MP_QSTR_stats, 61636, 5, "stats")
 QDEF1(MP_QSTR_sys, 36540, 3, "sys")
+QDEF1(MP_QSTR_ticks_add, 44701, 9, "ticks_add")
+QDEF1(MP_QSTR_ticks_cpu, 42266, 9, "ticks_cpu")
+QDEF1(MP_QSTR_ticks_diff, 57521, 10, "ticks_diff")
+QDEF1(MP_QSTR_ticks_ms, 12866, 8, "ticks_ms")
+QDEF1(MP_QSTR_ticks_us, 12634, 8, "ticks_us")
+QDEF1(MP_QSTR_time, 49648, 4, "time")
 QDEF1(MP_QSTR_time_ms, 45649, 7, "time_ms")
+QDEF1(MP_QSTR_uint, 15843, 4, "uint")
 QDEF1(MP_QSTR_ukernel, 58635, 7, "ukernel")
+QDEF1(MP_QSTR_unregister, 54295, 10, "unregister")
 QDEF1(MP_QSTR_usys, 62409, 4, "usys")
 QDEF1(MP_QSTR_version, 54207, 7, "version")
 QDEF1(MP_QSTR_version_info, 2670, 12, "version_info")
+QDEF1(MP_QSTR_viper, 9053, 5, "viper")
 QDEF1(MP_QSTR__brace_open__colon__hash_b_brace_close_, 14168, 5, "{:#b}")
 QDEF1(MP_QSTR__brace_open__colon__hash_o_brace_close_, 14325, 5, "{:#o}")
 QDEF1(MP_QSTR__brace_open__colon__hash_x_brace_close_, 14850, 5, "{:#x}")
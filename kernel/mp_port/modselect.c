@@ -0,0 +1,259 @@
+/*
+ * MicroPython 'select' module for the uKernel port — what asyncio's IOQueue
+ * needs: select.poll() with register/modify/unregister/poll/ipoll.
+ *
+ * extmod's select calls each registered stream's ioctl in a loop. Here a
+ * poll object owns a kernel readiness set (io_set_*), so each event-loop
+ * turn is one io_set_wait that blocks on every registered handle and on the
+ * loop's next deadline together. With nothing registered, a timed wait is
+ * io_poll(count=0, timeout), the kernel's deadline-aware sleep.
+ *
+ * Registered objects are ABI handles (the ints ukernel.net_udp_socket()
+ * returns) or objects whose fileno() returns one:
+ *
+ *   p = select.poll()
+ *   p.register(sock, select.POLLIN)
+ *   for obj, ev in p.ipoll(100):
+ *       ...
+ */
+
+#include "py/runtime.h"
+#include "py/obj.h"
+#include "py/mperrno.h"
+#include "py/stream.h"
+
+extern unsigned int io_poll(void *handles, unsigned int count,
+                            unsigned long timeout, unsigned long events_out,
+                            unsigned int *count_out);
+extern unsigned int io_set_create(unsigned int flags, unsigned long *set_out);
+extern unsigned int io_set_ctl(unsigned long set, unsigned int op, unsigned long handle,
+                               unsigned int events, unsigned long long user_data);
+extern unsigned int io_set_wait(unsigned long set, unsigned long events_out,
+                                unsigned int max_events, unsigned long timeout,
+                                unsigned int *count_out);
+extern unsigned int io_set_close(unsigned long set);
+
+/* Kernel event bits and io_set_ctl ops (ukernel_abi.h) */
+#define IO_READABLE 0x01
+#define IO_WRITABLE 0x02
+#define IO_HANGUP   0x04
+#define IO_ERROR    0x08
+#define IOSET_ADD 1
+#define IOSET_MOD 2
+#define IOSET_DEL 3
+#define ERR_TIMEOUT     5
+#define ERR_WOULD_BLOCK 9
+
+/* Events reported per wait; the rest stay queued for the next one */
+#define POLL_MAX_EVENTS 16
+
+/* Mirrors io_set_event_t */
+typedef struct {
+    unsigned long long handle;
+    unsigned long long user_data;
+    unsigned int events;
+    unsigned int reserved;
+} poll_event_t;
+
+typedef struct _mp_obj_poll_t {
+    mp_obj_base_t base;
+    unsigned long set; /* 0 until the first register */
+    mp_map_t map;      /* registered object -> eventmask */
+    mp_obj_tuple_t *ret_tuple;
+    size_t n_ready;
+    size_t iter_idx;
+    poll_event_t events[POLL_MAX_EVENTS];
+} mp_obj_poll_t;
+
+static const mp_obj_type_t mp_type_poll;
+
+static unsigned long poll_handle(mp_obj_t obj) {
+    if (mp_obj_is_int(obj)) return (unsigned long)mp_obj_get_int(obj);
+    mp_obj_t dest[2];
+    mp_load_method(obj, MP_QSTR_fileno, dest);
+    return (unsigned long)mp_obj_get_int(mp_call_method_n_kw(0, 0, dest));
+}
+
+static unsigned int to_kernel_events(mp_uint_t mask) {
+    unsigned int ev = 0;
+    if (mask & MP_STREAM_POLL_RD) ev |= IO_READABLE;
+    if (mask & MP_STREAM_POLL_WR) ev |= IO_WRITABLE;
+    return ev;
+}
+
+static mp_uint_t to_poll_mask(unsigned int ev) {
+    mp_uint_t mask = 0;
+    if (ev & IO_READABLE) mask |= MP_STREAM_POLL_RD;
+    if (ev & IO_WRITABLE) mask |= MP_STREAM_POLL_WR;
+    if (ev & IO_HANGUP) mask |= MP_STREAM_POLL_HUP;
+    if (ev & IO_ERROR) mask |= MP_STREAM_POLL_ERR;
+    return mask;
+}
+
+static void poll_ctl(mp_obj_poll_t *self, unsigned int op, mp_obj_t obj, mp_uint_t mask) {
+    /* user_data carries the object back out of io_set_wait; the map keeps
+     * it alive while registered */
+    unsigned int rc = io_set_ctl(self->set, op, poll_handle(obj), to_kernel_events(mask),
+                                 (unsigned long long)(uintptr_t)obj);
+    if (rc != 0) mp_raise_OSError((int)rc);
+}
+
+/* Block for up to timeout_ms (-1: no limit); returns events in self->events */
+static size_t poll_wait(mp_obj_poll_t *self, mp_int_t timeout_ms) {
+    unsigned long timeout = timeout_ms < 0 ? ~0UL : (unsigned long)timeout_ms * 1000000UL;
+    if (self->map.used == 0) {
+        if (timeout_ms != 0) io_poll(NULL, 0, timeout, 0, NULL);
+        return 0;
+    }
+    unsigned int n = 0;
+    unsigned int rc = io_set_wait(self->set, (unsigned long)self->events, POLL_MAX_EVENTS,
+                                  timeout, &n);
+    if (rc == ERR_WOULD_BLOCK || rc == ERR_TIMEOUT) return 0;
+    if (rc != 0) mp_raise_OSError((int)rc);
+    return n;
+}
+
+static mp_int_t poll_timeout_arg(size_t n_args, const mp_obj_t *args) {
+    if (n_args < 2 || args[1] == mp_const_none) return -1;
+    return mp_obj_get_int(args[1]);
+}
+
+/* poll.register(obj[, eventmask]) */
+static mp_obj_t poll_register(size_t n_args, const mp_obj_t *args) {
+    mp_obj_poll_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_uint_t mask = n_args == 3 ? mp_obj_get_int(args[2]) : MP_STREAM_POLL_RD | MP_STREAM_POLL_WR;
+    if (self->set == 0) {
+        unsigned int rc = io_set_create(0, &self->set);
+        if (rc != 0) mp_raise_OSError((int)rc);
+    }
+    mp_map_elem_t *elem = mp_map_lookup(&self->map, args[1], MP_MAP_LOOKUP);
+    poll_ctl(self, elem == NULL ? IOSET_ADD : IOSET_MOD, args[1], mask);
+    if (elem == NULL) elem = mp_map_lookup(&self->map, args[1], MP_MAP_LOOKUP_ADD_IF_NOT_FOUND);
+    elem->value = MP_OBJ_NEW_SMALL_INT(mask);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(poll_register_obj, 2, 3, poll_register);
+
+/* poll.modify(obj, eventmask) */
+static mp_obj_t poll_modify(mp_obj_t self_in, mp_obj_t obj_in, mp_obj_t mask_in) {
+    mp_obj_poll_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_map_elem_t *elem = mp_map_lookup(&self->map, obj_in, MP_MAP_LOOKUP);
+    if (elem == NULL) mp_raise_OSError(MP_ENOENT);
+    mp_uint_t mask = mp_obj_get_int(mask_in);
+    poll_ctl(self, IOSET_MOD, obj_in, mask);
+    elem->value = MP_OBJ_NEW_SMALL_INT(mask);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(poll_modify_obj, poll_modify);
+
+/* poll.unregister(obj) — no-op if obj is not registered */
+static mp_obj_t poll_unregister(mp_obj_t self_in, mp_obj_t obj_in) {
+    mp_obj_poll_t *self = MP_OBJ_TO_PTR(self_in);
+    if (mp_map_lookup(&self->map, obj_in, MP_MAP_LOOKUP_REMOVE_IF_FOUND) != NULL) {
+        /* The handle may already be closed, which also dropped it from the set */
+        io_set_ctl(self->set, IOSET_DEL, poll_handle(obj_in), 0, 0);
+    }
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(poll_unregister_obj, poll_unregister);
+
+/* poll.poll([timeout_ms]) → list of (obj, event) */
+static mp_obj_t poll_poll(size_t n_args, const mp_obj_t *args) {
+    mp_obj_poll_t *self = MP_OBJ_TO_PTR(args[0]);
+    size_t n = poll_wait(self, poll_timeout_arg(n_args, args));
+    mp_obj_t result = mp_obj_new_list(n, NULL);
+    for (size_t i = 0; i < n; i++) {
+        mp_obj_t pair[2] = {
+            (mp_obj_t)(uintptr_t)self->events[i].user_data,
+            MP_OBJ_NEW_SMALL_INT(to_poll_mask(self->events[i].events)),
+        };
+        mp_obj_list_store(result, MP_OBJ_NEW_SMALL_INT(i), mp_obj_new_tuple(2, pair));
+    }
+    return result;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(poll_poll_obj, 1, 2, poll_poll);
+
+/* poll.ipoll([timeout_ms[, flags]]) → iterator of (obj, event). The tuple
+ * is reused for every event, so the loop allocates nothing per wakeup. */
+static mp_obj_t poll_ipoll(size_t n_args, const mp_obj_t *args) {
+    mp_obj_poll_t *self = MP_OBJ_TO_PTR(args[0]);
+    if (self->ret_tuple == NULL) {
+        self->ret_tuple = MP_OBJ_TO_PTR(mp_obj_new_tuple(2, NULL));
+    }
+    self->n_ready = poll_wait(self, poll_timeout_arg(n_args, args));
+    self->iter_idx = 0;
+    return args[0];
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(poll_ipoll_obj, 1, 3, poll_ipoll);
+
+static mp_obj_t poll_iternext(mp_obj_t self_in) {
+    mp_obj_poll_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->iter_idx >= self->n_ready) return MP_OBJ_STOP_ITERATION;
+    const poll_event_t *ev = &self->events[self->iter_idx++];
+    self->ret_tuple->items[0] = (mp_obj_t)(uintptr_t)ev->user_data;
+    self->ret_tuple->items[1] = MP_OBJ_NEW_SMALL_INT(to_poll_mask(ev->events));
+    return MP_OBJ_FROM_PTR(self->ret_tuple);
+}
+
+/* poll.close() — release the kernel readiness set */
+static mp_obj_t poll_close(mp_obj_t self_in) {
+    mp_obj_poll_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->set != 0) {
+        io_set_close(self->set);
+        self->set = 0;
+    }
+    mp_map_clear(&self->map);
+    self->n_ready = 0;
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(poll_close_obj, poll_close);
+
+static const mp_rom_map_elem_t poll_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_register), MP_ROM_PTR(&poll_register_obj) },
+    { MP_ROM_QSTR(MP_QSTR_unregister), MP_ROM_PTR(&poll_unregister_obj) },
+    { MP_ROM_QSTR(MP_QSTR_modify), MP_ROM_PTR(&poll_modify_obj) },
+    { MP_ROM_QSTR(MP_QSTR_poll), MP_ROM_PTR(&poll_poll_obj) },
+    { MP_ROM_QSTR(MP_QSTR_ipoll), MP_ROM_PTR(&poll_ipoll_obj) },
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&poll_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&poll_close_obj) },
+};
+static MP_DEFINE_CONST_DICT(poll_locals_dict, poll_locals_dict_table);
+
+static MP_DEFINE_CONST_OBJ_TYPE(
+    mp_type_poll,
+    MP_QSTR_poll,
+    MP_TYPE_FLAG_ITER_IS_ITERNEXT,
+    iter, poll_iternext,
+    locals_dict, &poll_locals_dict
+    );
+
+/* select.poll() */
+static mp_obj_t mod_select_poll(void) {
+    /* The finaliser closes the readiness set of a poll that was never closed */
+    mp_obj_poll_t *self = mp_obj_malloc_with_finaliser(mp_obj_poll_t, &mp_type_poll);
+    self->set = 0;
+    mp_map_init(&self->map, 0);
+    self->ret_tuple = NULL;
+    self->n_ready = 0;
+    self->iter_idx = 0;
+    return MP_OBJ_FROM_PTR(self);
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(mod_select_poll_obj, mod_select_poll);
+
+static const mp_rom_map_elem_t mp_module_select_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_select) },
+    { MP_ROM_QSTR(MP_QSTR_poll), MP_ROM_PTR(&mod_select_poll_obj) },
+    { MP_ROM_QSTR(MP_QSTR_POLLIN), MP_ROM_INT(MP_STREAM_POLL_RD) },
+    { MP_ROM_QSTR(MP_QSTR_POLLOUT), MP_ROM_INT(MP_STREAM_POLL_WR) },
+    { MP_ROM_QSTR(MP_QSTR_POLLERR), MP_ROM_INT(MP_STREAM_POLL_ERR) },
+    { MP_ROM_QSTR(MP_QSTR_POLLHUP), MP_ROM_INT(MP_STREAM_POLL_HUP) },
+};
+
+static MP_DEFINE_CONST_DICT(mp_module_select_globals, mp_module_select_globals_table);
+
+const mp_obj_module_t mp_module_select = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t *)&mp_module_select_globals,
+};
+
+MP_REGISTER_MODULE(MP_QSTR_select, mp_module_select);
@@ -9,11 +9,26 @@
  *   sock = ukernel.net_udp_socket()
  *   ukernel.net_connect(sock, "172.16.0.1", 9000)
  *   ukernel.net_send(sock, b"hello")
+ *   peer = ukernel.net_addr("172.16.0.1", 9001)  # parse once, reuse
+ *   ukernel.net_connect(sock, peer)
+ *   buf = bytearray(1500)
+ *   n = ukernel.net_recv_into(sock, buf)  # no allocation; None if empty
  *   ukernel.net_close(sock)
+ *   log = ukernel.io_open("disklog", ukernel.IO_SYNC)  # record log on disk
+ *   ukernel.io_write(log, b"sample")  # one record per call
+ *   ukernel.io_close(log)
+ *   ukernel.stats()   # per-ABI-call counters (kernel built with -Dabi-stats)
+ *   ukernel.gc_stats()  # GC pauses, reclaimed bytes, heap occupancy
+ *   ukernel.mem_trim()  # report free memory to the host now (virtio-balloon)
+ *   ukernel.balloon_stats()  # balloon size, reported and reclaimed pages
  */
 
+#include <string.h>
+
 #include "py/runtime.h"
 #include "py/obj.h"
+#include "py/gc.h"
+#include "py/mphal.h"
 
 /* Zig ABI exports (C calling convention) */
 extern unsigned int log_write(unsigned int level, unsigned long msg_ptr, unsigned long len);
@@ -39,6 +54,10 @@ extern unsigned int net_recv(unsigned long sock, unsigned long buf_ptr,
                              unsigned long len, unsigned int flags, unsigned long *read_out);
 extern unsigned int net_close(unsigned long sock);
 
+extern unsigned int task_get_stats(unsigned long task, unsigned long stats_out);
+extern unsigned int mem_balloon_stats(unsigned long stats_out);
+extern unsigned int mem_trim(unsigned long long *reported_out);
+
 extern unsigned long long kernel_ticks_ms(void);
 extern void serial_write_bytes(const char *ptr, unsigned long len);
 
@@ -50,6 +69,9 @@ extern void serial_write_bytes(const char *ptr, unsigned long len);
 #define ABI_CAP_IO   5
 #define ABI_CAP_NET  7
 
+/* io_open flags */
+#define ABI_IO_OPEN_SYNC 0x01
+
 /* ukernel.log(msg, level=0) — write message to serial via ABI log_write */
 static mp_obj_t mod_ukernel_log(size_t n_args, const mp_obj_t *args) {
     size_t len;
@@ -74,16 +96,11 @@ static mp_obj_t mod_ukernel_time_ms(void) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_0(mod_ukernel_time_ms_obj, mod_ukernel_time_ms);
 
-/* ukernel.sleep_ms(ms) — busy-wait for ms milliseconds using io_poll */
+/* ukernel.sleep_ms(ms) — block in the kernel for ms milliseconds (io_poll
+ * deadline wait); asyncio code should await asyncio.sleep_ms instead */
 static mp_obj_t mod_ukernel_sleep_ms(mp_obj_t ms_obj) {
     mp_int_t ms = mp_obj_get_int(ms_obj);
-    if (ms <= 0) return mp_const_none;
-
-    /* Use rdtsc-based spin wait via io_poll(count=0, timeout) */
-    unsigned long long start = kernel_ticks_ms();
-    while ((kernel_ticks_ms() - start) < (unsigned long long)ms) {
-        __asm__ volatile ("pause");
-    }
+    if (ms > 0) mp_hal_delay_ms((mp_uint_t)ms);
     return mp_const_none;
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(mod_ukernel_sleep_ms_obj, mod_ukernel_sleep_ms);
@@ -123,18 +140,7 @@ static void build_addr(unsigned char buf[6], const unsigned char ip[4], unsigned
     buf[5] = (unsigned char)(port & 0xFF);
 }
 
-/* ukernel.net_udp_socket() — create a UDP socket, returns handle */
-static mp_obj_t mod_ukernel_net_udp_socket(void) {
-    unsigned long handle = 0;
-    unsigned int rc = net_socket(2, 2, 17, &handle); /* AF_INET, SOCK_DGRAM, UDP */
-    if (rc != 0) mp_raise_OSError((int)rc);
-    return mp_obj_new_int_from_uint((mp_uint_t)handle);
-}
-static MP_DEFINE_CONST_FUN_OBJ_0(mod_ukernel_net_udp_socket_obj, mod_ukernel_net_udp_socket);
-
-/* ukernel.net_bind(sock, ip_str, port) */
-static mp_obj_t mod_ukernel_net_bind(mp_obj_t sock_obj, mp_obj_t ip_obj, mp_obj_t port_obj) {
-    unsigned long sock = (unsigned long)mp_obj_get_int(sock_obj);
+static void parse_addr(mp_obj_t ip_obj, mp_obj_t port_obj, unsigned char addr[6]) {
     size_t ip_len;
     const char *ip_str = mp_obj_str_get_data(ip_obj, &ip_len);
     unsigned int port = (unsigned int)mp_obj_get_int(port_obj);
@@ -143,66 +149,135 @@ static mp_obj_t mod_ukernel_net_bind(mp_obj_t sock_obj, mp_obj_t ip_obj, mp_obj_
     if (parse_ip(ip_str, ip_len, ip) != 0) {
         mp_raise_ValueError(MP_ERROR_TEXT("invalid IP address"));
     }
+    build_addr(addr, ip, port);
+}
 
+/* Address argument of net_bind/net_connect: either a packed address from
+ * ukernel.net_addr() (args[1], used in place) or ip_str, port (parsed into
+ * scratch). */
+static const unsigned char *get_addr(size_t n_args, const mp_obj_t *args, unsigned char scratch[6]) {
+    if (n_args == 3) {
+        parse_addr(args[1], args[2], scratch);
+        return scratch;
+    }
+    mp_buffer_info_t addr_info;
+    mp_get_buffer_raise(args[1], &addr_info, MP_BUFFER_READ);
+    if (addr_info.len != 6) {
+        mp_raise_ValueError(MP_ERROR_TEXT("address must be 6 bytes"));
+    }
+    return (const unsigned char *)addr_info.buf;
+}
+
+/* ukernel.net_addr(ip_str, port) → packed 6-byte address, parsed once and
+ * reusable across net_bind/net_connect calls */
+static mp_obj_t mod_ukernel_net_addr(mp_obj_t ip_obj, mp_obj_t port_obj) {
     unsigned char addr[6];
-    build_addr(addr, ip, port);
+    parse_addr(ip_obj, port_obj, addr);
+    return mp_obj_new_bytes(addr, 6);
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(mod_ukernel_net_addr_obj, mod_ukernel_net_addr);
 
-    unsigned int rc = net_bind(sock, (unsigned long)addr, 6);
+/* ukernel.net_udp_socket() — create a UDP socket, returns handle */
+static mp_obj_t mod_ukernel_net_udp_socket(void) {
+    unsigned long handle = 0;
+    unsigned int rc = net_socket(2, 2, 17, &handle); /* AF_INET, SOCK_DGRAM, UDP */
     if (rc != 0) mp_raise_OSError((int)rc);
-    return mp_const_none;
+    return mp_obj_new_int_from_uint((mp_uint_t)handle);
 }
-static MP_DEFINE_CONST_FUN_OBJ_3(mod_ukernel_net_bind_obj, mod_ukernel_net_bind);
+static MP_DEFINE_CONST_FUN_OBJ_0(mod_ukernel_net_udp_socket_obj, mod_ukernel_net_udp_socket);
 
-/* ukernel.net_connect(sock, ip_str, port) */
-static mp_obj_t mod_ukernel_net_connect(mp_obj_t sock_obj, mp_obj_t ip_obj, mp_obj_t port_obj) {
-    unsigned long sock = (unsigned long)mp_obj_get_int(sock_obj);
-    size_t ip_len;
-    const char *ip_str = mp_obj_str_get_data(ip_obj, &ip_len);
-    unsigned int port = (unsigned int)mp_obj_get_int(port_obj);
+/* ukernel.net_bind(sock, addr) or ukernel.net_bind(sock, ip_str, port) */
+static mp_obj_t mod_ukernel_net_bind(size_t n_args, const mp_obj_t *args) {
+    unsigned long sock = (unsigned long)mp_obj_get_int(args[0]);
+    unsigned char scratch[6];
+    const unsigned char *addr = get_addr(n_args, args, scratch);
 
-    unsigned char ip[4];
-    if (parse_ip(ip_str, ip_len, ip) != 0) {
-        mp_raise_ValueError(MP_ERROR_TEXT("invalid IP address"));
-    }
+    unsigned int rc = net_bind(sock, (unsigned long)addr, 6);
+    if (rc != 0) mp_raise_OSError((int)rc);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_ukernel_net_bind_obj, 2, 3, mod_ukernel_net_bind);
 
-    unsigned char addr[6];
-    build_addr(addr, ip, port);
+/* ukernel.net_connect(sock, addr) or ukernel.net_connect(sock, ip_str, port) */
+static mp_obj_t mod_ukernel_net_connect(size_t n_args, const mp_obj_t *args) {
+    unsigned long sock = (unsigned long)mp_obj_get_int(args[0]);
+    unsigned char scratch[6];
+    const unsigned char *addr = get_addr(n_args, args, scratch);
 
     unsigned int rc = net_connect(sock, (unsigned long)addr, 6);
     if (rc != 0) mp_raise_OSError((int)rc);
     return mp_const_none;
 }
-static MP_DEFINE_CONST_FUN_OBJ_3(mod_ukernel_net_connect_obj, mod_ukernel_net_connect);
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_ukernel_net_connect_obj, 2, 3, mod_ukernel_net_connect);
+
+/* Optional length argument: at most len, defaulting to all of it */
+static size_t clamp_len(size_t n_args, const mp_obj_t *args, size_t len) {
+    if (n_args < 3) return len;
+    mp_int_t n = mp_obj_get_int(args[2]);
+    if (n < 0 || (size_t)n > len) return len;
+    return (size_t)n;
+}
 
-/* ukernel.net_send(sock, data) → bytes_sent */
-static mp_obj_t mod_ukernel_net_send(mp_obj_t sock_obj, mp_obj_t data_obj) {
-    unsigned long sock = (unsigned long)mp_obj_get_int(sock_obj);
+/* ukernel.net_send(sock, data[, nbytes]) → bytes_sent
+ * data is any buffer (bytes, bytearray, memoryview) and is handed to the
+ * kernel in place; nbytes sends a prefix without slicing. */
+static mp_obj_t mod_ukernel_net_send(size_t n_args, const mp_obj_t *args) {
+    unsigned long sock = (unsigned long)mp_obj_get_int(args[0]);
     mp_buffer_info_t buf_info;
-    mp_get_buffer_raise(data_obj, &buf_info, MP_BUFFER_READ);
+    mp_get_buffer_raise(args[1], &buf_info, MP_BUFFER_READ);
+    size_t len = clamp_len(n_args, args, buf_info.len);
 
     unsigned long wrote = 0;
-    unsigned int rc = net_send(sock, (unsigned long)buf_info.buf, buf_info.len, 0, &wrote);
+    unsigned int rc = net_send(sock, (unsigned long)buf_info.buf, len, 0, &wrote);
     if (rc != 0) mp_raise_OSError((int)rc);
     return mp_obj_new_int_from_uint((mp_uint_t)wrote);
 }
-static MP_DEFINE_CONST_FUN_OBJ_2(mod_ukernel_net_send_obj, mod_ukernel_net_send);
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_ukernel_net_send_obj, 2, 3, mod_ukernel_net_send);
+
+/* Largest UDP payload over IPv4; bigger datagrams arrive as fragments */
+#define NET_MAX_DATAGRAM 65507
 
 /* ukernel.net_recv(sock, bufsize) → bytes or None */
 static mp_obj_t mod_ukernel_net_recv(mp_obj_t sock_obj, mp_obj_t size_obj) {
     unsigned long sock = (unsigned long)mp_obj_get_int(sock_obj);
     mp_int_t bufsize = mp_obj_get_int(size_obj);
-    if (bufsize <= 0 || bufsize > 2048) bufsize = 2048;
+    if (bufsize <= 0) bufsize = 2048;
+    if (bufsize > NET_MAX_DATAGRAM) bufsize = NET_MAX_DATAGRAM;
+
+    vstr_t vstr;
+    vstr_init_len(&vstr, (size_t)bufsize);
+    unsigned long nread = 0;
+    unsigned int rc = net_recv(sock, (unsigned long)vstr.buf, (unsigned long)bufsize, 0, &nread);
+    if (rc != 0) {
+        vstr_clear(&vstr);
+        if (rc == 9) { /* ERR_WOULD_BLOCK */
+            return mp_const_none;
+        }
+        mp_raise_OSError((int)rc);
+    }
+    vstr.len = (size_t)nread;
+    return mp_obj_new_bytes_from_vstr(&vstr);
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(mod_ukernel_net_recv_obj, mod_ukernel_net_recv);
+
+/* ukernel.net_recv_into(sock, buf[, nbytes]) → bytes read or None
+ * The datagram is copied straight into a writable buffer (bytearray,
+ * memoryview) the caller keeps across calls, so nothing is allocated. */
+static mp_obj_t mod_ukernel_net_recv_into(size_t n_args, const mp_obj_t *args) {
+    unsigned long sock = (unsigned long)mp_obj_get_int(args[0]);
+    mp_buffer_info_t buf_info;
+    mp_get_buffer_raise(args[1], &buf_info, MP_BUFFER_WRITE);
+    size_t len = clamp_len(n_args, args, buf_info.len);
 
-    unsigned char buf[2048];
     unsigned long nread = 0;
-    unsigned int rc = net_recv(sock, (unsigned long)buf, (unsigned long)bufsize, 0, &nread);
+    unsigned int rc = net_recv(sock, (unsigned long)buf_info.buf, (unsigned long)len, 0, &nread);
     if (rc == 9) { /* ERR_WOULD_BLOCK */
         return mp_const_none;
     }
     if (rc != 0) mp_raise_OSError((int)rc);
-    return mp_obj_new_bytes(buf, (size_t)nread);
+    return MP_OBJ_NEW_SMALL_INT((mp_int_t)nread);
 }
-static MP_DEFINE_CONST_FUN_OBJ_2(mod_ukernel_net_recv_obj, mod_ukernel_net_recv);
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_ukernel_net_recv_into_obj, 2, 3, mod_ukernel_net_recv_into);
 
 /* ukernel.net_close(sock) */
 static mp_obj_t mod_ukernel_net_close(mp_obj_t sock_obj) {
@@ -213,6 +288,217 @@ static mp_obj_t mod_ukernel_net_close(mp_obj_t sock_obj) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(mod_ukernel_net_close_obj, mod_ukernel_net_close);
 
+/* --- I/O handles --- */
+
+/* ukernel.io_open(path, flags=0) → handle ("serial" or "disklog") */
+static mp_obj_t mod_ukernel_io_open(size_t n_args, const mp_obj_t *args) {
+    const char *path = mp_obj_str_get_str(args[0]);
+    unsigned int flags = n_args > 1 ? (unsigned int)mp_obj_get_int(args[1]) : 0;
+    unsigned long handle = 0;
+    unsigned int rc = io_open((unsigned long)path, flags, &handle);
+    if (rc != 0) mp_raise_OSError((int)rc);
+    return mp_obj_new_int_from_uint((mp_uint_t)handle);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_ukernel_io_open_obj, 1, 2, mod_ukernel_io_open);
+
+/* ukernel.io_write(handle, data[, nbytes]) → bytes written
+ * On a "disklog" handle each call appends one record. */
+static mp_obj_t mod_ukernel_io_write(size_t n_args, const mp_obj_t *args) {
+    unsigned long handle = (unsigned long)mp_obj_get_int(args[0]);
+    mp_buffer_info_t buf_info;
+    mp_get_buffer_raise(args[1], &buf_info, MP_BUFFER_READ);
+    size_t len = clamp_len(n_args, args, buf_info.len);
+
+    unsigned long wrote = 0;
+    unsigned int rc = io_write(handle, (unsigned long)buf_info.buf, len, &wrote);
+    if (rc != 0) mp_raise_OSError((int)rc);
+    return mp_obj_new_int_from_uint((mp_uint_t)wrote);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_ukernel_io_write_obj, 2, 3, mod_ukernel_io_write);
+
+/* ukernel.io_close(handle) — for "disklog", waits until its records are durable */
+static mp_obj_t mod_ukernel_io_close(mp_obj_t handle_obj) {
+    unsigned long handle = (unsigned long)mp_obj_get_int(handle_obj);
+    unsigned int rc = io_close(handle);
+    if (rc != 0) mp_raise_OSError((int)rc);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(mod_ukernel_io_close_obj, mod_ukernel_io_close);
+
+/* --- ABI call statistics --- */
+
+/* Mirrors abi_call_stats_t / task_stats_t in ukernel_abi.h */
+#define ABI_STATS_MAX_CALLS   64
+#define ABI_STATS_MAX_RESULTS 12
+
+typedef struct {
+    unsigned long long calls;
+    unsigned long long errors;
+    unsigned long long total_ns;
+    unsigned long long max_ns;
+    unsigned long long p50_ns;
+    unsigned long long p99_ns;
+    unsigned int results[ABI_STATS_MAX_RESULTS];
+} abi_call_stats_t;
+
+typedef struct {
+    unsigned long long cpu_time_ns;
+    unsigned long long sched_ticks;
+    unsigned long long context_switches;
+    unsigned int abi_stats_enabled;
+    unsigned int call_count;
+    abi_call_stats_t calls[ABI_STATS_MAX_CALLS];
+} task_stats_t;
+
+/* ABI_CALL_* order (UKERNEL_ABI_CALLS in ukernel_abi.h) */
+static const char *const abi_call_names[] = {
+    "cap_acquire", "cap_drop", "cap_enter", "cap_exit",
+    "abi_version", "abi_features", "abi_feature_enabled",
+    "task_spawn", "task_yield", "task_sleep", "task_set_priority",
+    "task_get_stats", "task_exit",
+    "time_now", "time_deadline", "time_cancel",
+    "mem_alloc", "mem_free", "mem_map", "mem_share", "mem_unshare",
+    "io_open", "io_read", "io_write", "io_close", "io_poll",
+    "io_set_create", "io_set_ctl", "io_set_wait", "io_set_close",
+    "io_ring_setup", "io_ring_enter", "io_ring_close",
+    "ipc_channel_create", "ipc_send", "ipc_recv", "ipc_close",
+    "net_socket", "net_bind", "net_connect", "net_send", "net_recv", "net_close",
+    "log_write", "log_set_level", "log_dropped",
+    "trace_span_begin", "trace_span_end", "trace_event",
+    "mem_balloon_stats", "mem_trim",
+    "net_frame_setup", "net_frame_sync", "net_frame_close",
+};
+#define ABI_CALL_NAME_COUNT (sizeof(abi_call_names) / sizeof(abi_call_names[0]))
+
+/* Too large for the MicroPython C stack */
+static task_stats_t stats_buf;
+
+static void stats_put(mp_obj_t dict, const char *key, unsigned long long value) {
+    mp_obj_dict_store(dict, mp_obj_new_str(key, strlen(key)),
+                      mp_obj_new_int_from_ull(value));
+}
+
+/* ukernel.stats() — {call_name: {calls, errors, p50_ns, p99_ns, max_ns, total_ns}}
+ * for every ABI call made at least once. Empty unless the kernel was built
+ * with -Dabi-stats=true. */
+static mp_obj_t mod_ukernel_stats(void) {
+    unsigned int rc = task_get_stats(0, (unsigned long)&stats_buf);
+    if (rc != 0) mp_raise_OSError((int)rc);
+
+    mp_obj_t result = mp_obj_new_dict(0);
+    unsigned int count = stats_buf.call_count;
+    if (count > ABI_CALL_NAME_COUNT) count = ABI_CALL_NAME_COUNT;
+    for (unsigned int i = 0; i < count; i++) {
+        const abi_call_stats_t *s = &stats_buf.calls[i];
+        if (s->calls == 0) continue;
+        mp_obj_t entry = mp_obj_new_dict(6);
+        stats_put(entry, "calls", s->calls);
+        stats_put(entry, "errors", s->errors);
+        stats_put(entry, "p50_ns", s->p50_ns);
+        stats_put(entry, "p99_ns", s->p99_ns);
+        stats_put(entry, "max_ns", s->max_ns);
+        stats_put(entry, "total_ns", s->total_ns);
+        const char *name = abi_call_names[i];
+        mp_obj_dict_store(result, mp_obj_new_str(name, strlen(name)), entry);
+    }
+    return result;
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(mod_ukernel_stats_obj, mod_ukernel_stats);
+
+/* --- GC telemetry --- */
+
+/* Mirrors GcStatsOut in kernel/gc_stats.zig */
+typedef struct {
+    unsigned long long collections;
+    unsigned long long pause_total_ns;
+    unsigned long long pause_max_ns;
+    unsigned long long pause_p50_ns;
+    unsigned long long pause_p99_ns;
+    unsigned long long reclaimed_bytes;
+    unsigned long long last_reclaimed_bytes;
+    unsigned long long heap_total;
+    unsigned long long heap_used;
+    unsigned long long heap_peak_used;
+    unsigned long long heap_limit;
+    unsigned int areas;
+    unsigned int grow_failures;
+} gc_stats_out_t;
+
+extern void kernel_gc_stats(gc_stats_out_t *out);
+
+/* ukernel.gc_stats() — collection count and pause percentiles (ns), bytes
+ * reclaimed, and heap occupancy: heap_used is live, heap_peak is the most
+ * in use at the start of any collection */
+static mp_obj_t mod_ukernel_gc_stats(void) {
+    gc_stats_out_t s;
+    kernel_gc_stats(&s);
+    gc_info_t info;
+    gc_info(&info);
+
+    mp_obj_t result = mp_obj_new_dict(14);
+    stats_put(result, "collections", s.collections);
+    stats_put(result, "pause_total_ns", s.pause_total_ns);
+    stats_put(result, "pause_p50_ns", s.pause_p50_ns);
+    stats_put(result, "pause_p99_ns", s.pause_p99_ns);
+    stats_put(result, "pause_max_ns", s.pause_max_ns);
+    stats_put(result, "reclaimed", s.reclaimed_bytes);
+    stats_put(result, "last_reclaimed", s.last_reclaimed_bytes);
+    stats_put(result, "heap_used", info.used);
+    stats_put(result, "heap_free", info.free);
+    stats_put(result, "heap_total", s.heap_total);
+    stats_put(result, "heap_peak", s.heap_peak_used);
+    stats_put(result, "heap_limit", s.heap_limit);
+    stats_put(result, "areas", s.areas);
+    stats_put(result, "grow_failures", s.grow_failures);
+    return result;
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(mod_ukernel_gc_stats_obj, mod_ukernel_gc_stats);
+
+/* --- Free page reporting (virtio-balloon) --- */
+
+/* Mirrors mem_balloon_stats_t in ukernel_abi.h */
+typedef struct {
+    unsigned int target_pages;
+    unsigned int balloon_pages;
+    unsigned long long inflated_pages;
+    unsigned long long deflated_pages;
+    unsigned long long reported_pages;
+    unsigned long long reports;
+    unsigned long long reclaimed_pages;
+    unsigned int reporting;
+    unsigned int reserved;
+} balloon_stats_out_t;
+
+/* ukernel.mem_trim() — report free memory to the host now; returns the
+ * number of 4 KiB pages handed back */
+static mp_obj_t mod_ukernel_mem_trim(void) {
+    unsigned long long reported = 0;
+    unsigned int rc = mem_trim(&reported);
+    if (rc != 0) mp_raise_OSError((int)rc);
+    return mp_obj_new_int_from_ull(reported);
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(mod_ukernel_mem_trim_obj, mod_ukernel_mem_trim);
+
+/* ukernel.balloon_stats() — host target and balloon size, pages inflated
+ * and deflated, pages reported (and requests used) and reclaimed on reuse */
+static mp_obj_t mod_ukernel_balloon_stats(void) {
+    balloon_stats_out_t s;
+    unsigned int rc = mem_balloon_stats((unsigned long)&s);
+    if (rc != 0) mp_raise_OSError((int)rc);
+
+    mp_obj_t result = mp_obj_new_dict(8);
+    stats_put(result, "target_pages", s.target_pages);
+    stats_put(result, "balloon_pages", s.balloon_pages);
+    stats_put(result, "inflated", s.inflated_pages);
+    stats_put(result, "deflated", s.deflated_pages);
+    stats_put(result, "reported", s.reported_pages);
+    stats_put(result, "reports", s.reports);
+    stats_put(result, "reclaimed", s.reclaimed_pages);
+    stats_put(result, "reporting", s.reporting);
+    return result;
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(mod_ukernel_balloon_stats_obj, mod_ukernel_balloon_stats);
+
 /* Module globals */
 static const mp_rom_map_elem_t mp_module_ukernel_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_ukernel) },
@@ -220,6 +506,10 @@ static const mp_rom_map_elem_t mp_module_ukernel_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_time_ms), MP_ROM_PTR(&mod_ukernel_time_ms_obj) },
     { MP_ROM_QSTR(MP_QSTR_sleep_ms), MP_ROM_PTR(&mod_ukernel_sleep_ms_obj) },
     { MP_ROM_QSTR(MP_QSTR_version), MP_ROM_PTR(&mod_ukernel_version_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stats), MP_ROM_PTR(&mod_ukernel_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_gc_stats), MP_ROM_PTR(&mod_ukernel_gc_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_mem_trim), MP_ROM_PTR(&mod_ukernel_mem_trim_obj) },
+    { MP_ROM_QSTR(MP_QSTR_balloon_stats), MP_ROM_PTR(&mod_ukernel_balloon_stats_obj) },
 
     /* Networking */
     { MP_ROM_QSTR(MP_QSTR_net_udp_socket), MP_ROM_PTR(&mod_ukernel_net_udp_socket_obj) },
@@ -227,8 +517,16 @@ static const mp_rom_map_elem_t mp_module_ukernel_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_net_connect), MP_ROM_PTR(&mod_ukernel_net_connect_obj) },
     { MP_ROM_QSTR(MP_QSTR_net_send), MP_ROM_PTR(&mod_ukernel_net_send_obj) },
     { MP_ROM_QSTR(MP_QSTR_net_recv), MP_ROM_PTR(&mod_ukernel_net_recv_obj) },
+    { MP_ROM_QSTR(MP_QSTR_net_recv_into), MP_ROM_PTR(&mod_ukernel_net_recv_into_obj) },
+    { MP_ROM_QSTR(MP_QSTR_net_addr), MP_ROM_PTR(&mod_ukernel_net_addr_obj) },
     { MP_ROM_QSTR(MP_QSTR_net_close), MP_ROM_PTR(&mod_ukernel_net_close_obj) },
 
+    /* I/O handles */
+    { MP_ROM_QSTR(MP_QSTR_io_open), MP_ROM_PTR(&mod_ukernel_io_open_obj) },
+    { MP_ROM_QSTR(MP_QSTR_io_write), MP_ROM_PTR(&mod_ukernel_io_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_io_close), MP_ROM_PTR(&mod_ukernel_io_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR_IO_SYNC), MP_ROM_INT(ABI_IO_OPEN_SYNC) },
+
     /* Capability constants */
     { MP_ROM_QSTR(MP_QSTR_CAP_LOG), MP_ROM_INT(ABI_CAP_LOG) },
     { MP_ROM_QSTR(MP_QSTR_CAP_TIME), MP_ROM_INT(ABI_CAP_TIME) },
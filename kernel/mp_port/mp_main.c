@@ -1,6 +1,8 @@
 /*
  * MicroPython port entry point and support functions for Zigu kernel.
- * Provides: mp_do_str, mp_lexer_new_from_file, mp_import_stat, nlr_jump_fail
+ * Provides: mp_port_init, mp_port_alloc_exec, mp_port_heap_used, mp_do_str,
+ * mp_do_mpy, mp_do_frozen, mp_lexer_new_from_file, mp_reader_new_file,
+ * mp_import_stat, nlr_jump_fail
  */
 
 #include <string.h>
@@ -9,8 +11,78 @@
 #include "py/gc.h"
 #include "py/mperrno.h"
 #include "py/builtin.h"
+#include "py/bc.h"
+#include "py/persistentcode.h"
+#include "py/frozenmod.h"
+#include "py/reader.h"
 
 extern void serial_write_bytes(const char *ptr, unsigned long len);
+extern void boot_workload_ready(void);
+extern int rootfs_stat(const char *path);
+extern const unsigned char *rootfs_open(const char *path, unsigned long *len);
+
+/* Called after mp_init: imports search the workload's src/ directory on
+ * the rootfs, then frozen modules */
+void mp_port_init(void) {
+    mp_sys_path = mp_obj_new_list(0, NULL);
+    mp_obj_list_append(mp_sys_path, MP_OBJ_NEW_QSTR(MP_QSTR_src));
+    #if MICROPY_MODULE_FROZEN
+    mp_obj_list_append(mp_sys_path, MP_OBJ_NEW_QSTR(MP_QSTR__dot_frozen));
+    #endif
+}
+
+#if MICROPY_EMIT_X64
+extern void *kernel_exec_alloc(size_t min_size, size_t *size);
+extern void kernel_exec_free(void *ptr, size_t size);
+
+/* Executable memory for the native emitter; MemoryError when exhausted */
+void mp_port_alloc_exec(size_t min_size, void **ptr, size_t *size) {
+    *ptr = kernel_exec_alloc(min_size, size);
+    if (*ptr == NULL) {
+        m_malloc_fail(min_size);
+    }
+}
+
+void mp_port_free_exec(void *ptr, size_t size) {
+    kernel_exec_free(ptr, size);
+}
+#endif
+
+/* Heap occupancy for the GC telemetry in mp_bridge.zig */
+size_t mp_port_heap_used(size_t *total) {
+    gc_info_t info;
+    gc_info(&info);
+    *total = info.total;
+    return info.used;
+}
+
+extern void kernel_gc_page(uintptr_t addr, int is_free);
+
+#define GC_PAGE_SIZE 4096
+
+/* Free page reporting (kernel/balloon.zig): tell the kernel, for every
+ * whole page of each area's block pool in address order, whether all its
+ * blocks are free. Reads the allocation table as gc.c does: 2 bits per
+ * block, 0 for free. Not called during a collection. */
+void mp_port_scan_gc_pages(void) {
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = area->next) {
+        uintptr_t pool = (uintptr_t)area->gc_pool_start;
+        uintptr_t start = (pool + GC_PAGE_SIZE - 1) & ~(uintptr_t)(GC_PAGE_SIZE - 1);
+        uintptr_t end = (uintptr_t)area->gc_pool_end & ~(uintptr_t)(GC_PAGE_SIZE - 1);
+        for (uintptr_t page = start; page < end; page += GC_PAGE_SIZE) {
+            size_t block = (page - pool) / MICROPY_BYTES_PER_GC_BLOCK;
+            size_t last = (page + GC_PAGE_SIZE - 1 - pool) / MICROPY_BYTES_PER_GC_BLOCK;
+            int is_free = 1;
+            for (; block <= last; block++) {
+                if ((area->gc_alloc_table_start[block / 4] >> (2 * (block & 3))) & 3) {
+                    is_free = 0;
+                    break;
+                }
+            }
+            kernel_gc_page(page, is_free);
+        }
+    }
+}
 
 /* Compile and execute a Python source string */
 void mp_do_str(const char *src, size_t len) {
@@ -20,6 +92,8 @@ void mp_do_str(const char *src, size_t len) {
         qstr source_name = lex->source_name;
         mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
         mp_obj_t module_fun = mp_compile(&parse_tree, source_name, false);
+        /* Boot timeline ends at the first workload bytecode */
+        boot_workload_ready();
         mp_call_function_0(module_fun);
         nlr_pop();
     } else {
@@ -28,14 +102,88 @@ void mp_do_str(const char *src, size_t len) {
     }
 }
 
-/* Required by MicroPython — we don't support loading from files */
+/* Module context for precompiled code, running in the __main__ globals */
+static mp_module_context_t *main_context(void) {
+    mp_module_context_t *context = m_new_obj(mp_module_context_t);
+    context->module.base.type = &mp_type_module;
+    context->module.globals = mp_globals_get();
+    return context;
+}
+
+/* Load and execute .mpy bytecode produced by mpy-cross (no compiler pass) */
+void mp_do_mpy(const unsigned char *buf, size_t len) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_compiled_module_t cm;
+        cm.context = main_context();
+        mp_raw_code_load_mem(buf, len, &cm);
+        mp_obj_t module_fun = mp_make_function_from_proto_fun(cm.rc, cm.context, NULL);
+        boot_workload_ready();
+        mp_call_function_0(module_fun);
+        nlr_pop();
+    } else {
+        mp_obj_print_exception(&mp_plat_print, (mp_obj_t)nlr.ret_val);
+    }
+}
+
+/* Execute a module frozen into the image as __main__.
+ * Returns 0 if there is no such frozen module. */
+int mp_do_frozen(const char *name) {
+    #if MICROPY_MODULE_FROZEN_MPY
+    int frozen_type;
+    void *modref;
+    if (mp_find_frozen_module(name, &frozen_type, &modref) != MP_IMPORT_STAT_FILE
+        || frozen_type != MP_FROZEN_MPY) {
+        return 0;
+    }
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        const mp_frozen_module_t *frozen = modref;
+        mp_module_context_t *context = main_context();
+        context->constants = frozen->constants;
+        mp_obj_t module_fun = mp_make_function_from_proto_fun(frozen->proto_fun, context, NULL);
+        boot_workload_ready();
+        mp_call_function_0(module_fun);
+        nlr_pop();
+    } else {
+        mp_obj_print_exception(&mp_plat_print, (mp_obj_t)nlr.ret_val);
+    }
+    return 1;
+    #else
+    (void)name;
+    return 0;
+    #endif
+}
+
+/* Source modules from the rootfs; the file stays resident while lexing */
 mp_lexer_t *mp_lexer_new_from_file(qstr filename) {
-    mp_raise_OSError(MP_ENOENT);
+    unsigned long len;
+    const unsigned char *data = rootfs_open(qstr_str(filename), &len);
+    if (data == NULL) {
+        mp_raise_OSError(MP_ENOENT);
+    }
+    return mp_lexer_new_from_str_len(filename, (const char *)data, len, 0);
+}
+
+/* .mpy modules from the rootfs, loaded by mp_raw_code_load_file */
+void mp_reader_new_file(mp_reader_t *reader, qstr filename) {
+    unsigned long len;
+    const unsigned char *data = rootfs_open(qstr_str(filename), &len);
+    if (data == NULL) {
+        mp_raise_OSError(MP_ENOENT);
+    }
+    mp_reader_new_mem(reader, data, len, 0);
 }
 
-/* Required by MicroPython — report no files exist */
 mp_import_stat_t mp_import_stat(const char *path) {
-    return MP_IMPORT_STAT_NO_EXIST;
+    switch (rootfs_stat(path)) {
+        case 1:
+            return MP_IMPORT_STAT_DIR;
+        case 2:
+            return MP_IMPORT_STAT_FILE;
+        default:
+            return MP_IMPORT_STAT_NO_EXIST;
+    }
 }
 
 /* Called when NLR (non-local return) jump fails — should never happen */
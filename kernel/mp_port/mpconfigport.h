@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 
 // Use the minimal starting configuration (disables all optional features).
@@ -5,18 +6,54 @@
 
 #define MICROPY_ENABLE_COMPILER     (1)
 #define MICROPY_ENABLE_GC           (1)
+// __del__ on select.poll objects returns their kernel readiness set
+#define MICROPY_ENABLE_FINALISER    (1)
 #define MICROPY_HELPER_REPL         (0)
 #define MICROPY_ERROR_REPORTING     (MICROPY_ERROR_REPORTING_TERSE)
 #define MICROPY_ALLOC_PATH_MAX      (256)
 #define MICROPY_ALLOC_PARSE_CHUNK_INIT (16)
 
+// Native code emitters (@micropython.native / @micropython.viper). Machine
+// code goes in a kernel arena (kernel/exec_arena.zig), not the GC heap or
+// libc_shim's malloc; build.zig passes MICROPY_EMIT_X64=0 for -Dmp-exec-kb=0.
+#ifndef MICROPY_EMIT_X64
+#define MICROPY_EMIT_X64            (1)
+#endif
+#if MICROPY_EMIT_X64
+#define MP_PLAT_ALLOC_EXEC(min_size, ptr, size) mp_port_alloc_exec(min_size, ptr, size)
+#define MP_PLAT_FREE_EXEC(ptr, size) mp_port_free_exec(ptr, size)
+void mp_port_alloc_exec(size_t min_size, void **ptr, size_t *size);
+void mp_port_free_exec(void *ptr, size_t size);
+#endif
+
 // Disable features we don't need in freestanding kernel
 #define MICROPY_PY_BUILTINS_STR_UNICODE (0)
 #define MICROPY_PY_SYS              (1)
 #define MICROPY_PY_IO               (0)
-#define MICROPY_PY_ASYNCIO          (0)
-#define MICROPY_ENABLE_EXTERNAL_IMPORT (0)
+
+// asyncio: extmod's _asyncio task queue and time ticks, with the 'select'
+// module from modselect.c (poll objects are kernel readiness sets, so the
+// event loop blocks in io_set_wait / io_poll rather than spinning). The
+// asyncio package itself is frozen by `ukernel build`.
+#define MICROPY_PY_ASYNCIO          (1)
+#define MICROPY_PY_TIME             (1)
+#define MICROPY_PY_SELECT           (0)
+#define MICROPY_MODULE_GETATTR      (1)
+// Bytecode precompiled by mpy-cross: loaded from the rootfs (.mpy) or
+// frozen into the image. Freezing is enabled by build.zig when it is
+// given a frozen_content.c (-Dfrozen-content).
+#define MICROPY_PERSISTENT_CODE_LOAD (1)
+#ifndef MICROPY_MODULE_FROZEN_MPY
 #define MICROPY_MODULE_FROZEN_MPY   (0)
+#endif
+#if MICROPY_MODULE_FROZEN_MPY
+#define MICROPY_QSTR_EXTRA_POOL     mp_qstr_frozen_const_pool
+#endif
+
+// import resolves against the read-only rootfs (kernel/rootfs.zig) and
+// .frozen/; mp_main.c provides the file reader over it
+#define MICROPY_ENABLE_EXTERNAL_IMPORT (1)
+#define MICROPY_HAS_FILE_READER     (1)
 #define MICROPY_READER_POSIX        (0)
 #define MICROPY_READER_VFS          (0)
 #define MICROPY_VFS                 (0)
@@ -29,10 +66,13 @@ typedef intptr_t mp_int_t;
 typedef uintptr_t mp_uint_t;
 typedef long mp_off_t;
 
-// Heap size: 4MB for MicroPython GC
-#ifndef MICROPY_HEAP_SIZE
-#define MICROPY_HEAP_SIZE (4 * 1024 * 1024)
-#endif
+// GC heap in areas from the kernel page pool (kernel/pages.zig): it starts
+// at -Dmp-heap-init-kb and grows, when a collection cannot make room, up
+// to -Dmp-heap-kb.
+#define MICROPY_GC_SPLIT_HEAP       (1)
+#define MICROPY_GC_SPLIT_HEAP_AUTO  (1)
+#define MP_PLAT_ALLOC_HEAP(size)    mp_port_alloc_heap(size)
+void *mp_port_alloc_heap(size_t size);
 
 // Board identification
 #define MICROPY_HW_BOARD_NAME "zigu-ukernel"
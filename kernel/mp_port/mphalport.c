@@ -14,3 +14,28 @@ mp_uint_t mp_hal_stdout_tx_strn(const char *str, mp_uint_t len) {
     serial_write_bytes(str, len);
     return len;
 }
+
+// Sleep in the kernel: io_poll with no handles is a deadline-aware wait
+// that keeps draining trace records and the UART from its idle loop
+extern unsigned int io_poll(void *handles, unsigned int count,
+                            unsigned long timeout, unsigned long events_out,
+                            unsigned int *count_out);
+extern unsigned long long kernel_ticks_us(void);
+
+static void delay_ns(unsigned long ns) {
+    // ERR_TIMEOUT is the normal result; anything else (no CAP_IO in the
+    // workload's policy) falls back to spinning on the clock
+    if (io_poll(NULL, 0, ns, 0, NULL) == 5) return;
+    unsigned long long end = kernel_ticks_us() + ns / 1000;
+    while (kernel_ticks_us() < end) {
+        __asm__ volatile ("pause");
+    }
+}
+
+void mp_hal_delay_ms(mp_uint_t ms) {
+    if (ms > 0) delay_ns((unsigned long)ms * 1000000UL);
+}
+
+void mp_hal_delay_us(mp_uint_t us) {
+    if (us > 0) delay_ns((unsigned long)us * 1000UL);
+}
@@ -9,6 +9,21 @@ static inline mp_uint_t mp_hal_ticks_ms(void) {
     return (mp_uint_t)kernel_ticks_ms();
 }
 
+static inline mp_uint_t mp_hal_ticks_us(void) {
+    extern unsigned long long kernel_ticks_us(void);
+    return (mp_uint_t)kernel_ticks_us();
+}
+
+static inline mp_uint_t mp_hal_ticks_cpu(void) {
+    unsigned int lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((mp_uint_t)hi << 32) | lo;
+}
+
+// Sleeps wait in the kernel (io_poll deadline), in mphalport.c
+void mp_hal_delay_ms(mp_uint_t ms);
+void mp_hal_delay_us(mp_uint_t us);
+
 static inline void mp_hal_set_interrupt_char(char c) {
     (void)c;
 }
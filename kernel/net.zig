@@ -1,6 +1,13 @@
+const std = @import("std");
 const serial = @import("serial.zig");
 const virtio_net = @import("virtio_net.zig");
 const builtin = @import("builtin");
+const readiness = @import("readiness.zig");
+const config = @import("config.zig");
+const boottime = @import("boottime.zig");
+const clock = @import("clock.zig");
+const pcap = @import("pcap.zig");
+const frame_ring = @import("frame_ring.zig");
 
 // --- Static network configuration ---
 pub const OUR_IP = [4]u8{ 172, 16, 0, 2 };
@@ -27,10 +34,10 @@ const EthHeader = extern struct {
 const ETH_HDR_SIZE = @sizeOf(EthHeader);
 
 // Frame assembly buffer (used for building outgoing frames)
-var frame_buf: [1514]u8 = undefined; // 14 eth + 1500 payload max
+var frame_buf: [ETH_HDR_SIZE + virtio_net.MaxMtu]u8 = undefined;
 
 fn ethSend(dst_mac: [6]u8, ethertype: u16, payload: []const u8) bool {
-    if (payload.len > 1500) return false;
+    if (payload.len > virtio_net.getMtu()) return false;
     const our_mac = virtio_net.getMac();
 
     // Build ethernet header
@@ -78,6 +85,9 @@ const ArpEntry = struct {
 
 const ARP_TABLE_SIZE = 8;
 var arp_table: [ARP_TABLE_SIZE]ArpEntry = [_]ArpEntry{.{}} ** ARP_TABLE_SIZE;
+// Bumped whenever a cached mapping changes or is evicted; UDP header
+// templates built under an older generation are rebuilt
+var arp_generation: u32 = 0;
 
 fn arpLookup(ip: [4]u8) ?[6]u8 {
     for (arp_table) |entry| {
@@ -90,6 +100,7 @@ fn arpStore(ip: [4]u8, mac_val: [6]u8) void {
     // Update existing or find free slot
     for (&arp_table) |*entry| {
         if (entry.valid and ipEql(entry.ip, ip)) {
+            if (!std.mem.eql(u8, &entry.mac, &mac_val)) arp_generation +%= 1;
             entry.mac = mac_val;
             return;
         }
@@ -104,6 +115,7 @@ fn arpStore(ip: [4]u8, mac_val: [6]u8) void {
     }
     // Table full — overwrite first entry
     arp_table[0] = .{ .ip = ip, .mac = mac_val, .valid = true };
+    arp_generation +%= 1;
 }
 
 fn arpSendRequest(target_ip: [4]u8) void {
@@ -139,12 +151,12 @@ fn arpSendReply(target_mac: [6]u8, target_ip: [4]u8) void {
 }
 
 fn arpProcess(payload: []u8) void {
-    if (payload.len < ARP_SIZE) return;
+    if (payload.len < ARP_SIZE) return pcap.dropRx(.bad_length);
     const pkt: *const ArpPacket = @ptrCast(@alignCast(payload.ptr));
 
     // Only handle Ethernet/IPv4 ARP
-    if (pkt.htype[0] != 0x00 or pkt.htype[1] != 0x01) return;
-    if (pkt.ptype[0] != 0x08 or pkt.ptype[1] != 0x00) return;
+    if (pkt.htype[0] != 0x00 or pkt.htype[1] != 0x01) return pcap.dropRx(.unsupported);
+    if (pkt.ptype[0] != 0x08 or pkt.ptype[1] != 0x00) return pcap.dropRx(.unsupported);
 
     // Store sender in ARP table
     arpStore(pkt.spa, pkt.sha);
@@ -198,83 +210,198 @@ const Ipv4Header = extern struct {
 
 const IPV4_HDR_SIZE = @sizeOf(Ipv4Header);
 
-var ip_id_counter: u16 = 1;
+// flags_frag: flags in the top 3 bits, offset in 8-byte units below
+const DONT_FRAGMENT: u16 = 0x4000;
+const MORE_FRAGMENTS: u16 = 0x2000;
+const FRAG_OFFSET_MASK: u16 = 0x1FFF;
 
-// IP packet assembly buffer
-var ip_buf: [1500]u8 = undefined;
+var ip_id_counter: u16 = 1;
 
-fn ipChecksum(data: []const u8) u16 {
-    var sum: u32 = 0;
+/// Ones' complement sum of data as big-endian 16-bit words, folded to 16
+/// bits and not inverted. Adds 8 bytes per step into a 64-bit accumulator
+/// (with end-around carry); the sum does not depend on byte order, so the
+/// little-endian loads only need a byte swap at the end (RFC 1071).
+pub fn checksumPartial(data: []const u8) u16 {
+    var sum: u64 = 0;
     var i: usize = 0;
-    while (i + 1 < data.len) : (i += 2) {
-        sum += (@as(u32, data[i]) << 8) | @as(u32, data[i + 1]);
+    while (i + 8 <= data.len) : (i += 8) {
+        const r = @addWithOverflow(sum, std.mem.readInt(u64, data[i..][0..8], .little));
+        sum = r[0] + r[1];
     }
-    if (i < data.len) {
-        sum += @as(u32, data[i]) << 8;
+    var tail: u64 = 0;
+    var shift: u6 = 0;
+    while (i < data.len) : (i += 1) {
+        tail |= @as(u64, data[i]) << shift;
+        shift +%= 8;
     }
+    const r = @addWithOverflow(sum, tail);
+    sum = r[0] + r[1];
     while (sum > 0xFFFF) {
         sum = (sum & 0xFFFF) + (sum >> 16);
     }
-    return @intCast(~sum & 0xFFFF);
+    return @byteSwap(@as(u16, @intCast(sum)));
 }
 
-fn ipSend(dst_ip: [4]u8, protocol: u8, payload: []const u8) bool {
-    if (payload.len > 1500 - IPV4_HDR_SIZE) return false;
-
-    const total_len: u16 = @intCast(IPV4_HDR_SIZE + payload.len);
-
-    // Build IP header in ip_buf
-    var hdr: *Ipv4Header = @ptrCast(@alignCast(&ip_buf));
-    hdr.ver_ihl = 0x45;
-    hdr.tos = 0;
-    hdr.total_len = .{ @intCast(total_len >> 8), @intCast(total_len & 0xFF) };
-    hdr.id = .{ @intCast(ip_id_counter >> 8), @intCast(ip_id_counter & 0xFF) };
-    ip_id_counter +%= 1;
-    hdr.flags_frag = .{ 0x40, 0x00 }; // Don't Fragment
-    hdr.ttl = 64;
-    hdr.protocol = protocol;
-    hdr.checksum = .{ 0, 0 };
-    hdr.src = OUR_IP;
-    hdr.dst = dst_ip;
-
-    // Compute checksum
-    const cksum = ipChecksum(ip_buf[0..IPV4_HDR_SIZE]);
-    hdr.checksum = .{ @intCast(cksum >> 8), @intCast(cksum & 0xFF) };
-
-    // Copy payload after header
-    for (0..payload.len) |i| {
-        ip_buf[IPV4_HDR_SIZE + i] = payload[i];
-    }
-
-    // Determine destination MAC
-    var next_hop = dst_ip;
-    if (!sameSubnet(dst_ip, OUR_IP, OUR_NETMASK)) {
-        next_hop = GATEWAY_IP;
-    }
+pub fn ipChecksum(data: []const u8) u16 {
+    return ~checksumPartial(data);
+}
 
-    const dst_mac = arpResolve(next_hop) orelse {
-        serial.writeAll("net: ARP resolve failed\n");
-        return false;
-    };
+/// Checksum after one 16-bit field changes from old to new (RFC 1624,
+/// eqn. 3), without summing the rest again.
+pub fn checksumUpdate(check: u16, old: u16, new: u16) u16 {
+    var sum: u32 = @as(u32, ~check) + @as(u32, ~old) + new;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~@as(u16, @intCast(sum));
+}
 
-    return ethSend(dst_mac, ETHERTYPE_IPV4, ip_buf[0..total_len]);
+/// Next hop for dst: itself on our subnet, otherwise the gateway.
+fn nextHop(dst_ip: [4]u8) [4]u8 {
+    return if (sameSubnet(dst_ip, OUR_IP, OUR_NETMASK)) dst_ip else GATEWAY_IP;
 }
 
 fn ipProcess(payload: []u8) void {
-    if (payload.len < IPV4_HDR_SIZE) return;
+    if (payload.len < IPV4_HDR_SIZE) return pcap.dropRx(.bad_length);
     const hdr: *const Ipv4Header = @ptrCast(@alignCast(payload.ptr));
 
     // Only handle IPv4
-    if ((hdr.ver_ihl & 0xF0) != 0x40) return;
+    if ((hdr.ver_ihl & 0xF0) != 0x40) return pcap.dropRx(.unsupported);
     const ihl: usize = @as(usize, hdr.ver_ihl & 0x0F) * 4;
-    if (ihl < IPV4_HDR_SIZE or ihl > payload.len) return;
+    // Short frames are padded to the Ethernet minimum; the IP length counts
+    const total_len: usize = std.mem.readInt(u16, &hdr.total_len, .big);
+    if (ihl < IPV4_HDR_SIZE or total_len < ihl or total_len > payload.len) return pcap.dropRx(.bad_length);
 
     // Check destination is us
-    if (!ipEql(hdr.dst, OUR_IP)) return;
+    if (!ipEql(hdr.dst, OUR_IP)) return pcap.dropRx(.not_for_us);
+    if (hdr.protocol != PROTO_UDP) return pcap.dropRx(.unsupported);
+
+    const body = payload[ihl..total_len];
+    const flags_frag = std.mem.readInt(u16, &hdr.flags_frag, .big);
+    if (flags_frag & (MORE_FRAGMENTS | FRAG_OFFSET_MASK) == 0) {
+        udpProcessIncoming(hdr.src, body);
+        return;
+    }
+    const id = std.mem.readInt(u16, &hdr.id, .big);
+    const datagram = reassemble(hdr.src, id, hdr.protocol, flags_frag, body, clock.nowNs()) orelse return;
+    udpProcessIncoming(hdr.src, datagram);
+}
 
-    if (hdr.protocol == PROTO_UDP) {
-        udpProcessIncoming(hdr.src, payload[ihl..]);
+// --- IPv4 reassembly ---
+
+/// Largest IP payload put back together from fragments (-Dip-reasm-kb)
+pub const MaxReassembly = config.ip_reasm_size;
+/// Datagrams reassembled at once. A fragment of a new one takes a free
+/// slot, or else evicts the oldest.
+const ReasmSlots = 4;
+/// An incomplete datagram is dropped this long after its first fragment
+const ReasmTimeoutNs = 5 * std.time.ns_per_s;
+const ReasmUnits = (MaxReassembly + 7) / 8;
+
+const Reassembly = struct {
+    in_use: bool = false,
+    src: [4]u8 = .{ 0, 0, 0, 0 },
+    id: u16 = 0,
+    protocol: u8 = 0,
+    deadline_ns: u64 = 0,
+    /// Payload length, known once the last fragment (MF clear) arrived
+    total_len: usize = 0,
+    have_last: bool = false,
+    /// End of the furthest fragment so far
+    end: usize = 0,
+    /// 8-byte units received, and which ones
+    units: usize = 0,
+    filled: std.StaticBitSet(ReasmUnits) = std.StaticBitSet(ReasmUnits).initEmpty(),
+    data: [MaxReassembly]u8 = undefined,
+};
+
+var reasm: [ReasmSlots]Reassembly = [_]Reassembly{.{}} ** ReasmSlots;
+
+pub const FragStats = struct {
+    fragments_sent: u64 = 0,
+    fragments_received: u64 = 0,
+    reassembled: u64 = 0,
+    /// Incomplete datagrams dropped at their deadline
+    reasm_timeouts: u64 = 0,
+    /// Incomplete datagrams dropped for a newer one
+    reasm_evicted: u64 = 0,
+    /// Fragments with a bad length or past the end or MaxReassembly; the
+    /// datagram they belong to is dropped
+    reasm_invalid: u64 = 0,
+};
+
+pub var frag_stats: FragStats = .{};
+
+/// The slot collecting (src, id, protocol), claimed if there is none.
+/// Slots past their deadline are released on the way.
+fn reasmSlot(src: [4]u8, id: u16, protocol: u8, now_ns: u64) *Reassembly {
+    for (&reasm) |*r| {
+        if (r.in_use and now_ns >= r.deadline_ns) {
+            r.in_use = false;
+            frag_stats.reasm_timeouts += 1;
+        }
+        if (r.in_use and r.id == id and r.protocol == protocol and ipEql(r.src, src)) return r;
     }
+    var victim = &reasm[0];
+    for (&reasm) |*r| {
+        if (!r.in_use) {
+            victim = r;
+            break;
+        }
+        if (r.deadline_ns < victim.deadline_ns) victim = r;
+    }
+    if (victim.in_use) frag_stats.reasm_evicted += 1;
+    // Field by field: data is left as it is
+    victim.in_use = true;
+    victim.src = src;
+    victim.id = id;
+    victim.protocol = protocol;
+    victim.deadline_ns = now_ns + ReasmTimeoutNs;
+    victim.total_len = 0;
+    victim.have_last = false;
+    victim.end = 0;
+    victim.units = 0;
+    victim.filled = std.StaticBitSet(ReasmUnits).initEmpty();
+    return victim;
+}
+
+/// Add one fragment's payload. Returns the whole datagram once every byte
+/// has arrived; it stays valid until the next fragment is added.
+fn reassemble(src: [4]u8, id: u16, protocol: u8, flags_frag: u16, payload: []const u8, now_ns: u64) ?[]const u8 {
+    frag_stats.fragments_received += 1;
+    const more = flags_frag & MORE_FRAGMENTS != 0;
+    const offset = @as(usize, flags_frag & FRAG_OFFSET_MASK) * 8;
+    const end = offset + payload.len;
+
+    const r = reasmSlot(src, id, protocol, now_ns);
+    // Every fragment but the last carries a non-zero multiple of 8 bytes,
+    // and none reaches past the last one's end
+    const invalid = end > MaxReassembly or
+        (more and (payload.len == 0 or payload.len % 8 != 0)) or
+        (r.have_last and (end > r.total_len or (!more and end != r.total_len))) or
+        (!more and r.end > end);
+    if (invalid) {
+        r.in_use = false;
+        frag_stats.reasm_invalid += 1;
+        pcap.dropRx(.bad_fragment);
+        return null;
+    }
+    if (!more) {
+        r.have_last = true;
+        r.total_len = end;
+    }
+    @memcpy(r.data[offset..end], payload);
+    var unit = offset / 8;
+    while (unit * 8 < end) : (unit += 1) {
+        if (r.filled.isSet(unit)) continue;
+        r.filled.set(unit);
+        r.units += 1;
+    }
+    r.end = @max(r.end, end);
+
+    if (!r.have_last or r.units != (r.total_len + 7) / 8) return null;
+    r.in_use = false;
+    frag_stats.reassembled += 1;
+    return r.data[0..r.total_len];
 }
 
 // --- UDP ---
@@ -288,9 +415,18 @@ const UdpHeader = extern struct {
 
 const UDP_HDR_SIZE = @sizeOf(UdpHeader);
 
-pub const MaxUdpSockets = 16;
+/// Ethernet, IPv4 and UDP headers of a connected socket's datagrams
+const HDR_TEMPLATE_SIZE = ETH_HDR_SIZE + IPV4_HDR_SIZE + UDP_HDR_SIZE;
+const IP_OFF = ETH_HDR_SIZE;
+const UDP_OFF = ETH_HDR_SIZE + IPV4_HDR_SIZE;
+/// Larger datagrams than the MTU allows are sent as IPv4 fragments
+const MAX_UDP_PAYLOAD = 65535 - IPV4_HDR_SIZE - UDP_HDR_SIZE;
+
+pub const MaxUdpSockets = config.udp_sockets;
 
-const RX_BUF_SIZE = 2048;
+// Sized by -Dudp-rx-kb, but never past the largest datagram that arrives
+// in one frame or reassembled; longer payloads are truncated on delivery
+const RX_BUF_SIZE = @min(config.udp_rx_size, @max(MaxReassembly - UDP_HDR_SIZE, virtio_net.MaxMtu - IPV4_HDR_SIZE - UDP_HDR_SIZE));
 
 pub const UdpSocket = struct {
     in_use: bool = false,
@@ -305,21 +441,29 @@ pub const UdpSocket = struct {
     rx_src_ip: [4]u8 = .{ 0, 0, 0, 0 },
     rx_src_port: u16 = 0,
     has_data: bool = false,
+    // Headers for udpSend, with the next hop's MAC, built on the first
+    // send after connect or bind. Length, ID and checksum are zero.
+    hdr_template: [HDR_TEMPLATE_SIZE]u8 = undefined,
+    template_valid: bool = false,
+    template_arp_gen: u32 = 0,
 };
 
 pub var udp_sockets: [MaxUdpSockets]UdpSocket = [_]UdpSocket{.{}} ** MaxUdpSockets;
+// Readiness sources, kept current on delivery and receive
+pub var udp_ready: [MaxUdpSockets]readiness.Source = [_]readiness.Source{.{}} ** MaxUdpSockets;
 
-// UDP send assembly buffer
-var udp_buf: [1472]u8 = undefined; // 1500 - 20 (IP) - 8 (UDP)
 
 pub fn udpSocketInit(idx: u32) void {
     if (idx >= MaxUdpSockets) return;
     udp_sockets[idx] = .{ .in_use = true };
+    // UDP sockets are always writable
+    readiness.setLevel(&udp_ready[idx], readiness.WRITABLE);
 }
 
 pub fn udpSocketClose(idx: u32) void {
     if (idx >= MaxUdpSockets) return;
     udp_sockets[idx] = .{};
+    readiness.reset(&udp_ready[idx]);
 }
 
 pub fn udpBind(idx: u32, port: u16) bool {
@@ -327,6 +471,7 @@ pub fn udpBind(idx: u32, port: u16) bool {
     if (!udp_sockets[idx].in_use) return false;
     udp_sockets[idx].local_port = port;
     udp_sockets[idx].bound = true;
+    udp_sockets[idx].template_valid = false;
     return true;
 }
 
@@ -336,51 +481,137 @@ pub fn udpConnect(idx: u32, ip: [4]u8, port: u16) bool {
     udp_sockets[idx].remote_ip = ip;
     udp_sockets[idx].remote_port = port;
     udp_sockets[idx].connected = true;
+    udp_sockets[idx].template_valid = false;
+    return true;
+}
+
+fn writeBe16(buf: []u8, offset: usize, value: u16) void {
+    std.mem.writeInt(u16, buf[offset..][0..2], value, .big);
+}
+
+/// Resolve the route and next hop once and lay out the constant header
+/// fields, with the IPv4 checksum over everything but length and ID.
+fn buildTemplate(sock: *UdpSocket) bool {
+    const dst_mac = arpResolve(nextHop(sock.remote_ip)) orelse {
+        serial.writeAll("net: ARP resolve failed\n");
+        return false;
+    };
+    const t = &sock.hdr_template;
+    @memcpy(t[0..6], &dst_mac);
+    @memcpy(t[6..12], &virtio_net.getMac());
+    writeBe16(t, 12, ETHERTYPE_IPV4);
+
+    const ip = t[IP_OFF..UDP_OFF];
+    ip[0] = 0x45;
+    ip[1] = 0; // tos
+    writeBe16(ip, 2, 0); // total length, per datagram
+    writeBe16(ip, 4, 0); // id, per datagram
+    writeBe16(ip, 6, DONT_FRAGMENT); // cleared on fragments
+    ip[8] = 64; // ttl
+    ip[9] = PROTO_UDP;
+    writeBe16(ip, 10, 0);
+    @memcpy(ip[12..16], &OUR_IP);
+    @memcpy(ip[16..20], &sock.remote_ip);
+    writeBe16(ip, 10, ipChecksum(ip));
+
+    writeBe16(t, UDP_OFF, sock.local_port);
+    writeBe16(t, UDP_OFF + 2, sock.remote_port);
+    writeBe16(t, UDP_OFF + 4, 0); // length, per datagram
+    writeBe16(t, UDP_OFF + 6, 0); // no checksum (valid for UDP over IPv4)
+
+    sock.template_valid = true;
+    sock.template_arp_gen = arp_generation;
     return true;
 }
 
+/// Fill in the per-packet IPv4 fields of a template copy. The checksum
+/// is updated from the template's for each field that differs from it.
+fn patchIpHeader(sock: *const UdpSocket, frame: []u8, ip_len: usize, id: u16, flags_frag: u16) void {
+    const len: u16 = @intCast(ip_len);
+    var check = std.mem.readInt(u16, sock.hdr_template[IP_OFF + 10 ..][0..2], .big);
+    check = checksumUpdate(checksumUpdate(check, 0, len), 0, id);
+    if (flags_frag != DONT_FRAGMENT) check = checksumUpdate(check, DONT_FRAGMENT, flags_frag);
+    writeBe16(frame, IP_OFF + 2, len);
+    writeBe16(frame, IP_OFF + 4, id);
+    writeBe16(frame, IP_OFF + 6, flags_frag);
+    writeBe16(frame, IP_OFF + 10, check);
+}
+
+/// Send data to the connected peer: copy the socket's header template,
+/// patch length and ID, and update the IPv4 checksum incrementally.
+/// Datagrams over the MTU go out as fragments.
 pub fn udpSend(idx: u32, data: []const u8) bool {
     if (idx >= MaxUdpSockets) return false;
     const sock = &udp_sockets[idx];
     if (!sock.in_use or !sock.connected) return false;
-    if (data.len > 1472 - UDP_HDR_SIZE) return false;
+    if (data.len > MAX_UDP_PAYLOAD) return false;
+    if (!sock.template_valid or sock.template_arp_gen != arp_generation) {
+        if (!buildTemplate(sock)) {
+            pcap.dropTx(.arp_failure, HDR_TEMPLATE_SIZE + data.len);
+            return false;
+        }
+    }
 
     const udp_len: u16 = @intCast(UDP_HDR_SIZE + data.len);
+    const id = ip_id_counter;
+    ip_id_counter +%= 1;
+    const mtu: usize = virtio_net.getMtu();
+    if (IPV4_HDR_SIZE + udp_len > mtu) return udpSendFragments(sock, data, udp_len, id, mtu);
 
-    // Build UDP header
-    udp_buf[0] = @intCast(sock.local_port >> 8);
-    udp_buf[1] = @intCast(sock.local_port & 0xFF);
-    udp_buf[2] = @intCast(sock.remote_port >> 8);
-    udp_buf[3] = @intCast(sock.remote_port & 0xFF);
-    udp_buf[4] = @intCast(udp_len >> 8);
-    udp_buf[5] = @intCast(udp_len & 0xFF);
-    udp_buf[6] = 0; // checksum = 0 (valid for UDP over IPv4)
-    udp_buf[7] = 0;
-
-    // Copy data
-    for (0..data.len) |i| {
-        udp_buf[UDP_HDR_SIZE + i] = data[i];
-    }
+    const total = HDR_TEMPLATE_SIZE + data.len;
+    const frame = frame_buf[0..total];
+    @memcpy(frame[0..HDR_TEMPLATE_SIZE], &sock.hdr_template);
+    @memcpy(frame[HDR_TEMPLATE_SIZE..], data);
+    patchIpHeader(sock, frame, IPV4_HDR_SIZE + udp_len, id, DONT_FRAGMENT);
+    writeBe16(frame, UDP_OFF + 4, udp_len);
 
-    return ipSend(sock.remote_ip, PROTO_UDP, udp_buf[0..udp_len]);
+    return virtio_net.txPacket(frame);
+}
+
+/// Split the IP payload (UDP header, then data) into pieces that fit the
+/// MTU, each but the last a multiple of 8 bytes. Only the first piece
+/// carries the UDP header.
+fn udpSendFragments(sock: *const UdpSocket, data: []const u8, udp_len: u16, id: u16, mtu: usize) bool {
+    const max_piece = (mtu - IPV4_HDR_SIZE) & ~@as(usize, 7);
+    var offset: usize = 0;
+    while (offset < udp_len) {
+        const piece = @min(max_piece, udp_len - offset);
+        const more = offset + piece < udp_len;
+        const frame = frame_buf[0 .. UDP_OFF + piece];
+        @memcpy(frame[0..UDP_OFF], sock.hdr_template[0..UDP_OFF]);
+        if (offset == 0) {
+            @memcpy(frame[UDP_OFF..HDR_TEMPLATE_SIZE], sock.hdr_template[UDP_OFF..]);
+            writeBe16(frame, UDP_OFF + 4, udp_len);
+            @memcpy(frame[HDR_TEMPLATE_SIZE..], data[0 .. piece - UDP_HDR_SIZE]);
+        } else {
+            @memcpy(frame[UDP_OFF..], data[offset - UDP_HDR_SIZE ..][0..piece]);
+        }
+        const flags_frag = @as(u16, @intCast(offset / 8)) | (if (more) MORE_FRAGMENTS else 0);
+        patchIpHeader(sock, frame, IPV4_HDR_SIZE + piece, id, flags_frag);
+        if (!virtio_net.txPacket(frame)) return false;
+        frag_stats.fragments_sent += 1;
+        offset += piece;
+    }
+    return true;
 }
 
-fn udpProcessIncoming(src_ip: [4]u8, payload: []u8) void {
-    if (payload.len < UDP_HDR_SIZE) return;
+fn udpProcessIncoming(src_ip: [4]u8, payload: []const u8) void {
+    if (payload.len < UDP_HDR_SIZE) return pcap.dropRx(.bad_length);
 
     const dst_port: u16 = (@as(u16, payload[2]) << 8) | @as(u16, payload[3]);
     const src_port: u16 = (@as(u16, payload[0]) << 8) | @as(u16, payload[1]);
     const udp_len_raw: u16 = (@as(u16, payload[4]) << 8) | @as(u16, payload[5]);
 
-    if (udp_len_raw < UDP_HDR_SIZE or udp_len_raw > payload.len) return;
+    if (udp_len_raw < UDP_HDR_SIZE or udp_len_raw > payload.len) return pcap.dropRx(.bad_length);
     const data_len = udp_len_raw - UDP_HDR_SIZE;
     const data = payload[UDP_HDR_SIZE .. UDP_HDR_SIZE + data_len];
 
     // Find matching socket
-    for (&udp_sockets) |*sock| {
+    for (&udp_sockets, 0..) |*sock, idx| {
         if (!sock.in_use) continue;
         if (sock.bound and sock.local_port == dst_port) {
             // Deliver to this socket
+            if (sock.has_data) pcap.dropRx(.rx_overwrite);
             const copy_len = if (data.len > RX_BUF_SIZE) RX_BUF_SIZE else data.len;
             for (0..copy_len) |i| {
                 sock.rx_buf[i] = data[i];
@@ -389,9 +620,11 @@ fn udpProcessIncoming(src_ip: [4]u8, payload: []u8) void {
             sock.rx_src_ip = src_ip;
             sock.rx_src_port = src_port;
             sock.has_data = true;
+            readiness.notify(&udp_ready[idx], readiness.READABLE);
             return;
         }
     }
+    pcap.dropRx(.no_socket);
 }
 
 pub fn udpRecv(idx: u32, buf: []u8) ?usize {
@@ -405,6 +638,7 @@ pub fn udpRecv(idx: u32, buf: []u8) ?usize {
     }
     sock.has_data = false;
     sock.rx_len = 0;
+    readiness.clear(&udp_ready[idx], readiness.READABLE);
     return copy_len;
 }
 
@@ -415,18 +649,123 @@ pub fn udpPollReadable(idx: u32) bool {
 
 // --- Main receive loop ---
 
+var device_started: bool = false;
+
+/// Bring up virtio-net the first time the workload touches the network
+/// rather than at boot. Returns whether the device is usable.
+pub fn ensureDevice() bool {
+    if (comptime !config.net) return false;
+    if (!device_started) {
+        device_started = true;
+        _ = virtio_net.init();
+        boottime.mark(.net);
+    }
+    return virtio_net.isReady();
+}
+
 pub fn processIncoming() void {
+    if (comptime !config.net) return;
     // Drain all available RX frames
     while (virtio_net.rxPoll()) |frame| {
-        const parsed = parseEthHeader(frame) orelse continue;
+        if (comptime config.net_raw) {
+            if (steerFrame(frame)) continue;
+        }
+        const parsed = parseEthHeader(frame) orelse {
+            pcap.dropRx(.bad_length);
+            continue;
+        };
         switch (parsed.ethertype) {
             ETHERTYPE_ARP => arpProcess(parsed.payload),
             ETHERTYPE_IPV4 => ipProcess(parsed.payload),
-            else => {},
+            else => pcap.dropRx(.unsupported),
         }
     }
 }
 
+// --- Raw frame rings (net_frame_*) ---
+
+pub const MaxFrameRings = 2;
+
+var frame_rings: [MaxFrameRings]frame_ring.Ring = undefined;
+var frame_steer: [MaxFrameRings]frame_ring.Steer = [_]frame_ring.Steer{.{}} ** MaxFrameRings;
+var frame_attached: [MaxFrameRings]bool = [_]bool{false} ** MaxFrameRings;
+// Readiness sources; READABLE is re-sampled from the shared ring because
+// the workload consumes frames without a call
+pub var frame_ready: [MaxFrameRings]readiness.Source = [_]readiness.Source{.{}} ** MaxFrameRings;
+
+/// Whether a frame at the negotiated MTU fits a ring slot. Frames that do
+/// not would be dropped on steering, so setup is refused instead.
+pub fn frameFitsSlot() bool {
+    return ETH_HDR_SIZE + @as(usize, virtio_net.getMtu()) <= frame_ring.SlotSize;
+}
+
+/// Start steering matching frames to ring idx. Rings are checked in index
+/// order; the first match takes the frame.
+pub fn frameAttach(idx: u32, ring: frame_ring.Ring, steer: frame_ring.Steer) void {
+    if (idx >= MaxFrameRings) return;
+    frame_rings[idx] = ring;
+    frame_steer[idx] = steer;
+    frame_attached[idx] = true;
+    // TX is synchronous, so a ring is always writable
+    readiness.setLevel(&frame_ready[idx], readiness.WRITABLE);
+}
+
+pub fn frameDetach(idx: u32) void {
+    if (idx >= MaxFrameRings) return;
+    frame_attached[idx] = false;
+    readiness.reset(&frame_ready[idx]);
+}
+
+pub fn frameRing(idx: u32) *frame_ring.Ring {
+    return &frame_rings[idx];
+}
+
+/// Copy a received frame to the first ring whose steering matches it.
+/// Returns whether a ring claimed it (even if it had no room).
+fn steerFrame(frame: []const u8) bool {
+    for (&frame_rings, frame_steer, frame_attached, &frame_ready) |*ring, steer, attached, *ready| {
+        if (!attached or !steer.matches(frame)) continue;
+        if (ring.rxPush(frame)) {
+            readiness.notify(ready, readiness.READABLE);
+        } else {
+            pcap.dropRx(if (frame.len > frame_ring.SlotSize) .bad_length else .ring_full);
+        }
+        return true;
+    }
+    return false;
+}
+
+/// Send everything queued on ring idx, in batches of one device notify.
+/// Returns the number of frames sent.
+pub fn frameTransmit(idx: u32) u32 {
+    const ring = &frame_rings[idx];
+    var sent: u32 = 0;
+    while (true) {
+        var frames: [virtio_net.MaxTxBatch][]const u8 = undefined;
+        const batch = ring.txPeek(&frames);
+        if (batch.consumed == 0) break;
+        const n = virtio_net.txBatch(frames[0..batch.frames]);
+        ring.txRelease(batch.consumed, batch.frames - n);
+        sent += n;
+    }
+    return sent;
+}
+
+/// Events for io_poll: READABLE while received frames are unconsumed.
+pub fn frameEvents(idx: u32) u32 {
+    var ev: u32 = readiness.WRITABLE;
+    if (frame_rings[idx].rxPending() != 0) ev |= readiness.READABLE;
+    return ev;
+}
+
+/// Resample every ring a readiness set watches.
+pub fn frameUpdateReadiness() void {
+    for (frame_attached, &frame_ready, 0..) |attached, *ready, idx| {
+        if (!attached or !readiness.hasInterest(ready)) continue;
+        readiness.setLevel(ready, frameEvents(@intCast(idx)));
+    }
+}
+
 // --- Helpers ---
 
 fn ipEql(a: [4]u8, b: [4]u8) bool {
@@ -439,3 +778,105 @@ fn sameSubnet(a: [4]u8, b: [4]u8, mask: [4]u8) bool {
         (a[2] & mask[2]) == (b[2] & mask[2]) and
         (a[3] & mask[3]) == (b[3] & mask[3]);
 }
+
+// --- Tests ---
+
+// Straightforward 16-bit version of checksumPartial
+fn referenceSum(data: []const u8) u16 {
+    var sum: u32 = 0;
+    var i: usize = 0;
+    while (i + 1 < data.len) : (i += 2) {
+        sum += (@as(u32, data[i]) << 8) | data[i + 1];
+    }
+    if (i < data.len) sum += @as(u32, data[i]) << 8;
+    while (sum > 0xFFFF) sum = (sum & 0xFFFF) + (sum >> 16);
+    return @intCast(sum);
+}
+
+test "word-wide checksum matches the 16-bit sum at every length and offset" {
+    var buf: [300]u8 = undefined;
+    var prng = std.Random.DefaultPrng.init(0x1071);
+    prng.random().bytes(&buf);
+    // All-ones words exercise the end-around carry
+    @memset(buf[200..264], 0xFF);
+    for (0..9) |offset| {
+        for (0..buf.len - offset) |len| {
+            const data = buf[offset .. offset + len];
+            try std.testing.expectEqual(referenceSum(data), checksumPartial(data));
+        }
+    }
+    // The example header from RFC 1071 tutorials: checksum 0xB861
+    const hdr = [_]u8{ 0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0x00, 0x00, 0xc0, 0xa8, 0x00, 0x01, 0xc0, 0xa8, 0x00, 0xc7 };
+    try std.testing.expectEqual(@as(u16, 0xB861), ipChecksum(&hdr));
+}
+
+test "incremental checksum update equals a full recompute" {
+    var hdr = [_]u8{ 0x45, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0x00, 0x00, 172, 16, 0, 2, 172, 16, 0, 1 };
+    const base = ipChecksum(&hdr);
+    const cases = [_][2]u16{ .{ 28, 1 }, .{ 1500, 0xFFFF }, .{ 0xFFFF, 0x8000 }, .{ 20, 0 } };
+    for (cases) |c| {
+        writeBe16(&hdr, 2, c[0]);
+        writeBe16(&hdr, 4, c[1]);
+        writeBe16(&hdr, 10, 0);
+        const expected = ipChecksum(&hdr);
+        try std.testing.expectEqual(expected, checksumUpdate(checksumUpdate(base, 0, c[0]), 0, c[1]));
+        writeBe16(&hdr, 10, expected);
+        try std.testing.expectEqual(@as(u16, 0), ipChecksum(&hdr));
+        writeBe16(&hdr, 2, 0);
+        writeBe16(&hdr, 4, 0);
+    }
+}
+
+fn resetReassembly() void {
+    for (&reasm) |*r| r.in_use = false;
+    frag_stats = .{};
+}
+
+test "fragments reassemble in any order and with duplicates" {
+    resetReassembly();
+    var payload: [3000]u8 = undefined;
+    for (&payload, 0..) |*b, i| b.* = @truncate(i * 7);
+    const src = GATEWAY_IP;
+    const pieces = [_][2]usize{ .{ 1480, 2960 }, .{ 2960, 3000 }, .{ 1480, 2960 }, .{ 0, 1480 } };
+    for (pieces, 0..) |p, i| {
+        const more: u16 = if (p[1] < payload.len) MORE_FRAGMENTS else 0;
+        const flags: u16 = @as(u16, @intCast(p[0] / 8)) | more;
+        const result = reassemble(src, 77, PROTO_UDP, flags, payload[p[0]..p[1]], 0);
+        if (i + 1 < pieces.len) {
+            try std.testing.expect(result == null);
+        } else {
+            try std.testing.expectEqualSlices(u8, &payload, result.?);
+        }
+    }
+    try std.testing.expectEqual(@as(u64, 1), frag_stats.reassembled);
+    // The slot is free again: one fragment does not complete anything
+    try std.testing.expect(reassemble(src, 77, PROTO_UDP, 185 | MORE_FRAGMENTS, payload[1480..2960], 0) == null);
+}
+
+test "reassembly drops incomplete, evicted and malformed datagrams" {
+    resetReassembly();
+    const data = [_]u8{0x5a} ** 16;
+    const src = GATEWAY_IP;
+    // First half of datagram 1; the second half arrives after the deadline
+    try std.testing.expect(reassemble(src, 1, PROTO_UDP, MORE_FRAGMENTS, &data, 0) == null);
+    try std.testing.expect(reassemble(src, 1, PROTO_UDP, 2, &data, ReasmTimeoutNs) == null);
+    try std.testing.expectEqual(@as(u64, 1), frag_stats.reasm_timeouts);
+
+    // With every slot busy the oldest datagram makes room
+    resetReassembly();
+    for (0..ReasmSlots + 1) |i| {
+        try std.testing.expect(reassemble(src, @intCast(10 + i), PROTO_UDP, MORE_FRAGMENTS, &data, i) == null);
+    }
+    try std.testing.expectEqual(@as(u64, 1), frag_stats.reasm_evicted);
+    try std.testing.expectEqual(@as(usize, 32), reassemble(src, 11, PROTO_UDP, 2, &data, 10).?.len);
+    try std.testing.expect(reassemble(src, 10, PROTO_UDP, 2, &data, 10) == null);
+
+    // A middle fragment that is not a multiple of 8 bytes, one past the
+    // buffer, and a last fragment short of data already received
+    resetReassembly();
+    try std.testing.expect(reassemble(src, 20, PROTO_UDP, MORE_FRAGMENTS, data[0..12], 0) == null);
+    try std.testing.expect(reassemble(src, 21, PROTO_UDP, MORE_FRAGMENTS | FRAG_OFFSET_MASK, &data, 0) == null);
+    try std.testing.expect(reassemble(src, 22, PROTO_UDP, MORE_FRAGMENTS | 4, &data, 0) == null);
+    try std.testing.expect(reassemble(src, 22, PROTO_UDP, 0, &data, 0) == null);
+    try std.testing.expectEqual(@as(u64, 3), frag_stats.reasm_invalid);
+}
@@ -0,0 +1,202 @@
+// Kernel page allocator.
+//
+// Hands out runs of 4 KiB pages from a static pool in .bss (-Dpage-pool-kb,
+// defaulting to the MicroPython heap limit). Nothing writes a page until it
+// is allocated, so under Firecracker the untouched part of the pool never
+// becomes resident on the host. First fit over a bitmap; runs are freed
+// whole.
+//
+// Free pages handed back to the host by free page reporting (balloon.zig)
+// are marked in a second bitmap. Allocating one needs no work, the host
+// supplies a zero page on first touch; alloc only clears the mark and
+// counts the page as reclaimed.
+
+const std = @import("std");
+const config = @import("config.zig");
+
+pub const PageSize = 4096;
+
+pub fn Pool(comptime num_pages: usize) type {
+    const Words = (num_pages + 63) / 64;
+    return struct {
+        const Self = @This();
+
+        mem: [num_pages * PageSize]u8 align(PageSize) = undefined,
+        bitmap: [Words]u64 = [_]u64{0} ** Words,
+        /// Pages reported to the host since they were last written
+        reported: [Words]u64 = [_]u64{0} ** Words,
+        used: usize = 0,
+        peak: usize = 0,
+        /// Reported pages handed out again (or written by their owner)
+        reclaimed: usize = 0,
+
+        fn bitSet(bits: *const [Words]u64, page: usize) bool {
+            return (bits[page / 64] >> @intCast(page % 64)) & 1 != 0;
+        }
+
+        fn setBits(bits: *[Words]u64, first: usize, count: usize, value: bool) void {
+            for (first..first + count) |page| {
+                const bit = @as(u64, 1) << @intCast(page % 64);
+                if (value) bits[page / 64] |= bit else bits[page / 64] &= ~bit;
+            }
+        }
+
+        fn isUsed(self: *const Self, page: usize) bool {
+            return bitSet(&self.bitmap, page);
+        }
+
+        fn mark(self: *Self, first: usize, count: usize, used: bool) void {
+            setBits(&self.bitmap, first, count, used);
+        }
+
+        /// A run of `count` contiguous pages, or null if none is free.
+        pub fn alloc(self: *Self, count: usize) ?[]align(PageSize) u8 {
+            if (count == 0 or count > num_pages) return null;
+            var run: usize = 0;
+            for (0..num_pages) |page| {
+                run = if (self.isUsed(page)) 0 else run + 1;
+                if (run == count) {
+                    const first = page + 1 - count;
+                    self.mark(first, count, true);
+                    for (first..first + count) |p| _ = self.unreport(p);
+                    self.used += count;
+                    if (self.used > self.peak) self.peak = self.used;
+                    return @alignCast(self.mem[first * PageSize .. (first + count) * PageSize]);
+                }
+            }
+            return null;
+        }
+
+        /// Return a run obtained from alloc.
+        pub fn free(self: *Self, run: []u8) void {
+            const first = (@intFromPtr(run.ptr) - @intFromPtr(&self.mem)) / PageSize;
+            const count = run.len / PageSize;
+            self.mark(first, count, false);
+            self.used -= count;
+        }
+
+        /// Longest run of free pages.
+        pub fn largestFreeRun(self: *const Self) usize {
+            var best: usize = 0;
+            var run: usize = 0;
+            for (0..num_pages) |page| {
+                run = if (self.isUsed(page)) 0 else run + 1;
+                if (run > best) best = run;
+            }
+            return best;
+        }
+
+        pub fn totalPages(_: *const Self) usize {
+            return num_pages;
+        }
+
+        /// Index of the pool page holding `addr`, or null outside the pool.
+        pub fn pageIndex(self: *const Self, addr: usize) ?usize {
+            const base = @intFromPtr(&self.mem);
+            if (addr < base or addr >= base + self.mem.len) return null;
+            return (addr - base) / PageSize;
+        }
+
+        pub fn pageAddr(self: *const Self, page: usize) usize {
+            return @intFromPtr(&self.mem) + page * PageSize;
+        }
+
+        pub fn isReported(self: *const Self, page: usize) bool {
+            return bitSet(&self.reported, page);
+        }
+
+        pub fn markReported(self: *Self, first: usize, count: usize) void {
+            setBits(&self.reported, first, count, true);
+        }
+
+        /// Clear the reported mark of a page about to be written; true
+        /// (and counted as reclaimed) if it had one.
+        pub fn unreport(self: *Self, page: usize) bool {
+            if (!self.isReported(page)) return false;
+            setBits(&self.reported, page, 1, false);
+            self.reclaimed += 1;
+            return true;
+        }
+
+        /// The next run of at least `min` free pages, none of them reported
+        /// yet, starting the search at page `cursor.*`. The run is marked
+        /// reported and the cursor moved past it.
+        pub fn nextUnreported(self: *Self, cursor: *usize, min: usize) ?[]align(PageSize) u8 {
+            var run: usize = 0;
+            var page = cursor.*;
+            while (page <= num_pages) : (page += 1) {
+                if (page < num_pages and !self.isUsed(page) and !self.isReported(page)) {
+                    run += 1;
+                    continue;
+                }
+                if (run >= min and run > 0) {
+                    const first = page - run;
+                    self.markReported(first, run);
+                    cursor.* = page;
+                    return @alignCast(self.mem[first * PageSize .. page * PageSize]);
+                }
+                run = 0;
+            }
+            cursor.* = num_pages;
+            return null;
+        }
+    };
+}
+
+pub var pool: Pool(config.page_pool_size / PageSize) = .{};
+
+/// Pages needed to hold `bytes`.
+pub fn pagesFor(bytes: usize) usize {
+    return (bytes + PageSize - 1) / PageSize;
+}
+
+var test_pool: Pool(8) = .{};
+
+test "page pool first fit, free and largest run" {
+    const p = &test_pool;
+    const a = p.alloc(2).?;
+    const b = p.alloc(3).?;
+    try std.testing.expectEqual(@as(usize, 2 * PageSize), @intFromPtr(b.ptr) - @intFromPtr(a.ptr));
+    try std.testing.expectEqual(@as(usize, 3), p.largestFreeRun());
+    try std.testing.expect(p.alloc(4) == null);
+
+    // Freeing the first run leaves a 2-page hole before b
+    p.free(a);
+    try std.testing.expectEqual(@as(usize, 3), p.used);
+    const c = p.alloc(2).?;
+    try std.testing.expectEqual(@intFromPtr(a.ptr), @intFromPtr(c.ptr));
+    try std.testing.expectEqual(@as(usize, 5), p.peak);
+
+    p.free(b);
+    p.free(c);
+    try std.testing.expectEqual(@as(usize, 8), p.largestFreeRun());
+    try std.testing.expectEqual(@as(usize, 2), pagesFor(PageSize + 1));
+}
+
+var test_report_pool: Pool(8) = .{};
+
+test "page pool reports free runs once and reclaims them on alloc" {
+    const p = &test_report_pool;
+    const a = p.alloc(1).?;
+    _ = p.alloc(1).?;
+    p.free(a);
+
+    // Page 0 alone is below the minimum; pages 2..7 form one run
+    var cursor: usize = 0;
+    const run = p.nextUnreported(&cursor, 2).?;
+    try std.testing.expectEqual(p.pageAddr(2), @intFromPtr(run.ptr));
+    try std.testing.expectEqual(@as(usize, 6 * PageSize), run.len);
+    try std.testing.expect(p.nextUnreported(&cursor, 2) == null);
+    cursor = 0;
+    try std.testing.expect(p.nextUnreported(&cursor, 2) == null);
+
+    // First fit takes page 0 (never reported), then reported pages
+    _ = p.alloc(1).?;
+    try std.testing.expectEqual(@as(usize, 0), p.reclaimed);
+    const b = p.alloc(3).?;
+    try std.testing.expectEqual(p.pageAddr(2), @intFromPtr(b.ptr));
+    try std.testing.expectEqual(@as(usize, 3), p.reclaimed);
+    try std.testing.expect(!p.isReported(2) and p.isReported(5));
+    try std.testing.expectEqual(@as(?usize, 5), p.pageIndex(p.pageAddr(5) + 100));
+    try std.testing.expect(p.pageIndex(@intFromPtr(&p.mem) + p.mem.len) == null);
+}
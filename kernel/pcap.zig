@@ -0,0 +1,250 @@
+// Packet capture ring.
+//
+// virtio_net copies the first SnapLen bytes of every frame it transmits or
+// receives into a fixed ring slot, with a raw TSC timestamp and direction.
+// net.zig tags the frame it is processing with a drop reason when the
+// stack discards it, and records frames it never built (ARP failures) as
+// empty TX records. The ring is drained to serial from idle points as "#P"
+// lines that scripts/pcap_convert.py (`ukernel pcap`) turns into pcapng:
+//
+//   #Ph <tsc_hz> <snaplen>        header, once per drain session
+//   #Pr <hex>                     one Record (16 bytes) and its captured bytes
+//   #Pd <count>                   records dropped since the last drain
+//
+// When the ring is full new records are dropped and counted, as in
+// trace.zig. Compiled in with -Dpcap (on in the full profile); otherwise
+// every call is a no-op.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const serial = @import("serial.zig");
+const clock = @import("clock.zig");
+const config = @import("config.zig");
+
+pub const Dir = enum(u8) { rx = 0, tx = 1 };
+
+/// Why the stack discarded a frame. Numbering is shared with
+/// scripts/pcap_convert.py.
+pub const Reason = enum(u8) {
+    none = 0,
+    /// UDP datagram for a port no socket is bound to
+    no_socket = 1,
+    /// Delivered over an unread datagram, which is lost
+    rx_overwrite = 2,
+    /// Frame, IP or UDP length fields inconsistent with the frame
+    bad_length = 3,
+    /// Next hop did not answer ARP; the datagram was never sent
+    arp_failure = 4,
+    /// IPv4 packet for another address
+    not_for_us = 5,
+    /// Ethertype, IP version or protocol the stack does not handle
+    unsupported = 6,
+    /// Fragment that does not fit its datagram (the datagram is dropped)
+    bad_fragment = 7,
+    /// Steered to a raw frame ring that had no room for it
+    ring_full = 8,
+};
+
+pub const Record = extern struct {
+    tsc: u64,
+    /// Frame length on the wire; cap_len bytes of it follow the record
+    orig_len: u16,
+    cap_len: u16,
+    dir: u8,
+    reason: u8,
+    reserved: u16 = 0,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(Record) == 16);
+}
+
+pub const SnapLen = config.pcap_snaplen;
+
+const Slot = struct {
+    rec: Record,
+    data: [SnapLen]u8,
+};
+
+const RingSize = std.math.floorPowerOfTwo(usize, @max(config.pcap_size / @sizeOf(Slot), 1));
+const RingMask = RingSize - 1;
+
+var ring: [RingSize]Slot = undefined;
+var head: u32 = 0; // next record to drain
+var tail: u32 = 0; // next slot to write
+var dropped: u32 = 0;
+// Slot of the last RX record, for dropRx
+var last_rx: ?u32 = null;
+
+fn push(dir: Dir, reason: Reason, orig_len: usize, bytes: []const u8) ?u32 {
+    if (tail -% head >= RingSize) {
+        dropped +%= 1;
+        return null;
+    }
+    const pos = tail;
+    const slot = &ring[pos & RingMask];
+    const n = @min(bytes.len, SnapLen);
+    slot.rec = .{
+        .tsc = clock.rdtsc(),
+        .orig_len = @intCast(@min(orig_len, std.math.maxInt(u16))),
+        .cap_len = @intCast(n),
+        .dir = @intFromEnum(dir),
+        .reason = @intFromEnum(reason),
+    };
+    @memcpy(slot.data[0..n], bytes[0..n]);
+    tail +%= 1;
+    return pos;
+}
+
+/// Record a frame as it leaves or enters the device.
+pub fn capture(dir: Dir, frame: []const u8, reason: Reason) void {
+    if (comptime !config.pcap) return;
+    const pos = push(dir, reason, frame.len, frame);
+    if (dir == .rx) last_rx = pos;
+}
+
+/// Tag the frame rxPoll returned last with the reason the stack dropped
+/// it. No-op if its record was not captured or has been drained.
+pub fn dropRx(reason: Reason) void {
+    if (comptime !config.pcap) return;
+    const pos = last_rx orelse return;
+    if (tail -% pos > tail -% head) return;
+    ring[pos & RingMask].rec.reason = @intFromEnum(reason);
+}
+
+/// Record a frame of orig_len bytes that was never built.
+pub fn dropTx(reason: Reason, orig_len: usize) void {
+    if (comptime !config.pcap) return;
+    _ = push(.tx, reason, orig_len, &.{});
+}
+
+pub fn pending() u32 {
+    return tail -% head;
+}
+
+pub fn droppedCount() u32 {
+    return dropped;
+}
+
+/// The most recent record, if any is queued.
+pub fn newest() ?*const Record {
+    if (head == tail) return null;
+    return &ring[(tail -% 1) & RingMask].rec;
+}
+
+pub fn reset() void {
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    last_rx = null;
+    header_sent = false;
+}
+
+// --- Drain ---
+
+var header_sent: bool = false;
+
+const hex = "0123456789abcdef";
+
+/// Two hex characters per byte of bytes into out.
+fn hexInto(bytes: []const u8, out: []u8) []const u8 {
+    for (bytes, 0..) |b, i| {
+        out[2 * i] = hex[b >> 4];
+        out[2 * i + 1] = hex[b & 0xF];
+    }
+    return out[0 .. 2 * bytes.len];
+}
+
+/// "#Pr <hex>\n" for one slot. Encoded in small chunks: drain runs deep in
+/// VM calls on the boot stack, and a full-snaplen line would not fit there.
+fn writeRecord(slot: *const Slot) void {
+    var buf: [64]u8 = undefined;
+    const chunk = buf.len / 2;
+    serial.writeAll("#Pr ");
+    for ([_][]const u8{ std.mem.asBytes(&slot.rec), slot.data[0..slot.rec.cap_len] }) |part| {
+        var i: usize = 0;
+        while (i < part.len) : (i += chunk) {
+            serial.writeAll(hexInto(part[i..@min(part.len, i + chunk)], &buf));
+        }
+    }
+    serial.writeAll("\n");
+}
+
+/// Write up to max_records records to serial. Called from idle points so
+/// the capture path never touches the UART.
+pub fn drain(max_records: u32) void {
+    if (comptime !config.pcap) return;
+    if (builtin.is_test) return;
+    if (head == tail and dropped == 0) return;
+
+    if (!header_sent) {
+        serial.writeAll("#Ph ");
+        serial.writeDec(clock.frequency());
+        serial.writeByte(' ');
+        serial.writeDec(SnapLen);
+        serial.writeAll("\n");
+        header_sent = true;
+    }
+
+    var n: u32 = 0;
+    while (n < max_records and head != tail) : (n += 1) {
+        writeRecord(&ring[head & RingMask]);
+        head +%= 1;
+    }
+
+    if (dropped != 0) {
+        serial.writeAll("#Pd ");
+        serial.writeDec(dropped);
+        serial.writeAll("\n");
+        dropped = 0;
+    }
+}
+
+/// Drain everything (end of workload, panic).
+pub fn flush() void {
+    drain(RingSize);
+}
+
+test "frames are captured up to the snap length and tagged with drops" {
+    if (!config.pcap) return error.SkipZigTest;
+    reset();
+    var frame: [SnapLen + 40]u8 = undefined;
+    for (&frame, 0..) |*b, i| b.* = @truncate(i);
+
+    capture(.tx, &frame, .none);
+    capture(.rx, frame[0..20], .none);
+    dropRx(.no_socket);
+    dropTx(.arp_failure, 42);
+    try std.testing.expectEqual(@as(u32, 3), pending());
+
+    const tx = &ring[0];
+    try std.testing.expectEqual(@as(u16, frame.len), tx.rec.orig_len);
+    try std.testing.expectEqual(@as(u16, SnapLen), tx.rec.cap_len);
+    try std.testing.expectEqualSlices(u8, frame[0..SnapLen], &tx.data);
+    try std.testing.expectEqual(@intFromEnum(Reason.no_socket), ring[1].rec.reason);
+    try std.testing.expectEqual(@intFromEnum(Dir.rx), ring[1].rec.dir);
+    const arp = newest().?;
+    try std.testing.expectEqual(@intFromEnum(Reason.arp_failure), arp.reason);
+    try std.testing.expectEqual(@as(u16, 0), arp.cap_len);
+
+    var buf: [2 * 20]u8 = undefined;
+    const rx = &ring[1];
+    try std.testing.expectEqualStrings("000102030405060708090a0b0c0d0e0f10111213", hexInto(rx.data[0..rx.rec.cap_len], &buf));
+    reset();
+}
+
+test "full ring drops new records and stale drop tags are ignored" {
+    if (!config.pcap) return error.SkipZigTest;
+    reset();
+    const frame = [_]u8{0xab} ** 60;
+    capture(.rx, &frame, .none);
+    var i: usize = 1;
+    while (i < RingSize + 2) : (i += 1) capture(.tx, &frame, .none);
+    try std.testing.expectEqual(@as(u32, RingSize), pending());
+    try std.testing.expectEqual(@as(u32, 2), droppedCount());
+    // An RX frame that did not fit clears the tag target
+    capture(.rx, &frame, .none);
+    dropRx(.not_for_us);
+    try std.testing.expectEqual(@as(u8, 0), ring[0].rec.reason);
+    reset();
+}
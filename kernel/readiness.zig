@@ -0,0 +1,320 @@
+// Readiness sets (epoll-style).
+//
+// Every pollable object owns a Source holding its current event state and
+// the list of registrations interested in it. Producers (UDP delivery,
+// timer callbacks, the serial probe) push state changes with notify() /
+// setLevel(); a registration whose interest matches is appended to its
+// set's ready queue. collect() walks only the ready queue, so a wait costs
+// O(ready) rather than O(registered).
+//
+// Level-triggered registrations stay queued while the source is still
+// ready; edge-triggered ones are reported once per notification.
+
+const std = @import("std");
+
+// Same bit values as IO_READABLE/IO_WRITABLE/IO_HANGUP/IO_ERROR in abi.zig.
+pub const READABLE: u32 = 0x01;
+pub const WRITABLE: u32 = 0x02;
+pub const HANGUP: u32 = 0x04;
+pub const ERROR: u32 = 0x08;
+// Interest flag: report transitions only.
+pub const EDGE: u32 = 0x8000_0000;
+
+// Always reported, whether or not they were asked for.
+const ALWAYS: u32 = HANGUP | ERROR;
+
+pub const MaxSets = 8;
+pub const MaxRegs = 128;
+
+pub const Event = extern struct {
+    handle: u64,
+    user_data: u64,
+    events: u32,
+    reserved: u32 = 0,
+};
+
+pub const Source = struct {
+    state: u32 = 0,
+    regs: ?*Reg = null,
+};
+
+pub const Reg = struct {
+    in_use: bool = false,
+    set: u32 = 0,
+    handle: u64 = 0,
+    user_data: u64 = 0,
+    events: u32 = 0,
+    pending: u32 = 0,
+    source: ?*Source = null,
+    src_next: ?*Reg = null,
+    src_prev: ?*Reg = null,
+    // Ready queue links
+    queued: bool = false,
+    ready_next: ?*Reg = null,
+    ready_prev: ?*Reg = null,
+};
+
+const ReadyQueue = struct {
+    head: ?*Reg = null,
+    tail: ?*Reg = null,
+    len: u32 = 0,
+};
+
+var regs: [MaxRegs]Reg = [_]Reg{.{}} ** MaxRegs;
+var queues: [MaxSets]ReadyQueue = [_]ReadyQueue{.{}} ** MaxSets;
+
+fn mask(r: *const Reg) u32 {
+    return (r.events & ~EDGE) | ALWAYS;
+}
+
+fn isEdge(r: *const Reg) bool {
+    return (r.events & EDGE) != 0;
+}
+
+fn enqueue(r: *Reg) void {
+    if (r.queued) return;
+    const q = &queues[r.set];
+    r.queued = true;
+    r.ready_next = null;
+    r.ready_prev = q.tail;
+    if (q.tail) |t| {
+        t.ready_next = r;
+    } else {
+        q.head = r;
+    }
+    q.tail = r;
+    q.len += 1;
+}
+
+fn dequeue(r: *Reg) void {
+    if (!r.queued) return;
+    const q = &queues[r.set];
+    if (r.ready_prev) |p| {
+        p.ready_next = r.ready_next;
+    } else {
+        q.head = r.ready_next;
+    }
+    if (r.ready_next) |n| {
+        n.ready_prev = r.ready_prev;
+    } else {
+        q.tail = r.ready_prev;
+    }
+    r.queued = false;
+    r.ready_next = null;
+    r.ready_prev = null;
+    q.len -= 1;
+}
+
+fn unlinkSource(r: *Reg) void {
+    const src = r.source orelse return;
+    if (r.src_prev) |p| {
+        p.src_next = r.src_next;
+    } else {
+        src.regs = r.src_next;
+    }
+    if (r.src_next) |n| n.src_prev = r.src_prev;
+    r.source = null;
+    r.src_next = null;
+    r.src_prev = null;
+}
+
+/// Find the registration for handle in a set.
+pub fn find(set: u32, handle: u64) ?*Reg {
+    for (&regs) |*r| {
+        if (r.in_use and r.set == set and r.handle == handle) return r;
+    }
+    return null;
+}
+
+/// Register interest; returns null when the registration pool is full.
+/// A source that is already ready is queued immediately.
+pub fn register(set: u32, src: *Source, handle: u64, events: u32, user_data: u64) ?*Reg {
+    for (&regs) |*r| {
+        if (r.in_use) continue;
+        r.* = .{
+            .in_use = true,
+            .set = set,
+            .handle = handle,
+            .user_data = user_data,
+            .events = events,
+            .source = src,
+            .src_next = src.regs,
+        };
+        if (src.regs) |h| h.src_prev = r;
+        src.regs = r;
+        const ready = src.state & mask(r);
+        if (ready != 0) {
+            r.pending = ready;
+            enqueue(r);
+        }
+        return r;
+    }
+    return null;
+}
+
+/// Change the interest mask; current readiness is re-evaluated as on add.
+pub fn modify(r: *Reg, events: u32, user_data: u64) void {
+    r.events = events;
+    r.user_data = user_data;
+    const src = r.source orelse return;
+    const ready = src.state & mask(r);
+    r.pending = ready;
+    if (ready != 0) enqueue(r) else dequeue(r);
+}
+
+pub fn unregister(r: *Reg) void {
+    dequeue(r);
+    unlinkSource(r);
+    r.* = .{};
+}
+
+/// Raise state bits on a source and queue every interested registration.
+/// Call on each arrival, even if the bit was already set, so edge-triggered
+/// waiters see new data.
+pub fn notify(src: *Source, bits: u32) void {
+    src.state |= bits;
+    var it = src.regs;
+    while (it) |r| : (it = r.src_next) {
+        const hit = bits & mask(r);
+        if (hit == 0) continue;
+        r.pending |= hit;
+        enqueue(r);
+    }
+}
+
+/// Lower state bits; level-triggered registrations drop out of the ready
+/// queue on the next collect().
+pub fn clear(src: *Source, bits: u32) void {
+    src.state &= ~bits;
+}
+
+/// Replace the state of a polled source, notifying only on rising bits.
+pub fn setLevel(src: *Source, state: u32) void {
+    const rising = state & ~src.state;
+    src.state = state;
+    if (rising != 0) notify(src, rising);
+}
+
+pub fn hasInterest(src: *const Source) bool {
+    return src.regs != null;
+}
+
+/// Drop every registration on a source and clear its state (object closed).
+pub fn reset(src: *Source) void {
+    while (src.regs) |r| unregister(r);
+    src.state = 0;
+}
+
+/// Drop the registrations a set holds for one handle.
+pub fn dropHandle(src: *Source, handle: u64) void {
+    var it = src.regs;
+    while (it) |r| {
+        it = r.src_next;
+        if (r.handle == handle) unregister(r);
+    }
+}
+
+pub fn closeSet(set: u32) void {
+    for (&regs) |*r| {
+        if (r.in_use and r.set == set) unregister(r);
+    }
+    queues[set] = .{};
+}
+
+pub fn resetAll() void {
+    for (&regs) |*r| {
+        if (r.in_use) unregister(r);
+    }
+    queues = [_]ReadyQueue{.{}} ** MaxSets;
+}
+
+/// Move ready events into out. Only queued registrations are visited.
+pub fn collect(set: u32, out: []Event) u32 {
+    const q = &queues[set];
+    var n: u32 = 0;
+    var budget = q.len;
+    while (budget > 0 and n < out.len) : (budget -= 1) {
+        const r = q.head orelse break;
+        dequeue(r);
+        const src = r.source orelse continue;
+        const ev = if (isEdge(r)) r.pending & mask(r) else src.state & mask(r);
+        r.pending = 0;
+        if (ev == 0) continue;
+        out[n] = .{ .handle = r.handle, .user_data = r.user_data, .events = ev };
+        n += 1;
+        // Level-triggered: stay queued while still ready
+        if (!isEdge(r)) enqueue(r);
+    }
+    return n;
+}
+
+test "level-triggered stays ready until cleared" {
+    resetAll();
+    var src: Source = .{};
+    _ = register(0, &src, 42, READABLE, 7).?;
+    var out: [4]Event = undefined;
+    try std.testing.expectEqual(@as(u32, 0), collect(0, out[0..]));
+
+    notify(&src, READABLE);
+    try std.testing.expectEqual(@as(u32, 1), collect(0, out[0..]));
+    try std.testing.expectEqual(@as(u64, 42), out[0].handle);
+    try std.testing.expectEqual(@as(u64, 7), out[0].user_data);
+    try std.testing.expectEqual(READABLE, out[0].events);
+    try std.testing.expectEqual(@as(u32, 1), collect(0, out[0..]));
+
+    clear(&src, READABLE);
+    try std.testing.expectEqual(@as(u32, 0), collect(0, out[0..]));
+    reset(&src);
+}
+
+test "edge-triggered reports once per notification" {
+    resetAll();
+    var src: Source = .{};
+    _ = register(1, &src, 5, READABLE | EDGE, 0).?;
+    var out: [4]Event = undefined;
+
+    notify(&src, READABLE);
+    try std.testing.expectEqual(@as(u32, 1), collect(1, out[0..]));
+    try std.testing.expectEqual(@as(u32, 0), collect(1, out[0..]));
+
+    // A new arrival fires again even though the bit never dropped
+    notify(&src, READABLE);
+    try std.testing.expectEqual(@as(u32, 1), collect(1, out[0..]));
+    reset(&src);
+}
+
+test "register reports existing readiness and setLevel fires on rising bits" {
+    resetAll();
+    var src: Source = .{};
+    setLevel(&src, WRITABLE);
+    _ = register(2, &src, 9, WRITABLE | EDGE, 0).?;
+    var out: [4]Event = undefined;
+    try std.testing.expectEqual(@as(u32, 1), collect(2, out[0..]));
+
+    setLevel(&src, WRITABLE);
+    try std.testing.expectEqual(@as(u32, 0), collect(2, out[0..]));
+    setLevel(&src, 0);
+    setLevel(&src, WRITABLE);
+    try std.testing.expectEqual(@as(u32, 1), collect(2, out[0..]));
+    reset(&src);
+}
+
+test "unregister and closeSet remove queued registrations" {
+    resetAll();
+    var a: Source = .{};
+    var b: Source = .{};
+    const ra = register(3, &a, 1, READABLE, 0).?;
+    _ = register(3, &b, 2, READABLE, 0).?;
+    notify(&a, READABLE);
+    notify(&b, READABLE);
+    unregister(ra);
+    try std.testing.expect(find(3, 1) == null);
+
+    var out: [4]Event = undefined;
+    try std.testing.expectEqual(@as(u32, 1), collect(3, out[0..]));
+    try std.testing.expectEqual(@as(u64, 2), out[0].handle);
+
+    closeSet(3);
+    try std.testing.expect(!hasInterest(&b));
+    try std.testing.expectEqual(@as(u32, 0), collect(3, out[0..]));
+}
@@ -0,0 +1,226 @@
+// Read-only view of the rootfs, used by MicroPython's import machinery.
+//
+// The drive holds a bundle (bundle.zig, written by `ukernel pack`) or, as a
+// fallback, a tar. Either is indexed once (on first use) into a table of
+// paths kept sorted for binary search; a bundle's index is already in
+// order. Directories are implied by the paths under them, so archives
+// without explicit directory members still resolve packages. File contents
+// are served from the boot prefetch window when they fall inside it,
+// otherwise read once into a bump-allocated cache (-Drootfs-cache-kb), so
+// later stats, imports and re-imports never go back to the device. Bundle
+// extents are read and decompressed straight into the cache.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const serial = @import("serial.zig");
+const config = @import("config.zig");
+const tar = @import("tar.zig");
+const bundle = @import("bundle.zig");
+const virtio_blk = @import("virtio_blk.zig");
+
+const MaxFiles = 256;
+const PathMax = 128;
+
+const Node = struct {
+    path_buf: [PathMax]u8,
+    path_len: u8,
+    is_dir: bool,
+    data_offset: u64,
+    size: usize,
+    /// Where a bundle stores the contents (null for tar members)
+    extent: ?bundle.Extent,
+    /// Resident contents once read (prefetch window or cache)
+    data: ?[]const u8,
+
+    fn path(self: *const Node) []const u8 {
+        return self.path_buf[0..self.path_len];
+    }
+};
+
+var nodes: [MaxFiles]Node = undefined;
+var node_count: usize = 0;
+var mounted: bool = false;
+
+var cache_buf: [config.rootfs_cache_size]u8 align(16) = undefined;
+var cache_used: usize = 0;
+
+pub const Stat = enum(c_int) {
+    // Values match MicroPython's mp_import_stat_t
+    none = 0,
+    dir = 1,
+    file = 2,
+};
+
+/// Index the archive. Safe to call repeatedly; only the first call scans.
+pub fn mount() bool {
+    if (mounted) return true;
+    if (comptime !config.blk or builtin.is_test) return false;
+    if (!virtio_blk.isReady()) return false;
+    mounted = true;
+
+    if (bundle.open()) |index| {
+        var i: u32 = 0;
+        while (i < index.count) : (i += 1) {
+            const entry = index.entry(i);
+            if (!addNode(entry.name, entry.is_dir, entry.extent.offset, entry.extent.size, entry.extent)) {
+                serial.writeAll("rootfs: index full or path too long, skipping entries\n");
+            }
+        }
+        return true;
+    }
+
+    var offset: u64 = 0;
+    while (tar.nextEntry(&offset)) |entry| {
+        if (!entry.is_file and !entry.is_dir) continue;
+        if (!addNode(entry.name(), entry.is_dir, entry.data_offset, entry.size, null)) {
+            serial.writeAll("rootfs: index full or path too long, skipping entries\n");
+        }
+    }
+    return true;
+}
+
+/// First node whose path is not below path.
+fn lowerBound(path: []const u8) usize {
+    var lo: usize = 0;
+    var hi = node_count;
+    while (lo < hi) {
+        const mid = lo + (hi - lo) / 2;
+        if (std.mem.lessThan(u8, nodes[mid].path(), path)) lo = mid + 1 else hi = mid;
+    }
+    return lo;
+}
+
+/// Insert in path order. Bundle entries arrive sorted and are appended; a
+/// later tar member with the same path shadows the earlier one.
+fn addNode(path: []const u8, is_dir: bool, data_offset: u64, size: usize, extent: ?bundle.Extent) bool {
+    if (node_count >= MaxFiles or path.len == 0 or path.len > PathMax) return false;
+    const pos = lowerBound(path);
+    std.mem.copyBackwards(Node, nodes[pos + 1 .. node_count + 1], nodes[pos..node_count]);
+    const node = &nodes[pos];
+    @memcpy(node.path_buf[0..path.len], path);
+    node.path_len = @intCast(path.len);
+    node.is_dir = is_dir;
+    node.data_offset = data_offset;
+    node.size = size;
+    node.extent = extent;
+    node.data = null;
+    node_count += 1;
+    return true;
+}
+
+fn find(path: []const u8) ?*Node {
+    const pos = lowerBound(path);
+    if (pos < node_count and std.mem.eql(u8, nodes[pos].path(), path)) return &nodes[pos];
+    return null;
+}
+
+fn hasChildren(path: []const u8) bool {
+    // Paths under "path/" sort together, from the first one not below it
+    var prefix_buf: [PathMax + 1]u8 = undefined;
+    if (path.len >= PathMax) return false;
+    const prefix = prefix_buf[0 .. path.len + 1];
+    @memcpy(prefix[0..path.len], path);
+    prefix[path.len] = '/';
+    const pos = lowerBound(prefix);
+    return pos < node_count and std.mem.startsWith(u8, nodes[pos].path(), prefix);
+}
+
+/// Type of the rootfs entry at path (no leading "/" or "./").
+pub fn stat(path: []const u8) Stat {
+    if (!mount()) return .none;
+    if (find(path)) |node| return if (node.is_dir) .dir else .file;
+    return if (hasChildren(path)) .dir else .none;
+}
+
+/// Like stat, but hides "x.py" when "x.mpy" exists, so imports load the
+/// precompiled bytecode (MicroPython itself tries .py first).
+pub fn importStat(path: []const u8) Stat {
+    const st = stat(path);
+    if (st != .file or !std.mem.endsWith(u8, path, ".py")) return st;
+    var mpy_buf: [PathMax + 1]u8 = undefined;
+    if (path.len + 1 > mpy_buf.len) return st;
+    const stem = path[0 .. path.len - 2];
+    @memcpy(mpy_buf[0..stem.len], stem);
+    @memcpy(mpy_buf[stem.len .. stem.len + 3], "mpy");
+    return if (stat(mpy_buf[0 .. path.len + 1]) == .file) .none else st;
+}
+
+/// Contents of the file at path. The slice stays valid for the life of the
+/// kernel, except when the cache is full: then it is only valid until the
+/// next open.
+pub fn open(path: []const u8) ?[]const u8 {
+    if (!mount()) return null;
+    const node = find(path) orelse return null;
+    if (node.is_dir) return null;
+    if (node.data) |data| return data;
+    if (node.extent) |extent| return openExtent(node, extent);
+
+    const entry = tar.Entry{ .is_file = true, .data_offset = node.data_offset, .size = node.size };
+    const data = tar.readData(&entry) orelse return null;
+    if (tar.isPrefetched(data)) {
+        node.data = data;
+        return data;
+    }
+    if (data.len <= cache_buf.len - cache_used) {
+        const cached = cache_buf[cache_used .. cache_used + data.len];
+        @memcpy(cached, data);
+        cache_used = std.mem.alignForward(usize, cache_used + data.len, 16);
+        if (cache_used > cache_buf.len) cache_used = cache_buf.len;
+        node.data = cached;
+        return cached;
+    }
+    return data;
+}
+
+fn openExtent(node: *Node, extent: bundle.Extent) ?[]const u8 {
+    if (bundle.resident(extent)) |data| {
+        node.data = data;
+        return data;
+    }
+    const need = bundle.destSize(extent);
+    if (need > cache_buf.len - cache_used) return bundle.loadShared(extent);
+    const data = bundle.load(extent, cache_buf[cache_used..][0..need]) orelse return null;
+    cache_used = std.mem.alignForward(usize, cache_used + data.len, 16);
+    if (cache_used > cache_buf.len) cache_used = cache_buf.len;
+    node.data = data;
+    return data;
+}
+
+pub fn reset() void {
+    node_count = 0;
+    mounted = false;
+    cache_used = 0;
+}
+
+test "rootfs stat resolves implied directories and prefers bytecode" {
+    reset();
+    mounted = true;
+    defer reset();
+    try std.testing.expect(addNode("src/main.py", false, 512, 10, null));
+    try std.testing.expect(addNode("src/util.py", false, 1536, 10, null));
+    try std.testing.expect(addNode("src/util.mpy", false, 2560, 10, null));
+    try std.testing.expect(addNode("src/pkg/__init__.mpy", false, 3584, 10, null));
+
+    try std.testing.expectEqual(Stat.file, stat("src/main.py"));
+    try std.testing.expectEqual(Stat.dir, stat("src"));
+    try std.testing.expectEqual(Stat.dir, stat("src/pkg"));
+    try std.testing.expectEqual(Stat.none, stat("src/pk"));
+    try std.testing.expectEqual(Stat.none, stat("src/missing.py"));
+
+    try std.testing.expectEqual(Stat.file, importStat("src/main.py"));
+    try std.testing.expectEqual(Stat.none, importStat("src/util.py"));
+    try std.testing.expectEqual(Stat.file, importStat("src/util.mpy"));
+    try std.testing.expectEqual(Stat.none, importStat("src/pkg/__init__.py"));
+    try std.testing.expectEqual(Stat.file, importStat("src/pkg/__init__.mpy"));
+}
+
+test "rootfs open returns resident data without touching the device" {
+    reset();
+    mounted = true;
+    defer reset();
+    try std.testing.expect(addNode("src/a.py", false, 512, 5, null));
+    nodes[0].data = "x = 1";
+    try std.testing.expectEqualStrings("x = 1", open("src/a.py").?);
+    try std.testing.expect(open("src/b.py") == null);
+    try std.testing.expect(!addNode("", false, 0, 0, null));
+}
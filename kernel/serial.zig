@@ -1,15 +1,19 @@
 const std = @import("std");
 const builtin = @import("builtin");
+const config = @import("config.zig");
 
 const Com1: u16 = 0x3F8;
 
 fn outb(port: u16, value: u8) void {
+    if (comptime config.hosted) return;
     if (comptime builtin.cpu.arch == .x86_64) {
         asm volatile ("outb %[value], %[port]" : : [value] "{al}" (value), [port] "{dx}" (port));
     }
 }
 
 fn inb(port: u16) u8 {
+    // No UART on the host: an always-empty transmitter lets pump() drain
+    if (comptime config.hosted) return if (port == Com1 + 5) 0x60 else 0;
     if (comptime builtin.cpu.arch == .x86_64) {
         var value: u8 = 0;
         asm volatile ("inb %[port], %[value]" : [value] "={al}" (value) : [port] "{dx}" (port));
@@ -40,22 +44,118 @@ pub fn init() void {
     outb(Com1 + 4, 0x0B);
 }
 
-pub fn writeByte(byte: u8) void {
-    while (!txReady()) {
-        if (comptime builtin.cpu.arch == .x86_64) {
-            asm volatile ("pause");
+// Transmit ring. Writers enqueue and return; pump() moves bytes into the
+// UART in bursts of FifoDepth per LSR check (init enables the 16-byte FIFO).
+// Console writes block only when the ring is full; records written with
+// tryWriteRecord() are dropped instead.
+const TxRingSize: u32 = 64 * 1024; // power of two
+const TxMask: u32 = TxRingSize - 1;
+const FifoDepth = 16;
+
+var tx_ring: [TxRingSize]u8 = undefined;
+var tx_head: u32 = 0;
+var tx_tail: u32 = 0;
+
+fn txFree() u32 {
+    return TxRingSize - (tx_tail -% tx_head);
+}
+
+fn txPut(byte: u8) void {
+    tx_ring[tx_tail & TxMask] = byte;
+    tx_tail +%= 1;
+}
+
+fn cpuRelax() void {
+    if (comptime builtin.cpu.arch == .x86_64) {
+        asm volatile ("pause");
+    }
+}
+
+pub fn pending() u32 {
+    return tx_tail -% tx_head;
+}
+
+/// Move queued bytes into the UART without waiting. Safe to call from any
+/// idle point.
+pub fn pump() void {
+    while (tx_head != tx_tail and txReady()) {
+        // THRE set: the FIFO is empty, so a full burst fits
+        var n: u32 = 0;
+        while (n < FifoDepth and tx_head != tx_tail) : (n += 1) {
+            outb(Com1, tx_ring[tx_head & TxMask]);
+            tx_head +%= 1;
         }
     }
-    outb(Com1, byte);
+}
+
+/// Block until everything queued has reached the UART (exit, panic).
+pub fn flush() void {
+    while (tx_head != tx_tail) {
+        pump();
+        cpuRelax();
+    }
+}
+
+fn waitForSpace(needed: u32) void {
+    while (txFree() < needed) {
+        pump();
+        cpuRelax();
+    }
+}
+
+pub fn writeByte(byte: u8) void {
+    waitForSpace(1);
+    txPut(byte);
+    pump();
 }
 
 pub fn writeAll(msg: []const u8) void {
     for (msg) |b| {
+        waitForSpace(2);
         if (b == '\n') {
-            writeByte('\r');
+            txPut('\r');
         }
-        writeByte(b);
+        txPut(b);
     }
+    pump();
+}
+
+/// Write value in decimal.
+pub fn writeDec(value: u64) void {
+    var buf: [20]u8 = undefined;
+    var v = value;
+    var i: usize = buf.len;
+    while (true) {
+        i -= 1;
+        buf[i] = @intCast('0' + v % 10);
+        v /= 10;
+        if (v == 0) break;
+    }
+    writeAll(buf[i..]);
+}
+
+fn encodedLen(bytes: []const u8) u32 {
+    var n: u32 = @intCast(bytes.len);
+    for (bytes) |b| {
+        if (b == '\n') n += 1;
+    }
+    return n;
+}
+
+/// Queue the concatenation of parts as one record if it fits whole.
+/// Returns false (nothing queued) when the ring is too full. Does not
+/// touch the UART; callers pump() when convenient.
+pub fn tryWriteRecord(parts: []const []const u8) bool {
+    var needed: u32 = 0;
+    for (parts) |part| needed += encodedLen(part);
+    if (needed > txFree()) return false;
+    for (parts) |part| {
+        for (part) |b| {
+            if (b == '\n') txPut('\r');
+            txPut(b);
+        }
+    }
+    return true;
 }
 
 pub fn writer() std.io.Writer(void, error{}, writeFn) {
@@ -66,3 +166,17 @@ fn writeFn(_: void, bytes: []const u8) error{}!usize {
     writeAll(bytes);
     return bytes.len;
 }
+
+test "tryWriteRecord admits whole records or nothing" {
+    tx_head = 0;
+    tx_tail = 0;
+    const line = "x" ** 1023 ++ "\n";
+    var written: u32 = 0;
+    while (tryWriteRecord(&.{line})) written += 1;
+    // 1025 encoded bytes per record
+    try std.testing.expectEqual(TxRingSize / 1025, written);
+    try std.testing.expectEqual(written * 1025, pending());
+    try std.testing.expect(tryWriteRecord(&.{"short"}));
+    tx_head = 0;
+    tx_tail = 0;
+}
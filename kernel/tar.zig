@@ -1,5 +1,7 @@
+const std = @import("std");
 const serial = @import("serial.zig");
 const virtio_blk = @import("virtio_blk.zig");
+const bundle = @import("bundle.zig");
 
 // Tar header (POSIX ustar format) — 512 bytes
 const TAR_BLOCK_SIZE = 512;
@@ -39,31 +41,10 @@ fn parseOctal(field: []const u8) usize {
     return result;
 }
 
-/// Check if a tar header name matches a target filename.
-/// Handles leading "./" prefix that tar may add.
-fn nameMatch(header_name: []const u8, target: []const u8) bool {
-    // Find the actual name end (null-terminated)
-    var name_len: usize = 0;
-    while (name_len < header_name.len and header_name[name_len] != 0) : (name_len += 1) {}
-    const name = header_name[0..name_len];
-
-    // Direct match
-    if (strEql(name, target)) return true;
-
-    // Match with "./" prefix stripped
-    if (name.len > 2 and name[0] == '.' and name[1] == '/') {
-        if (strEql(name[2..], target)) return true;
-    }
-
-    return false;
-}
-
-fn strEql(a: []const u8, b: []const u8) bool {
-    if (a.len != b.len) return false;
-    for (a, b) |ca, cb| {
-        if (ca != cb) return false;
-    }
-    return true;
+fn cStr(field: []const u8) []const u8 {
+    var len: usize = 0;
+    while (len < field.len and field[len] != 0) : (len += 1) {}
+    return field[0..len];
 }
 
 fn isZeroBlock(buf: []const u8) bool {
@@ -76,24 +57,85 @@ fn isZeroBlock(buf: []const u8) bool {
 // Maximum file size we'll load from tar (1MB)
 const MAX_FILE_SIZE = 1024 * 1024;
 
-// Static buffer for loaded file content
-var file_buf: [MAX_FILE_SIZE]u8 = undefined;
+// Static buffer for loaded file content. A rootfs drive is a tar or a
+// bundle, never both, so bundle.loadShared decodes into the same buffer.
+var file_buf: [@max(MAX_FILE_SIZE, bundle.MaxDestSize)]u8 align(512) = undefined;
 
-/// Find and load a file from a tar archive stored on the virtio block device.
-/// Returns the file contents as a slice, or null if not found.
-pub fn findFile(filename: []const u8) ?[]const u8 {
-    if (!virtio_blk.isReady()) {
-        serial.writeAll("tar: block device not ready\n");
-        return null;
+/// file_buf, for bundle.loadShared
+pub fn fileBuffer() []u8 {
+    return &file_buf;
+}
+
+// Head of the rootfs drive (a tar, or a bundle.zig bundle), read
+// asynchronously at boot so the device transfer overlaps MicroPython init.
+// Small rootfs images fit entirely; lookups outside the window fall back to
+// synchronous reads.
+const PREFETCH_SIZE = 256 * 1024;
+var prefetch_buf: [PREFETCH_SIZE]u8 align(512) = undefined;
+var prefetch_len: usize = 0;
+var prefetch_state: enum { idle, pending, ready, failed } = .idle;
+
+/// Forget the prefetch window (host tests swap disks between cases).
+pub fn reset() void {
+    prefetch_state = .idle;
+    prefetch_len = 0;
+}
+
+/// Submit the prefetch read and return immediately.
+pub fn prefetchStart() void {
+    if (prefetch_state != .idle or !virtio_blk.isReady()) return;
+    const cap = virtio_blk.capacityBytes();
+    const len: usize = @intCast(@min(cap, PREFETCH_SIZE) & ~@as(u64, TAR_BLOCK_SIZE - 1));
+    if (len == 0) return;
+    if (virtio_blk.startRead(0, @intCast(len / TAR_BLOCK_SIZE), &prefetch_buf)) {
+        prefetch_len = len;
+        prefetch_state = .pending;
     }
+}
+
+fn prefetchWait() void {
+    if (prefetch_state != .pending) return;
+    prefetch_state = if (virtio_blk.waitRead()) .ready else .failed;
+    if (prefetch_state == .failed) serial.writeAll("tar: prefetch failed, reading synchronously\n");
+}
+
+/// Bytes [offset, offset+len) if they are inside the completed prefetch.
+pub fn prefetched(offset: u64, len: usize) ?[]const u8 {
+    prefetchWait();
+    if (prefetch_state != .ready) return null;
+    if (offset > prefetch_len or len > prefetch_len - offset) return null;
+    const start: usize = @intCast(offset);
+    return prefetch_buf[start .. start + len];
+}
+
+pub const NameMax = 256;
+
+/// One archive member, as returned by nextEntry.
+pub const Entry = struct {
+    /// prefix + "/" + name, without a leading "./" or trailing "/"
+    name_buf: [NameMax]u8 = undefined,
+    name_len: usize = 0,
+    is_file: bool = false,
+    is_dir: bool = false,
+    data_offset: u64 = 0,
+    size: usize = 0,
 
-    var byte_offset: u64 = 0;
+    pub fn name(self: *const Entry) []const u8 {
+        return self.name_buf[0..self.name_len];
+    }
+};
+
+/// Read the header at offset.* and advance offset.* past the member's
+/// data. Returns null at the end of the archive or on a read error.
+pub fn nextEntry(offset: *u64) ?Entry {
     var header_buf: [TAR_BLOCK_SIZE]u8 = undefined;
     var zero_blocks: u32 = 0;
 
     while (true) {
         // Read tar header
-        if (!virtio_blk.readBytes(byte_offset, TAR_BLOCK_SIZE, &header_buf)) {
+        if (prefetched(offset.*, TAR_BLOCK_SIZE)) |bytes| {
+            @memcpy(header_buf[0..], bytes);
+        } else if (!virtio_blk.readBytes(offset.*, TAR_BLOCK_SIZE, &header_buf)) {
             serial.writeAll("tar: read error\n");
             return null;
         }
@@ -101,40 +143,73 @@ pub fn findFile(filename: []const u8) ?[]const u8 {
         // End of archive: two consecutive zero blocks
         if (isZeroBlock(&header_buf)) {
             zero_blocks += 1;
-            if (zero_blocks >= 2) break;
-            byte_offset += TAR_BLOCK_SIZE;
+            if (zero_blocks >= 2) return null;
+            offset.* += TAR_BLOCK_SIZE;
             continue;
         }
-        zero_blocks = 0;
 
         const header: *const TarHeader = @ptrCast(&header_buf);
+        var entry = Entry{
+            .is_file = (header.typeflag == '0' or header.typeflag == 0),
+            .is_dir = header.typeflag == '5',
+            .data_offset = offset.* + TAR_BLOCK_SIZE,
+            .size = parseOctal(&header.size),
+        };
 
-        // Parse file size
-        const file_size = parseOctal(&header.size);
-
-        // Check if this is our target file
-        const is_regular = (header.typeflag == '0' or header.typeflag == 0);
-
-        if (is_regular and nameMatch(&header.name, filename)) {
-            if (file_size > MAX_FILE_SIZE) {
-                serial.writeAll("tar: file too large\n");
-                return null;
-            }
+        // Skip to next header: data is padded to 512-byte blocks
+        const data_blocks = (entry.size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE;
+        offset.* += TAR_BLOCK_SIZE + data_blocks * TAR_BLOCK_SIZE;
+
+        // ustar splits long paths into prefix and name
+        const prefix = cStr(&header.prefix);
+        var name = cStr(&header.name);
+        if (prefix.len == 0 and name.len > 2 and name[0] == '.' and name[1] == '/') name = name[2..];
+        if (name.len > 0 and name[name.len - 1] == '/') name = name[0 .. name.len - 1];
+        if (prefix.len + 1 + name.len > NameMax) continue;
+        if (prefix.len > 0) {
+            @memcpy(entry.name_buf[0..prefix.len], prefix);
+            entry.name_buf[prefix.len] = '/';
+            entry.name_len = prefix.len + 1;
+        }
+        @memcpy(entry.name_buf[entry.name_len .. entry.name_len + name.len], name);
+        entry.name_len += name.len;
+        return entry;
+    }
+}
 
-            // Read file data
-            const data_offset = byte_offset + TAR_BLOCK_SIZE;
-            if (!virtio_blk.readBytes(data_offset, file_size, &file_buf)) {
-                serial.writeAll("tar: failed to read file data\n");
-                return null;
-            }
+/// Contents of a member: a slice of the prefetch window if it is inside
+/// it (stable), otherwise a shared buffer overwritten by the next read.
+pub fn readData(entry: *const Entry) ?[]const u8 {
+    if (entry.size > MAX_FILE_SIZE) {
+        serial.writeAll("tar: file too large\n");
+        return null;
+    }
+    if (prefetched(entry.data_offset, entry.size)) |bytes| return bytes;
+    if (!virtio_blk.readBytes(entry.data_offset, entry.size, &file_buf)) {
+        serial.writeAll("tar: failed to read file data\n");
+        return null;
+    }
+    return file_buf[0..entry.size];
+}
 
-            return file_buf[0..file_size];
-        }
+/// True if a readData result points into the prefetch window.
+pub fn isPrefetched(data: []const u8) bool {
+    const start = @intFromPtr(&prefetch_buf);
+    const addr = @intFromPtr(data.ptr);
+    return addr >= start and addr + data.len <= start + prefetch_buf.len;
+}
 
-        // Skip to next header: data is padded to 512-byte blocks
-        const data_blocks = (file_size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE;
-        byte_offset += TAR_BLOCK_SIZE + data_blocks * TAR_BLOCK_SIZE;
+/// Find and load a file from a tar archive stored on the virtio block device.
+/// Returns the file contents as a slice, or null if not found.
+pub fn findFile(filename: []const u8) ?[]const u8 {
+    if (!virtio_blk.isReady()) {
+        serial.writeAll("tar: block device not ready\n");
+        return null;
     }
 
+    var offset: u64 = 0;
+    while (nextEntry(&offset)) |entry| {
+        if (entry.is_file and std.mem.eql(u8, entry.name(), filename)) return readData(&entry);
+    }
     return null;
 }
@@ -0,0 +1,291 @@
+// Hierarchical timer wheel.
+//
+// Four levels of 64 slots. A level-0 slot spans one tick (2^TICK_SHIFT ns),
+// a level-N slot spans 64^N ticks. Timers are intrusive doubly linked list
+// nodes owned by the caller, so arm and cancel are O(1) with no allocation.
+// Higher levels cascade down as the wheel turns; advance() skips empty
+// level-0 runs using a per-level occupancy bitmap.
+//
+// The wheel has no interrupt source: callers drive it with advance(now_ns)
+// from their wait loops (io_poll, task_sleep, ...).
+
+const std = @import("std");
+
+pub const TICK_SHIFT = 14; // ~16.4 us per tick
+pub const TICK_NS: u64 = 1 << TICK_SHIFT;
+
+const LEVELS = 4;
+const SLOT_BITS = 6;
+const SLOTS = 1 << SLOT_BITS;
+const SLOT_MASK: u64 = SLOTS - 1;
+// Furthest a timer can be placed from the current tick (~275 s); later
+// expiries park in the top level and are re-placed on cascade.
+const MAX_DELTA: u64 = (1 << (SLOT_BITS * LEVELS)) - 1;
+
+pub const Callback = *const fn (t: *Timer) void;
+
+pub const Timer = struct {
+    expires_ns: u64 = 0,
+    next: ?*Timer = null,
+    prev: ?*Timer = null,
+    level: u8 = 0,
+    slot: u8 = 0,
+    armed: bool = false,
+    fired: bool = false,
+    callback: ?Callback = null,
+    ctx: usize = 0,
+};
+
+var slots: [LEVELS][SLOTS]?*Timer = [_][SLOTS]?*Timer{[_]?*Timer{null} ** SLOTS} ** LEVELS;
+var occupied: [LEVELS]u64 = [_]u64{0} ** LEVELS;
+// Timers armed for a tick that has already been processed; fired first
+// on the next advance().
+const DUE_LEVEL: u8 = LEVELS;
+var due: ?*Timer = null;
+// Next tick to process; every tick below it has fired.
+var current: u64 = 0;
+var started: bool = false;
+var armed_count: u32 = 0;
+
+fn levelShift(level: usize) u6 {
+    return @intCast(level * SLOT_BITS);
+}
+
+fn headOf(level: usize, slot: usize) *?*Timer {
+    if (level == DUE_LEVEL) return &due;
+    return &slots[level][slot];
+}
+
+fn link(t: *Timer, level: usize, slot: usize) void {
+    const head = headOf(level, slot);
+    t.level = @intCast(level);
+    t.slot = @intCast(slot);
+    t.prev = null;
+    t.next = head.*;
+    if (t.next) |n| n.prev = t;
+    head.* = t;
+    if (level != DUE_LEVEL) occupied[level] |= @as(u64, 1) << @as(u6, @intCast(slot));
+}
+
+fn unlink(t: *Timer) void {
+    const head = headOf(t.level, t.slot);
+    if (t.prev) |p| {
+        p.next = t.next;
+    } else {
+        head.* = t.next;
+    }
+    if (t.next) |n| n.prev = t.prev;
+    if (head.* == null and t.level != DUE_LEVEL) {
+        occupied[t.level] &= ~(@as(u64, 1) << @as(u6, @intCast(t.slot)));
+    }
+    t.next = null;
+    t.prev = null;
+}
+
+fn place(t: *Timer) void {
+    // Round up so a timer never fires before its deadline.
+    var tick = (t.expires_ns +| (TICK_NS - 1)) >> TICK_SHIFT;
+    if (started and tick < current) {
+        link(t, DUE_LEVEL, 0);
+        return;
+    }
+    if (tick < current) tick = current;
+    var delta = tick - current;
+    if (delta > MAX_DELTA) {
+        delta = MAX_DELTA;
+        tick = current + MAX_DELTA;
+    }
+
+    var level: usize = 0;
+    while (level + 1 < LEVELS and delta >= (@as(u64, 1) << levelShift(level + 1))) : (level += 1) {}
+    const slot: usize = @intCast((tick >> levelShift(level)) & SLOT_MASK);
+    link(t, level, slot);
+}
+
+/// Arm (or re-arm) a timer for an absolute expiry in nanoseconds.
+/// Call advance() at least once before the first arm so the wheel knows
+/// the current time.
+pub fn arm(t: *Timer, expires_ns: u64) void {
+    if (t.armed) cancel(t);
+    t.expires_ns = expires_ns;
+    t.fired = false;
+    t.armed = true;
+    armed_count += 1;
+    place(t);
+}
+
+pub fn cancel(t: *Timer) void {
+    if (!t.armed) return;
+    unlink(t);
+    t.armed = false;
+    armed_count -= 1;
+}
+
+pub fn isArmed(t: *const Timer) bool {
+    return t.armed;
+}
+
+pub fn hasFired(t: *const Timer) bool {
+    return t.fired;
+}
+
+fn cascade(level: usize) void {
+    const idx: usize = @intCast((current >> levelShift(level)) & SLOT_MASK);
+    if (idx == 0 and level + 1 < LEVELS) cascade(level + 1);
+
+    var t = slots[level][idx];
+    slots[level][idx] = null;
+    occupied[level] &= ~(@as(u64, 1) << @as(u6, @intCast(idx)));
+    while (t) |timer| {
+        t = timer.next;
+        timer.next = null;
+        timer.prev = null;
+        place(timer);
+    }
+}
+
+fn fireList(head: *?*Timer) void {
+    // Pop one timer at a time so callbacks may cancel or re-arm any timer,
+    // including ones still on this list.
+    while (head.*) |timer| {
+        head.* = timer.next;
+        if (timer.next) |n| n.prev = null;
+        timer.next = null;
+        timer.prev = null;
+        timer.armed = false;
+        timer.fired = true;
+        armed_count -= 1;
+        if (timer.callback) |cb| cb(timer);
+    }
+}
+
+fn fireSlot(idx: usize) void {
+    fireList(&slots[0][idx]);
+    occupied[0] &= ~(@as(u64, 1) << @as(u6, @intCast(idx)));
+}
+
+/// Fire every timer whose expiry is at or before now_ns.
+pub fn advance(now_ns: u64) void {
+    const target = now_ns >> TICK_SHIFT;
+    fireList(&due);
+    if (!started or armed_count == 0) {
+        // Nothing can fire; jump straight to now.
+        if (target + 1 > current) current = target + 1;
+        started = true;
+        return;
+    }
+
+    while (current <= target) {
+        const idx: usize = @intCast(current & SLOT_MASK);
+        if (idx == 0) cascade(1);
+        fireSlot(idx);
+
+        if (armed_count == 0) {
+            current = target + 1;
+            break;
+        }
+
+        // Skip to the next occupied level-0 slot in this rotation, or to the
+        // next rotation boundary where higher levels cascade.
+        var next: u64 = (current | SLOT_MASK) + 1;
+        if (idx < SLOTS - 1) {
+            const rest = occupied[0] >> @as(u6, @intCast(idx + 1));
+            if (rest != 0) next = current + 1 + @ctz(rest);
+        }
+        current = if (next > target + 1) target + 1 else next;
+    }
+}
+
+/// Drop all armed timers and forget the current time (workload reset).
+pub fn reset() void {
+    for (&slots) |*level| {
+        for (level) |*head| {
+            var t = head.*;
+            while (t) |timer| {
+                t = timer.next;
+                timer.* = .{ .callback = timer.callback, .ctx = timer.ctx };
+            }
+            head.* = null;
+        }
+    }
+    var t = due;
+    while (t) |timer| {
+        t = timer.next;
+        timer.* = .{ .callback = timer.callback, .ctx = timer.ctx };
+    }
+    due = null;
+    occupied = [_]u64{0} ** LEVELS;
+    armed_count = 0;
+    current = 0;
+    started = false;
+}
+
+test "timer fires at or after its deadline" {
+    reset();
+    advance(0);
+    var t: Timer = .{};
+    arm(&t, 1_000_000);
+    advance(500_000);
+    try std.testing.expect(!hasFired(&t));
+    advance(1_000_000 + TICK_NS);
+    try std.testing.expect(hasFired(&t));
+    try std.testing.expect(!isArmed(&t));
+}
+
+test "timer armed in the past fires on the next advance" {
+    reset();
+    advance(10 * TICK_NS);
+    var t: Timer = .{};
+    arm(&t, 5 * TICK_NS);
+    advance(10 * TICK_NS);
+    try std.testing.expect(hasFired(&t));
+}
+
+test "cancel removes a pending timer" {
+    reset();
+    advance(0);
+    var a: Timer = .{};
+    var b: Timer = .{};
+    arm(&a, 2_000_000);
+    arm(&b, 2_000_000);
+    cancel(&a);
+    advance(10_000_000);
+    try std.testing.expect(!hasFired(&a));
+    try std.testing.expect(hasFired(&b));
+}
+
+test "far timers cascade down through levels" {
+    reset();
+    advance(0);
+    var near: Timer = .{};
+    var mid: Timer = .{};
+    var far: Timer = .{};
+    arm(&near, 100 * TICK_NS);
+    arm(&mid, 5000 * TICK_NS);
+    arm(&far, 300_000 * TICK_NS);
+
+    advance(4999 * TICK_NS);
+    try std.testing.expect(hasFired(&near));
+    try std.testing.expect(!hasFired(&mid));
+    advance(5000 * TICK_NS);
+    try std.testing.expect(hasFired(&mid));
+    try std.testing.expect(!hasFired(&far));
+    advance(300_000 * TICK_NS);
+    try std.testing.expect(hasFired(&far));
+}
+
+test "callback can re-arm its own timer" {
+    reset();
+    advance(0);
+    const S = struct {
+        var hits: u32 = 0;
+        fn cb(t: *Timer) void {
+            hits += 1;
+            if (hits < 3) arm(t, t.expires_ns + 10 * TICK_NS);
+        }
+    };
+    var t: Timer = .{ .callback = &S.cb };
+    arm(&t, 10 * TICK_NS);
+    advance(100 * TICK_NS);
+    try std.testing.expectEqual(@as(u32, 3), S.hits);
+}
@@ -0,0 +1,319 @@
+// Binary trace ring.
+//
+// Span begin/end and point events are recorded as fixed 24-byte records
+// with a raw TSC timestamp and interned name ids; nothing is formatted on
+// the record path. An event's key/value payload is copied into Payload
+// records that follow it in the ring, so per-request values never reach
+// the name table. The ring is drained to serial from idle points as "#T"
+// lines that scripts/trace_convert.py turns into Chrome trace JSON:
+//
+//   #Th <tsc_hz>                  header, once per drain session
+//   #Tn <id> <name>               name definition, before first use
+//   #Tr <48 hex chars>            one Record or Payload, little-endian
+//   #Td <count>                   records dropped since the last drain
+//
+// When the ring is full new records are dropped and counted; an event and
+// its payload are queued or dropped together.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const serial = @import("serial.zig");
+const clock = @import("clock.zig");
+
+pub const KIND_BEGIN: u8 = 1;
+pub const KIND_END: u8 = 2;
+pub const KIND_EVENT: u8 = 3;
+pub const KIND_PAYLOAD: u8 = 4;
+
+pub const Record = extern struct {
+    tsc: u64,
+    span: u32,
+    parent: u32,
+    name: u16,
+    kind: u8,
+    reserved: u8 = 0,
+    // Events: bytes of key/value payload in the Payload records that follow
+    arg: u32,
+};
+
+/// Up to PayloadChunk bytes of the preceding event's key/value payload.
+pub const Payload = extern struct {
+    bytes: [PayloadChunk]u8,
+    kind: u8 = KIND_PAYLOAD,
+    len: u8,
+    reserved: [4]u8 = .{ 0, 0, 0, 0 },
+};
+
+pub const PayloadChunk = 18;
+/// Longer payloads are truncated
+pub const MaxPayload = 4 * PayloadChunk;
+
+comptime {
+    std.debug.assert(@sizeOf(Record) == 24);
+    std.debug.assert(@sizeOf(Payload) == 24);
+    std.debug.assert(@offsetOf(Payload, "kind") == @offsetOf(Record, "kind"));
+}
+
+const RingSize = 4096; // power of two
+const RingMask = RingSize - 1;
+
+var ring: [RingSize]Record = undefined;
+var head: u32 = 0; // next record to drain
+var tail: u32 = 0; // next slot to write
+var dropped: u32 = 0;
+
+// --- Name interning ---
+
+pub const MaxNames = 256;
+const MaxNameLen = 47;
+
+const NameEntry = struct {
+    len: u8 = 0,
+    hash: u32 = 0,
+    sent: bool = false,
+    bytes: [MaxNameLen]u8 = undefined,
+};
+
+// Id 0 is reserved for "no name" / table full
+var names: [MaxNames]NameEntry = [_]NameEntry{.{}} ** MaxNames;
+var name_count: u16 = 1;
+var names_unsent: bool = false;
+
+// Open-addressed hash of name ids (0 = empty slot), at most half full
+const HashSlots = 2 * MaxNames;
+var name_slots: [HashSlots]u16 = [_]u16{0} ** HashSlots;
+
+fn hashName(s: []const u8) u32 {
+    // FNV-1a
+    var h: u32 = 0x811c9dc5;
+    for (s) |c| {
+        h ^= c;
+        h *%= 0x01000193;
+    }
+    return h;
+}
+
+/// Map a span or event name to a small id, adding it on first use. Names
+/// longer than MaxNameLen are truncated; returns 0 once the table is full.
+pub fn intern(name: []const u8) u16 {
+    if (name.len == 0) return 0;
+    const s = if (name.len > MaxNameLen) name[0..MaxNameLen] else name;
+    const h = hashName(s);
+    var slot = h & (HashSlots - 1);
+    while (name_slots[slot] != 0) : (slot = (slot + 1) & (HashSlots - 1)) {
+        const found = name_slots[slot];
+        const e = &names[found];
+        if (e.hash == h and e.len == s.len and std.mem.eql(u8, e.bytes[0..e.len], s)) return found;
+    }
+    if (name_count >= MaxNames) return 0;
+    const id = name_count;
+    name_count += 1;
+    names[id] = .{ .len = @intCast(s.len), .hash = h };
+    @memcpy(names[id].bytes[0..s.len], s);
+    name_slots[slot] = id;
+    names_unsent = true;
+    return id;
+}
+
+// --- Span bookkeeping ---
+
+var next_span_id: u32 = 1;
+// Innermost open span; new spans and events are parented to it
+var current_span: u32 = 0;
+
+pub const OpenSpan = struct {
+    id: u32 = 0,
+    parent: u32 = 0,
+    name: u16 = 0,
+};
+
+fn push(rec: Record) void {
+    if (tail -% head >= RingSize) {
+        dropped +%= 1;
+        return;
+    }
+    ring[tail & RingMask] = rec;
+    tail +%= 1;
+}
+
+pub fn beginSpan(name: u16) OpenSpan {
+    const span = OpenSpan{ .id = next_span_id, .parent = current_span, .name = name };
+    next_span_id +%= 1;
+    if (next_span_id == 0) next_span_id = 1;
+    current_span = span.id;
+    push(.{ .tsc = clock.rdtsc(), .span = span.id, .parent = span.parent, .name = name, .kind = KIND_BEGIN, .arg = 0 });
+    return span;
+}
+
+pub fn endSpan(span: OpenSpan) void {
+    push(.{ .tsc = clock.rdtsc(), .span = span.id, .parent = span.parent, .name = span.name, .kind = KIND_END, .arg = 0 });
+    if (current_span == span.id) current_span = span.parent;
+}
+
+/// Point event inside span (0 = innermost open span), with an optional
+/// key/value payload copied into the ring (truncated to MaxPayload).
+pub fn event(span: u32, name: u16, kv: []const u8) void {
+    const owner = if (span != 0) span else current_span;
+    const payload = kv[0..@min(kv.len, MaxPayload)];
+    const chunks: u32 = @intCast((payload.len + PayloadChunk - 1) / PayloadChunk);
+    if (tail -% head + 1 + chunks > RingSize) {
+        dropped +%= 1;
+        return;
+    }
+    push(.{ .tsc = clock.rdtsc(), .span = owner, .parent = 0, .name = name, .kind = KIND_EVENT, .arg = @intCast(payload.len) });
+    var off: usize = 0;
+    while (off < payload.len) : (off += PayloadChunk) {
+        const part = payload[off..@min(off + PayloadChunk, payload.len)];
+        var rec = Payload{ .bytes = [_]u8{0} ** PayloadChunk, .len = @intCast(part.len) };
+        @memcpy(rec.bytes[0..part.len], part);
+        push(@bitCast(rec));
+    }
+}
+
+pub fn pending() u32 {
+    return tail -% head;
+}
+
+pub fn droppedCount() u32 {
+    return dropped;
+}
+
+pub fn reset() void {
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    next_span_id = 1;
+    current_span = 0;
+    header_sent = false;
+    for (names[1..name_count]) |*e| e.sent = false;
+    names_unsent = name_count > 1;
+}
+
+// --- Drain ---
+
+var header_sent: bool = false;
+
+const hex = "0123456789abcdef";
+
+fn sendNames() void {
+    if (!names_unsent) return;
+    var i: u16 = 1;
+    while (i < name_count) : (i += 1) {
+        const e = &names[i];
+        if (e.sent) continue;
+        serial.writeAll("#Tn ");
+        serial.writeDec(i);
+        serial.writeByte(' ');
+        // Keep the line format intact whatever the name contains
+        for (e.bytes[0..e.len]) |c| {
+            serial.writeByte(if (c < 0x20 or c == 0x7f) '?' else c);
+        }
+        serial.writeAll("\n");
+        e.sent = true;
+    }
+    names_unsent = false;
+}
+
+/// Write up to max_records records to serial. Called from idle points so
+/// the record path never touches the UART.
+pub fn drain(max_records: u32) void {
+    if (builtin.is_test) return;
+    if (head == tail and dropped == 0 and !names_unsent) return;
+
+    if (!header_sent) {
+        serial.writeAll("#Th ");
+        serial.writeDec(clock.frequency());
+        serial.writeAll("\n");
+        header_sent = true;
+    }
+    // Names must precede the records that reference them
+    sendNames();
+
+    var n: u32 = 0;
+    while (n < max_records and head != tail) : (n += 1) {
+        const bytes = std.mem.asBytes(&ring[head & RingMask]);
+        var line: [4 + 48 + 1]u8 = undefined;
+        @memcpy(line[0..4], "#Tr ");
+        for (bytes, 0..) |b, i| {
+            line[4 + i * 2] = hex[b >> 4];
+            line[4 + i * 2 + 1] = hex[b & 0xF];
+        }
+        line[line.len - 1] = '\n';
+        serial.writeAll(line[0..]);
+        head +%= 1;
+    }
+
+    if (dropped != 0) {
+        serial.writeAll("#Td ");
+        serial.writeDec(dropped);
+        serial.writeAll("\n");
+        dropped = 0;
+    }
+}
+
+/// Drain everything (end of workload, panic).
+pub fn flush() void {
+    drain(RingSize);
+}
+
+test "spans nest and records are queued without formatting" {
+    reset();
+    const outer_name = intern("request");
+    const inner_name = intern("parse");
+    try std.testing.expect(outer_name != 0);
+    try std.testing.expectEqual(outer_name, intern("request"));
+
+    const outer = beginSpan(outer_name);
+    const inner = beginSpan(inner_name);
+    try std.testing.expectEqual(outer.id, inner.parent);
+    event(0, intern("cache_miss"), "");
+    endSpan(inner);
+    endSpan(outer);
+
+    try std.testing.expectEqual(@as(u32, 5), pending());
+    try std.testing.expectEqual(KIND_EVENT, ring[2].kind);
+    try std.testing.expectEqual(inner.id, ring[2].span);
+    try std.testing.expectEqual(@as(u32, 0), current_span);
+}
+
+test "event payloads follow the event and stay out of the name table" {
+    reset();
+    const names_before = name_count;
+    const name = intern("db_query");
+    const kv = "request_id=4f1c9a2e7b user=alice"; // 32 bytes: two chunks
+    event(0, name, kv);
+    try std.testing.expectEqual(@as(u32, 3), pending());
+    try std.testing.expectEqual(@as(u32, kv.len), ring[0].arg);
+    const first: Payload = @bitCast(ring[1]);
+    const second: Payload = @bitCast(ring[2]);
+    try std.testing.expectEqual(KIND_PAYLOAD, first.kind);
+    try std.testing.expectEqualStrings(kv[0..PayloadChunk], first.bytes[0..first.len]);
+    try std.testing.expectEqualStrings(kv[PayloadChunk..], second.bytes[0..second.len]);
+    try std.testing.expect(name_count <= names_before + 1);
+
+    // Long payloads are truncated; an event that does not fit whole is dropped
+    event(0, name, "x" ** (MaxPayload + 10));
+    try std.testing.expectEqual(@as(u32, 3 + 1 + MaxPayload / PayloadChunk), pending());
+    tail = head +% RingSize - 1;
+    event(0, name, "k=v");
+    try std.testing.expectEqual(@as(u32, 1), droppedCount());
+    reset();
+}
+
+test "interned names hash to stable ids" {
+    const a = intern("span_a");
+    const b = intern("span_b");
+    try std.testing.expect(a != 0 and b != 0 and a != b);
+    try std.testing.expectEqual(a, intern("span_a"));
+    try std.testing.expectEqual(b, intern("span_b"));
+    try std.testing.expectEqualStrings("span_a", names[a].bytes[0..names[a].len]);
+}
+
+test "full ring drops and counts new records" {
+    reset();
+    var i: u32 = 0;
+    while (i < RingSize + 3) : (i += 1) event(0, 0, "");
+    try std.testing.expectEqual(@as(u32, RingSize), pending());
+    try std.testing.expectEqual(@as(u32, 3), droppedCount());
+    reset();
+}
@@ -1,5 +1,7 @@
 const serial = @import("serial.zig");
 const builtin = @import("builtin");
+const config = @import("config.zig");
+const virtio_mock = @import("virtio_mock.zig");
 
 // Virtio-MMIO register offsets
 pub const MMIO_MAGIC: u32 = 0x00;
@@ -38,12 +40,15 @@ pub const MAGIC_VALUE: u32 = 0x74726976; // "virt" little-endian
 // Device types
 pub const DEVICE_NET: u32 = 1;
 pub const DEVICE_BLOCK: u32 = 2;
+pub const DEVICE_BALLOON: u32 = 5;
 
 // Firecracker MMIO device base addresses
 // Firecracker v1.x places up to 8 devices starting at 0xd0000000
-const MMIO_BASE: u64 = 0xd0000000;
-const MMIO_STRIDE: u64 = 0x1000;
-const MAX_DEVICES: u32 = 8;
+pub const MMIO_BASE: u64 = 0xd0000000;
+pub const MMIO_STRIDE: u64 = 0x1000;
+pub const MAX_DEVICES: u32 = 8;
+// Device-specific configuration space
+pub const MMIO_CONFIG: u32 = 0x100;
 
 // Virtqueue descriptor
 pub const VirtqDesc = extern struct {
@@ -86,21 +91,42 @@ pub const VirtioDevice = struct {
     queue_size: u16,
     avail_idx: u16,
     last_used_idx: u16,
+    /// Feature bits (0-31) accepted by negotiate
+    features: u32,
+    /// Queue this handle drives (notify target)
+    queue_index: u16,
 };
 
+// Host builds reach the in-process device models instead of hardware
 pub fn mmioRead32(base: u64, offset: u32) u32 {
+    if (comptime config.hosted) return virtio_mock.read32(base, offset);
     if (comptime builtin.cpu.arch != .x86_64) return 0;
     const addr: *volatile u32 = @ptrFromInt(base + offset);
     return addr.*;
 }
 
+pub fn mmioRead8(base: u64, offset: u32) u8 {
+    if (comptime config.hosted) return virtio_mock.read8(base, offset);
+    if (comptime builtin.cpu.arch != .x86_64) return 0;
+    const addr: *volatile u8 = @ptrFromInt(base + offset);
+    return addr.*;
+}
+
 pub fn mmioWrite32(base: u64, offset: u32, value: u32) void {
+    if (comptime config.hosted) return virtio_mock.write32(base, offset, value);
     if (comptime builtin.cpu.arch != .x86_64) return;
     const addr: *volatile u32 = @ptrFromInt(base + offset);
     addr.* = value;
 }
 
 pub fn probe(device_type: u32) ?VirtioDevice {
+    return probeIndex(device_type, 0);
+}
+
+/// The index-th device of a type, in MMIO slot order (Firecracker attaches
+/// drives in the order they are configured).
+pub fn probeIndex(device_type: u32, index: u32) ?VirtioDevice {
+    var seen: u32 = 0;
     var i: u32 = 0;
     while (i < MAX_DEVICES) : (i += 1) {
         const base = MMIO_BASE + @as(u64, i) * MMIO_STRIDE;
@@ -113,6 +139,10 @@ pub fn probe(device_type: u32) ?VirtioDevice {
         const dev_id = mmioRead32(base, MMIO_DEVICE_ID);
         if (dev_id == 0) continue; // No device
         if (dev_id != device_type) continue;
+        if (seen < index) {
+            seen += 1;
+            continue;
+        }
 
         return VirtioDevice{
             .base = base,
@@ -123,18 +153,36 @@ pub fn probe(device_type: u32) ?VirtioDevice {
             .queue_size = 0,
             .avail_idx = 0,
             .last_used_idx = 0,
+            .features = 0,
+            .queue_index = 0,
         };
     }
     return null;
 }
 
-// Static memory for virtqueue (queue_size=16)
-const QUEUE_SIZE = 16;
-var vq_desc: [QUEUE_SIZE]VirtqDesc align(16) = undefined;
-var vq_avail_buf: [6 + 2 * QUEUE_SIZE]u8 align(2) = undefined;
-var vq_used_buf: [6 + 8 * QUEUE_SIZE]u8 align(4) = undefined;
+// Queue depth set by -Dvirtq-size
+pub const QUEUE_SIZE = config.virtq_size;
+
+/// Ring memory for one virtqueue. Owned by the driver (usually static) and
+/// must stay in place while the device is live.
+pub const QueueMem = struct {
+    desc: [QUEUE_SIZE]VirtqDesc align(16) = undefined,
+    avail: [6 + 2 * QUEUE_SIZE]u8 align(2) = undefined,
+    used: [6 + 8 * QUEUE_SIZE]u8 align(4) = undefined,
+};
+
+/// Reset the device, offer it the subset of `wanted` feature bits it
+/// supports, and bring up queue 0 on `mem`.
+pub fn setupVirtqueue(dev: *VirtioDevice, mem: *QueueMem, wanted: u32) bool {
+    if (!negotiate(dev, wanted)) return false;
+    if (!setupQueue(dev, 0, mem)) return false;
+    driverOk(dev);
+    return true;
+}
 
-pub fn setupVirtqueue(dev: *VirtioDevice) bool {
+/// Reset the device and accept the subset of `wanted` feature bits it
+/// offers. Queues are set up next, then driverOk.
+pub fn negotiate(dev: *VirtioDevice, wanted: u32) bool {
     const base = dev.base;
 
     // Reset device
@@ -144,11 +192,11 @@ pub fn setupVirtqueue(dev: *VirtioDevice) bool {
     mmioWrite32(base, MMIO_STATUS, STATUS_ACKNOWLEDGE);
     mmioWrite32(base, MMIO_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER);
 
-    // Feature negotiation — accept no optional features for simplicity
+    // Feature negotiation: only bits the driver asked for
     mmioWrite32(base, MMIO_DEVICE_FEATURES_SEL, 0);
-    _ = mmioRead32(base, MMIO_DEVICE_FEATURES);
+    const features = mmioRead32(base, MMIO_DEVICE_FEATURES) & wanted;
     mmioWrite32(base, MMIO_DRIVER_FEATURES_SEL, 0);
-    mmioWrite32(base, MMIO_DRIVER_FEATURES, 0);
+    mmioWrite32(base, MMIO_DRIVER_FEATURES, features);
 
     mmioWrite32(base, MMIO_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_FEATURES_OK);
 
@@ -158,9 +206,17 @@ pub fn setupVirtqueue(dev: *VirtioDevice) bool {
         serial.writeAll("virtio: features negotiation failed\n");
         return false;
     }
+    dev.features = features;
+    return true;
+}
 
-    // Select queue 0
-    mmioWrite32(base, MMIO_QUEUE_SEL, 0);
+/// Bring up queue `index` on `mem` and point `dev` at it. Devices with
+/// several queues use one VirtioDevice per queue, copied from the
+/// negotiated one.
+pub fn setupQueue(dev: *VirtioDevice, index: u16, mem: *QueueMem) bool {
+    const base = dev.base;
+
+    mmioWrite32(base, MMIO_QUEUE_SEL, index);
     const max_size = mmioRead32(base, MMIO_QUEUE_NUM_MAX);
     if (max_size == 0) {
         serial.writeAll("virtio: queue not available\n");
@@ -171,14 +227,14 @@ pub fn setupVirtqueue(dev: *VirtioDevice) bool {
     mmioWrite32(base, MMIO_QUEUE_NUM, qsize);
 
     // Zero out buffers
-    for (&vq_avail_buf) |*b| b.* = 0;
-    for (&vq_used_buf) |*b| b.* = 0;
-    for (&vq_desc) |*d| d.* = .{ .addr = 0, .len = 0, .flags = 0, .next = 0 };
+    for (&mem.avail) |*b| b.* = 0;
+    for (&mem.used) |*b| b.* = 0;
+    for (&mem.desc) |*d| d.* = .{ .addr = 0, .len = 0, .flags = 0, .next = 0 };
 
     // Set queue addresses
-    const desc_addr = @intFromPtr(&vq_desc);
-    const avail_addr = @intFromPtr(&vq_avail_buf);
-    const used_addr = @intFromPtr(&vq_used_buf);
+    const desc_addr = @intFromPtr(&mem.desc);
+    const avail_addr = @intFromPtr(&mem.avail);
+    const used_addr = @intFromPtr(&mem.used);
 
     mmioWrite32(base, MMIO_QUEUE_DESC_LOW, @truncate(desc_addr));
     mmioWrite32(base, MMIO_QUEUE_DESC_HIGH, @truncate(desc_addr >> 32));
@@ -189,42 +245,68 @@ pub fn setupVirtqueue(dev: *VirtioDevice) bool {
 
     mmioWrite32(base, MMIO_QUEUE_READY, 1);
 
-    // Driver ok
-    mmioWrite32(base, MMIO_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_FEATURES_OK | STATUS_DRIVER_OK);
-
-    dev.desc = &vq_desc;
-    dev.avail = @ptrCast(@alignCast(&vq_avail_buf));
-    dev.used = @ptrCast(@alignCast(&vq_used_buf));
+    dev.desc = &mem.desc;
+    dev.avail = @ptrCast(@alignCast(&mem.avail));
+    dev.used = @ptrCast(@alignCast(&mem.used));
     dev.queue_size = qsize;
     dev.avail_idx = 0;
     dev.last_used_idx = 0;
-
+    dev.queue_index = index;
     return true;
 }
 
+pub fn driverOk(dev: *const VirtioDevice) void {
+    mmioWrite32(dev.base, MMIO_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_FEATURES_OK | STATUS_DRIVER_OK);
+}
+
 pub fn submitAndWait(dev: *VirtioDevice) void {
-    // Notify the device (queue 0)
-    mmioWrite32(dev.base, MMIO_QUEUE_NOTIFY, 0);
+    notify(dev);
 
     // Poll the used ring until the device processes our request
-    const used_ptr: [*]volatile u8 = @ptrCast(dev.used);
-    while (true) {
-        // used.idx is at offset 2
-        const used_idx_ptr: *volatile u16 = @ptrCast(@alignCast(used_ptr + 2));
-        if (used_idx_ptr.* != dev.last_used_idx) {
-            dev.last_used_idx = used_idx_ptr.*;
-            break;
-        }
+    while (!pollUsed(dev)) {
         if (comptime builtin.cpu.arch == .x86_64) {
             asm volatile ("pause");
         }
     }
+}
+
+/// Notify the device (dev.queue_index) without waiting for completion.
+pub fn notify(dev: *VirtioDevice) void {
+    mmioWrite32(dev.base, MMIO_QUEUE_NOTIFY, dev.queue_index);
+}
+
+/// Consume a used-ring update if the device has completed a request.
+pub fn pollUsed(dev: *VirtioDevice) bool {
+    // used.idx is at offset 2
+    const used_ptr: [*]volatile u8 = @ptrCast(dev.used);
+    const used_idx_ptr: *volatile u16 = @ptrCast(@alignCast(used_ptr + 2));
+    if (used_idx_ptr.* == dev.last_used_idx) return false;
+    dev.last_used_idx = used_idx_ptr.*;
 
     // Acknowledge interrupt
     const isr = mmioRead32(dev.base, MMIO_INTERRUPT_STATUS);
     if (isr != 0) {
         mmioWrite32(dev.base, MMIO_INTERRUPT_ACK, isr);
     }
+    return true;
+}
+
+/// Take the next used-ring element, for drivers with several requests in
+/// flight (pollUsed only reports that something completed).
+pub fn popUsed(dev: *VirtioDevice) ?VirtqUsedElem {
+    const used_ptr: [*]volatile u8 = @ptrCast(dev.used);
+    const used_idx_ptr: *volatile u16 = @ptrCast(@alignCast(used_ptr + 2));
+    if (used_idx_ptr.* == dev.last_used_idx) return null;
+    const offset = 4 + @as(usize, dev.last_used_idx % dev.queue_size) * 8;
+    const elem_ptr: *volatile VirtqUsedElem = @ptrCast(@alignCast(used_ptr + offset));
+    const elem = elem_ptr.*;
+    dev.last_used_idx +%= 1;
+
+    const isr = mmioRead32(dev.base, MMIO_INTERRUPT_STATUS);
+    if (isr != 0) {
+        mmioWrite32(dev.base, MMIO_INTERRUPT_ACK, isr);
+    }
+    return elem;
 }
 
 pub fn addAvail(dev: *VirtioDevice, desc_idx: u16) void {
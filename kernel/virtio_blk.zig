@@ -3,8 +3,15 @@ const serial = @import("serial.zig");
 const builtin = @import("builtin");
 
 // Virtio block request types
-const VIRTIO_BLK_T_IN: u32 = 0;  // Read
-const VIRTIO_BLK_T_OUT: u32 = 1; // Write
+pub const Op = enum(u32) {
+    read = 0, // VIRTIO_BLK_T_IN
+    write = 1, // VIRTIO_BLK_T_OUT
+    flush = 4, // VIRTIO_BLK_T_FLUSH
+};
+
+// Feature bits
+const VIRTIO_BLK_F_RO: u32 = 1 << 5;
+const VIRTIO_BLK_F_FLUSH: u32 = 1 << 9;
 
 // Virtio block request header
 const VirtioBlkReqHeader = extern struct {
@@ -13,37 +20,225 @@ const VirtioBlkReqHeader = extern struct {
     sector: u64,
 };
 
-// Block device state
-var dev: virtio.VirtioDevice = undefined;
-var initialized: bool = false;
+// Device config space (virtio-mmio offset 0x100): capacity in sectors
+const CONFIG_CAPACITY: u32 = virtio.MMIO_CONFIG;
 
-// Static buffers for block I/O
-var req_header: VirtioBlkReqHeader align(16) = undefined;
-var req_status: u8 align(1) = 0;
+/// Requests one disk can have in flight: each takes three descriptors
+/// (header, data, status), at fixed positions per slot.
+pub const MaxRequests = virtio.QUEUE_SIZE / 3;
 
-pub fn init() bool {
-    serial.writeAll("virtio_blk: probing...\n");
+comptime {
+    if (MaxRequests == 0) @compileError("virtio-blk needs -Dvirtq-size >= 4");
+}
+
+/// Request slot returned by the start* calls, redeemed with poll or wait.
+pub const Tag = u32;
+
+const Request = struct {
+    header: VirtioBlkReqHeader align(16) = undefined,
+    status: u8 = 0,
+    state: enum { free, pending, done } = .free,
+};
+
+/// One virtio-blk device with its own virtqueue. Requests are queued with
+/// the start* calls, which do not notify the device; kick() submits
+/// everything queued since the last kick in one MMIO write.
+pub const Disk = struct {
+    dev: virtio.VirtioDevice = undefined,
+    queue: virtio.QueueMem = .{},
+    ready: bool = false,
+    reqs: [MaxRequests]Request = [_]Request{.{}} ** MaxRequests,
+
+    /// Bring up the index-th virtio-blk device (0: the rootfs drive).
+    pub fn init(self: *Disk, index: u32) bool {
+        self.ready = false;
+        self.reqs = [_]Request{.{}} ** MaxRequests;
+        self.dev = virtio.probeIndex(virtio.DEVICE_BLOCK, index) orelse return false;
+        if (!virtio.setupVirtqueue(&self.dev, &self.queue, VIRTIO_BLK_F_RO | VIRTIO_BLK_F_FLUSH)) return false;
+        self.ready = true;
+        return true;
+    }
+
+    /// Device size in bytes (0 if not initialized).
+    pub fn capacityBytes(self: *const Disk) u64 {
+        if (!self.ready) return 0;
+        const lo = virtio.mmioRead32(self.dev.base, CONFIG_CAPACITY);
+        const hi = virtio.mmioRead32(self.dev.base, CONFIG_CAPACITY + 4);
+        return ((@as(u64, hi) << 32) | lo) * 512;
+    }
+
+    pub fn isReadOnly(self: *const Disk) bool {
+        return self.dev.features & VIRTIO_BLK_F_RO != 0;
+    }
+
+    /// Whether the device has a volatile write cache that flush() drains.
+    /// Without it, completed writes are already durable.
+    pub fn hasFlush(self: *const Disk) bool {
+        return self.dev.features & VIRTIO_BLK_F_FLUSH != 0;
+    }
+
+    fn submit(self: *Disk, op: Op, sector: u64, addr: u64, len: u32) ?Tag {
+        if (!self.ready) return null;
+        // A device with a shorter queue than QUEUE_SIZE gets fewer slots
+        const slots = @min(MaxRequests, self.dev.queue_size / 3);
+        const slot = for (self.reqs[0..slots], 0..) |*r, i| {
+            if (r.state == .free) break i;
+        } else return null;
+        const req = &self.reqs[slot];
+        req.header = .{ .type_ = @intFromEnum(op), .reserved = 0, .sector = sector };
+        req.status = 0xFF; // sentinel
+        req.state = .pending;
 
-    if (virtio.probe(virtio.DEVICE_BLOCK)) |found| {
-        dev = found;
-        serial.writeAll("virtio_blk: found block device\n");
+        // Descriptor chain: header (device reads) -> data -> status (device writes)
+        const d: u16 = @intCast(slot * 3);
+        self.dev.desc[d] = .{
+            .addr = @intFromPtr(&req.header),
+            .len = @sizeOf(VirtioBlkReqHeader),
+            .flags = virtio.VRING_DESC_F_NEXT,
+            .next = if (op == .flush) d + 2 else d + 1,
+        };
+        self.dev.desc[d + 1] = .{
+            .addr = addr,
+            .len = len,
+            .flags = virtio.VRING_DESC_F_NEXT | (if (op == .read) virtio.VRING_DESC_F_WRITE else 0),
+            .next = d + 2,
+        };
+        self.dev.desc[d + 2] = .{
+            .addr = @intFromPtr(&req.status),
+            .len = 1,
+            .flags = virtio.VRING_DESC_F_WRITE,
+            .next = 0,
+        };
+        virtio.addAvail(&self.dev, d);
+        return @intCast(slot);
+    }
+
+    /// Queue a read of len bytes (a multiple of 512) into buf.
+    pub fn startRead(self: *Disk, sector: u64, buf: [*]u8, len: u32) ?Tag {
+        return self.submit(.read, sector, @intFromPtr(buf), len);
+    }
 
-        if (!virtio.setupVirtqueue(&dev)) {
-            serial.writeAll("virtio_blk: virtqueue setup failed\n");
-            return false;
+    /// Queue a write of data (a multiple of 512 bytes). data must stay
+    /// untouched until the request completes.
+    pub fn startWrite(self: *Disk, sector: u64, data: []const u8) ?Tag {
+        if (self.isReadOnly()) return null;
+        return self.submit(.write, sector, @intFromPtr(data.ptr), @intCast(data.len));
+    }
+
+    /// Queue a cache flush. It covers writes that completed before it was
+    /// kicked, not ones still in flight.
+    pub fn startFlush(self: *Disk) ?Tag {
+        return self.submit(.flush, 0, 0, 0);
+    }
+
+    /// Notify the device of everything queued so far.
+    pub fn kick(self: *Disk) void {
+        virtio.notify(&self.dev);
+    }
+
+    fn reap(self: *Disk) void {
+        while (virtio.popUsed(&self.dev)) |elem| {
+            const slot = elem.id / 3;
+            if (slot < MaxRequests and self.reqs[slot].state == .pending) self.reqs[slot].state = .done;
         }
+    }
 
-        initialized = true;
+    /// null while the request is in flight, then whether it succeeded (the
+    /// slot is released at that point).
+    pub fn poll(self: *Disk, tag: Tag) ?bool {
+        const req = &self.reqs[tag];
+        if (req.state == .pending) self.reap();
+        if (req.state != .done) return null;
+        req.state = .free;
+        return req.status == 0;
+    }
+
+    pub fn wait(self: *Disk, tag: Tag) bool {
+        while (true) {
+            if (self.poll(tag)) |ok| return ok;
+            if (comptime builtin.cpu.arch == .x86_64) {
+                asm volatile ("pause");
+            }
+        }
+    }
+
+    /// Number of requests queued or in flight.
+    pub fn pending(self: *const Disk) u32 {
+        var n: u32 = 0;
+        for (self.reqs) |r| {
+            if (r.state != .free) n += 1;
+        }
+        return n;
+    }
+};
+
+// The rootfs drive. The functions below keep its original one-read-at-a-
+// time interface; the boot prefetch may be in flight next to sync reads.
+var root: Disk = .{};
+var async_tag: ?Tag = null;
+var async_ok: bool = false;
+
+pub fn init() bool {
+    serial.writeAll("virtio_blk: probing...\n");
+    async_tag = null;
+
+    if (root.init(0)) {
         serial.writeAll("virtio_blk: ready\n");
         return true;
-    } else {
+    }
+    if (virtio.probe(virtio.DEVICE_BLOCK) == null) {
         serial.writeAll("virtio_blk: no block device found\n");
-        return false;
+    } else {
+        serial.writeAll("virtio_blk: virtqueue setup failed\n");
     }
+    return false;
 }
 
 pub fn isReady() bool {
-    return initialized;
+    return root.ready;
+}
+
+/// Device size in bytes (0 if not initialized).
+pub fn capacityBytes() u64 {
+    return root.capacityBytes();
+}
+
+/// Start a multi-sector read as one request and return without waiting.
+/// The device fills buf while the caller does other work; collect the
+/// result with pollRead() or waitRead().
+pub fn startRead(start_sector: u64, count: u32, buf: [*]u8) bool {
+    if (!root.ready or async_tag != null or count == 0) return false;
+    async_tag = root.startRead(start_sector, buf, count * 512) orelse return false;
+    async_ok = false;
+    root.kick();
+    return true;
+}
+
+/// null while the read is in flight, then whether it succeeded.
+pub fn pollRead() ?bool {
+    if (async_tag) |tag| {
+        async_ok = root.poll(tag) orelse return null;
+        async_tag = null;
+    }
+    return async_ok;
+}
+
+pub fn waitRead() bool {
+    while (true) {
+        if (pollRead()) |ok| return ok;
+        if (comptime builtin.cpu.arch == .x86_64) {
+            asm volatile ("pause");
+        }
+    }
+}
+
+/// Read whole sectors straight into buf (a multiple of 512 bytes) as one
+/// request and wait for it. May run while the boot prefetch is in flight.
+pub fn readInto(start_sector: u64, buf: []u8) bool {
+    if (!root.ready or buf.len == 0 or buf.len % 512 != 0) return false;
+    const tag = root.startRead(start_sector, buf.ptr, @intCast(buf.len)) orelse return false;
+    root.kick();
+    return root.wait(tag);
 }
 
 /// Read sectors from the block device.
@@ -52,7 +247,7 @@ pub fn isReady() bool {
 /// buf: output buffer (must be at least count * 512 bytes)
 /// Returns true on success.
 pub fn readSectors(start_sector: u64, count: u32, buf: [*]u8) bool {
-    if (!initialized) return false;
+    if (!root.ready) return false;
     if (count == 0) return true;
 
     // Read sectors one at a time for simplicity
@@ -71,50 +266,15 @@ pub fn readSectors(start_sector: u64, count: u32, buf: [*]u8) bool {
 }
 
 fn readOneSector(sector: u64, buf: [*]u8) bool {
-    // Set up request header
-    req_header = .{
-        .type_ = VIRTIO_BLK_T_IN,
-        .reserved = 0,
-        .sector = sector,
-    };
-    req_status = 0xFF; // sentinel
-
-    // Descriptor chain: header -> data -> status
-    // Descriptor 0: request header (device reads)
-    dev.desc[0] = .{
-        .addr = @intFromPtr(&req_header),
-        .len = @sizeOf(VirtioBlkReqHeader),
-        .flags = virtio.VRING_DESC_F_NEXT,
-        .next = 1,
-    };
-
-    // Descriptor 1: data buffer (device writes)
-    dev.desc[1] = .{
-        .addr = @intFromPtr(buf),
-        .len = 512,
-        .flags = virtio.VRING_DESC_F_NEXT | virtio.VRING_DESC_F_WRITE,
-        .next = 2,
-    };
-
-    // Descriptor 2: status byte (device writes)
-    dev.desc[2] = .{
-        .addr = @intFromPtr(&req_status),
-        .len = 1,
-        .flags = virtio.VRING_DESC_F_WRITE,
-        .next = 0,
-    };
-
-    // Add to available ring and notify
-    virtio.addAvail(&dev, 0);
-    virtio.submitAndWait(&dev);
-
-    return req_status == 0;
+    const tag = root.startRead(sector, buf, 512) orelse return false;
+    root.kick();
+    return root.wait(tag);
 }
 
 /// Read raw bytes from the block device at a byte offset.
 /// Handles alignment to 512-byte sectors internally.
 pub fn readBytes(byte_offset: u64, len: usize, out: [*]u8) bool {
-    if (!initialized) return false;
+    if (!root.ready) return false;
     if (len == 0) return true;
 
     var sector_buf: [512]u8 = undefined;
@@ -0,0 +1,1055 @@
+// In-process virtio-mmio device models for host builds.
+//
+// With config.hosted (unit tests, `zig build bench`) the virtio MMIO
+// accessors land here instead of on hardware. Devices occupy the slots
+// Firecracker uses, so virtio.probe and the drivers run unmodified, and
+// descriptor addresses are plain host pointers. A queue notify is processed
+// synchronously, unless the device is stalled; then it waits for
+// complete().
+//
+// virtio-blk serves reads, writes and flushes from a caller-owned disk
+// image. virtio-net hands every transmitted frame to its peer: `capture`
+// only records it, `loopback` sends it straight back, and `gateway` plays
+// 172.16.0.1, answering ARP requests and echoing UDP datagrams (fragment
+// by fragment). Frames for the guest wait in a small backlog until the
+// driver posts a buffer. setNetMtu offers VIRTIO_NET_F_MTU.
+// virtio-balloon counts inflated and deflated PFNs and zero-fills every
+// range on the reporting queue, as the host dropping those pages would.
+//
+// Faults are set per device: I/O errors on every n-th blk request,
+// rejected feature negotiation, missing queues, dropped TX frames, stalls.
+
+const std = @import("std");
+const config = @import("config.zig");
+const virtio = @import("virtio.zig");
+const virtio_blk = @import("virtio_blk.zig");
+const virtio_net = @import("virtio_net.zig");
+const net = @import("net.zig");
+const pcap = @import("pcap.zig");
+const frame_ring = @import("frame_ring.zig");
+const tar = @import("tar.zig");
+const bundle = @import("bundle.zig");
+
+pub const MaxQueues = 3;
+pub const QueueNumMax: u32 = 256;
+const ConfigSize = 64;
+const VendorId: u32 = 0x554d4551; // "QEMU", as Firecracker reports
+const MaxChain = 16;
+
+// virtio-blk requests
+pub const BLK_T_IN: u32 = 0;
+pub const BLK_T_OUT: u32 = 1;
+pub const BLK_T_FLUSH: u32 = 4;
+pub const BLK_S_OK: u8 = 0;
+pub const BLK_S_IOERR: u8 = 1;
+pub const BLK_S_UNSUPP: u8 = 2;
+pub const BLK_F_RO: u64 = 1 << 5;
+pub const BLK_F_FLUSH: u64 = 1 << 9;
+
+// virtio-net
+pub const NET_F_MTU: u64 = 1 << 3;
+pub const NET_F_MAC: u64 = 1 << 5;
+pub const MaxFrame = 14 + 9000;
+const NetHdrSize = 10;
+const RxQueue = 0;
+const TxQueue = 1;
+const RxBacklog = 8;
+
+// virtio-balloon
+pub const BALLOON_F_MUST_TELL_HOST: u64 = 1 << 0;
+pub const BALLOON_F_REPORTING: u64 = 1 << 5;
+const InflateQueue = 0;
+const DeflateQueue = 1;
+const ReportingQueue = 2;
+
+/// MAC the gateway peer answers ARP requests with
+pub const GatewayMac = [6]u8{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+pub const Peer = enum { capture, loopback, gateway };
+
+pub const Faults = struct {
+    /// Fail every n-th blk request with BLK_S_IOERR (1: all of them)
+    blk_error_every: u32 = 0,
+    /// Drop every n-th transmitted frame after completing it
+    tx_drop_every: u32 = 0,
+    /// Leave FEATURES_OK clear when the driver sets it
+    reject_features: bool = false,
+    /// Report QueueNumMax = 0 for every queue
+    no_queues: bool = false,
+    /// Hold notified requests (and RX delivery) until complete()
+    stall: bool = false,
+};
+
+pub const Stats = struct {
+    notifies: u64 = 0,
+    requests: u64 = 0,
+    errors: u64 = 0,
+    bytes_read: u64 = 0,
+    bytes_written: u64 = 0,
+    flushes: u64 = 0,
+    tx_frames: u64 = 0,
+    tx_dropped: u64 = 0,
+    rx_frames: u64 = 0,
+    rx_dropped: u64 = 0,
+    inflated_pages: u64 = 0,
+    deflated_pages: u64 = 0,
+    reports: u64 = 0,
+    reported_bytes: u64 = 0,
+};
+
+const Queue = struct {
+    num: u32 = 0,
+    ready: bool = false,
+    desc: u64 = 0,
+    avail: u64 = 0,
+    used: u64 = 0,
+    last_avail: u16 = 0,
+    used_idx: u16 = 0,
+    held: bool = false,
+};
+
+pub const Device = struct {
+    present: bool = false,
+    device_id: u32 = 0,
+    num_queues: u32 = 0,
+    features: u64 = 0,
+    features_sel: u32 = 0,
+    driver_features: u64 = 0,
+    driver_features_sel: u32 = 0,
+    status: u32 = 0,
+    queue_sel: u32 = 0,
+    queues: [MaxQueues]Queue = [_]Queue{.{}} ** MaxQueues,
+    isr: u32 = 0,
+    config: [ConfigSize]u8 = [_]u8{0} ** ConfigSize,
+    faults: Faults = .{},
+    stats: Stats = .{},
+    // virtio-blk
+    disk: []u8 = &.{},
+    // virtio-net
+    peer: Peer = .capture,
+    last_tx: [MaxFrame]u8 = undefined,
+    last_tx_len: usize = 0,
+    rx_backlog: [RxBacklog][MaxFrame]u8 = undefined,
+    rx_backlog_len: [RxBacklog]usize = undefined,
+    rx_head: usize = 0,
+    rx_count: usize = 0,
+
+    /// The most recent frame the driver transmitted (without virtio header).
+    pub fn lastTx(self: *const Device) []const u8 {
+        return self.last_tx[0..self.last_tx_len];
+    }
+};
+
+var devices: [virtio.MAX_DEVICES]Device = [_]Device{.{}} ** virtio.MAX_DEVICES;
+
+/// Remove every device.
+pub fn reset() void {
+    for (&devices) |*dev| dev.* = .{};
+}
+
+fn addDevice(device_id: u32, num_queues: u32, features: u64) *Device {
+    for (&devices) |*dev| {
+        if (dev.present) continue;
+        dev.* = .{ .present = true, .device_id = device_id, .num_queues = num_queues, .features = features };
+        return dev;
+    }
+    @panic("virtio_mock: no free MMIO slot");
+}
+
+/// A block device backed by `disk` (whole sectors are visible).
+pub fn addBlk(disk: []u8) *Device {
+    const dev = addDevice(virtio.DEVICE_BLOCK, 1, BLK_F_FLUSH);
+    dev.disk = disk;
+    std.mem.writeInt(u64, dev.config[0..8], disk.len / 512, .little);
+    return dev;
+}
+
+pub fn addNet(mac: [6]u8, peer: Peer) *Device {
+    const dev = addDevice(virtio.DEVICE_NET, 2, NET_F_MAC);
+    dev.peer = peer;
+    @memcpy(dev.config[0..6], &mac);
+    return dev;
+}
+
+/// Offer VIRTIO_NET_F_MTU with `mtu` in the config space; set before the
+/// driver initializes.
+pub fn setNetMtu(dev: *Device, mtu: u16) void {
+    dev.features |= NET_F_MTU;
+    std.mem.writeInt(u16, dev.config[10..12], mtu, .little);
+}
+
+/// A balloon with inflate, deflate and (if offered) reporting queues.
+pub fn addBalloon(features: u64) *Device {
+    const queues: u32 = if (features & BALLOON_F_REPORTING != 0) 3 else 2;
+    return addDevice(virtio.DEVICE_BALLOON, queues, features);
+}
+
+/// Ask the driver to grow or shrink the balloon to `pages` 4 KiB pages.
+pub fn setBalloonTarget(dev: *Device, pages: u32) void {
+    std.mem.writeInt(u32, dev.config[0..4], pages, .little);
+    dev.isr |= 2; // configuration change
+}
+
+/// The balloon size the driver last reported (config `actual`).
+pub fn balloonActual(dev: *const Device) u32 {
+    return std.mem.readInt(u32, dev.config[4..8], .little);
+}
+
+fn slotOf(base: u64) ?*Device {
+    if (base < virtio.MMIO_BASE or (base - virtio.MMIO_BASE) % virtio.MMIO_STRIDE != 0) return null;
+    const i = (base - virtio.MMIO_BASE) / virtio.MMIO_STRIDE;
+    if (i >= devices.len or !devices[i].present) return null;
+    return &devices[i];
+}
+
+fn selected(dev: *Device) ?*Queue {
+    return if (dev.queue_sel < dev.num_queues) &dev.queues[dev.queue_sel] else null;
+}
+
+fn configRead(dev: *const Device, offset: u32, width: u32) u32 {
+    if (offset < virtio.MMIO_CONFIG or offset - virtio.MMIO_CONFIG + width > ConfigSize) return 0;
+    const start = offset - virtio.MMIO_CONFIG;
+    var value: u32 = 0;
+    for (0..width) |i| value |= @as(u32, dev.config[start + i]) << @intCast(8 * i);
+    return value;
+}
+
+// --- Register interface (called by virtio.mmioRead32 etc.) ---
+
+pub fn read32(base: u64, offset: u32) u32 {
+    const dev = slotOf(base) orelse return 0;
+    return switch (offset) {
+        virtio.MMIO_MAGIC => virtio.MAGIC_VALUE,
+        virtio.MMIO_VERSION => 2,
+        virtio.MMIO_DEVICE_ID => dev.device_id,
+        virtio.MMIO_VENDOR_ID => VendorId,
+        virtio.MMIO_DEVICE_FEATURES => switch (dev.features_sel) {
+            0 => @truncate(dev.features),
+            1 => @truncate(dev.features >> 32),
+            else => 0,
+        },
+        virtio.MMIO_QUEUE_NUM_MAX => if (selected(dev) != null and !dev.faults.no_queues) QueueNumMax else 0,
+        virtio.MMIO_QUEUE_READY => if (selected(dev)) |q| @intFromBool(q.ready) else 0,
+        virtio.MMIO_INTERRUPT_STATUS => dev.isr,
+        virtio.MMIO_STATUS => dev.status,
+        else => configRead(dev, offset, 4),
+    };
+}
+
+pub fn read8(base: u64, offset: u32) u8 {
+    const dev = slotOf(base) orelse return 0;
+    return @truncate(configRead(dev, offset, 1));
+}
+
+fn configWrite(dev: *Device, offset: u32, value: u32) void {
+    if (offset < virtio.MMIO_CONFIG or offset - virtio.MMIO_CONFIG + 4 > ConfigSize) return;
+    const start = offset - virtio.MMIO_CONFIG;
+    std.mem.writeInt(u32, dev.config[start..][0..4], value, .little);
+}
+
+fn setLow(field: *u64, value: u32) void {
+    field.* = (field.* & 0xFFFF_FFFF_0000_0000) | value;
+}
+
+fn setHigh(field: *u64, value: u32) void {
+    field.* = (field.* & 0xFFFF_FFFF) | (@as(u64, value) << 32);
+}
+
+pub fn write32(base: u64, offset: u32, value: u32) void {
+    const dev = slotOf(base) orelse return;
+    switch (offset) {
+        virtio.MMIO_DEVICE_FEATURES_SEL => dev.features_sel = value,
+        virtio.MMIO_DRIVER_FEATURES_SEL => dev.driver_features_sel = value,
+        virtio.MMIO_DRIVER_FEATURES => switch (dev.driver_features_sel) {
+            0 => setLow(&dev.driver_features, value),
+            1 => setHigh(&dev.driver_features, value),
+            else => {},
+        },
+        virtio.MMIO_QUEUE_SEL => dev.queue_sel = value,
+        virtio.MMIO_QUEUE_NUM => if (selected(dev)) |q| {
+            q.num = @min(value, QueueNumMax);
+        },
+        virtio.MMIO_QUEUE_READY => if (selected(dev)) |q| {
+            q.ready = value != 0;
+        },
+        virtio.MMIO_QUEUE_DESC_LOW => if (selected(dev)) |q| setLow(&q.desc, value),
+        virtio.MMIO_QUEUE_DESC_HIGH => if (selected(dev)) |q| setHigh(&q.desc, value),
+        virtio.MMIO_QUEUE_AVAIL_LOW => if (selected(dev)) |q| setLow(&q.avail, value),
+        virtio.MMIO_QUEUE_AVAIL_HIGH => if (selected(dev)) |q| setHigh(&q.avail, value),
+        virtio.MMIO_QUEUE_USED_LOW => if (selected(dev)) |q| setLow(&q.used, value),
+        virtio.MMIO_QUEUE_USED_HIGH => if (selected(dev)) |q| setHigh(&q.used, value),
+        virtio.MMIO_QUEUE_NOTIFY => notify(dev, value),
+        virtio.MMIO_INTERRUPT_ACK => dev.isr &= ~value,
+        virtio.MMIO_STATUS => setStatus(dev, value),
+        else => configWrite(dev, offset, value),
+    }
+}
+
+fn setStatus(dev: *Device, value: u32) void {
+    if (value == 0) {
+        // Device reset: negotiation and queues start over, pending RX goes
+        dev.status = 0;
+        dev.driver_features = 0;
+        dev.queues = [_]Queue{.{}} ** MaxQueues;
+        dev.isr = 0;
+        dev.rx_head = 0;
+        dev.rx_count = 0;
+        return;
+    }
+    var status = value;
+    const features_ok = virtio.STATUS_FEATURES_OK;
+    if (status & features_ok != 0 and dev.status & features_ok == 0) {
+        if (dev.faults.reject_features or dev.driver_features & ~dev.features != 0) status &= ~features_ok;
+    }
+    dev.status = status;
+}
+
+fn notify(dev: *Device, index: u32) void {
+    dev.stats.notifies += 1;
+    if (index >= dev.num_queues) return;
+    const q = &dev.queues[index];
+    if (!q.ready or q.num == 0) return;
+    if (dev.faults.stall) {
+        q.held = true;
+        return;
+    }
+    processQueue(dev, index);
+}
+
+/// Clear a stall and process everything it held back.
+pub fn complete(dev: *Device) void {
+    dev.faults.stall = false;
+    for (dev.queues[0..dev.num_queues], 0..) |*q, i| {
+        if (!q.held) continue;
+        q.held = false;
+        processQueue(dev, @intCast(i));
+    }
+}
+
+fn processQueue(dev: *Device, index: u32) void {
+    switch (dev.device_id) {
+        virtio.DEVICE_BLOCK => {
+            while (popAvail(&dev.queues[0])) |head| blkRequest(dev, head);
+        },
+        virtio.DEVICE_NET => {
+            if (index == RxQueue) {
+                deliverRx(dev);
+            } else {
+                while (popAvail(&dev.queues[TxQueue])) |head| netTx(dev, head);
+            }
+        },
+        virtio.DEVICE_BALLOON => {
+            while (popAvail(&dev.queues[index])) |head| balloonRequest(dev, index, head);
+        },
+        else => {},
+    }
+}
+
+// --- Split ring ---
+
+fn popAvail(q: *Queue) ?u16 {
+    const idx: *const volatile u16 = @ptrFromInt(q.avail + 2);
+    if (q.last_avail == idx.*) return null;
+    const ring: [*]const volatile u16 = @ptrFromInt(q.avail + 4);
+    const head = ring[q.last_avail % q.num];
+    q.last_avail +%= 1;
+    return head;
+}
+
+fn pushUsed(dev: *Device, q: *Queue, head: u16, len: u32) void {
+    const elem: [*]volatile u32 = @ptrFromInt(q.used + 4 + @as(u64, q.used_idx % q.num) * 8);
+    elem[0] = head;
+    elem[1] = len;
+    q.used_idx +%= 1;
+    const idx: *volatile u16 = @ptrFromInt(q.used + 2);
+    idx.* = q.used_idx;
+    dev.isr |= 1;
+}
+
+fn descAt(q: *const Queue, i: u16) virtio.VirtqDesc {
+    const table: [*]const volatile virtio.VirtqDesc = @ptrFromInt(q.desc);
+    return table[i % q.num];
+}
+
+fn walkChain(q: *const Queue, head: u16, out: *[MaxChain]virtio.VirtqDesc) usize {
+    var n: usize = 0;
+    var i = head;
+    while (n < MaxChain) {
+        const d = descAt(q, i);
+        out[n] = d;
+        n += 1;
+        if (d.flags & virtio.VRING_DESC_F_NEXT == 0) break;
+        i = d.next;
+    }
+    return n;
+}
+
+// --- virtio-blk ---
+
+fn blkRequest(dev: *Device, head: u16) void {
+    const q = &dev.queues[0];
+    dev.stats.requests += 1;
+    var chain: [MaxChain]virtio.VirtqDesc = undefined;
+    const n = walkChain(q, head, &chain);
+    // header (16 bytes), data..., status (1 byte, device-writable)
+    if (n < 2 or chain[0].len < 16 or chain[n - 1].flags & virtio.VRING_DESC_F_WRITE == 0) {
+        dev.stats.errors += 1;
+        pushUsed(dev, q, head, 0);
+        return;
+    }
+    const hdr: [*]const u8 = @ptrFromInt(chain[0].addr);
+    const kind = std.mem.readInt(u32, hdr[0..4], .little);
+    const sector = std.mem.readInt(u64, hdr[8..16], .little);
+
+    var status = BLK_S_OK;
+    var written: u32 = 0;
+    const every = dev.faults.blk_error_every;
+    if (every != 0 and dev.stats.requests % every == 0) {
+        status = BLK_S_IOERR;
+    } else if (kind == BLK_T_OUT and dev.driver_features & BLK_F_RO != 0) {
+        status = BLK_S_IOERR;
+    } else switch (kind) {
+        BLK_T_IN, BLK_T_OUT => {
+            var offset: u64 = std.math.mul(u64, sector, 512) catch std.math.maxInt(u64);
+            for (chain[1 .. n - 1]) |d| {
+                if (offset > dev.disk.len or d.len > dev.disk.len - offset) {
+                    status = BLK_S_IOERR;
+                    break;
+                }
+                const start: usize = @intCast(offset);
+                const buf: [*]u8 = @ptrFromInt(d.addr);
+                if (kind == BLK_T_IN) {
+                    @memcpy(buf[0..d.len], dev.disk[start .. start + d.len]);
+                    written += d.len;
+                    dev.stats.bytes_read += d.len;
+                } else {
+                    @memcpy(dev.disk[start .. start + d.len], buf[0..d.len]);
+                    dev.stats.bytes_written += d.len;
+                }
+                offset += d.len;
+            }
+        },
+        BLK_T_FLUSH => dev.stats.flushes += 1,
+        else => status = BLK_S_UNSUPP,
+    }
+    if (status != BLK_S_OK) dev.stats.errors += 1;
+    const status_ptr: *volatile u8 = @ptrFromInt(chain[n - 1].addr);
+    status_ptr.* = status;
+    pushUsed(dev, q, head, written + 1);
+}
+
+// --- virtio-net ---
+
+/// Queue a frame for the guest; it lands in the next receive buffer the
+/// driver posts. False (and counted as dropped) if the backlog is full.
+pub fn injectRx(dev: *Device, frame: []const u8) bool {
+    if (frame.len > MaxFrame or dev.rx_count == RxBacklog) {
+        dev.stats.rx_dropped += 1;
+        return false;
+    }
+    const slot = (dev.rx_head + dev.rx_count) % RxBacklog;
+    @memcpy(dev.rx_backlog[slot][0..frame.len], frame);
+    dev.rx_backlog_len[slot] = frame.len;
+    dev.rx_count += 1;
+    deliverRx(dev);
+    return true;
+}
+
+fn deliverRx(dev: *Device) void {
+    const q = &dev.queues[RxQueue];
+    if (!q.ready or q.num == 0) return;
+    if (dev.faults.stall) {
+        q.held = true;
+        return;
+    }
+    while (dev.rx_count > 0) {
+        const head = popAvail(q) orelse return;
+        const d = descAt(q, head);
+        const frame = dev.rx_backlog[dev.rx_head][0..dev.rx_backlog_len[dev.rx_head]];
+        dev.rx_head = (dev.rx_head + 1) % RxBacklog;
+        dev.rx_count -= 1;
+
+        const total = NetHdrSize + frame.len;
+        if (d.len < total) {
+            dev.stats.rx_dropped += 1;
+            pushUsed(dev, q, head, 0);
+            continue;
+        }
+        const buf: [*]u8 = @ptrFromInt(d.addr);
+        @memset(buf[0..NetHdrSize], 0);
+        @memcpy(buf[NetHdrSize..total], frame);
+        pushUsed(dev, q, head, @intCast(total));
+        dev.stats.rx_frames += 1;
+    }
+}
+
+fn netTx(dev: *Device, head: u16) void {
+    const q = &dev.queues[TxQueue];
+    var chain: [MaxChain]virtio.VirtqDesc = undefined;
+    const n = walkChain(q, head, &chain);
+    var buf: [NetHdrSize + MaxFrame]u8 = undefined;
+    var len: usize = 0;
+    for (chain[0..n]) |d| {
+        const take = @min(d.len, buf.len - len);
+        const src: [*]const u8 = @ptrFromInt(d.addr);
+        @memcpy(buf[len .. len + take], src[0..take]);
+        len += take;
+    }
+    pushUsed(dev, q, head, 0);
+    if (len <= NetHdrSize) return;
+
+    const frame = buf[NetHdrSize..len];
+    dev.stats.tx_frames += 1;
+    const every = dev.faults.tx_drop_every;
+    if (every != 0 and dev.stats.tx_frames % every == 0) {
+        dev.stats.tx_dropped += 1;
+        return;
+    }
+    @memcpy(dev.last_tx[0..frame.len], frame);
+    dev.last_tx_len = frame.len;
+    switch (dev.peer) {
+        .capture => {},
+        .loopback => _ = injectRx(dev, frame),
+        .gateway => gatewayReply(dev, frame),
+    }
+}
+
+fn swapBytes(a: []u8, b: []u8) void {
+    for (a, b) |*x, *y| std.mem.swap(u8, x, y);
+}
+
+fn gatewayReply(dev: *Device, frame: []u8) void {
+    if (frame.len < 14) return;
+    const ethertype = std.mem.readInt(u16, frame[12..14], .big);
+    const guest_mac = frame[6..12].*;
+
+    if (ethertype == 0x0806 and frame.len >= 14 + 28) {
+        // ARP request for any address: answer with the gateway MAC
+        const arp = frame[14..];
+        if (std.mem.readInt(u16, arp[6..8], .big) != 1) return;
+        var reply: [14 + 28]u8 = undefined;
+        @memcpy(reply[0..6], &guest_mac);
+        @memcpy(reply[6..12], &GatewayMac);
+        reply[12] = 0x08;
+        reply[13] = 0x06;
+        @memcpy(reply[14..20], arp[0..6]); // htype, ptype, hlen, plen
+        reply[20] = 0;
+        reply[21] = 2; // reply
+        @memcpy(reply[22..28], &GatewayMac);
+        @memcpy(reply[28..32], arp[24..28]); // sender IP = requested IP
+        @memcpy(reply[32..38], arp[8..14]);
+        @memcpy(reply[38..42], arp[14..18]);
+        _ = injectRx(dev, &reply);
+    } else if (ethertype == 0x0800 and frame.len >= 14 + 20 + 8) {
+        // UDP echo. Swapping addresses and ports keeps both checksums
+        // valid; only a first fragment carries the ports
+        const ip = frame[14..];
+        if (ip[9] != 17) return;
+        const ihl: usize = @as(usize, ip[0] & 0x0F) * 4;
+        if (ihl < 20 or ip.len < ihl + 8) return;
+        @memcpy(frame[0..6], &guest_mac);
+        @memcpy(frame[6..12], &GatewayMac);
+        swapBytes(ip[12..16], ip[16..20]);
+        const frag_offset = std.mem.readInt(u16, ip[6..8], .big) & 0x1FFF;
+        if (frag_offset == 0) swapBytes(ip[ihl .. ihl + 2], ip[ihl + 2 .. ihl + 4]);
+        _ = injectRx(dev, frame);
+    }
+}
+
+// --- virtio-balloon ---
+
+fn balloonRequest(dev: *Device, index: u32, head: u16) void {
+    const q = &dev.queues[index];
+    var chain: [MaxChain]virtio.VirtqDesc = undefined;
+    const n = walkChain(q, head, &chain);
+    for (chain[0..n]) |d| {
+        switch (index) {
+            InflateQueue => dev.stats.inflated_pages += d.len / 4,
+            DeflateQueue => dev.stats.deflated_pages += d.len / 4,
+            ReportingQueue => {
+                const range: [*]u8 = @ptrFromInt(d.addr);
+                @memset(range[0..d.len], 0);
+                dev.stats.reported_bytes += d.len;
+            },
+            else => {},
+        }
+    }
+    if (index == ReportingQueue) dev.stats.reports += 1;
+    pushUsed(dev, q, head, 0);
+}
+
+// --- Driver tests against the models ---
+
+var test_disk: [64 * 1024]u8 = undefined;
+
+fn fillPattern(disk: []u8) void {
+    for (disk, 0..) |*b, i| b.* = @truncate(i *% 31 +% i / 512);
+}
+
+test "blk driver reads through the split ring" {
+    reset();
+    fillPattern(&test_disk);
+    const dev = addBlk(&test_disk);
+    try std.testing.expect(virtio_blk.init());
+    try std.testing.expectEqual(@as(u64, test_disk.len), virtio_blk.capacityBytes());
+
+    var buf: [4096]u8 = undefined;
+    try std.testing.expect(virtio_blk.readSectors(3, 2, &buf));
+    try std.testing.expectEqualSlices(u8, test_disk[3 * 512 .. 5 * 512], buf[0..1024]);
+    try std.testing.expect(virtio_blk.readBytes(1000, 50, &buf));
+    try std.testing.expectEqualSlices(u8, test_disk[1000..1050], buf[0..50]);
+
+    // One request for eight sectors
+    const before = dev.stats.requests;
+    try std.testing.expect(virtio_blk.startRead(8, 8, &buf));
+    try std.testing.expect(virtio_blk.waitRead());
+    try std.testing.expectEqual(before + 1, dev.stats.requests);
+    try std.testing.expectEqualSlices(u8, test_disk[8 * 512 .. 16 * 512], buf[0..]);
+
+    // Past the end of the disk
+    try std.testing.expect(!virtio_blk.readSectors(test_disk.len / 512, 1, &buf));
+}
+
+test "blk faults: errors, stalls, rejected features, missing queues" {
+    reset();
+    fillPattern(&test_disk);
+    const dev = addBlk(&test_disk);
+    try std.testing.expect(virtio_blk.init());
+    var buf: [1024]u8 = undefined;
+
+    dev.faults.blk_error_every = 2;
+    try std.testing.expect(virtio_blk.readSectors(0, 1, &buf));
+    try std.testing.expect(!virtio_blk.readSectors(0, 1, &buf));
+    dev.faults.blk_error_every = 0;
+
+    // A stalled read stays in flight until the device completes it
+    dev.faults.stall = true;
+    try std.testing.expect(virtio_blk.startRead(2, 2, &buf));
+    try std.testing.expect(virtio_blk.pollRead() == null);
+    try std.testing.expect(!virtio_blk.startRead(0, 1, &buf));
+    complete(dev);
+    try std.testing.expectEqual(@as(?bool, true), virtio_blk.pollRead());
+    try std.testing.expectEqualSlices(u8, test_disk[1024..2048], buf[0..]);
+
+    reset();
+    addBlk(&test_disk).faults.reject_features = true;
+    try std.testing.expect(!virtio_blk.init());
+    try std.testing.expect(!virtio_blk.isReady());
+
+    reset();
+    addBlk(&test_disk).faults.no_queues = true;
+    try std.testing.expect(!virtio_blk.init());
+
+    reset();
+    try std.testing.expect(!virtio_blk.init());
+}
+
+test "blk writes, flushes and batches on a second disk" {
+    reset();
+    var root_disk = [_]u8{0} ** 4096;
+    @memset(&test_disk, 0);
+    _ = addBlk(&root_disk);
+    const model = addBlk(&test_disk);
+    var disk: virtio_blk.Disk = .{};
+    try std.testing.expect(disk.init(1));
+    try std.testing.expect(disk.hasFlush());
+    try std.testing.expect(!disk.isReadOnly());
+    try std.testing.expectEqual(@as(u64, test_disk.len), disk.capacityBytes());
+
+    // A batch of writes goes out with one notify
+    var data: [virtio_blk.MaxRequests][512]u8 = undefined;
+    var tags: [virtio_blk.MaxRequests]virtio_blk.Tag = undefined;
+    for (&data, &tags, 0..) |*d, *tag, i| {
+        @memset(d, @intCast(i + 1));
+        tag.* = disk.startWrite(2 + i, d).?;
+    }
+    try std.testing.expect(disk.startWrite(0, &data[0]) == null);
+    const notifies = model.stats.notifies;
+    disk.kick();
+    try std.testing.expectEqual(notifies + 1, model.stats.notifies);
+    for (tags, 0..) |tag, i| {
+        try std.testing.expectEqual(@as(?bool, true), disk.poll(tag));
+        try std.testing.expectEqualSlices(u8, &data[i], test_disk[(2 + i) * 512 ..][0..512]);
+    }
+    try std.testing.expectEqual(@as(u32, 0), disk.pending());
+
+    const flush = disk.startFlush().?;
+    disk.kick();
+    try std.testing.expect(disk.wait(flush));
+    try std.testing.expectEqual(@as(u64, 1), model.stats.flushes);
+
+    // Completions are matched to their requests, whatever order they are reaped in
+    var back: [1024]u8 = undefined;
+    model.faults.stall = true;
+    const r1 = disk.startRead(2, &back, 512).?;
+    const r2 = disk.startRead(3, back[512..].ptr, 512).?;
+    disk.kick();
+    try std.testing.expect(disk.poll(r2) == null);
+    complete(model);
+    try std.testing.expectEqual(@as(?bool, true), disk.poll(r2));
+    try std.testing.expectEqual(@as(?bool, true), disk.poll(r1));
+    try std.testing.expectEqualSlices(u8, test_disk[1024..2048], &back);
+
+    model.faults.blk_error_every = 1;
+    const failed = disk.startWrite(0, &data[0]).?;
+    disk.kick();
+    try std.testing.expect(!disk.wait(failed));
+    model.faults.blk_error_every = 0;
+
+    // The rootfs drive is untouched
+    try std.testing.expect(std.mem.allEqual(u8, &root_disk, 0));
+
+    reset();
+    const ro = addBlk(&test_disk);
+    ro.features |= BLK_F_RO;
+    try std.testing.expect(disk.init(0));
+    try std.testing.expect(disk.isReadOnly());
+    try std.testing.expect(disk.startWrite(0, &data[0]) == null);
+}
+
+test "tar lookups over the mock disk, prefetched and synchronous" {
+    reset();
+    tar.reset();
+    @memset(&test_disk, 0);
+    const body = "print('hi')\n";
+    const hdr = test_disk[0..512];
+    @memcpy(hdr[0..11], "src/main.py");
+    @memcpy(hdr[124..135], "00000000014");
+    hdr[156] = '0';
+    @memcpy(test_disk[512 .. 512 + body.len], body);
+    _ = addBlk(&test_disk);
+    try std.testing.expect(virtio_blk.init());
+
+    try std.testing.expectEqualStrings(body, tar.findFile("src/main.py").?);
+    try std.testing.expect(tar.findFile("src/other.py") == null);
+    tar.prefetchStart();
+    const data = tar.findFile("src/main.py").?;
+    try std.testing.expectEqualStrings(body, data);
+    try std.testing.expect(tar.isPrefetched(data));
+}
+
+test "bundle over the mock disk: raw and lz4 extents, direct and prefetched" {
+    reset();
+    tar.reset();
+    @memset(&test_disk, 0);
+    const Crc32 = std.hash.Crc32;
+    const body = "print('hi')\n";
+    const lines = "x = 1\n" ** 40;
+    const block = [_]u8{ 0x6f, 'x', ' ', '=', ' ', '1', '\n', 6, 0, 0xd2, 0x50, ' ', '=', ' ', '1', '\n' };
+    const names = "src" ++ "src/__init__.py" ++ "src/lines.py" ++ "src/main.py";
+    const file: u8 = @intFromEnum(bundle.Kind.file);
+    const entries = [_]bundle.IndexEntry{
+        .{ .offset = 0, .stored_size = 0, .size = 0, .crc = 0, .name_offset = 128, .name_len = 3, .kind = @intFromEnum(bundle.Kind.dir), .codec = 0, .reserved = 0 },
+        .{ .offset = 12288, .stored_size = 0, .size = 0, .crc = 0, .name_offset = 131, .name_len = 15, .kind = file, .codec = @intFromEnum(bundle.Codec.raw), .reserved = 0 },
+        .{ .offset = 4096, .stored_size = block.len, .size = lines.len, .crc = Crc32.hash(lines), .name_offset = 146, .name_len = 12, .kind = file, .codec = @intFromEnum(bundle.Codec.lz4), .reserved = 0 },
+        .{ .offset = 8192, .stored_size = body.len, .size = body.len, .crc = Crc32.hash(body), .name_offset = 158, .name_len = 11, .kind = file, .codec = @intFromEnum(bundle.Codec.raw), .reserved = 0 },
+    };
+    const index_bytes = test_disk[64..][0 .. @sizeOf(@TypeOf(entries)) + names.len];
+    @memcpy(index_bytes[0..@sizeOf(@TypeOf(entries))], std.mem.sliceAsBytes(&entries));
+    @memcpy(index_bytes[@sizeOf(@TypeOf(entries))..], names);
+    var hdr = bundle.Header{
+        .magic = bundle.Magic.*,
+        .version = bundle.Version,
+        .flags = 0,
+        .entry_count = entries.len,
+        .index_size = index_bytes.len,
+        .page_size = bundle.PageSize,
+        .index_crc = Crc32.hash(index_bytes),
+        .reserved = [_]u8{0} ** 32,
+        .header_crc = 0,
+    };
+    hdr.header_crc = Crc32.hash(std.mem.asBytes(&hdr)[0 .. @sizeOf(bundle.Header) - 4]);
+    @memcpy(test_disk[0..64], std.mem.asBytes(&hdr));
+    @memcpy(test_disk[4096..][0..block.len], &block);
+    @memcpy(test_disk[8192..][0..body.len], body);
+    _ = addBlk(&test_disk);
+    try std.testing.expect(virtio_blk.init());
+
+    const index = bundle.open().?;
+    try std.testing.expectEqual(@as(u32, 4), index.count);
+    try std.testing.expect(index.entry(0).is_dir);
+    const main_py = index.entry(3);
+    try std.testing.expectEqualStrings("src/main.py", main_py.name);
+    const lz = index.entry(2).extent;
+    const empty = index.entry(1).extent;
+    try std.testing.expectEqual(bundle.Codec.lz4, lz.codec);
+
+    // Without a prefetch, one read straight into the destination
+    var dest: [1024]u8 align(512) = undefined;
+    try std.testing.expect(bundle.resident(main_py.extent) == null);
+    try std.testing.expectEqualStrings(body, bundle.load(main_py.extent, &dest).?);
+    try std.testing.expectEqualStrings(lines, bundle.load(lz, &dest).?);
+    try std.testing.expect(bundle.load(lz, dest[0..512]) == null);
+    // An empty file needs no read at all
+    try std.testing.expectEqualStrings("", bundle.load(empty, &dest).?);
+
+    // Raw extents in the prefetch window are used where they are
+    tar.prefetchStart();
+    const data = bundle.resident(main_py.extent).?;
+    try std.testing.expect(tar.isPrefetched(data));
+    try std.testing.expectEqualStrings(lines, bundle.load(lz, &dest).?);
+
+    // Contents that do not match their crc, then a drive without a bundle
+    tar.reset();
+    test_disk[8192] = 'P';
+    try std.testing.expect(bundle.load(main_py.extent, &dest) == null);
+    @memset(test_disk[0..512], 0);
+    try std.testing.expect(bundle.open() == null);
+}
+
+const test_mac = [6]u8{ 0xaa, 0xfc, 0, 0, 0, 1 };
+
+test "net driver, ARP and UDP echo through the gateway peer" {
+    reset();
+    const dev = addNet(test_mac, .gateway);
+    try std.testing.expect(virtio_net.init());
+    try std.testing.expectEqualSlices(u8, &test_mac, &virtio_net.getMac());
+
+    net.udpSocketInit(0);
+    defer net.udpSocketClose(0);
+    try std.testing.expect(net.udpBind(0, 5000));
+    try std.testing.expect(net.udpConnect(0, net.GATEWAY_IP, 7));
+    try std.testing.expect(net.udpSend(0, "ping"));
+    // ARP request, then the datagram
+    try std.testing.expectEqual(@as(u64, 2), dev.stats.tx_frames);
+    try std.testing.expectEqualSlices(u8, &GatewayMac, dev.lastTx()[0..6]);
+    try std.testing.expectEqual(@as(u16, 0), net.ipChecksum(dev.lastTx()[14..34]));
+
+    net.processIncoming();
+    var buf: [64]u8 = undefined;
+    const n = net.udpRecv(0, &buf).?;
+    try std.testing.expectEqualStrings("ping", buf[0..n]);
+    try std.testing.expect(net.udpRecv(0, &buf) == null);
+
+    // Later sends reuse the header template: no ARP, a new ID, and the
+    // patched checksum still verifies
+    const first_id = std.mem.readInt(u16, dev.lastTx()[18..20], .big);
+    try std.testing.expect(net.udpSend(0, "ping, longer"));
+    try std.testing.expectEqual(@as(u64, 3), dev.stats.tx_frames);
+    const tx = dev.lastTx();
+    try std.testing.expectEqual(@as(usize, 14 + 20 + 8 + 12), tx.len);
+    try std.testing.expectEqual(first_id +% 1, std.mem.readInt(u16, tx[18..20], .big));
+    try std.testing.expectEqual(@as(u16, 20 + 8 + 12), std.mem.readInt(u16, tx[16..18], .big));
+    try std.testing.expectEqual(@as(u16, 8 + 12), std.mem.readInt(u16, tx[38..40], .big));
+    try std.testing.expectEqual(@as(u16, 0), net.ipChecksum(tx[14..34]));
+    net.processIncoming();
+    var echo: [64]u8 = undefined;
+    try std.testing.expectEqualStrings("ping, longer", echo[0..net.udpRecv(0, &echo).?]);
+}
+
+test "net MTU negotiation, jumbo frames and fragments through the gateway" {
+    reset();
+    var dev = addNet(test_mac, .gateway);
+    setNetMtu(dev, virtio_net.MaxMtu);
+    try std.testing.expect(virtio_net.init());
+    try std.testing.expectEqual(@as(u16, virtio_net.MaxMtu), virtio_net.getMtu());
+    try std.testing.expect(dev.driver_features & NET_F_MTU != 0);
+
+    net.udpSocketInit(0);
+    defer net.udpSocketClose(0);
+    try std.testing.expect(net.udpBind(0, 5000));
+    try std.testing.expect(net.udpConnect(0, net.GATEWAY_IP, 7));
+    var payload: [@max(virtio_net.MaxMtu, 4000)]u8 = undefined;
+    for (&payload, 0..) |*b, i| b.* = @truncate(i ^ (i >> 8));
+    var echo: [@max(virtio_net.MaxMtu, 4000)]u8 = undefined;
+
+    // The largest datagram that fits one jumbo frame
+    const jumbo = payload[0 .. virtio_net.MaxMtu - 28];
+    const sent = net.frag_stats.fragments_sent;
+    try std.testing.expect(net.udpSend(0, jumbo));
+    try std.testing.expectEqual(sent, net.frag_stats.fragments_sent);
+    try std.testing.expectEqual(@as(usize, 14 + virtio_net.MaxMtu), dev.lastTx().len);
+    net.processIncoming();
+    try std.testing.expectEqualSlices(u8, jumbo, echo[0..net.udpRecv(0, &echo).?]);
+
+    // An MTU larger than the buffers is declined
+    reset();
+    dev = addNet(test_mac, .gateway);
+    setNetMtu(dev, virtio_net.MaxMtu + 1);
+    try std.testing.expect(virtio_net.init());
+    try std.testing.expectEqual(@as(u16, virtio_net.DefaultMtu), virtio_net.getMtu());
+    try std.testing.expect(dev.driver_features & NET_F_MTU == 0);
+
+    // At 1500 the same socket sends 4000 bytes as three fragments, which
+    // the gateway echoes one by one and the stack puts back together
+    try std.testing.expect(net.udpConnect(0, net.GATEWAY_IP, 7));
+    const reassembled = net.frag_stats.reassembled;
+    try std.testing.expect(net.udpSend(0, payload[0..4000]));
+    try std.testing.expectEqual(sent + 3, net.frag_stats.fragments_sent);
+    const last = dev.lastTx();
+    try std.testing.expectEqual(@as(usize, 14 + 20 + 4008 - 2 * 1480), last.len);
+    try std.testing.expectEqual(@as(u16, 2 * 1480 / 8), std.mem.readInt(u16, last[20..22], .big));
+    try std.testing.expectEqual(@as(u16, 0), net.ipChecksum(last[14..34]));
+    net.processIncoming();
+    try std.testing.expectEqual(reassembled + 1, net.frag_stats.reassembled);
+    try std.testing.expectEqualSlices(u8, payload[0..4000], echo[0..net.udpRecv(0, &echo).?]);
+}
+
+test "frames the stack drops are tagged in the capture ring" {
+    if (!config.pcap) return error.SkipZigTest;
+    reset();
+    _ = addNet(test_mac, .loopback);
+    try std.testing.expect(virtio_net.init());
+    pcap.reset();
+    defer pcap.reset();
+
+    net.udpSocketInit(0);
+    defer net.udpSocketClose(0);
+    try std.testing.expect(net.udpBind(0, 5000));
+    // To ourselves, at a port nothing is bound to
+    try std.testing.expect(net.udpConnect(0, net.OUR_IP, 6000));
+    try std.testing.expect(net.udpSend(0, "lost"));
+    net.processIncoming();
+    const lost = pcap.newest().?;
+    try std.testing.expectEqual(@intFromEnum(pcap.Dir.rx), lost.dir);
+    try std.testing.expectEqual(@intFromEnum(pcap.Reason.no_socket), lost.reason);
+    try std.testing.expectEqual(@as(u16, 14 + 20 + 8 + 4), lost.orig_len);
+
+    // Two datagrams before a read: the second overwrites the first
+    try std.testing.expect(net.udpConnect(0, net.OUR_IP, 5000));
+    try std.testing.expect(net.udpSend(0, "one"));
+    try std.testing.expect(net.udpSend(0, "two"));
+    net.processIncoming();
+    try std.testing.expectEqual(@intFromEnum(pcap.Reason.rx_overwrite), pcap.newest().?.reason);
+
+    var frame = [_]u8{0} ** 60;
+    frame[12] = 0x86; // IPv6
+    frame[13] = 0xdd;
+    try std.testing.expect(virtio_net.txPacket(&frame));
+    try std.testing.expectEqual(@intFromEnum(pcap.Dir.tx), pcap.newest().?.dir);
+    net.processIncoming();
+    try std.testing.expectEqual(@intFromEnum(pcap.Reason.unsupported), pcap.newest().?.reason);
+}
+
+/// Minimal Ethernet/IPv4/UDP frame from the guest to the gateway
+fn rawUdpFrame(buf: []u8, src_port: u16, dst_port: u16, tag: u8) u16 {
+    const len = 14 + 20 + 8 + 1;
+    @memset(buf[0..len], 0);
+    @memcpy(buf[0..6], &GatewayMac);
+    @memcpy(buf[6..12], &test_mac);
+    std.mem.writeInt(u16, buf[12..14], 0x0800, .big);
+    buf[14] = 0x45;
+    std.mem.writeInt(u16, buf[16..18], 20 + 8 + 1, .big);
+    buf[22] = 64;
+    buf[23] = 17;
+    @memcpy(buf[26..30], &net.OUR_IP);
+    @memcpy(buf[30..34], &net.GATEWAY_IP);
+    std.mem.writeInt(u16, buf[34..36], src_port, .big);
+    std.mem.writeInt(u16, buf[36..38], dst_port, .big);
+    std.mem.writeInt(u16, buf[38..40], 8 + 1, .big);
+    buf[42] = tag;
+    return len;
+}
+
+test "raw frame rings: steering, batched sends and ARP left to the stack" {
+    if (!config.net_raw) return error.SkipZigTest;
+    reset();
+    const dev = addNet(test_mac, .gateway);
+    try std.testing.expect(virtio_net.init());
+
+    const entries = 4;
+    var mem: [frame_ring.ringSize(entries)]u8 align(64) = undefined;
+    net.frameAttach(0, frame_ring.Ring.init(@intFromPtr(&mem), entries), .{});
+    const ring = net.frameRing(0);
+
+    // With everything steered to the ring, an ARP request for the guest is
+    // still answered by the stack
+    var arp = [_]u8{0} ** (14 + 28);
+    @memset(arp[0..6], 0xff);
+    @memcpy(arp[6..12], &GatewayMac);
+    arp[12] = 0x08;
+    arp[13] = 0x06;
+    @memcpy(arp[14..22], &[_]u8{ 0, 1, 8, 0, 6, 4, 0, 1 });
+    @memcpy(arp[22..28], &GatewayMac);
+    @memcpy(arp[28..32], &net.GATEWAY_IP);
+    @memcpy(arp[38..42], &net.OUR_IP);
+    try std.testing.expect(injectRx(dev, &arp));
+    const tx_frames = dev.stats.tx_frames;
+    net.processIncoming();
+    try std.testing.expectEqual(tx_frames + 1, dev.stats.tx_frames);
+    try std.testing.expectEqual(@as(u16, 2), std.mem.readInt(u16, dev.lastTx()[20..22], .big));
+    try std.testing.expectEqual(@as(u32, 0), ring.rxPending());
+
+    // Now only UDP port 9000: three frames go out on one notify, and the
+    // gateway's echoes come back to that port
+    net.frameDetach(0);
+    net.frameAttach(0, frame_ring.Ring.init(@intFromPtr(&mem), entries), .{ .udp_port = 9000 });
+    defer net.frameDetach(0);
+    var i: u8 = 0;
+    while (i < 3) : (i += 1) {
+        const desc = &ring.tx[i];
+        desc.len = rawUdpFrame(ring.slot(desc.slot).?[0..frame_ring.SlotSize], 9000, 7, i);
+    }
+    ring.hdr.tx_tail = 3;
+    const notifies = dev.stats.notifies;
+    try std.testing.expectEqual(@as(u32, 3), net.frameTransmit(0));
+    try std.testing.expectEqual(notifies + 1, dev.stats.notifies);
+    try std.testing.expectEqual(@as(u32, 3), ring.hdr.tx_head);
+    net.processIncoming();
+    try std.testing.expectEqual(@as(u32, 3), ring.rxPending());
+    const echo = ring.slot(ring.rx[2].slot).?;
+    try std.testing.expectEqual(@as(u16, 9000), std.mem.readInt(u16, echo[36..38], .big));
+    try std.testing.expectEqual(@as(u8, 2), echo[42]);
+
+    // A UDP socket on another port is unaffected
+    net.udpSocketInit(0);
+    defer net.udpSocketClose(0);
+    try std.testing.expect(net.udpBind(0, 5000));
+    try std.testing.expect(net.udpConnect(0, net.GATEWAY_IP, 7));
+    try std.testing.expect(net.udpSend(0, "stack"));
+    net.processIncoming();
+    var buf: [16]u8 = undefined;
+    try std.testing.expectEqualStrings("stack", buf[0..net.udpRecv(0, &buf).?]);
+    try std.testing.expectEqual(@as(u32, 3), ring.rxPending());
+
+    // Forward the first echo by moving its slot to the TX ring; it is
+    // sent from that slot without a copy
+    const first = ring.rx[0];
+    std.mem.swap(u32, &ring.rx[0].slot, &ring.tx[3].slot);
+    ring.tx[3].len = first.len;
+    ring.hdr.rx_head = 1;
+    ring.hdr.tx_tail = 4;
+    try std.testing.expectEqual(@as(u32, 1), net.frameTransmit(0));
+    try std.testing.expectEqualSlices(u8, ring.slot(first.slot).?[0..first.len], dev.lastTx());
+
+    // Three more echoes for two free RX descriptors: the last is dropped
+    while (i < 6) : (i += 1) {
+        const desc = &ring.tx[i - 3];
+        desc.len = rawUdpFrame(ring.slot(desc.slot).?[0..frame_ring.SlotSize], 9000, 7, i);
+    }
+    ring.hdr.tx_tail = 7;
+    try std.testing.expectEqual(@as(u32, 3), net.frameTransmit(0));
+    net.processIncoming();
+    try std.testing.expectEqual(@as(u32, 4), ring.rxPending());
+    try std.testing.expectEqual(@as(u32, 1), ring.hdr.rx_dropped);
+}
+
+test "net RX backlog, drops and loopback" {
+    reset();
+    const dev = addNet(test_mac, .loopback);
+    try std.testing.expect(virtio_net.init());
+
+    var frame = [_]u8{0x11} ** 60;
+    // Posted buffers fill first, then the backlog; the rest is dropped
+    const capacity = config.net_rx_bufs + RxBacklog;
+    var queued: usize = 0;
+    while (injectRx(dev, &frame)) queued += 1;
+    try std.testing.expectEqual(@as(usize, capacity), queued);
+    try std.testing.expectEqual(@as(u64, 1), dev.stats.rx_dropped);
+
+    var polled: usize = 0;
+    while (virtio_net.rxPoll()) |rx| {
+        try std.testing.expectEqualSlices(u8, &frame, rx);
+        polled += 1;
+    }
+    try std.testing.expectEqual(queued, polled);
+
+    frame[0] = 0x22;
+    try std.testing.expect(virtio_net.txPacket(&frame));
+    try std.testing.expectEqualSlices(u8, &frame, virtio_net.rxPoll().?);
+
+    dev.faults.tx_drop_every = 1;
+    try std.testing.expect(virtio_net.txPacket(&frame));
+    try std.testing.expect(virtio_net.rxPoll() == null);
+    try std.testing.expectEqual(@as(u64, 1), dev.stats.tx_dropped);
+}
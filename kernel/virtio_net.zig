@@ -1,6 +1,8 @@
 const virtio = @import("virtio.zig");
 const serial = @import("serial.zig");
 const builtin = @import("builtin");
+const config = @import("config.zig");
+const pcap = @import("pcap.zig");
 
 // Virtio net header — prepended to every frame
 const VirtioNetHdr = extern struct {
@@ -15,22 +17,34 @@ const VirtioNetHdr = extern struct {
 const NET_HDR_SIZE = @sizeOf(VirtioNetHdr);
 
 // Feature bits
+const VIRTIO_NET_F_MTU: u32 = 1 << 3;
 const VIRTIO_NET_F_MAC: u32 = 1 << 5;
 
+// Device config space: mac[6], status u16, max_virtqueue_pairs u16, mtu u16
+const CONFIG_MTU: u32 = virtio.MMIO_CONFIG + 10;
+
 // Queue indices
 const RX_QUEUE: u32 = 0;
 const TX_QUEUE: u32 = 1;
 
 // Queue sizes
-const QUEUE_SIZE = 16;
-const NUM_RX_BUFS = 8;
+const QUEUE_SIZE = config.virtq_size;
+const NUM_RX_BUFS = config.net_rx_bufs;
+
+/// Largest MTU the buffers are sized for (-Dnet-max-mtu, up to 9000)
+pub const MaxMtu = config.net_max_mtu;
+/// MTU without VIRTIO_NET_F_MTU, or when the device's does not fit
+pub const DefaultMtu = 1500;
+pub const ETH_HDR_SIZE = 14;
+const MIN_MTU = 68;
 
-// Max frame: 10 (net_hdr) + 14 (eth) + 1500 (MTU) + 2 (pad)
-const MAX_FRAME_SIZE = 1526;
+// Max frame: 10 (net_hdr) + 14 (eth) + MaxMtu + 2 (pad)
+const MAX_FRAME_SIZE = NET_HDR_SIZE + ETH_HDR_SIZE + MaxMtu + 2;
 
 // Device state
 var base_addr: u64 = 0;
 var mac_addr: [6]u8 = undefined;
+var mtu: u16 = DefaultMtu;
 var initialized: bool = false;
 
 // RX queue state
@@ -53,6 +67,20 @@ var rx_bufs: [NUM_RX_BUFS][MAX_FRAME_SIZE]u8 align(16) = undefined;
 // TX buffer
 var tx_buf: [MAX_FRAME_SIZE]u8 align(16) = undefined;
 
+// Net header shared by every txBatch chain; all zero, the device only reads it
+var tx_batch_hdr: VirtioNetHdr align(16) = .{
+    .flags = 0,
+    .gso_type = 0,
+    .hdr_len = 0,
+    .gso_size = 0,
+    .csum_start = 0,
+    .csum_offset = 0,
+};
+
+/// Frames one txBatch notify can carry: two descriptors each (shared net
+/// header, frame).
+pub const MaxTxBatch = QUEUE_SIZE / 2;
+
 fn setupQueue(queue_idx: u32, desc: [*]virtio.VirtqDesc, avail: [*]u8, used: [*]u8) bool {
     virtio.mmioWrite32(base_addr, virtio.MMIO_QUEUE_SEL, queue_idx);
     const max_size = virtio.mmioRead32(base_addr, virtio.MMIO_QUEUE_NUM_MAX);
@@ -119,6 +147,12 @@ fn postRxBuf(idx: u16) void {
 
 pub fn init() bool {
     serial.writeAll("virtio_net: probing...\n");
+    // The device is reset below; ring indices start over with it
+    initialized = false;
+    rx_avail_idx = 0;
+    rx_last_used_idx = 0;
+    tx_avail_idx = 0;
+    tx_last_used_idx = 0;
 
     // Probe for net device
     const dev = virtio.probe(virtio.DEVICE_NET) orelse {
@@ -135,12 +169,21 @@ pub fn init() bool {
     virtio.mmioWrite32(base_addr, virtio.MMIO_STATUS, virtio.STATUS_ACKNOWLEDGE);
     virtio.mmioWrite32(base_addr, virtio.MMIO_STATUS, virtio.STATUS_ACKNOWLEDGE | virtio.STATUS_DRIVER);
 
-    // Feature negotiation — acknowledge MAC feature
+    // Feature negotiation — acknowledge MAC, and MTU when the device's
+    // fits the receive buffers (every posted buffer must hold a full frame)
     virtio.mmioWrite32(base_addr, virtio.MMIO_DEVICE_FEATURES_SEL, 0);
     const dev_features = virtio.mmioRead32(base_addr, virtio.MMIO_DEVICE_FEATURES);
-    _ = dev_features;
+    var driver_features = VIRTIO_NET_F_MAC;
+    mtu = DefaultMtu;
+    if (dev_features & VIRTIO_NET_F_MTU != 0) {
+        const dev_mtu = readConfig16(CONFIG_MTU);
+        if (dev_mtu >= MIN_MTU and dev_mtu <= MaxMtu) {
+            driver_features |= VIRTIO_NET_F_MTU;
+            mtu = dev_mtu;
+        }
+    }
     virtio.mmioWrite32(base_addr, virtio.MMIO_DRIVER_FEATURES_SEL, 0);
-    virtio.mmioWrite32(base_addr, virtio.MMIO_DRIVER_FEATURES, VIRTIO_NET_F_MAC);
+    virtio.mmioWrite32(base_addr, virtio.MMIO_DRIVER_FEATURES, driver_features);
 
     virtio.mmioWrite32(base_addr, virtio.MMIO_STATUS, virtio.STATUS_ACKNOWLEDGE | virtio.STATUS_DRIVER | virtio.STATUS_FEATURES_OK);
 
@@ -151,11 +194,9 @@ pub fn init() bool {
         return false;
     }
 
-    // Read MAC address from device config (offset 0x100)
-    const config_base: u64 = base_addr + 0x100;
+    // Read MAC address from device config space
     for (0..6) |i| {
-        const addr: *volatile u8 = @ptrFromInt(config_base + i);
-        mac_addr[i] = addr.*;
+        mac_addr[i] = virtio.mmioRead8(base_addr, virtio.MMIO_CONFIG + @as(u32, @intCast(i)));
     }
 
     serial.writeAll("virtio_net: mac=");
@@ -163,6 +204,8 @@ pub fn init() bool {
         writeHexByte(b);
         if (i < 5) serial.writeByte(':');
     }
+    serial.writeAll(" mtu=");
+    serial.writeDec(mtu);
     serial.writeAll("\n");
 
     // Setup RX queue (queue 0)
@@ -201,12 +244,21 @@ pub fn getMac() [6]u8 {
     return mac_addr;
 }
 
+/// Largest IP packet a frame can carry: the device's MTU when it offers
+/// one up to MaxMtu, otherwise 1500.
+pub fn getMtu() u16 {
+    return mtu;
+}
+
 /// Transmit a raw Ethernet frame. The caller provides the complete frame
 /// (dst_mac + src_mac + ethertype + payload). This function prepends the
 /// virtio net header.
 pub fn txPacket(frame: []const u8) bool {
     if (!initialized) return false;
-    if (frame.len == 0 or frame.len > MAX_FRAME_SIZE - NET_HDR_SIZE) return false;
+    if (frame.len == 0 or frame.len > ETH_HDR_SIZE + @as(usize, mtu)) {
+        pcap.capture(.tx, frame, .bad_length);
+        return false;
+    }
 
     // Build buffer: net_hdr + frame
     const net_hdr = VirtioNetHdr{
@@ -239,27 +291,71 @@ pub fn txPacket(frame: []const u8) bool {
     addAvailTx(0);
     virtio.mmioWrite32(base_addr, virtio.MMIO_QUEUE_SEL, TX_QUEUE);
     virtio.mmioWrite32(base_addr, virtio.MMIO_QUEUE_NOTIFY, TX_QUEUE);
+    waitTxUsed(1);
 
-    // Poll TX used ring
-    const used_ptr: [*]volatile u8 = @ptrCast(&tx_used_buf);
-    while (true) {
-        const used_idx_ptr: *volatile u16 = @ptrCast(@alignCast(used_ptr + 2));
-        if (used_idx_ptr.* != tx_last_used_idx) {
-            tx_last_used_idx = used_idx_ptr.*;
-            break;
+    pcap.capture(.tx, frame, .none);
+    return true;
+}
+
+/// Transmit frames straight from the caller's buffers: up to MaxTxBatch
+/// descriptor chains are posted per notify, and each batch is waited for
+/// before the next, so the frames must stay untouched until this returns.
+/// Frames of a bad length are skipped. Returns how many were sent.
+pub fn txBatch(frames: []const []const u8) u32 {
+    if (!initialized) return 0;
+    var sent: u32 = 0;
+    var i: usize = 0;
+    while (i < frames.len) {
+        var posted: u16 = 0;
+        while (i < frames.len and posted < MaxTxBatch) : (i += 1) {
+            const frame = frames[i];
+            if (frame.len == 0 or frame.len > ETH_HDR_SIZE + @as(usize, mtu)) {
+                pcap.capture(.tx, frame, .bad_length);
+                continue;
+            }
+            const d = posted * 2;
+            tx_desc[d] = .{
+                .addr = @intFromPtr(&tx_batch_hdr),
+                .len = NET_HDR_SIZE,
+                .flags = virtio.VRING_DESC_F_NEXT,
+                .next = d + 1,
+            };
+            tx_desc[d + 1] = .{
+                .addr = @intFromPtr(frame.ptr),
+                .len = @intCast(frame.len),
+                .flags = 0, // device reads
+                .next = 0,
+            };
+            addAvailTx(d);
+            pcap.capture(.tx, frame, .none);
+            posted += 1;
         }
+        if (posted == 0) break;
+        virtio.mmioWrite32(base_addr, virtio.MMIO_QUEUE_SEL, TX_QUEUE);
+        virtio.mmioWrite32(base_addr, virtio.MMIO_QUEUE_NOTIFY, TX_QUEUE);
+        waitTxUsed(posted);
+        sent += posted;
+    }
+    return sent;
+}
+
+/// Poll the TX used ring until count more chains have completed.
+fn waitTxUsed(count: u16) void {
+    const used_ptr: [*]volatile u8 = @ptrCast(&tx_used_buf);
+    const used_idx_ptr: *volatile u16 = @ptrCast(@alignCast(used_ptr + 2));
+    const target = tx_last_used_idx +% count;
+    while (used_idx_ptr.* != target) {
         if (comptime builtin.cpu.arch == .x86_64) {
             asm volatile ("pause");
         }
     }
+    tx_last_used_idx = target;
 
     // Acknowledge interrupt
     const isr = virtio.mmioRead32(base_addr, virtio.MMIO_INTERRUPT_STATUS);
     if (isr != 0) {
         virtio.mmioWrite32(base_addr, virtio.MMIO_INTERRUPT_ACK, isr);
     }
-
-    return true;
 }
 
 /// Poll for received frames. Returns the raw Ethernet frame data (after
@@ -291,6 +387,7 @@ pub fn rxPoll() ?[]u8 {
 
     // Validate
     if (buf_idx >= NUM_RX_BUFS or total_len <= NET_HDR_SIZE) {
+        pcap.capture(.rx, &.{}, .bad_length);
         // Re-post buffer and skip
         if (buf_idx < NUM_RX_BUFS) postRxBuf(@intCast(buf_idx));
         virtio.mmioWrite32(base_addr, virtio.MMIO_QUEUE_SEL, RX_QUEUE);
@@ -308,6 +405,8 @@ pub fn rxPoll() ?[]u8 {
 
     // Return slice into the rx buffer, past the net header
     const result = rx_bufs[buf_idx][NET_HDR_SIZE .. NET_HDR_SIZE + frame_len];
+    // Before the buffer goes back to the device
+    pcap.capture(.rx, result, .none);
 
     // Re-post buffer for reuse
     postRxBuf(@intCast(buf_idx));
@@ -317,6 +416,12 @@ pub fn rxPoll() ?[]u8 {
     return result;
 }
 
+fn readConfig16(offset: u32) u16 {
+    const lo = virtio.mmioRead8(base_addr, offset);
+    const hi = virtio.mmioRead8(base_addr, offset + 1);
+    return (@as(u16, hi) << 8) | lo;
+}
+
 fn writeHexByte(b: u8) void {
     const hi: u8 = b >> 4;
     const lo: u8 = b & 0x0F;
@@ -0,0 +1,316 @@
+#!/usr/bin/env python3
+"""Run the in-guest microbenchmarks and compare them against a baseline.
+
+A kernel built with -Dbench=true writes one line per measurement (see
+kernel/bench.zig) and a final marker:
+
+  #M <name> <key>=<value> ...
+  #M done
+
+Keys ending in _ns are latencies (lower is better), keys ending in _per_s
+are rates (higher is better); other keys are context and are not compared.
+Lines with skipped=<reason> are listed but not compared.
+
+The image is booted under Firecracker (--firecracker, KVM) or QEMU TCG
+(--vmm qemu, no KVM needed). QEMU's microvm places virtio-mmio where the
+kernel does not probe, so there the blk and net suites report skipped.
+With --log, an existing console log is parsed instead of booting.
+
+Exit status: 0 when every metric is within tolerance of the baseline, 1 on
+a regression, 2 when the run produced no results, 3 when there is no
+baseline to compare against (record one with --update-baseline).
+
+Usage: bench.py [--kernel K] [--disk D] [--vmm firecracker|qemu] [--log L]
+                [--baseline B] [--tolerance PCT] [--update-baseline] [--json]
+"""
+
+import argparse
+import json
+import os
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+GUEST_IP = "172.16.0.2"
+GUEST_MAC = "AA:FC:00:00:00:01"
+DEFAULT_TOLERANCE_PCT = 10.0
+DEFAULT_TIMEOUT_S = 120
+RX_PAYLOAD = b"\x5a" * 64
+
+
+def parse_results(lines):
+    """Return (metrics, skipped, done) from the #M lines.
+
+    metrics maps "<name>.<key>" to an int, skipped maps name to the reason.
+    """
+    metrics = {}
+    skipped = {}
+    done = False
+    for raw in lines:
+        line = raw.rstrip("\r\n")
+        idx = line.find("#M ")
+        if idx < 0:
+            continue
+        fields = line[idx + 3:].split()
+        if not fields:
+            continue
+        name = fields[0]
+        if name == "done":
+            done = True
+            continue
+        for field in fields[1:]:
+            key, sep, value = field.partition("=")
+            if not sep:
+                continue
+            if key == "skipped":
+                skipped[name] = value
+                continue
+            try:
+                metrics[f"{name}.{key}"] = int(value)
+            except ValueError:
+                continue
+    return metrics, skipped, done
+
+
+def direction(metric):
+    """-1 if lower is better, 1 if higher is better, 0 if not compared."""
+    if metric.endswith("_ns"):
+        return -1
+    if metric.endswith("_per_s"):
+        return 1
+    return 0
+
+
+def compare(metrics, baseline, tolerance_pct):
+    """[(metric, base, current, change_pct, regressed)] for compared metrics."""
+    rows = []
+    for metric in sorted(set(metrics) | set(baseline)):
+        sign = direction(metric)
+        if sign == 0:
+            continue
+        base = baseline.get(metric)
+        cur = metrics.get(metric)
+        if base is None or cur is None:
+            rows.append((metric, base, cur, None, False))
+            continue
+        change = (cur - base) * 100.0 / base if base else 0.0
+        regressed = change * sign < -tolerance_pct
+        rows.append((metric, base, cur, change, regressed))
+    return rows
+
+
+class RxSender:
+    """Sends UDP datagrams to the guest while the net.udp_rx window is open."""
+
+    def __init__(self, port):
+        self.port = port
+        self.stop = threading.Event()
+        self.thread = threading.Thread(target=self._run, daemon=True)
+
+    def _run(self):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        try:
+            while not self.stop.is_set():
+                try:
+                    sock.sendto(RX_PAYLOAD, (GUEST_IP, self.port))
+                except OSError:
+                    time.sleep(0.001)
+        finally:
+            sock.close()
+
+    def start(self):
+        self.thread.start()
+
+    def close(self):
+        self.stop.set()
+        self.thread.join(timeout=1)
+
+
+def firecracker_cmd(args, workdir):
+    vm = {
+        "boot-source": {
+            "kernel_image_path": os.path.abspath(args.kernel),
+            "boot_args": "console=ttyS0 reboot=k panic=1",
+        },
+        "drives": [],
+        "machine-config": {"vcpu_count": 1, "mem_size_mib": args.memory, "smt": False},
+        "network-interfaces": [],
+    }
+    if args.disk:
+        vm["drives"].append(
+            {
+                "drive_id": "rootfs",
+                "path_on_host": os.path.abspath(args.disk),
+                "is_root_device": True,
+                "is_read_only": True,
+            }
+        )
+    if args.tap:
+        vm["network-interfaces"].append({"iface_id": "eth0", "host_dev_name": args.tap, "guest_mac": GUEST_MAC})
+    cfg_path = os.path.join(workdir, "vm.json")
+    with open(cfg_path, "w", encoding="utf-8") as f:
+        json.dump(vm, f)
+    return [args.firecracker, "--no-api", "--config-file", cfg_path]
+
+
+def qemu_cmd(args):
+    qemu = args.qemu or shutil.which("qemu-system-x86_64") or "qemu-system-x86_64"
+    cmd = [
+        qemu,
+        "-M", "microvm",
+        "-accel", "tcg",
+        "-cpu", "max",
+        "-m", str(args.memory),
+        "-nodefaults",
+        "-no-user-config",
+        "-display", "none",
+        "-serial", "stdio",
+        "-no-reboot",
+        "-kernel", os.path.abspath(args.kernel),
+    ]
+    if args.disk:
+        cmd += [
+            "-drive", f"id=rootfs,file={os.path.abspath(args.disk)},format=raw,if=none,readonly=on",
+            "-device", "virtio-blk-device,drive=rootfs",
+        ]
+    return cmd
+
+
+def boot(args, log_path):
+    """Boot the bench image, tee its console into log_path, return the lines."""
+    with tempfile.TemporaryDirectory(prefix="ukernel-bench-") as workdir:
+        cmd = firecracker_cmd(args, workdir) if args.vmm == "firecracker" else qemu_cmd(args)
+        proc = subprocess.Popen(
+            cmd, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.STDOUT
+        )
+        # Stop the VM on the end marker or the timeout; it halts rather than
+        # powering off
+        timer = threading.Timer(args.timeout, proc.kill)
+        timer.start()
+        lines = []
+        sender = None
+        try:
+            with open(log_path, "w", encoding="utf-8") as log:
+                for raw in proc.stdout:
+                    line = raw.decode("utf-8", errors="replace")
+                    log.write(line)
+                    lines.append(line)
+                    if "#M net.rx_ready" in line and args.tap and sender is None:
+                        metrics, _, _ = parse_results([line])
+                        port = metrics.get("net.rx_ready.port")
+                        if port:
+                            sender = RxSender(port)
+                            sender.start()
+                    elif "#M net.udp_rx" in line and sender is not None:
+                        sender.close()
+                    if "#M done" in line:
+                        break
+        finally:
+            timer.cancel()
+            if sender is not None:
+                sender.close()
+            if proc.poll() is None:
+                proc.kill()
+            proc.wait()
+    return lines
+
+
+def print_table(metrics, skipped, rows):
+    print(f"{'metric':<36} {'baseline':>12} {'current':>12} {'change':>9}")
+    for metric, base, cur, change, regressed in rows:
+        base_s = str(base) if base is not None else "-"
+        cur_s = str(cur) if cur is not None else "-"
+        change_s = f"{change:+.1f}%" if change is not None else "-"
+        print(f"{metric:<36} {base_s:>12} {cur_s:>12} {change_s:>9}{'  REGRESSED' if regressed else ''}")
+    for name, reason in sorted(skipped.items()):
+        print(f"{name:<36} skipped ({reason})")
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--kernel", help="bench kernel image (-Dbench=true)")
+    parser.add_argument("--disk", help="raw disk image for the blk suites")
+    parser.add_argument("--vmm", choices=("firecracker", "qemu"))
+    parser.add_argument("--firecracker", default=os.environ.get("FIRECRACKER"))
+    parser.add_argument("--qemu")
+    parser.add_argument("--tap", help="tap device with 172.16.0.1/24 for the net suites")
+    parser.add_argument("--memory", type=int, default=256)
+    parser.add_argument("--timeout", type=int, default=DEFAULT_TIMEOUT_S)
+    parser.add_argument("--log", help="parse this console log instead of booting")
+    parser.add_argument("--console-log", default=os.path.join("logs", "bench.log"))
+    parser.add_argument("--baseline", default=os.path.join("bench", "baseline.json"))
+    parser.add_argument("--tolerance", type=float, default=DEFAULT_TOLERANCE_PCT, metavar="PCT")
+    parser.add_argument("--update-baseline", action="store_true")
+    parser.add_argument("--json", action="store_true", help="print the results as JSON")
+    args = parser.parse_args(argv)
+
+    if args.log:
+        with open(args.log, "r", encoding="utf-8", errors="replace") as f:
+            lines = f.readlines()
+        vmm = None
+    else:
+        if not args.kernel:
+            print("--kernel is required unless --log is given", file=sys.stderr)
+            return 2
+        args.vmm = args.vmm or ("firecracker" if args.firecracker else "qemu")
+        if args.vmm == "firecracker" and not args.firecracker:
+            print("Missing Firecracker path. Pass --firecracker or set FIRECRACKER.", file=sys.stderr)
+            return 2
+        os.makedirs(os.path.dirname(args.console_log) or ".", exist_ok=True)
+        lines = boot(args, args.console_log)
+        vmm = args.vmm
+
+    metrics, skipped, done = parse_results(lines)
+    if not metrics:
+        print("no #M bench results in log", file=sys.stderr)
+        return 2
+    if not done:
+        print("warning: no '#M done' marker; the run was cut short", file=sys.stderr)
+
+    baseline = {}
+    have_baseline = os.path.exists(args.baseline)
+    if have_baseline:
+        with open(args.baseline, "r", encoding="utf-8") as f:
+            stored = json.load(f)
+        baseline = stored.get("metrics", {})
+        if vmm and stored.get("vmm") and stored["vmm"] != vmm:
+            print(f"warning: baseline was recorded under {stored['vmm']}, this run used {vmm}", file=sys.stderr)
+
+    rows = compare(metrics, baseline, args.tolerance)
+    regressed = [r[0] for r in rows if r[4]]
+
+    if args.json:
+        json.dump(
+            {
+                "vmm": vmm,
+                "metrics": metrics,
+                "skipped": skipped,
+                "complete": done,
+                "regressed": regressed,
+            },
+            sys.stdout,
+        )
+        sys.stdout.write("\n")
+    else:
+        print_table(metrics, skipped, rows)
+
+    if args.update_baseline:
+        os.makedirs(os.path.dirname(args.baseline) or ".", exist_ok=True)
+        with open(args.baseline, "w", encoding="utf-8") as f:
+            json.dump({"vmm": vmm, "metrics": metrics}, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print(f"baseline written to {args.baseline}", file=sys.stderr)
+        return 0
+
+    if not have_baseline:
+        print(f"error: no baseline at {args.baseline}; record one with --update-baseline", file=sys.stderr)
+        return 3
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -5,6 +5,9 @@
 # Usage:
 #   scripts/boot_test.sh [--firecracker /path/to/firecracker]
 #
+# Boot-phase budgets (microseconds) can be tightened with
+#   BOOT_BUDGETS="net=5000 compile=8000" BOOT_TOTAL_US=50000
+#
 # Requires: Firecracker binary, KVM access
 
 set -euo pipefail
@@ -66,11 +69,19 @@ setup_tap() {
 
 setup_tap
 
-# Create rootfs: tar archive with src/main.py for MicroPython
+# Create rootfs: tar archive with src/main.py for MicroPython, plus the
+# asyncio package as src/asyncio when the submodule is checked out
 # The kernel reads this as a raw block device via virtio-block and parses as tar
+ASYNCIO_PARENT="${PROJECT_DIR}/lib/micropython/extmod"
 if [ -f "${PROJECT_DIR}/src/main.py" ]; then
     tar cf "$ROOTFS" -C "$PROJECT_DIR" src/main.py
-    echo "  Rootfs: tar with src/main.py"
+    if [ -d "${ASYNCIO_PARENT}/asyncio" ]; then
+        tar rf "$ROOTFS" -C "$ASYNCIO_PARENT" --exclude manifest.py \
+            --transform 's,^asyncio,src/asyncio,' asyncio
+        echo "  Rootfs: tar with src/main.py and src/asyncio"
+    else
+        echo "  Rootfs: tar with src/main.py"
+    fi
 else
     # Fallback: empty file
     dd if=/dev/zero of="$ROOTFS" bs=1M count=1 status=none 2>/dev/null
@@ -179,6 +190,23 @@ check "python net demo" "python net: sent UDP packet"
 check "python net done" "python net: done"
 check "python complete" "python asyncio done"
 check "micropython done" "micropython: done"
+check "boot timeline" "#B t0="
+
+echo ""
+echo "=== Boot Timeline ==="
+# Per-phase table; fails the run when a phase exceeds its budget.
+# Extra budgets: BOOT_BUDGETS="net=5000 compile=8000" (microseconds)
+TIMELINE_ARGS=()
+for b in ${BOOT_BUDGETS:-}; do
+    TIMELINE_ARGS+=(--budget "$b")
+done
+if python3 "${SCRIPT_DIR}/boot_timeline.py" "$LOG" ${TIMELINE_ARGS[@]+"${TIMELINE_ARGS[@]}"} \
+        --total-us "${BOOT_TOTAL_US:-100000}"; then
+    PASS=$((PASS + 1))
+else
+    echo "  FAIL: boot timeline over budget"
+    FAIL=$((FAIL + 1))
+fi
 
 echo ""
 if [ "$FAIL" -eq 0 ]; then
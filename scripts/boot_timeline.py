@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Print the guest boot timeline from a serial console log.
+
+The kernel writes one line once the workload is about to run (see
+kernel/boottime.zig):
+
+  #B t0=<entry ns since TSC reset> <phase>=<ns since entry> ...
+
+Each phase value is the time at which that phase ended, so a phase's
+duration is the gap from the previous phase. Durations are checked
+against per-phase budgets; the exit status is 1 if any budget (or the
+total) is exceeded, 2 if no timeline was found.
+
+Usage: boot_timeline.py <console.log> [--budget phase=us ...] [--total-us N] [--json]
+"""
+
+import argparse
+import json
+import sys
+
+# Default per-phase budgets in microseconds. Generous on purpose: they are
+# regression tripwires, not targets. clock includes the 10 ms PIT fallback.
+DEFAULT_BUDGETS_US = {
+    "long_mode": 1000,
+    "kernel_main": 1000,
+    "serial": 500,
+    "clock": 15000,
+    "mmio": 500,
+    "workload": 5000,
+    "blk": 20000,
+    "net": 20000,
+    "rootfs": 5000,
+    "mp_init": 10000,
+    "compile": 20000,
+}
+DEFAULT_TOTAL_US = 100000
+
+
+def parse_timeline(lines):
+    """Return (t0_ns, [(phase, end_ns), ...]) from the last #B line, or None."""
+    found = None
+    for raw in lines:
+        line = raw.rstrip("\r\n")
+        idx = line.find("#B ")
+        if idx < 0:
+            continue
+        t0 = None
+        phases = []
+        for field in line[idx + 3:].split():
+            name, sep, value = field.partition("=")
+            if not sep:
+                continue
+            try:
+                ns = int(value)
+            except ValueError:
+                continue
+            if name == "t0":
+                t0 = ns
+            else:
+                phases.append((name, ns))
+        if t0 is not None:
+            found = (t0, phases)
+    return found
+
+
+def phase_rows(phases):
+    """[(phase, duration_ns, end_ns)] with durations from the previous end."""
+    rows = []
+    prev = 0
+    for name, end in phases:
+        rows.append((name, max(0, end - prev), end))
+        prev = end
+    return rows
+
+
+def parse_budgets(items):
+    budgets = dict(DEFAULT_BUDGETS_US)
+    for item in items or []:
+        name, sep, value = item.partition("=")
+        if not sep:
+            raise ValueError(f"bad --budget '{item}' (expected phase=us)")
+        budgets[name] = int(value)
+    return budgets
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log")
+    parser.add_argument("--budget", action="append", metavar="PHASE=US")
+    parser.add_argument("--total-us", type=int, default=DEFAULT_TOTAL_US)
+    parser.add_argument("--json", action="store_true", help="print the timeline as JSON")
+    args = parser.parse_args(argv)
+
+    try:
+        budgets = parse_budgets(args.budget)
+    except ValueError as exc:
+        print(exc, file=sys.stderr)
+        return 2
+
+    with open(args.log, "r", encoding="utf-8", errors="replace") as f:
+        timeline = parse_timeline(f)
+    if timeline is None:
+        print("no #B boot timeline in log", file=sys.stderr)
+        return 2
+
+    t0, phases = timeline
+    rows = phase_rows(phases)
+    total = phases[-1][1] if phases else 0
+    over = [(name, dur) for name, dur, _ in rows if name in budgets and dur > budgets[name] * 1000]
+    total_over = total > args.total_us * 1000
+
+    if args.json:
+        json.dump(
+            {
+                "t0_ns": t0,
+                "total_ns": total,
+                "phases": [{"phase": n, "duration_ns": d, "end_ns": e} for n, d, e in rows],
+                "over_budget": [n for n, _ in over] + (["total"] if total_over else []),
+            },
+            sys.stdout,
+        )
+        sys.stdout.write("\n")
+    else:
+        print(f"{'phase':<12} {'duration us':>12} {'at us':>10} {'budget us':>10}")
+        for name, dur, end in rows:
+            budget = budgets.get(name)
+            flag = "  OVER" if budget is not None and dur > budget * 1000 else ""
+            budget_s = str(budget) if budget is not None else "-"
+            print(f"{name:<12} {dur / 1000:>12.1f} {end / 1000:>10.1f} {budget_s:>10}{flag}")
+        print(f"{'total':<12} {total / 1000:>12.1f} {'':>10} {args.total_us:>10}{'  OVER' if total_over else ''}")
+        print(f"entry at {t0 / 1000:.1f} us after TSC reset")
+
+    return 1 if over or total_over else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
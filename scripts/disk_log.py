@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Read the kernel's record log back from a data disk image.
+
+The kernel appends records to the second virtio-blk drive (see
+kernel/disk_log.zig). Layout, in 512-byte sectors:
+
+  0, 1    checkpoints: "ZLC1", log id, generation, tail, next seq, epoch, crc32
+  2..     batches: 40-byte header ("ZLB1", sectors, seq, log id, payload
+          length, record count, epoch, crc32), then records, sector padded
+  record  length u32, stream u16, reserved u16, crc32 u32, data
+
+Batches are read from sector 2 while each one has the next sequence
+number, an epoch no older than the one before it and intact checksums,
+the same rule the kernel applies at mount. The exit status is 2 if the
+image holds no log.
+
+Usage: disk_log.py <data.img> [--stream log|user] [--raw] [--json]
+"""
+
+import argparse
+import json
+import struct
+import sys
+import zlib
+
+SECTOR = 512
+DATA_START = 2
+BATCH_SIZE = 64 * 1024
+BATCH_HEADER = struct.Struct("<IIQIIIII")  # magic sectors seq log_id payload records epoch reserved
+RECORD_HEADER = struct.Struct("<IHHI")
+CHECKPOINT = struct.Struct("<IIQQQI")
+BATCH_MAGIC = 0x31424C5A
+CHECKPOINT_MAGIC = 0x31434C5A
+STREAMS = {1: "log", 2: "user"}
+
+
+def read_checkpoint(sector):
+    """Return (log_id, gen, tail, next_seq, epoch) or None."""
+    magic, log_id, gen, tail, next_seq, epoch = CHECKPOINT.unpack_from(sector)
+    if magic != CHECKPOINT_MAGIC:
+        return None
+    (crc,) = struct.unpack_from("<I", sector, CHECKPOINT.size)
+    if crc != zlib.crc32(sector[: CHECKPOINT.size]):
+        return None
+    return log_id, gen, tail, next_seq, epoch
+
+
+def parse_records(batch, payload, count):
+    """Return [(stream, data), ...] or None if any record is damaged."""
+    end = BATCH_HEADER.size + 4 + payload
+    offset = BATCH_HEADER.size + 4
+    records = []
+    while offset < end:
+        if end - offset < RECORD_HEADER.size:
+            return None
+        length, stream, _, crc = RECORD_HEADER.unpack_from(batch, offset)
+        start = offset + RECORD_HEADER.size
+        if length > end - start:
+            return None
+        data = batch[start : start + length]
+        if crc != zlib.crc32(data, zlib.crc32(batch[offset : offset + 8])):
+            return None
+        records.append((stream, data))
+        offset = start + length
+    return records if len(records) == count else None
+
+
+def read_log(image):
+    """Return (checkpoint, [(seq, stream, data), ...]) or None without a log."""
+    checkpoints = [read_checkpoint(image[i * SECTOR : (i + 1) * SECTOR]) for i in range(DATA_START)]
+    checkpoints = [cp for cp in checkpoints if cp]
+    if not checkpoints:
+        return None
+    newest = max(checkpoints, key=lambda cp: cp[1])
+    log_id = newest[0]
+    capacity = len(image) // SECTOR
+
+    records = []
+    sector, seq, min_epoch = DATA_START, 1, 0
+    while sector < capacity:
+        header = image[sector * SECTOR : (sector + 1) * SECTOR]
+        magic, sectors, bseq, bid, payload, count, epoch, _ = BATCH_HEADER.unpack_from(header)
+        (crc,) = struct.unpack_from("<I", header, BATCH_HEADER.size)
+        if magic != BATCH_MAGIC or crc != zlib.crc32(header[: BATCH_HEADER.size]):
+            break
+        if bseq != seq or bid != log_id or epoch < min_epoch:
+            break
+        if not 0 < sectors <= BATCH_SIZE // SECTOR or sector + sectors > capacity:
+            break
+        if BATCH_HEADER.size + 4 + payload > sectors * SECTOR:
+            break
+        batch = image[sector * SECTOR : (sector + sectors) * SECTOR]
+        parsed = parse_records(batch, payload, count)
+        if parsed is None:
+            break
+        records.extend((seq, stream, data) for stream, data in parsed)
+        sector += sectors
+        seq += 1
+        min_epoch = epoch
+    return {"log_id": log_id, "checkpoint_tail": newest[2], "tail": sector, "batches": seq - 1}, records
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image")
+    parser.add_argument("--stream", choices=sorted(STREAMS.values()))
+    parser.add_argument("--raw", action="store_true", help="write record data to stdout without framing")
+    parser.add_argument("--json", action="store_true")
+    args = parser.parse_args(argv)
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    result = read_log(image)
+    if result is None:
+        print(f"{args.image}: no record log", file=sys.stderr)
+        return 2
+    info, records = result
+    if args.stream:
+        records = [r for r in records if STREAMS.get(r[1]) == args.stream]
+
+    if args.raw:
+        for _, _, data in records:
+            sys.stdout.buffer.write(data)
+        return 0
+    if args.json:
+        info["records"] = [
+            {"batch": seq, "stream": STREAMS.get(stream, stream), "data": data.decode("utf-8", "replace")}
+            for seq, stream, data in records
+        ]
+        json.dump(info, sys.stdout, indent=2)
+        print()
+        return 0
+
+    for seq, stream, data in records:
+        text = data.decode("utf-8", "replace").rstrip("\n")
+        print(f"{seq:>6} {STREAMS.get(stream, stream):<4} {text}")
+    print(
+        f"# {len(records)} records in {info['batches']} batches, tail sector {info['tail']}"
+        f" (checkpoint {info['checkpoint_tail']})",
+        file=sys.stderr,
+    )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Convert guest packet capture records from a serial console log to pcapng.
+
+The kernel drains its capture ring as "#P" lines (see kernel/pcap.zig):
+
+  #Ph <tsc_hz> <snaplen>   TSC frequency and snap length, once per drain session
+  #Pr <hex>                16-byte record (tsc, orig_len, cap_len, dir,
+                           reason; little-endian) and the captured bytes
+  #Pd <count>              records lost to a full ring in the guest
+
+Every frame becomes an Enhanced Packet Block with its direction in
+epb_flags. Frames the guest stack dropped carry the reason as a comment
+("drop: no_socket"), so `frame.comment contains "drop"` filters them in
+Wireshark. Timestamps are nanoseconds since the guest's TSC reset (VM start),
+not wall-clock time. Records lost in the guest are reported in an Interface
+Statistics Block (isb_ifdrop).
+
+Usage: pcap_convert.py <console.log> [-o capture.pcapng]
+"""
+
+import argparse
+import collections
+import struct
+import sys
+
+RECORD = struct.Struct("<QHHBBH")
+DIR_RX = 0
+DIR_TX = 1
+REASONS = {
+    0: None,
+    1: "no_socket",
+    2: "rx_overwrite",
+    3: "bad_length",
+    4: "arp_failure",
+    5: "not_for_us",
+    6: "unsupported",
+    7: "bad_fragment",
+    8: "ring_full",
+}
+LINKTYPE_ETHERNET = 1
+
+
+def parse_log(lines):
+    """Return (tsc_hz, snaplen, records, lost) from console log lines.
+
+    records holds (tsc, orig_len, dir, reason, data) tuples.
+    """
+    tsc_hz = 0
+    snaplen = 0
+    records = []
+    lost = 0
+    for raw in lines:
+        line = raw.rstrip("\r\n")
+        idx = line.find("#P")
+        if idx < 0:
+            continue
+        tag, _, rest = line[idx:].partition(" ")
+        if tag == "#Ph":
+            try:
+                hz, snap = rest.split()
+                tsc_hz, snaplen = int(hz), int(snap)
+            except ValueError:
+                pass
+        elif tag == "#Pr":
+            try:
+                data = bytes.fromhex(rest.strip())
+            except ValueError:
+                continue
+            if len(data) < RECORD.size:
+                continue
+            tsc, orig_len, cap_len, direction, reason, _ = RECORD.unpack_from(data)
+            if len(data) != RECORD.size + cap_len:
+                continue
+            records.append((tsc, orig_len, direction, reason, data[RECORD.size :]))
+        elif tag == "#Pd":
+            try:
+                lost += int(rest)
+            except ValueError:
+                pass
+    return tsc_hz, snaplen, records, lost
+
+
+def _pad4(data):
+    return data + b"\0" * (-len(data) % 4)
+
+
+def _options(opts):
+    out = b""
+    for code, value in opts:
+        out += struct.pack("<HH", code, len(value)) + _pad4(value)
+    if out:
+        out += struct.pack("<HH", 0, 0)
+    return out
+
+
+def _block(block_type, body):
+    total = 12 + len(body)
+    return struct.pack("<II", block_type, total) + body + struct.pack("<I", total)
+
+
+def _ts(ns):
+    return struct.pack("<II", ns >> 32, ns & 0xFFFFFFFF)
+
+
+def to_pcapng(tsc_hz, snaplen, records, lost):
+    def ns(tsc):
+        return tsc * 1_000_000_000 // tsc_hz if tsc_hz else tsc
+
+    shb = struct.pack("<IHHq", 0x1A2B3C4D, 1, 0, -1)
+    shb += _options([(4, b"ukernel pcap_convert.py")])
+    out = [_block(0x0A0D0D0A, shb)]
+
+    idb = struct.pack("<HHI", LINKTYPE_ETHERNET, 0, snaplen or 65535)
+    idb += _options([(2, b"eth0"), (9, bytes([9]))])  # if_tsresol: nanoseconds
+    out.append(_block(1, idb))
+
+    for tsc, orig_len, direction, reason, data in records:
+        epb = struct.pack("<I", 0) + _ts(ns(tsc)) + struct.pack("<II", len(data), orig_len)
+        epb += _pad4(data)
+        flags = 1 if direction == DIR_RX else 2  # inbound / outbound
+        opts = [(2, struct.pack("<I", flags))]
+        name = REASONS.get(reason, f"reason{reason}")
+        if name:
+            opts.append((1, f"drop: {name}".encode()))
+        epb += _options(opts)
+        out.append(_block(6, epb))
+
+    last = ns(records[-1][0]) if records else 0
+    isb = struct.pack("<I", 0) + _ts(last) + _options([(5, struct.pack("<Q", lost))])
+    out.append(_block(5, isb))
+    return b"".join(out)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log")
+    parser.add_argument("-o", "--output")
+    args = parser.parse_args(argv)
+
+    with open(args.log, "r", encoding="utf-8", errors="replace") as f:
+        tsc_hz, snaplen, records, lost = parse_log(f)
+
+    data = to_pcapng(tsc_hz, snaplen, records, lost)
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(data)
+    else:
+        sys.stdout.buffer.write(data)
+
+    directions = collections.Counter("rx" if r[2] == DIR_RX else "tx" for r in records)
+    drops = collections.Counter(REASONS.get(r[3], f"reason{r[3]}") for r in records if r[3])
+    summary = f"{len(records)} frames ({directions['rx']} rx, {directions['tx']} tx), {lost} lost in the guest ring"
+    if drops:
+        summary += "; dropped by the stack: " + ", ".join(f"{k}={v}" for k, v in sorted(drops.items()))
+    print(summary, file=sys.stderr)
+    if not tsc_hz:
+        print("warning: no #Ph header; timestamps are raw TSC ticks", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
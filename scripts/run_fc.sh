@@ -3,13 +3,22 @@ set -euo pipefail
 
 # Minimal Firecracker run helper for local debugging.
 # Usage:
-#   scripts/run_fc.sh /path/to/firecracker /path/to/vmlinux /path/to/rootfs.ext4 tap0 logs/console.log
+#   scripts/run_fc.sh /path/to/firecracker /path/to/vmlinux /path/to/rootfs.ext4 tap0 logs/console.log [data.img]
+#
+# The optional data image is attached writable as the second drive, where
+# the kernel keeps its record log (scripts/disk_log.py reads it back).
+#
+# A balloon device with free page reporting is always attached, starting
+# empty; resize it with PATCH /balloon {"amount_mib": N}. Firecracker
+# versions without free page reporting reject the device, and the guest
+# runs without one.
 
 FC_BIN="${1:?firecracker binary path required}"
 KERNEL_IMG="${2:?kernel image path required}"
 ROOTFS_IMG="${3:?rootfs image path required}"
 TAP_DEV="${4:?tap device name required}"
 CONSOLE_LOG="${5:?console log path required}"
+DATA_IMG="${6:-}"
 
 SOCK="/tmp/ukernel-fc.sock"
 
@@ -39,6 +48,20 @@ curl --unix-socket "$SOCK" -i \
   -H 'Content-Type: application/json' \
   -d "{\"drive_id\":\"rootfs\",\"path_on_host\":\"$ROOTFS_IMG\",\"is_root_device\":true,\"is_read_only\":true}"
 
+if [ -n "$DATA_IMG" ]; then
+  curl --unix-socket "$SOCK" -i \
+    -X PUT 'http://localhost/drives/data' \
+    -H 'Accept: application/json' \
+    -H 'Content-Type: application/json' \
+    -d "{\"drive_id\":\"data\",\"path_on_host\":\"$DATA_IMG\",\"is_root_device\":false,\"is_read_only\":false,\"cache_type\":\"Writeback\"}"
+fi
+
+curl --unix-socket "$SOCK" -i \
+  -X PUT 'http://localhost/balloon' \
+  -H 'Accept: application/json' \
+  -H 'Content-Type: application/json' \
+  -d '{"amount_mib":0,"deflate_on_oom":false,"stats_polling_interval_s":0,"free_page_reporting":true}'
+
 curl --unix-socket "$SOCK" -i \
   -X PUT 'http://localhost/network-interfaces/eth0' \
   -H 'Accept: application/json' \
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Convert guest trace records from a serial console log to Chrome trace JSON.
+
+The kernel drains its binary trace ring as "#T" lines (see kernel/trace.zig):
+
+  #Th <tsc_hz>        TSC frequency, once per drain session
+  #Tn <id> <name>     interned name definition
+  #Tr <48 hex>        one 24-byte record (little-endian); an event with a
+                      key/value payload is followed by payload records
+                      holding its bytes
+  #Td <count>         records dropped in the guest
+
+The output loads in chrome://tracing and ui.perfetto.dev.
+
+Usage: trace_convert.py <console.log> [-o trace.json]
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+RECORD = struct.Struct("<QIIHBBI")
+KIND_BEGIN = 1
+KIND_END = 2
+KIND_EVENT = 3
+KIND_PAYLOAD = 4
+PAYLOAD_CHUNK = 18
+
+
+def parse_log(lines):
+    """Return (tsc_hz, names, records, dropped) from console log lines.
+
+    records holds the unpacked fields of each record plus its raw bytes.
+    """
+    tsc_hz = 0
+    names = {0: ""}
+    records = []
+    dropped = 0
+    for raw in lines:
+        line = raw.rstrip("\r\n")
+        idx = line.find("#T")
+        if idx < 0:
+            continue
+        line = line[idx:]
+        tag, _, rest = line.partition(" ")
+        if tag == "#Th":
+            try:
+                tsc_hz = int(rest)
+            except ValueError:
+                pass
+        elif tag == "#Tn":
+            num, _, name = rest.partition(" ")
+            try:
+                names[int(num)] = name
+            except ValueError:
+                pass
+        elif tag == "#Tr":
+            try:
+                data = bytes.fromhex(rest.strip())
+            except ValueError:
+                continue
+            if len(data) != RECORD.size:
+                continue
+            records.append(RECORD.unpack(data) + (data,))
+        elif tag == "#Td":
+            try:
+                dropped += int(rest)
+            except ValueError:
+                pass
+    return tsc_hz, names, records, dropped
+
+
+def to_chrome(tsc_hz, names, records, dropped):
+    if not records:
+        return {"traceEvents": [], "displayTimeUnit": "ns"}
+    scale = 1e6 / tsc_hz if tsc_hz else 1e-3  # ticks -> us
+    base = min((r[0] for r in records if r[4] != KIND_PAYLOAD), default=0)
+    events = []
+    kv_event = None
+    kv = b""
+    for tsc, span, parent, name_id, kind, chunk_len, arg, raw in records:
+        if kind == KIND_PAYLOAD:
+            # Bytes of the preceding event's key/value payload
+            if kv_event is not None:
+                kv += raw[: min(chunk_len, PAYLOAD_CHUNK)]
+                kv_event["args"]["kv"] = kv.decode("utf-8", "replace")
+            continue
+        kv_event = None
+        ts = (tsc - base) * scale
+        name = names.get(name_id, f"name#{name_id}")
+        ev = {"name": name or "?", "ts": ts, "pid": 1, "tid": 1, "cat": "guest"}
+        if kind == KIND_BEGIN:
+            ev["ph"] = "B"
+            ev["args"] = {"span": span, "parent": parent}
+        elif kind == KIND_END:
+            ev["ph"] = "E"
+        elif kind == KIND_EVENT:
+            ev["ph"] = "i"
+            ev["s"] = "t"
+            ev["args"] = {"span": span}
+            if arg:
+                kv_event = ev
+                kv = b""
+        else:
+            continue
+        events.append(ev)
+    out = {"traceEvents": events, "displayTimeUnit": "ns"}
+    out["metadata"] = {"tsc_hz": tsc_hz, "dropped": dropped}
+    return out
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log")
+    parser.add_argument("-o", "--output")
+    args = parser.parse_args(argv)
+
+    with open(args.log, "r", encoding="utf-8", errors="replace") as f:
+        tsc_hz, names, records, dropped = parse_log(f)
+
+    trace = to_chrome(tsc_hz, names, records, dropped)
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+        sys.stdout.write("\n")
+
+    print(f"{len(records)} records, {dropped} dropped", file=sys.stderr)
+    if not tsc_hz:
+        print("warning: no #Th header; timestamps are raw TSC ticks / 1000", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -1,9 +1,14 @@
 import ukernel
 
-def heartbeat():
-    for i in range(3):
-        ukernel.log("python heartbeat " + str(i))
-        ukernel.sleep_ms(100)
+try:
+    import asyncio
+except ImportError:
+    # Kernel image without the frozen asyncio package: run sequentially
+    asyncio = None
+
+SERVE_PORTS = (7001, 7002, 7003)
+SERVE_MS = 300
+
 
 def net_demo():
     ukernel.log("python net: starting UDP demo")
@@ -14,13 +19,71 @@ def net_demo():
     ukernel.net_close(sock)
     ukernel.log("python net: done")
 
+
+def heartbeat_sync():
+    for i in range(3):
+        ukernel.log("python heartbeat " + str(i))
+        ukernel.sleep_ms(100)
+
+
+async def heartbeat():
+    for i in range(3):
+        ukernel.log("python heartbeat " + str(i))
+        await asyncio.sleep_ms(100)
+
+
+async def recv_into(sock, buf):
+    # Park this task on the socket in the event loop's poll set until a
+    # datagram is queued
+    while True:
+        n = ukernel.net_recv_into(sock, buf)
+        if n is not None:
+            return n
+        yield asyncio.core._io_queue.queue_read(sock)
+
+
+async def serve(port, ms):
+    # One task per socket; all of them wait in the same kernel io_set_wait
+    sock = ukernel.net_udp_socket()
+    ukernel.net_bind(sock, ukernel.net_addr("0.0.0.0", port))
+    buf = bytearray(1472)
+    count = 0
+    total = 0
+    end = ukernel.time_ms() + ms
+    try:
+        while True:
+            left = end - ukernel.time_ms()
+            if left <= 0:
+                break
+            try:
+                total += await asyncio.wait_for_ms(recv_into(sock, buf), left)
+            except asyncio.TimeoutError:
+                break
+            count += 1
+    finally:
+        ukernel.net_close(sock)
+    ukernel.log("python net: port " + str(port) + " got " + str(count) + " datagrams, " + str(total) + " bytes")
+
+
+async def main_async():
+    servers = [asyncio.create_task(serve(port, SERVE_MS)) for port in SERVE_PORTS]
+    await heartbeat()
+    net_demo()
+    for task in servers:
+        await task
+
+
 def main():
     ukernel.log("python asyncio starting")
     ukernel.log("ukernel version: " + ukernel.version())
     t0 = ukernel.time_ms()
     ukernel.log("boot time: " + str(t0) + " ms")
-    heartbeat()
-    net_demo()
+    if asyncio:
+        asyncio.run(main_async())
+    else:
+        heartbeat_sync()
+        net_demo()
     ukernel.log("python asyncio done")
 
+
 main()
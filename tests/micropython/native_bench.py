@@ -0,0 +1,184 @@
+# Bytecode vs @micropython.native vs @micropython.viper on the tight loops
+# workloads run: Internet checksum, decimal field parsing, header crafting.
+# Run it as the entrypoint, e.g.
+#
+#   zig build -Dprofile=net -Dentry-source=tests/micropython/native_bench.py
+#
+# Each line reports ms per variant and the speedup over bytecode.
+import ukernel
+
+ROUNDS = 200
+
+
+def csum_bc(buf, n):
+    s = 0
+    i = 0
+    while i < n:
+        s += (buf[i] << 8) | buf[i + 1]
+        i += 2
+    while s >> 16:
+        s = (s & 0xFFFF) + (s >> 16)
+    return s ^ 0xFFFF
+
+
+@micropython.native
+def csum_native(buf, n):
+    s = 0
+    i = 0
+    while i < n:
+        s += (buf[i] << 8) | buf[i + 1]
+        i += 2
+    while s >> 16:
+        s = (s & 0xFFFF) + (s >> 16)
+    return s ^ 0xFFFF
+
+
+@micropython.viper
+def csum_viper(buf, n: int) -> int:
+    p = ptr8(buf)
+    s = 0
+    i = 0
+    while i < n:
+        s += (p[i] << 8) | p[i + 1]
+        i += 2
+    while s >> 16:
+        s = (s & 0xFFFF) + (s >> 16)
+    return s ^ 0xFFFF
+
+
+def parse_bc(buf, n):
+    total = 0
+    v = 0
+    i = 0
+    while i < n:
+        c = buf[i]
+        if c == 44:
+            total += v
+            v = 0
+        else:
+            v = v * 10 + (c - 48)
+        i += 1
+    return total + v
+
+
+@micropython.native
+def parse_native(buf, n):
+    total = 0
+    v = 0
+    i = 0
+    while i < n:
+        c = buf[i]
+        if c == 44:
+            total += v
+            v = 0
+        else:
+            v = v * 10 + (c - 48)
+        i += 1
+    return total + v
+
+
+@micropython.viper
+def parse_viper(buf, n: int) -> int:
+    p = ptr8(buf)
+    total = 0
+    v = 0
+    i = 0
+    while i < n:
+        c = p[i]
+        if c == 44:
+            total += v
+            v = 0
+        else:
+            v = v * 10 + (c - 48)
+        i += 1
+    return total + v
+
+
+def craft_bc(out, n):
+    i = 0
+    while i < n:
+        port = 1024 + (i & 1023)
+        out[0] = port >> 8
+        out[1] = port & 0xFF
+        out[2] = 0x23
+        out[3] = 0x28
+        out[4] = 0
+        out[5] = 28
+        out[6] = 0
+        out[7] = 0
+        i += 1
+    return out[1]
+
+
+@micropython.native
+def craft_native(out, n):
+    i = 0
+    while i < n:
+        port = 1024 + (i & 1023)
+        out[0] = port >> 8
+        out[1] = port & 0xFF
+        out[2] = 0x23
+        out[3] = 0x28
+        out[4] = 0
+        out[5] = 28
+        out[6] = 0
+        out[7] = 0
+        i += 1
+    return out[1]
+
+
+@micropython.viper
+def craft_viper(out, n: int) -> int:
+    p = ptr8(out)
+    i = 0
+    while i < n:
+        port = 1024 + (i & 1023)
+        p[0] = port >> 8
+        p[1] = port & 0xFF
+        p[2] = 0x23
+        p[3] = 0x28
+        p[4] = 0
+        p[5] = 28
+        p[6] = 0
+        p[7] = 0
+        i += 1
+    return p[1]
+
+
+def timed(fn, arg, n):
+    t0 = ukernel.time_ms()
+    r = 0
+    for _ in range(ROUNDS):
+        r = fn(arg, n)
+    return ukernel.time_ms() - t0, r
+
+
+def ratio(base, t):
+    q = base * 10 // (t if t > 0 else 1)
+    return str(q // 10) + "." + str(q % 10)
+
+
+def run(name, variants, arg, n):
+    base, expect = timed(variants[0], arg, n)
+    line = "bench " + name + " bytecode=" + str(base) + "ms"
+    for label, fn in (("native", variants[1]), ("viper", variants[2])):
+        t, r = timed(fn, arg, n)
+        line += " " + label + "=" + str(t) + "ms x" + ratio(base, t)
+        if r != expect:
+            line += " MISMATCH"
+    ukernel.log(line)
+
+
+def main():
+    packet = bytearray(1500)
+    for i in range(len(packet)):
+        packet[i] = (i * 7) & 0xFF
+    digits = b"1234,56789,42,7,99999,31415,2718,1,0,65535," * 8
+    header = bytearray(8)
+
+    run("checksum", (csum_bc, csum_native, csum_viper), packet, len(packet))
+    run("parse", (parse_bc, parse_native, parse_viper), digits, len(digits))
+    run("craft", (craft_bc, craft_native, craft_viper), header, 1500)
+
+
+main()